@@ -0,0 +1,176 @@
+// DGO_VKarena.h - Память для разбора JSON без кучи
+// Документ ArduinoJson берет память у VkArena: куски идут подряд из буфера, размер которого
+// задан при компиляции, а когда уничтожен последний документ на арене, буфер снова пуст целиком.
+// Не хватило буфера - кусок берется из кучи (счетчик overflows()), ответ VK не теряется
+
+#ifndef DGO_VKARENA_H
+#define DGO_VKARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <stdlib.h>
+
+#define VK_ARENA_ALIGN 8             // Выравнивание кусков; перед каждым - заголовок с размером
+
+// Арена без буфера (N = 0) - та же куча, что у JsonDocument по умолчанию
+class VkArenaBase : public ArduinoJson::Allocator {
+private:
+    uint8_t* buf;
+    size_t cap;
+    size_t top;                 // Занято байт от начала буфера
+    size_t last;                // Начало последнего куска (его можно растянуть или вернуть), cap - нет
+    size_t peakUsed;
+    uint32_t overflowCount;
+    uint8_t users;              // Сколько документов сейчас живет на арене
+
+    static size_t align(size_t n) {
+        return (n + VK_ARENA_ALIGN - 1) & ~(size_t)(VK_ARENA_ALIGN - 1);
+    }
+
+    bool owns(const void* p) const {
+        uintptr_t a = (uintptr_t)p;
+        return cap && a >= (uintptr_t)buf && a < (uintptr_t)buf + cap;
+    }
+
+    static uint32_t& sizeOf(void* p) {
+        return *(uint32_t*)((uint8_t*)p - VK_ARENA_ALIGN);
+    }
+
+    void grow(size_t newTop) {
+        top = newTop;
+        if (top > peakUsed) {
+            peakUsed = top;
+        }
+    }
+
+protected:
+    VkArenaBase(uint8_t* storage, size_t size)
+        : buf(storage), cap(size), top(0), last(size), peakUsed(0), overflowCount(0), users(0) {}
+
+public:
+    VkArenaBase(const VkArenaBase&) = delete;
+    VkArenaBase& operator=(const VkArenaBase&) = delete;
+
+    void* allocate(size_t size) override {
+        size_t need = VK_ARENA_ALIGN + align(size);
+        if (cap - top >= need) {
+            uint8_t* block = buf + top;
+            *(uint32_t*)block = (uint32_t)size;
+            last = top;
+            grow(top + need);
+            return block + VK_ARENA_ALIGN;
+        }
+        if (cap) {
+            overflowCount++;
+        }
+        return malloc(size);
+    }
+
+    // Вернуть можно только последний кусок (так ArduinoJson отдает лишнее после чтения строки),
+    // остальное освобождается разом, когда уходит последний документ
+    void deallocate(void* p) override {
+        if (!owns(p)) {
+            free(p);
+            return;
+        }
+        if ((uint8_t*)p - VK_ARENA_ALIGN == buf + last) {
+            top = last;
+            last = cap;
+        }
+    }
+
+    void* reallocate(void* p, size_t size) override {
+        if (!p) {
+            return allocate(size);
+        }
+        if (!owns(p)) {
+            return realloc(p, size);
+        }
+        uint32_t old = sizeOf(p);
+        if ((uint8_t*)p - VK_ARENA_ALIGN == buf + last) {
+            // Последний кусок растет и сжимается на месте
+            size_t need = VK_ARENA_ALIGN + align(size);
+            if (cap - last >= need) {
+                sizeOf(p) = (uint32_t)size;
+                grow(last + need);
+                return p;
+            }
+        } else if (size <= old) {
+            sizeOf(p) = (uint32_t)size;
+            return p;
+        }
+        void* q = allocate(size);
+        if (q) {
+            memcpy(q, p, old < size ? old : size);
+            deallocate(p);
+        }
+        return q;
+    }
+
+    // Документ начал и закончил пользоваться ареной (VkArenaDoc)
+    void acquire() {
+        users++;
+    }
+
+    void release() {
+        if (users && --users == 0) {
+            top = 0;
+            last = cap;
+        }
+    }
+
+    size_t capacity() const {
+        return cap;
+    }
+
+    size_t used() const {
+        return top;
+    }
+
+    // Больше всего было занято: по нему подбирают размер в конфигурации бота
+    size_t peak() const {
+        return peakUsed;
+    }
+
+    // Сколько раз буфера не хватило и кусок взят из кучи
+    uint32_t overflows() const {
+        return overflowCount;
+    }
+};
+
+template <size_t N>
+class VkArena : public VkArenaBase {
+private:
+    alignas(VK_ARENA_ALIGN) uint8_t storage[N];
+
+public:
+    VkArena() : VkArenaBase(storage, N) {}
+};
+
+template <>
+class VkArena<0> : public VkArenaBase {
+public:
+    VkArena() : VkArenaBase(nullptr, 0) {}
+};
+
+// Документ на арене. Пока жив хоть один такой документ (вложенные запросы из обработчиков),
+// память арены не переиспользуется; уничтожен последний - арена пуста
+class VkArenaDoc : public JsonDocument {
+private:
+    VkArenaBase& arena;
+
+public:
+    explicit VkArenaDoc(VkArenaBase& a) : JsonDocument(&a), arena(a) {
+        arena.acquire();
+    }
+
+    ~VkArenaDoc() {
+        clear();
+        arena.release();
+    }
+
+    VkArenaDoc(const VkArenaDoc&) = delete;
+    VkArenaDoc& operator=(const VkArenaDoc&) = delete;
+};
+
+#endif // DGO_VKARENA_H
@@ -1,502 +1,3192 @@
-// DGO_VKbot.h - Библиотека для работы с VK API через Long Poll
-// Поддержка ESP8266 и ESP32
-// Автор: DGO
-// Версия: 1.0.0
-
-#ifndef DGO_VKBOT_H
-#define DGO_VKBOT_H
-
-#include <Arduino.h>
-#include <functional>
-#include <time.h>
-#include <ArduinoJson.h>
-
-// Поддержка ESP8266 и ESP32
-#ifdef ESP8266
-    #include <ESP8266WiFi.h>
-    #include <ESP8266HTTPClient.h>
-    #include <WiFiClientSecure.h>
-#elif defined(ESP32)
-    #include <WiFi.h>
-    #include <HTTPClient.h>
-    #include <WiFiClientSecure.h>
-#else
-    #error "Платформа не поддерживается. Используйте ESP8266 или ESP32"
-#endif
-
-// Типы событий VK Long Poll
-enum VkEventType {
-    VK_MESSAGE_NEW,
-    VK_MESSAGE_REPLY,
-    VK_MESSAGE_EDIT,
-    VK_UNKNOWN
-};
-
-// Структура сообщения
-struct VkMessage {
-    int id;
-    int from_id;
-    int peer_id;
-    String text;
-    unsigned long date;
-    
-    VkMessage() : id(0), from_id(0), peer_id(0), date(0) {}
-    VkMessage(String t, int p) : id(0), from_id(0), peer_id(p), text(t), date(0) {}
-};
-
-// Структура обновления
-struct VkUpdate {
-    VkEventType type;
-    VkMessage message;
-    
-    VkUpdate() : type(VK_UNKNOWN) {}
-};
-
-// Класс VK бота
-class DGO_VKbot {
-private:
-    String token;
-    String groupId;
-    WiFiClientSecure client;
-    
-    // Long Poll параметры
-    String lpServer;
-    String lpKey;
-    String lpTs;
-    
-    // Флаг запуска
-    bool started;
-    
-    // Callback для новых сообщений
-    std::function<void(VkUpdate&)> newMessageCallback;
-    
-    // Управление временем и таймзоной
-    time_t systemTime;              // Системное время в UTC
-    unsigned long lastTimeUpdate;   // Когда последний раз обновляли время (millis)
-    int timezoneOffset;             // Смещение таймзоны в секундах (по умолчанию 0 - UTC)
-    
-    // Кодирование URL
-    String urlEncode(String str) {
-        String encoded = "";
-        char c;
-        for (unsigned int i = 0; i < str.length(); i++) {
-            c = str.charAt(i);
-            if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
-                encoded += c;
-            } else if (c == ' ') {
-                encoded += "%20";
-            } else {
-                encoded += "%";
-                if (c < 16) encoded += "0";
-                encoded += String(c, HEX);
-            }
-        }
-        return encoded;
-    }
-    
-    // Получение Long Poll сервера
-    bool getLongPollServer() {
-        HTTPClient http;
-        String url = "https://api.vk.com/method/groups.getLongPollServer?";
-        url += "access_token=" + token;
-        url += "&group_id=" + groupId.substring(1); // Без минуса
-        url += "&v=5.199";
-        
-        http.begin(client, url);
-        http.setTimeout(5000);
-        
-        if (http.GET() == 200) {
-            String response = http.getString();
-            DynamicJsonDocument doc(2048);
-            DeserializationError error = deserializeJson(doc, response);
-            
-            if (!error && doc["response"].is<JsonObject>()) {
-                lpServer = doc["response"]["server"].as<String>();
-                lpKey = doc["response"]["key"].as<String>();
-                lpTs = doc["response"]["ts"].as<String>();
-                
-                Serial.print("[VK] Long Poll сервер: ");
-                Serial.println(lpServer);
-                return true;
-            } else if (doc["error"].is<JsonObject>()) {
-                Serial.print("[VK] API ошибка: ");
-                Serial.println(doc["error"]["error_msg"].as<String>());
-            }
-        }
-        
-        http.end();
-        Serial.println("[VK] Ошибка получения Long Poll сервера");
-        return false;
-    }
-    
-    // Обработка Long Poll событий
-    bool processLongPoll() {
-        HTTPClient http;
-        String url = lpServer + "?act=a_check&key=" + lpKey + 
-                    "&ts=" + lpTs + "&wait=25&mode=2&version=3";
-        
-        http.begin(client, url);
-        http.setTimeout(30000); // 30 секунд максимум
-        
-        int httpCode = http.GET();
-        
-        if (httpCode == 200) {
-            String response = http.getString();
-            DynamicJsonDocument doc(4096);
-            DeserializationError error = deserializeJson(doc, response);
-            
-            if (!error) {
-                // Обновляем ts для следующего запроса
-                if (doc["ts"].is<String>()) {
-                    lpTs = doc["ts"].as<String>();
-                }
-                
-                // Проверяем на ошибки Long Poll (failed, pts)
-                if (doc["failed"].is<int>()) {
-                    int failed = doc["failed"].as<int>();
-                    if (failed == 1) {
-                        // Нужно обновить ts
-                        if (doc["ts"].is<String>()) {
-                            lpTs = doc["ts"].as<String>();
-                        }
-                        http.end();
-                        return true;
-                    } else if (failed == 2 || failed == 3) {
-                        // Нужно переподключиться
-                        Serial.println("[VK] Long Poll требует переподключения");
-                        http.end();
-                        return getLongPollServer();
-                    }
-                }
-                
-                // Обрабатываем события
-                if (doc["updates"].is<JsonArray>()) {
-                    JsonArray updates = doc["updates"].as<JsonArray>();
-                    
-                    for (JsonObject update : updates) {
-                        VkUpdate vkUpdate;
-                        String type = update["type"].as<String>();
-                        
-                        if (type == "message_new") {
-                            vkUpdate.type = VK_MESSAGE_NEW;
-                            JsonObject msg = update["object"]["message"];
-                            vkUpdate.message.id = msg["id"].as<int>();
-                            vkUpdate.message.from_id = msg["from_id"].as<int>();
-                            vkUpdate.message.peer_id = msg["peer_id"].as<int>();
-                            vkUpdate.message.text = msg["text"].as<String>();
-                            vkUpdate.message.date = msg["date"].as<unsigned long>();
-                            
-                            // Вызываем callback если есть
-                            if (newMessageCallback) {
-                                newMessageCallback(vkUpdate);
-                            }
-                        }
-                    }
-                    http.end();
-                    return true;
-                }
-            } else {
-                Serial.print("[VK] JSON ошибка: ");
-                Serial.println(error.c_str());
-            }
-        } else if (httpCode == -1) {
-            // Таймаут - нормально для Long Poll
-            http.end();
-            return true;
-        } else {
-            // Серверная ошибка - переподключаемся
-            Serial.print("[VK] Long Poll HTTP ошибка: ");
-            Serial.println(httpCode);
-            delay(1000);
-            http.end();
-            return getLongPollServer();
-        }
-        
-        http.end();
-        return false;
-    }
-
-public:
-    // Конструктор
-    DGO_VKbot() : started(false), systemTime(0), lastTimeUpdate(0), timezoneOffset(0) {
-        client.setInsecure();
-    }
-    
-    // Установить токен
-    void setToken(String t) {
-        token = t;
-    }
-    
-    // Установить ID группы (с минусом!)
-    void setGroupId(String id) {
-        groupId = id;
-    }
-    
-    // Запуск бота
-    bool begin() {
-        if (token.length() == 0 || groupId.length() == 0) {
-            Serial.println("[VK] Установите токен и ID группы!");
-            return false;
-        }
-        
-        if (!getLongPollServer()) {
-            return false;
-        }
-        
-        started = true;
-        Serial.println("[VK] Бот запущен с Long Poll");
-        return true;
-    }
-    
-    // Прикрепить обработчик сообщений
-    void attach(std::function<void(VkUpdate&)> callback) {
-        newMessageCallback = callback;
-    }
-    
-    // Отправить сообщение
-    bool sendMessage(VkMessage msg) {
-        if (!started) {
-            Serial.println("[VK] Бот не запущен!");
-            return false;
-        }
-        
-        HTTPClient http;
-        String url = "https://api.vk.com/method/messages.send?";
-        url += "access_token=" + token;
-        url += "&peer_id=" + String(msg.peer_id);
-        url += "&message=" + urlEncode(msg.text);
-        url += "&random_id=" + String(random(1000000));
-        url += "&v=5.199";
-        
-        http.begin(client, url);
-        http.setTimeout(5000);
-        int httpCode = http.GET();
-        
-        bool success = false;
-        if (httpCode == 200) {
-            String response = http.getString();
-            DynamicJsonDocument doc(512);
-            DeserializationError error = deserializeJson(doc, response);
-            
-            if (!error) {
-                if (doc["response"].is<int>()) {
-                    success = true;
-                } else if (doc["error"].is<JsonObject>()) {
-                    Serial.print("[VK] Ошибка отправки: ");
-                    Serial.print(doc["error"]["error_code"].as<int>());
-                    Serial.print(" - ");
-                    Serial.println(doc["error"]["error_msg"].as<String>());
-                }
-            }
-        } else {
-            Serial.print("[VK] HTTP ошибка отправки: ");
-            Serial.println(httpCode);
-        }
-        
-        http.end();
-        return success;
-    }
-    
-    // Быстрая отправка (перегрузка)
-    bool sendMessage(String text, int peer_id) {
-        VkMessage msg(text, peer_id);
-        return sendMessage(msg);
-    }
-    
-    // Получить время сервера VK
-    unsigned long getServerTime() {
-        if (!started) {
-            Serial.println("[VK] Бот не запущен, невозможно получить время");
-            return 0;
-        }
-        
-        HTTPClient http;
-        String url = "https://api.vk.com/method/utils.getServerTime?";
-        url += "access_token=" + token;
-        url += "&v=5.199";
-        
-        http.begin(client, url);
-        http.setTimeout(5000);
-        int httpCode = http.GET();
-        
-        unsigned long serverTime = 0;
-        if (httpCode == 200) {
-            String response = http.getString();
-            DynamicJsonDocument doc(512);
-            DeserializationError error = deserializeJson(doc, response);
-            
-            if (!error && doc["response"].is<unsigned long>()) {
-                serverTime = doc["response"].as<unsigned long>();
-            } else if (doc["error"].is<JsonObject>()) {
-                Serial.print("[VK] Ошибка получения времени: ");
-                Serial.println(doc["error"]["error_msg"].as<String>());
-            }
-        } else {
-            Serial.print("[VK] HTTP ошибка при получении времени: ");
-            Serial.println(httpCode);
-        }
-        
-        http.end();
-        return serverTime;
-    }
-    
-    // Тикер - обработать события
-    void tick() {
-        if (started) {
-            processLongPoll();
-        }
-    }
-    
-    // Проверить подключение
-    bool isStarted() {
-        return started;
-    }
-    
-    // === УПРАВЛЕНИЕ ВРЕМЕНЕМ И ТАЙМЗОНОЙ ===
-    
-    // Установить смещение таймзоны в секундах (например, 10800 для UTC+3)
-    bool setTimezoneOffset(int offsetSeconds) {
-        if (offsetSeconds < -43200 || offsetSeconds > 50400) {
-            Serial.print("[VK] Неверное значение таймзоны: ");
-            Serial.print(offsetSeconds);
-            Serial.println(" секунд (должно быть от -43200 до +50400)");
-            return false;
-        }
-        
-        timezoneOffset = offsetSeconds;
-        int hours = offsetSeconds / 3600;
-        int minutes = (abs(offsetSeconds) % 3600) / 60;
-        Serial.print("[VK] Таймзона установлена: UTC");
-        if (offsetSeconds >= 0) Serial.print("+");
-        Serial.print(hours);
-        if (minutes > 0) {
-            Serial.print(":");
-            if (minutes < 10) Serial.print("0");
-            Serial.print(minutes);
-        }
-        Serial.print(" (");
-        Serial.print(offsetSeconds);
-        Serial.println(" секунд)");
-        return true;
-    }
-    
-    // Установить таймзону в часах (например, 3 для UTC+3)
-    bool setTimezone(int offsetHours) {
-        if (offsetHours < -12 || offsetHours > 14) {
-            Serial.print("[VK] Неверное значение таймзоны: ");
-            Serial.print(offsetHours);
-            Serial.println(" часов (должно быть от -12 до +14)");
-            return false;
-        }
-        return setTimezoneOffset(offsetHours * 3600);
-    }
-    
-    // Получить текущее смещение таймзоны в секундах
-    int getTimezoneOffset() {
-        return timezoneOffset;
-    }
-    
-    // Синхронизировать время с сервером VK (UTC)
-    bool syncTime() {
-        if (!started) {
-            Serial.println("[VK] Бот не запущен, невозможно синхронизировать время");
-            return false;
-        }
-        
-        Serial.println("[VK] Синхронизация времени с сервером VK...");
-        
-        unsigned long vkTime = getServerTime();
-        if (vkTime == 0) {
-            Serial.println("[VK] Ошибка получения времени от VK API");
-            return false;
-        }
-        
-        systemTime = vkTime;
-        lastTimeUpdate = millis();
-        
-        struct tm *timeinfo_utc = gmtime(&systemTime);
-        if (timeinfo_utc != nullptr) {
-            char timeStr[30];
-            strftime(timeStr, sizeof(timeStr), "%d.%m.%Y %H:%M:%S UTC", timeinfo_utc);
-            Serial.print("[VK] Время синхронизировано: ");
-            Serial.print(systemTime);
-            Serial.print(" (");
-            Serial.print(timeStr);
-            Serial.print(")");
-            
-            if (timezoneOffset != 0) {
-                time_t localTime = systemTime + timezoneOffset;
-                struct tm *timeinfo_local = gmtime(&localTime);
-                if (timeinfo_local != nullptr) {
-                    strftime(timeStr, sizeof(timeStr), "%d.%m.%Y %H:%M:%S", timeinfo_local);
-                    Serial.print(", локальное: ");
-                    Serial.print(timeStr);
-                }
-            }
-            Serial.println();
-        }
-        
-        return true;
-    }
-    
-    // Получить текущее время с учетом таймзоны
-    time_t getCurrentTime() {
-        if (systemTime == 0) {
-            return 0;
-        }
-        
-        unsigned long elapsedSeconds = (millis() - lastTimeUpdate) / 1000;
-        time_t currentTime = systemTime + elapsedSeconds + timezoneOffset;
-        
-        return currentTime;
-    }
-    
-    // Получить текущее время как строку
-    String getCurrentTimeString() {
-        time_t currentTime = getCurrentTime();
-        
-        if (currentTime < 946684800) {
-            return "Время не синхронизировано";
-        }
-        
-        struct tm *timeinfo = gmtime(&currentTime);
-        if (timeinfo == nullptr) {
-            return "Ошибка получения времени";
-        }
-        
-        if (timeinfo->tm_hour > 23 || timeinfo->tm_min > 59 || timeinfo->tm_sec > 59) {
-            return "Некорректное время";
-        }
-        
-        char timeStr[30];
-        strftime(timeStr, sizeof(timeStr), "%d.%m.%Y %H:%M:%S", timeinfo);
-        return String(timeStr);
-    }
-    
-    // Получить секунды с начала дня (0-86399)
-    unsigned long getSecondsFromMidnight() {
-        time_t currentTime = getCurrentTime();
-        
-        if (currentTime < 946684800) {
-            return 0;
-        }
-        
-        struct tm *timeinfo = gmtime(&currentTime);
-        if (timeinfo == nullptr) {
-            return 0;
-        }
-        
-        if (timeinfo->tm_hour > 23 || timeinfo->tm_min > 59 || timeinfo->tm_sec > 59) {
-            return 0;
-        }
-        
-        return timeinfo->tm_hour * 3600 + timeinfo->tm_min * 60 + timeinfo->tm_sec;
-    }
-    
-    // Проверить, синхронизировано ли время
-    bool isTimeSynced() {
-        return (systemTime != 0);
-    }
-};
-
-#endif // DGO_VKBOT_H
+// DGO_VKbot.h - Библиотека для работы с VK API через Long Poll
+// Поддержка ESP8266 и ESP32
+// Автор: DGO
+// Версия: 1.0.0
+
+#ifndef DGO_VKBOT_H
+#define DGO_VKBOT_H
+
+#include <Arduino.h>
+#include <functional>
+#include <time.h>
+#include <ArduinoJson.h>
+
+// Поддержка ESP8266 и ESP32
+#ifdef ESP8266
+    #include <ESP8266WiFi.h>
+    #include <WiFiClientSecure.h>
+#elif defined(ESP32)
+    #include <WiFi.h>
+    #include <WiFiClientSecure.h>
+#elif defined(DGO_VKBOT_HOST)
+    #include <DGO_VKhost.h>          // Сборка на Linux, см. extras/host
+    #include <thread>
+#else
+    #error "Платформа не поддерживается. Используйте ESP8266 или ESP32"
+#endif
+
+#include "DGO_VKlog.h"
+#include "DGO_VKhttp.h"
+#include "DGO_VKstate.h"
+#include "DGO_VKring.h"
+#include "DGO_VKmetrics.h"
+#include "DGO_VKclock.h"
+#include "DGO_VKupload.h"
+#include "DGO_VKkeyboard.h"
+#include "DGO_VKprofiles.h"
+#include "DGO_VKarena.h"
+#include "DGO_VKlive.h"
+
+// Сетевая задача на отдельном ядре (ESP32) или в отдельном потоке (хост)
+#if defined(ESP32) || defined(DGO_VKBOT_HOST)
+#define VK_HAS_NET_TASK
+#endif
+
+// Параметры Long Poll
+#ifndef VK_LP_WAIT
+#define VK_LP_WAIT 25                // Сколько секунд сервер держит запрос
+#endif
+#define VK_LP_TIMEOUT_MARGIN 5000UL  // Сколько ждать ответа сверх wait
+#define VK_LP_BODY_TIMEOUT 5000UL
+#ifndef VK_LP_BODY_MAX
+#define VK_LP_BODY_MAX 8192          // Сколько байт тела Long Poll копится до разбора
+#endif
+#define VK_LP_RETRY_DELAY 1000UL
+
+// Параметры VK API (адрес можно поменять через setApiEndpoint())
+#define VK_API_HOST "api.vk.com"
+#define VK_API_PORT 443
+#define VK_API_VERSION "5.199"
+#define VK_API_TIMEOUT 5000UL
+
+// Очередь исходящих сообщений
+#ifndef VK_OUTBOX_SIZE
+#define VK_OUTBOX_SIZE 32
+#endif
+#define VK_EXECUTE_BATCH 25          // Максимум вызовов API в одном execute
+#define VK_BROADCAST_PEERS 100       // Получателей в одном messages.send (peer_ids)
+// Получателей рассылки в одном execute: VK отвечает объектом на каждого (~60 байт JSON)
+#ifndef VK_EXECUTE_PEERS
+#define VK_EXECUTE_PEERS 300
+#endif
+
+// Ошибки лимитов VK API и повторы
+#define VK_ERROR_TOO_MANY_REQUESTS 6 // Слишком много запросов в секунду
+#define VK_ERROR_FLOOD_CONTROL 9     // Слишком много однотипных действий
+#ifndef VK_MAX_RETRIES
+#define VK_MAX_RETRIES 8             // Попыток отправить сообщение из очереди
+#endif
+#define VK_SYNC_RETRIES 3            // Попыток для синхронных запросов
+#define VK_BACKOFF_BASE 1000UL       // Первая пауза после ошибки лимита
+#define VK_BACKOFF_MAX 60000UL       // Максимальная пауза
+
+// Интервалы сна pollOnce() для питания от батареи
+#ifndef VK_SLEEP_MIN
+#define VK_SLEEP_MIN 15000UL         // Во время переписки
+#endif
+#ifndef VK_SLEEP_MAX
+#define VK_SLEEP_MAX 600000UL        // В тишине интервал удваивается до этого значения
+#endif
+
+// Сетевая задача (startNetworkTask())
+#ifndef VK_TASK_EVENTS
+#define VK_TASK_EVENTS 16            // Кольцо событий задача -> loop() (степень двойки)
+#endif
+#ifndef VK_TASK_OUTGOING
+#define VK_TASK_OUTGOING 16          // Кольцо сообщений loop() -> задача (степень двойки)
+#endif
+#define VK_TASK_STACK 8192
+#define VK_TASK_PRIORITY 1
+
+// Типы событий VK Long Poll
+enum VkEventType {
+    VK_MESSAGE_NEW,         // Входящее сообщение
+    VK_MESSAGE_REPLY,       // Исходящее сообщение (ответ сообщества)
+    VK_MESSAGE_EDIT,        // Сообщение отредактировано
+    VK_MESSAGE_EVENT,       // Нажата callback кнопка
+    VK_MESSAGE_ALLOW,       // Пользователь разрешил сообщения от сообщества
+    VK_MESSAGE_DENY,        // Пользователь запретил сообщения от сообщества
+    VK_GROUP_JOIN,          // Вступление в сообщество
+    VK_GROUP_LEAVE,         // Выход из сообщества
+    VK_UNKNOWN
+};
+
+#define VK_EVENT_TYPES VK_UNKNOWN    // Число известных типов событий
+#define VK_EVENT_BIT(type) (1UL << (type))              // Маска типа для VkDefaultConfig::EVENTS
+#define VK_ALL_EVENTS ((1UL << VK_EVENT_TYPES) - 1)
+#define VK_PAYLOAD_SIZE 256          // payload кнопки у VK не длиннее 255 символов
+
+// Имена типов событий в ответе Long Poll (в порядке VkEventType)
+static const char* const VK_EVENT_NAMES[VK_EVENT_TYPES] = {
+    "message_new",
+    "message_reply",
+    "message_edit",
+    "message_event",
+    "message_allow",
+    "message_deny",
+    "group_join",
+    "group_leave"
+};
+
+// Тип события по имени, без создания String
+inline VkEventType vkEventType(const char* name) {
+    if (name) {
+        for (uint8_t i = 0; i < VK_EVENT_TYPES; i++) {
+            if (strcmp(name, VK_EVENT_NAMES[i]) == 0) {
+                return (VkEventType)i;
+            }
+        }
+    }
+    return VK_UNKNOWN;
+}
+
+// Состояния асинхронного Long Poll запроса
+enum VkPollState {
+    VK_POLL_IDLE,           // Запрос не начат
+    VK_POLL_SERVER,         // Ожидание нового сервера из очереди (execute)
+    VK_POLL_CONNECT,        // Подключение к серверу
+    VK_POLL_SEND,           // Отправка запроса
+    VK_POLL_WAIT_HEADERS,   // Ожидание ответа (сервер держит запрос до wait секунд)
+    VK_POLL_READ_BODY,      // Чтение тела ответа в буфер
+    VK_POLL_PARSE           // Разбор и обработка событий
+};
+
+// Структура сообщения
+// attachment - вложения для отправки через запятую ("photo-1_2_key,doc-1_3"), см. uploadPhoto()
+// keyboard - клавиатура для отправки (VkKeyboard::toJson() или VK_KEYBOARD_HIDE)
+// payload - payload нажатой обычной кнопки во входящем сообщении
+struct VkMessage {
+    int id;
+    int conversation_message_id;
+    int from_id;
+    int peer_id;
+    String text;
+    unsigned long date;
+    String attachment;
+    String keyboard;
+    String payload;
+    
+    VkMessage() : id(0), conversation_message_id(0), from_id(0), peer_id(0), date(0) {}
+    VkMessage(String t, int p) : id(0), conversation_message_id(0), from_id(0), peer_id(p), text(t), date(0) {}
+};
+
+// Структура обновления
+// message_new/reply/edit: заполнено message
+// message_event: user_id, event_id, payload, message.peer_id и message.conversation_message_id
+// command/command_arg - номер команды и аргумент из payload кнопки VkKeyboard (0 - не кнопка),
+// заполняются для message_event и для message_new, отправленного обычной кнопкой
+// message_allow/deny, group_join/leave: user_id (join_type - для group_join, self - для group_leave)
+// group_id - сообщество, которому пришло событие (для VkHub с несколькими группами)
+struct VkUpdate {
+    VkEventType type;
+    VkMessage message;
+    int user_id;
+    String event_id;
+    String payload;
+    String join_type;
+    bool self;
+    long group_id;
+    uint16_t command;
+    long command_arg;
+    
+    VkUpdate() : type(VK_UNKNOWN), user_id(0), self(false), group_id(0), command(0), command_arg(0) {}
+};
+
+// Строка без копии: указатель и длина (строка всегда заканчивается нулем)
+struct VkStr {
+    const char* ptr;
+    size_t len;
+    
+    VkStr() : ptr(""), len(0) {}
+    VkStr(const char* p, size_t n) : ptr(p), len(n) {}
+    explicit VkStr(const String& s) : ptr(s.c_str()), len(s.length()) {}
+    
+    const char* c_str() const { return ptr; }
+    const char* data() const { return ptr; }
+    size_t length() const { return len; }
+    bool isEmpty() const { return len == 0; }
+    
+    bool equals(const char* s) const {
+        return strlen(s) == len && memcmp(ptr, s, len) == 0;
+    }
+    
+    // Копия (выделяет память)
+    String toString() const {
+        return String(ptr);
+    }
+};
+
+// Сообщение внутри разобранного ответа Long Poll
+struct VkMessageView {
+    int id;
+    int conversation_message_id;
+    int from_id;
+    int peer_id;
+    VkStr text;
+    unsigned long date;
+    VkStr payload;
+    
+    VkMessageView() : id(0), conversation_message_id(0), from_id(0), peer_id(0), date(0) {}
+};
+
+// Событие без копий: строки указывают прямо в разобранный JSON и действительны только
+// до выхода из обработчика onView(). Чтобы сохранить событие дольше - toOwned()
+struct VkUpdateView {
+    VkEventType type;
+    VkMessageView message;
+    int user_id;
+    VkStr event_id;
+    VkStr payload;      // JSON как в VkUpdate::payload
+    VkStr join_type;
+    bool self;
+    long group_id;
+    uint16_t command;
+    long command_arg;
+    
+    VkUpdateView() : type(VK_UNKNOWN), user_id(0), self(false), group_id(0), command(0), command_arg(0) {}
+    
+    // Вид на уже скопированное событие (строки указывают в update)
+    explicit VkUpdateView(const VkUpdate& update)
+        : type(update.type), user_id(update.user_id), event_id(update.event_id), payload(update.payload),
+          join_type(update.join_type), self(update.self), group_id(update.group_id),
+          command(update.command), command_arg(update.command_arg) {
+        message.id = update.message.id;
+        message.conversation_message_id = update.message.conversation_message_id;
+        message.from_id = update.message.from_id;
+        message.peer_id = update.message.peer_id;
+        message.text = VkStr(update.message.text);
+        message.date = update.message.date;
+        message.payload = VkStr(update.message.payload);
+    }
+    
+    // Копия, которую можно хранить после обработчика
+    VkUpdate toOwned() const {
+        VkUpdate update;
+        update.type = type;
+        update.message.id = message.id;
+        update.message.conversation_message_id = message.conversation_message_id;
+        update.message.from_id = message.from_id;
+        update.message.peer_id = message.peer_id;
+        update.message.text = message.text.toString();
+        update.message.date = message.date;
+        update.message.payload = message.payload.toString();
+        update.user_id = user_id;
+        update.event_id = event_id.toString();
+        update.payload = payload.toString();
+        update.join_type = join_type.toString();
+        update.self = self;
+        update.group_id = group_id;
+        update.command = command;
+        update.command_arg = command_arg;
+        return update;
+    }
+};
+
+// Сообщение в очереди на отправку
+// С непустым event_id это ответ на нажатие callback-кнопки: text - всплывающее уведомление,
+// с conversation_message_id - новый текст уже отправленного сообщения (messages.edit)
+struct VkOutgoing {
+    uint32_t id;
+    int peer_id;
+    int user_id;
+    int conversation_message_id;
+    long random_id;
+    uint8_t attempts;   // Сколько раз уже получали ошибку лимита
+    uint32_t queuedAt;  // micros() постановки в очередь, для задержки отправки
+    String text;
+    String attachment;
+    String keyboard;
+    String event_id;
+    String peer_ids;    // Рассылка: получатели через запятую вместо peer_id
+    uint8_t recipients; // Сколько их в peer_ids (0 - обычное сообщение)
+    
+    VkOutgoing()
+        : id(0), peer_id(0), user_id(0), conversation_message_id(0), random_id(0), attempts(0), queuedAt(0),
+          recipients(0) {}
+};
+
+// Итог одного pollOnce()
+struct VkPollResult {
+    bool ok;                    // Long Poll ответил
+    uint16_t events;            // Сколько событий обработано
+    uint8_t sent;               // Сколько сообщений из очереди отправлено
+    unsigned long awakeMs;      // Сколько длился pollOnce() (время с включенным радио)
+    unsigned long sleepMs;      // Сколько можно спать
+    
+    VkPollResult() : ok(false), events(0), sent(0), awakeMs(0), sleepMs(0) {}
+};
+
+// Результат отправки сообщения из очереди
+struct VkSendResult {
+    uint32_t id;        // Номер, который вернул enqueueMessage()
+    int peer_id;
+    int message_id;     // ID отправленного сообщения (0 при ошибке и для рассылки)
+    int conversation_message_id;    // Номер в беседе: для одного получателя в peer_ids и правок
+    int error_code;     // 0 - успешно, иначе код ошибки VK API (-1 - нет ответа)
+    uint8_t recipients; // Рассылка (peer_id = 0): получателей в пачке
+    uint8_t failed;     // Из них не доставлено (например, 901 - запретил сообщения группы)
+};
+
+// Ограничитель частоты запросов к API (token bucket)
+// По умолчанию 17 запросов/с и запас 3 - не больше 20 запросов за любую секунду
+class VkRateLimiter {
+private:
+    uint16_t perSecond;
+    uint16_t burst;
+    uint32_t tokens;            // В тысячных долях запроса
+    unsigned long lastRefill;
+    unsigned long pausedSince;  // Пауза после ошибки лимита
+    unsigned long pause;
+    
+    void refill() {
+        unsigned long now = millis();
+        unsigned long elapsed = now - lastRefill;
+        uint32_t capacity = (uint32_t)burst * 1000UL;
+        lastRefill = now;
+        if (elapsed > capacity) {
+            elapsed = capacity;
+        }
+        tokens += elapsed * perSecond;
+        if (tokens > capacity) {
+            tokens = capacity;
+        }
+    }
+    
+public:
+    VkRateLimiter() : perSecond(17), burst(3), tokens(3000), lastRefill(0), pausedSince(0), pause(0) {}
+    
+    void setLimit(uint16_t requestsPerSecond, uint16_t maxBurst) {
+        perSecond = requestsPerSecond > 0 ? requestsPerSecond : 1;
+        burst = maxBurst > 0 ? maxBurst : 1;
+        tokens = 0;
+        lastRefill = millis();
+    }
+    
+    // Сколько мс ждать до следующего запроса (0 - можно сейчас)
+    unsigned long waitTime() {
+        unsigned long paused = millis() - pausedSince;
+        if (paused < pause) {
+            return pause - paused;
+        }
+        refill();
+        if (tokens >= 1000) {
+            return 0;
+        }
+        return (1000 - tokens + perSecond - 1) / perSecond;
+    }
+    
+    // Взять разрешение на запрос, если оно есть
+    bool tryAcquire() {
+        if (waitTime() > 0) {
+            return false;
+        }
+        tokens -= 1000;
+        return true;
+    }
+    
+    // Дождаться разрешения на запрос
+    void acquire() {
+        while (!tryAcquire()) {
+            delay(waitTime());
+        }
+    }
+    
+    // VK ответил ошибкой лимита: приостановить все запросы
+    void penalize(unsigned long ms) {
+        tokens = 0;
+        pausedSince = millis();
+        pause = ms;
+    }
+};
+
+#if defined(ESP8266) || defined(ESP32)
+// TLS клиент со своей сессией
+// После обрыва TLS сессия возобновляется без полного рукопожатия (ESP8266)
+class VkSecureClient : public WiFiClientSecure {
+#ifdef ESP8266
+    BearSSL::Session session;
+#endif
+public:
+    VkSecureClient() {
+        setInsecure();
+#ifdef ESP8266
+        setSession(&session);
+#endif
+    }
+};
+
+// Транспорт по умолчанию: WiFiClientSecure для https, WiFiClient для http
+class VkWiFiTransport : public VkTransport {
+public:
+    Client* createClient(bool secure) override {
+        if (secure) {
+            return new VkSecureClient();
+        }
+        return new WiFiClient();
+    }
+    
+    void destroyClient(Client* client, bool secure) override {
+        if (secure) {
+            delete static_cast<VkSecureClient*>(client);
+        } else {
+            delete static_cast<WiFiClient*>(client);
+        }
+    }
+};
+
+typedef VkWiFiTransport VkDefaultTransport;
+#endif
+
+// Конфигурация бота при компиляции: DGO_VKbotT<Config>
+// Свою конфигурацию наследуют от VkDefaultConfig и переопределяют только нужное:
+//   struct SensorConfig : VkDefaultConfig {
+//       enum { OUTBOX = 8, EVENTS = VK_EVENT_BIT(VK_MESSAGE_NEW), STATIC_EVENTS = EVENTS,
+//              LP_ARENA = 6144, API_ARENA = 1536, MESSAGE_SIZE = 160 };
+//       static void onUpdate(const VkUpdateView& update);
+//   };
+//   DGO_VKbotT<SensorConfig> bot;
+// С аренами и MESSAGE_SIZE после begin() опрос и отправка из очереди не обращаются к куче
+struct VkDefaultConfig {
+    enum {
+        OUTBOX = VK_OUTBOX_SIZE,            // Сообщений в очереди (до 255)
+        LP_WAIT = VK_LP_WAIT,               // wait Long Poll, секунд
+        EVENTS = VK_ALL_EVENTS,             // Какие типы событий разбираются (маска VK_EVENT_BIT)
+        STATIC_EVENTS = 0,                  // Какие из них идут в Config::onUpdate(), а не в on()/onView()
+        LP_ARENA = 0,                       // Байт под разбор ответа Long Poll, 0 - куча
+        API_ARENA = 0,                      // Байт под ответы VK API, 0 - куча
+        MESSAGE_SIZE = 0,                   // Байт текста на ячейку очереди, выделяются в begin(); 0 - по мере надобности
+        PROFILE_CACHE = VK_PROFILE_CACHE,
+        MEMBER_CACHE = VK_MEMBER_CACHE
+    };
+    
+    // Обработчик типов из STATIC_EVENTS: обычная функция, вызов без std::function.
+    // Строки события живут до выхода из обработчика, как у onView()
+    static void onUpdate(const VkUpdateView&) {}
+};
+
+template <class Config = VkDefaultConfig>
+class DGO_VKbotT;
+
+// Постоянное keep-alive соединение с одним хостом
+// Клиент создается транспортом при первом подключении
+template <class Bot>
+struct VkConnection {
+    VkTransport* transport;
+    Client* client;
+    bool secure;
+    VkHttpClient http;
+    unsigned long connects;     // Сколько раз открывали соединение
+    VkHistogram* connectTime;   // Куда записывать время подключения
+    bool shared;                // Соединением с API пользуются несколько ботов (VkHub)
+    Bot* busy;                  // Чья пачка из очереди сейчас ждет ответа
+    
+    VkConnection() : transport(nullptr), client(nullptr), secure(true), connects(0), connectTime(nullptr),
+                     shared(false), busy(nullptr) {}
+    
+    ~VkConnection() {
+        release();
+    }
+    
+    void setTransport(VkTransport* t) {
+        release();
+        transport = t;
+    }
+    
+    // Закрыть соединение и вернуть клиента транспорту
+    void release() {
+        if (client) {
+            http.stop();
+            transport->destroyClient(client, secure);
+            client = nullptr;
+        }
+    }
+    
+    // Открыть соединение или переиспользовать уже открытое
+    bool open(const String& host, uint16_t port, bool useTls) {
+        if (client && secure != useTls) {
+            release();
+        }
+        if (!client) {
+            client = transport ? transport->createClient(useTls) : nullptr;
+            if (!client) {
+                return false;
+            }
+            secure = useTls;
+            http.setClient(*client);
+        }
+        if (http.connected()) {
+            return http.connect(host, port);
+        }
+        connects++;
+        uint32_t start = micros();
+        if (!http.connect(host, port)) {
+            return false;
+        }
+        if (connectTime) {
+            connectTime->since(start);
+        }
+        return true;
+    }
+};
+
+// Класс VK бота (DGO_VKbot - с конфигурацией по умолчанию)
+template <class Config>
+class DGO_VKbotT {
+    static_assert(Config::OUTBOX > 0 && Config::OUTBOX < 256, "OUTBOX: от 1 до 255 сообщений");
+    static_assert(Config::PROFILE_CACHE > 0 && Config::PROFILE_CACHE < 256 &&
+                  Config::MEMBER_CACHE > 0 && Config::MEMBER_CACHE < 256, "Кэши профилей: от 1 до 255 записей");
+    
+#ifdef DGO_VKBOT_HOST
+    friend struct VkBenchAccess;    // Бенчмарки внутренних функций (extras/host/bench)
+#endif
+private:
+    String token;
+    String groupId;
+    long groupNum;                  // ID группы числом, без минуса (VkUpdate::group_id)
+    
+    // Транспорт объявлен раньше соединений: они возвращают ему клиентов в деструкторе
+    VkDefaultTransport defaultTransport;
+    
+    // Адрес API (на хосте - адрес mock сервера)
+    String apiHost;
+    uint16_t apiPort;
+    bool apiSecure;
+    
+    // Сохранение сервера, ключа и ts между перезагрузками (по умолчанию - RTC память)
+    VkRtcStore defaultStateStore;
+    VkStateStore* stateStore;
+    uint32_t stateCrc;              // CRC последнего сохраненного снимка
+    
+    // Соединения: отдельно для Long Poll и для api.vk.com
+    // api - свое apiConn или соединение другого бота (shareApi())
+    VkConnection<DGO_VKbotT> lpConn;
+    VkConnection<DGO_VKbotT> apiConn;
+    VkConnection<DGO_VKbotT>* api;
+    
+    // Long Poll параметры
+    String lpServer;
+    String lpKey;
+    String lpTs;
+    VkUrl lpUrl;
+    
+    // Состояние асинхронного Long Poll
+    VkPollState pollState;
+    unsigned long pollStateSince;   // Когда вошли в текущее состояние (millis)
+    unsigned long pollDelay;        // Пауза перед следующим запросом
+    bool pollReused;                // Запрос идет по переиспользованному соединению
+    bool needLongPollServer;        // Нужно заново получить сервер
+    bool lpTsLost;                  // Сервер потерял историю (failed 3), нужен новый ts
+    bool lpResumed;                 // Сервер и ключ восстановлены после перезагрузки, еще не проверены
+    bool blockingMode;              // Старый режим: tick() ждет ответа
+    uint8_t lpWait;                 // wait для a_check, секунд (pollOnce() ставит короткий)
+    uint32_t lpEvents;              // Сколько событий передано обработчикам
+    bool lpAnswered;                // Последний запрос Long Poll получил разобранный ответ
+    bool lpServerQueued;            // groups.getLongPollServer ждет следующего execute
+    bool lpServerInFlight;          // groups.getLongPollServer в отправленном execute
+    String lpBody;                  // Тело ответа Long Poll: разбирается, когда пришло целиком
+    
+    // Сон между pollOnce()
+    unsigned long sleepMin;
+    unsigned long sleepMax;
+    unsigned long sleepInterval;
+    VkPollResult lastPoll;
+    uint16_t tickSlice;             // Сколько мс tick() может работать в асинхронном режиме
+    
+    // Фильтры ArduinoJson: из ответа разбираются только нужные поля
+    JsonDocument lpFilter;
+    JsonDocument apiFilter;
+    
+    // Память документов: ответ Long Poll и ответы API разбираются каждый в свою арену
+    VkArena<Config::LP_ARENA> lpArena;
+    VkArena<Config::API_ARENA> apiArena;
+    
+    // Флаг запуска
+    bool started;
+    
+    // Обработчики событий по типам (VK_MESSAGE_NEW - обработчик из attach())
+    // На тип - один обработчик: с копией события (on()) или без копий (onView())
+    std::function<void(VkUpdate&)> eventHandlers[VK_EVENT_TYPES];
+    std::function<void(const VkUpdateView&)> viewHandlers[VK_EVENT_TYPES];
+    
+    // Вызывается на каждом tick() и pollOnce() (например, VkScheduler)
+    std::function<void()> tickHook;
+    
+    // Очередь исходящих сообщений (кольцевой буфер)
+    VkOutgoing outbox[Config::OUTBOX];
+    uint8_t outboxHead;
+    uint8_t outboxCount;
+    uint8_t outboxInFlight;         // Сколько сообщений из головы очереди сейчас в запросе
+    uint32_t outboxNextId;
+    unsigned long outboxSince;      // Когда отправили пачку или начали паузу (millis)
+    unsigned long outboxPause;      // Пауза перед следующей пачкой
+    bool outboxReused;
+    uint32_t outboxQueued;          // Сколько сообщений поставлено (меняет loop())
+    std::atomic<uint32_t> outboxDone;   // Сколько отправлено или отброшено (меняет сеть)
+    std::function<void(const VkSendResult&)> sendCallback;
+    VkLiveMessage* lives[VK_LIVE_MESSAGES];     // Живые сообщения, которым нужны отчеты
+    uint8_t liveCount;
+    String batchCode;               // Код execute (с MESSAGE_SIZE память остается между пачками)
+    
+    // Кольца между сетевой задачей и loop(), есть только пока задача запущена
+    VkRing<VkUpdate, VK_TASK_EVENTS>* eventRing;
+    VkRing<VkOutgoing, VK_TASK_OUTGOING>* outRing;
+    VkRing<VkSendResult, VK_TASK_EVENTS>* resultRing;
+    std::atomic<bool> taskRunning;
+#ifdef DGO_VKBOT_HOST
+    std::thread netThread;
+#elif defined(ESP32)
+    TaskHandle_t netTask;
+    std::atomic<bool> taskExited;
+#endif
+    
+    // Общий лимит запросов к api.vk.com
+    VkRateLimiter apiLimiter;
+    
+    // Счетчики и гистограммы (getMetrics())
+    VkMetrics metrics;
+    uint32_t pollSentUs;            // Когда отправили запрос Long Poll (micros)
+    
+    // Управление временем и таймзоной
+    VkClock clock;                  // UTC по заголовкам Date и датам сообщений
+    int timezoneOffset;             // Смещение таймзоны в секундах (по умолчанию 0 - UTC)
+    
+    // Кэш профилей и участников бесед (getProfile(), isChatMember())
+    VkLruCache<VkProfile, Config::PROFILE_CACHE> profiles;
+    VkLruCache<VkMember, Config::MEMBER_CACHE> members;
+    bool profilePrefetch;           // Запрашивать профили авторов пачки событий заранее
+    int profileQueue[Config::PROFILE_CACHE];    // Чьи профили запросит следующий execute
+    uint8_t profileQueued;
+    uint8_t profilesInFlight;       // Сколько id из начала profileQueue в отправленном execute
+    std::function<void(const VkProfile&)> profileCallback;
+    
+    // Выполнить POST запрос к API по постоянному соединению и разобрать ответ
+    // Тело формы кодируется прямо в сокет, без промежуточных строк
+    // Возвращает HTTP код, 0 при таймауте, <0 при ошибке соединения
+    int apiRequestOnce(const char* method, const VkForm& form, JsonDocument& doc) {
+        VkHttpClient& http = api->http;
+        char path[48];
+        snprintf(path, sizeof(path), "/method/%s", method);
+        
+        // Вторая попытка нужна, если сервер успел закрыть keep-alive соединение
+        for (int attempt = 0; attempt < 2; attempt++) {
+            bool reused = http.connected();
+            if (!api->open(apiHost, apiPort, apiSecure)) {
+                metrics.connectErrors++;
+                return -1;
+            }
+            
+            int httpCode = -1;
+            if (http.sendForm(path, form)) {
+                httpCode = http.readHeaders(VK_API_TIMEOUT);
+            }
+            if (httpCode > 0) {
+                clockSample(http, false);
+            }
+            if (httpCode < 0 && reused) {
+                http.stop();
+                continue;
+            }
+            if (httpCode <= 0) {
+                http.stop();
+                metrics.httpErrors++;
+                return httpCode;
+            }
+            
+            if (httpCode == 200) {
+                http.setTimeout(VK_API_TIMEOUT);
+                DeserializationError error = deserializeJson(doc, http, DeserializationOption::Filter(apiFilter));
+                if (error) {
+                    metrics.jsonErrors++;
+                    VK_LOGE("JSON ошибка: %s", error.c_str());
+                }
+                metrics.sampleHeap();
+            } else {
+                metrics.httpErrors++;
+            }
+            http.finish();
+            return httpCode;
+        }
+        return -1;
+    }
+    
+    // Запрос к API с учетом лимита частоты
+    // При ошибке 6 (слишком много запросов) повторяет запрос с растущей паузой
+    // Токен и версия API добавляются в форму здесь
+    int apiRequest(const char* method, VkForm& form, JsonDocument& doc, bool retryRateLimit = true) {
+        // Соединение одно: сначала дожидаемся ответа на пачку из очереди
+        // (своей или другого бота, с которым соединение общее)
+        while (api->busy) {
+            if (!api->busy->stepOutbox()) {
+                delay(1);
+            }
+        }
+        
+        form.add("access_token", token);
+        form.add("v", VK_API_VERSION);
+        
+        for (uint8_t attempt = 1; ; attempt++) {
+            apiLimiter.acquire();
+            int httpCode = apiRequestOnce(method, form, doc);
+            int errorCode = doc["error"]["error_code"] | 0;
+            metrics.apiCalls++;
+            if (errorCode != 0) {
+                metrics.countApiError(errorCode);
+            }
+            if (httpCode != 200 || errorCode != VK_ERROR_TOO_MANY_REQUESTS ||
+                !retryRateLimit || attempt >= VK_SYNC_RETRIES) {
+                return httpCode;
+            }
+            
+            unsigned long wait = backoffDelay(attempt);
+            apiLimiter.penalize(wait);
+            VK_LOGW("Превышен лимит запросов, повтор через %lu мс", wait);
+            doc.clear();
+        }
+    }
+    
+    // Ошибка лимита: запрос можно повторить позже
+    static bool isRateLimitError(int errorCode) {
+        return errorCode == VK_ERROR_TOO_MANY_REQUESTS || errorCode == VK_ERROR_FLOOD_CONTROL;
+    }
+    
+    // Экспоненциальная пауза перед повтором (с небольшим случайным разбросом)
+    static unsigned long backoffDelay(uint8_t attempt) {
+        uint8_t shift = attempt > 1 ? attempt - 1 : 0;
+        if (shift > 6) shift = 6;
+        unsigned long wait = VK_BACKOFF_BASE << shift;
+        if (wait > VK_BACKOFF_MAX) {
+            wait = VK_BACKOFF_MAX;
+        }
+        return wait + random(wait / 4 + 1);
+    }
+    
+    // Подвести часы по заголовку Date ответа
+    // Long Poll сервер держит запрос до wait секунд, поэтому время запроса там не показатель
+    void clockSample(VkHttpClient& http, bool longPoll) {
+        uint32_t date = http.getDate();
+        if (date == 0) {
+            return;
+        }
+        if (longPoll) {
+            clock.addLongPollDate(http.getHeadersTime(), date);
+        } else {
+            clock.addHttpDate(http.getHeadersTime(), date, http.getRoundTrip());
+        }
+    }
+    
+    // Отправить файл на сервер загрузки VK (POST multipart/form-data) и разобрать ответ
+    // Соединение берется у Long Poll: третье TLS соединение ESP8266 не потянет по памяти.
+    // Ожидающий a_check прерывается без потерь (ts прежний), Long Poll потом переподключится
+    bool uploadFile(const String& url, const char* field, VkUploadSource& source,
+                    const String& filename, JsonDocument& doc) {
+        VkUrl target;
+        if (!target.parse(url)) {
+            VK_LOGE("Неверный адрес сервера загрузки");
+            return false;
+        }
+        // Запрос Long Poll в полете или ответ не дочитан (загрузка из обработчика события):
+        // такое соединение для другого запроса не годится, даже если хост тот же
+        if (pollState != VK_POLL_IDLE && pollState != VK_POLL_SERVER) {
+            lpConn.http.stop();
+            if (pollState != VK_POLL_PARSE) {
+                finishPoll(0);
+            }
+        }
+        
+        VkHttpClient& http = lpConn.http;
+        if (!lpConn.open(target.host, target.port, target.secure)) {
+            metrics.connectErrors++;
+            VK_LOGE("Ошибка подключения к серверу загрузки");
+            http.stop();
+            return false;
+        }
+        
+        VkMultipart body(field, filename);
+        uint8_t chunk[VK_UPLOAD_CHUNK];
+        int httpCode = -1;
+        if (http.beginRequest("POST", target.path.c_str(), (long)body.length(source.size()),
+                              body.getContentType()) &&
+            body.writeTo(http, source, chunk, sizeof(chunk)) &&
+            http.endRequest()) {
+            httpCode = http.readHeaders(VK_UPLOAD_TIMEOUT);
+        }
+        
+        bool ok = false;
+        if (httpCode == 200) {
+            // Ответ фото: server, photo, hash; документа: file
+            JsonDocument filter;
+            filter["server"] = true;
+            filter["photo"] = true;
+            filter["hash"] = true;
+            filter["file"] = true;
+            filter["error"] = true;
+            http.setTimeout(VK_API_TIMEOUT);
+            DeserializationError error = deserializeJson(doc, http, DeserializationOption::Filter(filter));
+            if (error) {
+                metrics.jsonErrors++;
+                VK_LOGE("JSON ошибка: %s", error.c_str());
+            } else if (!doc["error"].isNull()) {
+                VK_LOGE("Сервер загрузки вернул ошибку: %s", doc["error"].as<String>().c_str());
+            } else {
+                ok = true;
+            }
+        } else {
+            if (httpCode > 0) {
+                metrics.httpErrors++;
+            }
+            VK_LOGE("HTTP ошибка загрузки файла: %d", httpCode);
+        }
+        // Long Poll откроет свое соединение заново
+        http.stop();
+        return ok;
+    }
+    
+    // Вызов API: ответ или сообщение об ошибке
+    bool callMethod(const char* method, VkForm& form, JsonDocument& doc) {
+        int httpCode = apiRequest(method, form, doc);
+        if (httpCode == 200 && !doc["response"].isNull()) {
+            return true;
+        }
+        if (httpCode != 200) {
+            VK_LOGE("Ошибка %s: %d", method, httpCode);
+        } else {
+            VK_LOGE("Ошибка %s: %d - %s", method, doc["error"]["error_code"].as<int>(),
+                    doc["error"]["error_msg"] | "");
+        }
+        return false;
+    }
+    
+    // Цепочка загрузки: адрес сервера -> файл -> сохранение -> строка вложения
+    // photo: photos.getMessagesUploadServer, поле photo, photos.saveMessagesPhoto
+    // документ: docs.getMessagesUploadServer, поле file, docs.save
+    String uploadAttachment(bool photo, int peer_id, VkUploadSource& source, const String& filename) {
+        if (!started) {
+            VK_LOGE("Бот не запущен!");
+            return String();
+        }
+        if (outRing) {
+            // Соединение с API у сетевой задачи, а загрузка блокирующая
+            VK_LOGE("Загрузка файлов недоступна при запущенной сетевой задаче");
+            return String();
+        }
+        
+        uint32_t start = micros();
+        String attachment;
+        VkArenaDoc doc(apiArena);
+        {
+            VkForm form;
+            form.add("peer_id", (long)peer_id);
+            if (!photo) {
+                form.add("type", "doc");
+            }
+            if (!callMethod(photo ? "photos.getMessagesUploadServer" : "docs.getMessagesUploadServer", form, doc)) {
+                metrics.uploadErrors++;
+                return String();
+            }
+        }
+        String url = doc["response"]["upload_url"].as<String>();
+        doc.clear();
+        
+        if (!uploadFile(url, photo ? "photo" : "file", source, filename, doc)) {
+            metrics.uploadErrors++;
+            return String();
+        }
+        
+        // Поля ответа сервера загрузки живут в doc, пока идет сохранение
+        VkForm form;
+        VkArenaDoc saved(apiArena);
+        bool ok;
+        if (photo) {
+            String photoJson = doc["photo"].as<String>();
+            String hash = doc["hash"].as<String>();
+            form.add("server", doc["server"].as<long>());
+            form.add("photo", photoJson);
+            form.add("hash", hash);
+            ok = callMethod("photos.saveMessagesPhoto", form, saved);
+            if (ok) {
+                JsonObject p = saved["response"][0];
+                attachment = "photo";
+                attachment += p["owner_id"].as<long>();
+                attachment += '_';
+                attachment += p["id"].as<long>();
+                if (p["access_key"].is<const char*>()) {
+                    attachment += '_';
+                    attachment += p["access_key"].as<const char*>();
+                }
+            }
+        } else {
+            String file = doc["file"].as<String>();
+            form.add("file", file);
+            form.add("title", filename);
+            ok = callMethod("docs.save", form, saved);
+            if (ok) {
+                // {"type":"doc","doc":{...}}; голосовое сообщение придет как audio_message
+                const char* type = saved["response"]["type"] | "doc";
+                JsonObject d = saved["response"][type];
+                attachment = type;
+                attachment += d["owner_id"].as<long>();
+                attachment += '_';
+                attachment += d["id"].as<long>();
+            }
+        }
+        
+        if (!ok) {
+            metrics.uploadErrors++;
+            return String();
+        }
+        metrics.uploads++;
+        metrics.upload.since(start);
+        return attachment;
+    }
+    
+#if defined(ESP8266) || defined(ESP32)
+    // Отправить файл с флеша (sendPhoto()/sendDocument() с fs::FS)
+    bool sendFile(bool photo, int peer_id, fs::FS& fs, const char* path, const String& text) {
+        fs::File file = fs.open(path, "r");
+        if (!file) {
+            VK_LOGE("Не удалось открыть файл %s", path);
+            return false;
+        }
+        // Имя без каталогов: под ним документ будет виден в чате
+        const char* name = strrchr(path, '/');
+        name = name ? name + 1 : path;
+        VkStreamSource source(file);
+        bool ok = photo ? sendPhoto(peer_id, source, name, text) : sendDocument(peer_id, source, name, text);
+        file.close();
+        return ok;
+    }
+#endif
+    
+    // Профили запрашиваются блокирующим вызовом API, с сетевой задачей соединение у нее
+    bool canFetchProfiles() {
+        if (!started) {
+            VK_LOGE("Бот не запущен!");
+            return false;
+        }
+        if (outRing) {
+            VK_LOGE("Запрос профилей недоступен при запущенной сетевой задаче");
+            return false;
+        }
+        return true;
+    }
+    
+    void storeProfile(JsonObject p) {
+        int id = p["id"] | 0;
+        if (id <= 0) {
+            return;
+        }
+        VkProfile& profile = profiles.put(id);
+        profile.id = id;
+        VkProfile::copyName(profile.first_name, p["first_name"] | "");
+        VkProfile::copyName(profile.last_name, p["last_name"] | "");
+        profile.sex = p["sex"] | 0;
+    }
+    
+    // Один users.get на все id, результат - в кэш
+    bool fetchProfiles(const int* ids, uint8_t count) {
+        String list;
+        list.reserve(count * 11);
+        for (uint8_t i = 0; i < count; i++) {
+            if (i > 0) list += ',';
+            list += String(ids[i]);
+        }
+        VkForm form;
+        form.add("user_ids", list);
+        form.add("fields", "sex");
+        VkArenaDoc doc(apiArena);
+        if (!callMethod("users.get", form, doc)) {
+            return false;
+        }
+        for (JsonObject p : doc["response"].as<JsonArray>()) {
+            storeProfile(p);
+        }
+        return true;
+    }
+    
+    static long long memberKey(int peer_id, int user_id) {
+        return ((long long)peer_id << 32) | (uint32_t)user_id;
+    }
+    
+    // Участники беседы: пары (беседа, участник) и их профили - в кэш
+    // Искомый пользователь записывается последним, чтобы большой чат его не вытеснил
+    const VkMember* fetchMember(int peer_id, int user_id) {
+        VkForm form;
+        form.add("peer_id", (long)peer_id);
+        form.add("fields", "sex");
+        VkArenaDoc doc(apiArena);
+        if (!callMethod("messages.getConversationMembers", form, doc)) {
+            return nullptr;
+        }
+        VkMember found;
+        for (JsonObject item : doc["response"]["items"].as<JsonArray>()) {
+            int id = item["member_id"] | 0;
+            VkMember m;
+            m.member = true;
+            m.admin = (item["is_admin"] | false) || (item["is_owner"] | false);
+            if (id == user_id) {
+                found = m;
+            } else {
+                members.put(memberKey(peer_id, id)) = m;
+            }
+        }
+        for (JsonObject p : doc["response"]["profiles"].as<JsonArray>()) {
+            storeProfile(p);
+        }
+        VkMember& slot = members.put(memberKey(peer_id, user_id));
+        slot = found;
+        return &slot;
+    }
+    
+    // Поставить id в очередь профилей: их запросит вызов users.get в следующем execute
+    // false - профиль уже в кэше или в очереди, либо очередь полна
+    bool queueProfile(int id) {
+        if (id <= 0 || profiles.peek(id) || profileQueued >= Config::PROFILE_CACHE) {
+            return false;
+        }
+        for (uint8_t i = 0; i < profileQueued; i++) {
+            if (profileQueue[i] == id) {
+                return false;
+            }
+        }
+        profileQueue[profileQueued++] = id;
+        metrics.profileMisses++;
+        return true;
+    }
+    
+    // Авторы новых сообщений из ответа Long Poll, которых нет в кэше, - в очередь профилей.
+    // События не ждут: профили придут с ближайшим execute (onProfile())
+    void prefetchSenders(JsonArray updates) {
+        for (JsonObject update : updates) {
+            if (vkEventType(update["type"].as<const char*>()) == VK_MESSAGE_NEW) {
+                queueProfile(update["object"]["message"]["from_id"] | 0);
+            }
+        }
+    }
+    
+    // Пачка execute отправлена и ждет ответа
+    bool batchInFlight() const {
+        return outboxInFlight > 0 || profilesInFlight > 0 || lpServerInFlight;
+    }
+    
+    // Пауза перед следующей пачкой из очереди
+    void pauseOutbox(unsigned long ms) {
+        if (batchInFlight() && api->busy == this) {
+            api->busy = nullptr;
+        }
+        outboxInFlight = 0;
+        profilesInFlight = 0;
+        lpServerInFlight = false;
+        outboxPause = ms;
+        outboxSince = millis();
+    }
+    
+    // random_id для messages.send: VK отбрасывает повтор с тем же random_id к тому же получателю,
+    // поэтому все пути отправки берут его здесь, из всего положительного диапазона int32
+    static long newRandomId() {
+        return random(1, 2147483647L);
+    }
+    
+    // Число в код execute без временной String
+    static void appendNumber(String& code, long value) {
+        char number[12];
+        int n = snprintf(number, sizeof(number), "%ld", value);
+        code.concat(number, (size_t)n);
+    }
+    
+    // Вызов messages.sendMessageEventAnswer для ответа на callback-кнопку
+    // Без текста просто гасит индикатор загрузки на кнопке, с текстом - показывает уведомление
+    static void appendEventAnswer(String& code, const VkOutgoing& item) {
+        code += "API.messages.sendMessageEventAnswer({\"event_id\":";
+        vkAppendJsonString(code, item.event_id);
+        code += ",\"user_id\":";
+        appendNumber(code, item.user_id);
+        code += ",\"peer_id\":";
+        appendNumber(code, item.peer_id);
+        if (item.text.length()) {
+            String data;
+            data.reserve(40 + item.text.length());
+            data += "{\"type\":\"show_snackbar\",\"text\":";
+            vkAppendJsonString(data, item.text);
+            data += '}';
+            code += ",\"event_data\":";
+            vkAppendJsonString(code, data);
+        }
+        code += "})";
+    }
+    
+    // Вызов messages.edit: новый текст сообщения, найденного по номеру в беседе
+    static void appendEdit(String& code, const VkOutgoing& item) {
+        code += "API.messages.edit({\"peer_id\":";
+        appendNumber(code, item.peer_id);
+        code += ",\"conversation_message_id\":";
+        appendNumber(code, item.conversation_message_id);
+        code += ",\"message\":";
+        vkAppendJsonString(code, item.text);
+        if (item.keyboard.length()) {
+            code += ",\"keyboard\":";
+            vkAppendJsonString(code, item.keyboard);
+        }
+        code += "})";
+    }
+    
+    // Отправить пачку сообщений из головы очереди одним запросом execute
+    // Очередь профилей добавляет в конец пачки один users.get,
+    // а запрос нового сервера Long Poll - groups.getLongPollServer после него
+    bool startOutboxBatch() {
+        uint8_t limit = VK_EXECUTE_BATCH - (profileQueued ? 1 : 0) - (lpServerQueued ? 1 : 0);
+        uint8_t n = outboxCount < limit ? outboxCount : limit;
+        
+        // Память под код выделяем сразу, чтобы строка не росла по символу
+        // Пачки рассылки ограничены VK_EXECUTE_PEERS: от числа получателей растет ответ
+        size_t size = 16 + (profileQueued ? 60 + profileQueued * 11 : 0) + (lpServerQueued ? 60 : 0);
+        uint16_t peers = 0;
+        for (uint8_t i = 0; i < n; i++) {
+            VkOutgoing& item = outbox[(outboxHead + i) % Config::OUTBOX];
+            if (i > 0 && peers + item.recipients > VK_EXECUTE_PEERS) {
+                n = i;
+                break;
+            }
+            peers += item.recipients;
+            size += 80 + item.text.length() + (item.attachment.length() ? 20 + item.attachment.length() : 0) +
+                    (item.keyboard.length() ? 20 + item.keyboard.length() * 5 / 4 : 0) + item.event_id.length() +
+                    item.peer_ids.length();
+        }
+        String& code = batchCode;
+        code.remove(0);
+        code.reserve(size);
+        code += "return [";
+        for (uint8_t i = 0; i < n; i++) {
+            VkOutgoing& item = outbox[(outboxHead + i) % Config::OUTBOX];
+            if (i > 0) code += ',';
+            if (item.event_id.length()) {
+                appendEventAnswer(code, item);
+                continue;
+            }
+            if (item.conversation_message_id) {
+                appendEdit(code, item);
+                continue;
+            }
+            if (item.recipients) {
+                code += "API.messages.send({\"peer_ids\":\"";
+                code += item.peer_ids;
+                code += '"';
+            } else {
+                code += "API.messages.send({\"peer_id\":";
+                appendNumber(code, item.peer_id);
+            }
+            code += ",\"random_id\":";
+            appendNumber(code, item.random_id);
+            code += ",\"message\":";
+            vkAppendJsonString(code, item.text);
+            if (item.attachment.length()) {
+                code += ",\"attachment\":";
+                vkAppendJsonString(code, item.attachment);
+            }
+            if (item.keyboard.length()) {
+                // keyboard - JSON, который передается строкой
+                code += ",\"keyboard\":";
+                vkAppendJsonString(code, item.keyboard);
+            }
+            code += "})";
+        }
+        if (profileQueued) {
+            if (n > 0) code += ',';
+            code += "API.users.get({\"user_ids\":\"";
+            for (uint8_t i = 0; i < profileQueued; i++) {
+                if (i > 0) code += ',';
+                appendNumber(code, profileQueue[i]);
+            }
+            code += "\",\"fields\":\"sex\"})";
+        }
+        if (lpServerQueued) {
+            if (n > 0 || profileQueued) code += ',';
+            code += "API.groups.getLongPollServer({\"group_id\":";
+            code += positiveGroupId();
+            code += "})";
+            metrics.serverRequests++;
+        }
+        code += "];";
+        
+        VkForm form;
+        form.add("code", code);
+        form.add("access_token", token);
+        form.add("v", VK_API_VERSION);
+        
+        outboxReused = api->http.connected();
+        metrics.apiCalls += n + (profileQueued ? 1 : 0) + (lpServerQueued ? 1 : 0);
+        bool sent = api->open(apiHost, apiPort, apiSecure) && api->http.sendForm("/method/execute", form);
+        size_t codeLength = code.length();
+        if (Config::MESSAGE_SIZE == 0) {
+            code = String();        // Память под код нужна только на время отправки
+        }
+        if (!sent) {
+            // Если закрылось старое keep-alive соединение, сразу пробуем новое
+            api->http.stop();
+            pauseOutbox(outboxReused ? 0 : VK_LP_RETRY_DELAY);
+            return false;
+        }
+        
+        api->busy = this;
+        outboxInFlight = n;
+        profilesInFlight = profileQueued;
+        lpServerInFlight = lpServerQueued;
+        outboxSince = millis();
+        VK_LOGD("execute: вызовов %u, профилей %u, %u байт", (unsigned)n, (unsigned)profileQueued,
+                (unsigned)codeLength);
+        return true;
+    }
+    
+    // Один шаг отправки очереди
+    // Возвращает true, если что-то продвинулось
+    bool stepOutbox() {
+        if (!batchInFlight()) {
+            bool idle = outboxCount == 0 && profileQueued == 0 && !lpServerQueued;
+            if (idle || millis() - outboxSince < outboxPause) {
+                return false;
+            }
+            // Общее соединение занято пачкой другого бота: помогаем ей дойти до конца
+            if (api->busy) {
+                return api->busy->stepOutbox();
+            }
+            if (!apiLimiter.tryAcquire()) {
+                return false;
+            }
+            return startOutboxBatch();
+        }
+        
+        VkHttpClient& http = api->http;
+        int httpCode = http.pollHeaders();
+        if (httpCode == 0) {
+            if (millis() - outboxSince > VK_API_TIMEOUT) {
+                VK_LOGW("Таймаут отправки очереди");
+                http.stop();
+                pauseOutbox(VK_LP_RETRY_DELAY);
+            }
+            return false;
+        }
+        if (httpCode < 0) {
+            http.stop();
+            pauseOutbox(outboxReused ? 0 : VK_LP_RETRY_DELAY);
+            return false;
+        }
+        clockSample(http, false);
+        if (httpCode != 200) {
+            metrics.httpErrors++;
+            VK_LOGE("HTTP ошибка отправки: %d", httpCode);
+            http.finish();
+            pauseOutbox(VK_LP_RETRY_DELAY);
+            return false;
+        }
+        
+        VkArenaDoc doc(apiArena);
+        http.setTimeout(VK_API_TIMEOUT);
+        DeserializationError error = deserializeJson(doc, http, DeserializationOption::Filter(apiFilter));
+        http.finish();
+        metrics.sampleHeap();
+        if (error) {
+            metrics.jsonErrors++;
+            // Повтор безопасен: VK не продублирует сообщение с тем же random_id
+            VK_LOGE("JSON ошибка: %s", error.c_str());
+            pauseOutbox(VK_LP_RETRY_DELAY);
+            return false;
+        }
+        
+        // Ответ execute: массив ID сообщений, false на месте неудачных вызовов,
+        // а их ошибки по порядку в execute_errors. Рассылка отвечает массивом
+        // по получателю: {"peer_id", "message_id"} или {"peer_id", "error"}
+        VkSendResult results[VK_EXECUTE_BATCH];
+        bool retry[VK_EXECUTE_BATCH];
+        uint8_t n = outboxInFlight;
+        uint8_t fetched = profilesInFlight;
+        uint8_t reported = 0;
+        uint8_t maxAttempts = 0;
+        int batchError = doc["error"]["error_code"] | 0;
+        JsonArray response = doc["response"].as<JsonArray>();
+        JsonArray errors = doc["execute_errors"].as<JsonArray>();
+        size_t errorIndex = 0;
+        
+        for (uint8_t i = 0; i < n; i++) {
+            VkOutgoing& item = outbox[(outboxHead + i) % Config::OUTBOX];
+            int messageId = 0;
+            int conversationId = item.conversation_message_id;
+            int errorCode = batchError;
+            uint8_t failed = 0;
+            
+            if (!batchError) {
+                JsonVariant r = response[i];
+                if (r.is<int>()) {
+                    messageId = conversationId ? 0 : r.as<int>();
+                } else if (r.is<JsonArray>()) {
+                    if (item.recipients == 1) {
+                        messageId = r[0]["message_id"] | 0;
+                        conversationId = r[0]["conversation_message_id"] | 0;
+                    }
+                    for (JsonObject peer : r.as<JsonArray>()) {
+                        int peerError = peer["error"]["code"] | 0;
+                        if (peerError != 0) {
+                            failed++;
+                            metrics.countApiError(peerError);
+                            VK_LOGD("Рассылка: %d не получил сообщение (%d)", peer["peer_id"] | 0, peerError);
+                        }
+                    }
+                } else {
+                    errorCode = errors[errorIndex]["error_code"] | -1;
+                    errorIndex++;
+                }
+            }
+            
+            if (errorCode != 0) {
+                metrics.countApiError(errorCode);
+            }
+            
+            // Ошибку лимита не считаем окончательной: сообщение останется в очереди
+            retry[i] = isRateLimitError(errorCode) && item.attempts + 1 < VK_MAX_RETRIES;
+            if (retry[i]) {
+                item.attempts++;
+                if (item.attempts > maxAttempts) maxAttempts = item.attempts;
+                continue;
+            }
+            
+            if (errorCode != 0) {
+                metrics.sendErrors += item.recipients ? item.recipients : 1;
+                VK_LOGE("Ошибка отправки: %d", errorCode);
+            } else if (item.recipients) {
+                metrics.sent += item.recipients - failed;
+                metrics.sendErrors += failed;
+                metrics.send.since(item.queuedAt);
+            } else if (item.conversation_message_id) {
+                metrics.edits++;
+                metrics.send.since(item.queuedAt);
+            } else if (item.event_id.length() == 0) {
+                metrics.sent++;
+                metrics.send.since(item.queuedAt);
+            }
+            VkSendResult& result = results[reported++];
+            result.id = item.id;
+            result.peer_id = item.peer_id;
+            result.message_id = messageId;
+            result.conversation_message_id = conversationId;
+            result.error_code = errorCode;
+            result.recipients = item.recipients;
+            result.failed = errorCode != 0 ? item.recipients : failed;
+        }
+        
+        // Ответ users.get - последний элемент. Запрошенные id убираем из очереди и при ошибке:
+        // следующее сообщение автора поставит его снова
+        int got[Config::PROFILE_CACHE];
+        uint8_t gotCount = 0;
+        if (fetched) {
+            for (JsonObject p : response[n].as<JsonArray>()) {
+                int id = p["id"] | 0;
+                storeProfile(p);
+                if (id > 0 && gotCount < fetched) {
+                    got[gotCount++] = id;
+                }
+            }
+            profileQueued -= fetched;
+            memmove(profileQueue, profileQueue + fetched, profileQueued * sizeof(int));
+        }
+        
+        // Ответ groups.getLongPollServer - после users.get. Неудачу видит
+        // автомат Long Poll (needLongPollServer остался) и повторяет запрос позже
+        if (lpServerInFlight) {
+            lpServerQueued = false;
+            JsonVariant r = response[n + (fetched ? 1 : 0)];
+            if (!r.is<JsonObject>() || !applyLongPollServer(r.as<JsonObject>())) {
+                VK_LOGE("Ошибка получения Long Poll сервера");
+            }
+        }
+        
+        // Отправленные убираем, повторяемые сдвигаем к новой голове в прежнем порядке
+        uint8_t kept = 0;
+        for (int i = n - 1; i >= 0; i--) {
+            uint8_t src = (outboxHead + i) % Config::OUTBOX;
+            if (retry[i]) {
+                // Обмен, а не перенос: освободившаяся ячейка сохраняет свою память
+                uint8_t dst = (outboxHead + n - 1 - kept) % Config::OUTBOX;
+                if (dst != src) {
+                    std::swap(outbox[dst], outbox[src]);
+                }
+                kept++;
+            } else {
+                clearSlot(outbox[src]);
+            }
+        }
+        outboxHead = (outboxHead + n - kept) % Config::OUTBOX;
+        outboxCount -= n - kept;
+        
+        if (kept > 0) {
+            unsigned long wait = backoffDelay(maxAttempts);
+            VK_LOGW("Превышен лимит отправки, повтор через %lu мс", wait);
+            apiLimiter.penalize(wait);
+            pauseOutbox(wait);
+        } else {
+            pauseOutbox(0);
+        }
+        
+        // Callback вызываем, когда очередь уже в согласованном состоянии:
+        // из него можно снова ставить сообщения и вызывать sendMessage()
+        outboxDone += reported;
+        if (sendCallback || liveCount) {
+            for (uint8_t i = 0; i < reported; i++) {
+                if (resultRing) {
+                    // С сетевой задачей отчеты забирает loop() в tick()
+                    while (!resultRing->push(results[i]) && taskRunning) {
+                        delay(1);
+                    }
+                } else {
+                    reportResult(results[i]);
+                }
+            }
+        }
+        // Очередь профилей есть только без сетевой задачи, так что это поток loop()
+        if (profileCallback) {
+            for (uint8_t i = 0; i < gotCount; i++) {
+                const VkProfile* profile = profiles.peek(got[i]);
+                if (profile) {
+                    profileCallback(*profile);
+                }
+            }
+        }
+        return true;
+    }
+    
+    // Отчет об отправке: живым сообщениям, затем обработчику (только в потоке loop())
+    void reportResult(const VkSendResult& result) {
+        // Ошибка получателя в peer_ids приходит без общего кода
+        int error = result.error_code != 0 ? result.error_code : (result.failed ? -1 : 0);
+        for (uint8_t i = 0; i < liveCount; i++) {
+            if (lives[i]->complete(result.id, result.conversation_message_id, error)) {
+                break;
+            }
+        }
+        if (sendCallback) {
+            sendCallback(result);
+        }
+    }
+    
+    // Передать событие обработчику: сразу или через кольцо в loop()
+    void deliver(VkUpdate& update) {
+        if (eventRing) {
+            // Кольцо полно - ждем, пока loop() разберет события: они не теряются,
+            // а Long Poll просто приостанавливается
+            while (!eventRing->push(update)) {
+                if (!taskRunning) {
+                    return;
+                }
+                delay(1);
+            }
+            return;
+        }
+        callHandler(update);
+    }
+    
+    // Тип разбирается этой конфигурацией
+    static bool isEnabled(VkEventType type) {
+        return (Config::EVENTS & VK_EVENT_BIT(type)) != 0;
+    }
+    
+    // Тип обрабатывает Config::onUpdate()
+    static bool isStatic(VkEventType type) {
+        return (Config::EVENTS & Config::STATIC_EVENTS & VK_EVENT_BIT(type)) != 0;
+    }
+    
+    bool hasHandler(VkEventType type) const {
+        return isStatic(type) || (isEnabled(type) && (eventHandlers[type] || viewHandlers[type]));
+    }
+    
+    // Вызвать обработчик события и записать, сколько он работал
+    void callHandler(VkUpdate& update) {
+        uint32_t start = micros();
+        if (isStatic(update.type)) {
+            Config::onUpdate(VkUpdateView(update));
+        } else if (eventHandlers[update.type]) {
+            eventHandlers[update.type](update);
+        } else {
+            viewHandlers[update.type](VkUpdateView(update));
+        }
+        metrics.callback.since(start);
+        metrics.dispatched++;
+    }
+    
+    void callHandler(const VkUpdateView& view) {
+        uint32_t start = micros();
+        if (isStatic(view.type)) {
+            Config::onUpdate(view);
+        } else {
+            viewHandlers[view.type](view);
+        }
+        metrics.callback.since(start);
+        metrics.dispatched++;
+    }
+    
+    // Освободить ячейку очереди после отправки
+    // С MESSAGE_SIZE память строк остается ячейке для следующего сообщения
+    static void clearSlot(VkOutgoing& item) {
+        if (Config::MESSAGE_SIZE > 0) {
+            item.text.remove(0);
+            item.attachment.remove(0);
+            item.keyboard.remove(0);
+            item.event_id.remove(0);
+        } else {
+            item.text = String();
+            item.attachment = String();
+            item.keyboard = String();
+            item.event_id = String();
+        }
+        item.peer_ids = String();   // Список рассылки в ячейке не держим
+        item.recipients = 0;
+        item.conversation_message_id = 0;
+    }
+    
+    // Строку - в память ячейки (пустая строка памяти не заводит)
+    static void copyInto(String& slot, const String& value) {
+        if (value.length()) {
+            slot = value;
+        } else {
+            slot.remove(0);
+        }
+    }
+    
+    // Положить сообщение в очередь (только в потоке сети)
+    void addOutgoing(VkOutgoing& item) {
+        VkOutgoing& slot = outbox[(outboxHead + outboxCount) % Config::OUTBOX];
+        if (Config::MESSAGE_SIZE > 0) {
+            slot.id = item.id;
+            slot.peer_id = item.peer_id;
+            slot.user_id = item.user_id;
+            slot.conversation_message_id = item.conversation_message_id;
+            slot.random_id = item.random_id;
+            slot.attempts = item.attempts;
+            slot.queuedAt = item.queuedAt;
+            copyInto(slot.text, item.text);
+            copyInto(slot.attachment, item.attachment);
+            copyInto(slot.keyboard, item.keyboard);
+            copyInto(slot.event_id, item.event_id);
+            slot.peer_ids = std::move(item.peer_ids);
+            slot.recipients = item.recipients;
+        } else {
+            slot = std::move(item);
+        }
+        outboxCount++;
+    }
+    
+    // Очередь (или кольцо к сетевой задаче) заполнена
+    bool outgoingFull() {
+        if (outRing ? outRing->size() >= outRing->capacity() : outboxCount >= Config::OUTBOX) {
+            VK_LOGW("Очередь отправки заполнена");
+            return true;
+        }
+        return false;
+    }
+    
+    // Выдать элементу номер для onSendComplete()
+    uint32_t stampOutgoing(VkOutgoing& item) {
+        if (++outboxNextId == 0) {
+            outboxNextId = 1;
+        }
+        item.id = outboxNextId;
+        item.queuedAt = micros();
+        outboxQueued++;
+        return outboxNextId;
+    }
+    
+    // Живое сообщение будет получать отчеты об отправке (место на VK_LIVE_MESSAGES штук)
+    bool watchLive(VkLiveMessage& live) {
+        for (uint8_t i = 0; i < liveCount; i++) {
+            if (lives[i] == &live) {
+                return true;
+            }
+        }
+        if (liveCount >= VK_LIVE_MESSAGES) {
+            VK_LOGE("Слишком много живых сообщений, увеличьте VK_LIVE_MESSAGES");
+            return false;
+        }
+        lives[liveCount++] = &live;
+        return true;
+    }
+    
+    // Выдать номер и поставить в очередь сообщение или ответ на кнопку
+    // С сетевой задачей очередь принадлежит ей, элемент идет через кольцо
+    uint32_t enqueueOutgoing(VkOutgoing& item) {
+        if (outgoingFull()) {
+            return 0;
+        }
+        uint32_t id = stampOutgoing(item);
+        if (outRing) {
+            outRing->push(item);
+        } else {
+            addOutgoing(item);
+        }
+        return id;
+    }
+    
+    // Вызвать обработчики событий и отчетов, пришедших из сетевой задачи
+    void drainRings(unsigned long start) {
+        VkUpdate update;
+        while (eventRing->pop(update)) {
+            if (hasHandler(update.type)) {
+                callHandler(update);
+            }
+            if (millis() - start >= tickSlice) {
+                return;
+            }
+        }
+        VkSendResult result;
+        while (resultRing->pop(result)) {
+            reportResult(result);
+        }
+    }
+    
+    // Цикл сетевой задачи: Long Poll, разбор и отправка очереди
+    void runNetworkTask() {
+        while (taskRunning) {
+            VkOutgoing item;
+            while (outboxCount < Config::OUTBOX && outRing->pop(item)) {
+                addOutgoing(item);
+            }
+            bool busy = stepLongPoll();
+            busy = stepOutbox() || busy;
+            if (!busy) {
+                delay(1);
+            }
+        }
+    }
+    
+#if defined(ESP32) && !defined(DGO_VKBOT_HOST)
+    static void netTaskEntry(void* arg) {
+        DGO_VKbotT* bot = (DGO_VKbotT*)arg;
+        bot->runNetworkTask();
+        bot->taskExited = true;
+        vTaskDelete(NULL);
+    }
+#endif
+    
+    // id группы для groups.getLongPollServer (без минуса)
+    const char* positiveGroupId() const {
+        const char* id = groupId.c_str();
+        return *id == '-' ? id + 1 : id;
+    }
+    
+    // Принять ответ groups.getLongPollServer
+    bool applyLongPollServer(JsonObject response) {
+        lpServer = response["server"].as<String>();
+        lpKey = response["key"].as<String>();
+        // Прежний ts сохраняем, чтобы не пропустить события за время переподключения
+        if (lpTsLost || lpTs.length() == 0) {
+            lpTs = response["ts"].as<String>();
+        }
+        lpTsLost = false;
+        
+        if (!lpUrl.parse(lpServer)) {
+            VK_LOGE("Некорректный адрес Long Poll сервера");
+            return false;
+        }
+        needLongPollServer = false;
+        lpResumed = false;
+        saveState();
+        
+        VK_LOGI("Long Poll сервер: %s", lpServer.c_str());
+        return true;
+    }
+    
+    // Получение Long Poll сервера (блокирующее, для start())
+    // В работе tick() сервер приходит через очередь: см. VK_POLL_SERVER
+    bool getLongPollServer() {
+        VkForm form;
+        form.add("group_id", positiveGroupId());
+        
+        VkArenaDoc doc(apiArena);
+        metrics.serverRequests++;
+        if (apiRequest("groups.getLongPollServer", form, doc) == 200) {
+            if (doc["response"].is<JsonObject>()) {
+                return applyLongPollServer(doc["response"].as<JsonObject>());
+            } else if (doc["error"].is<JsonObject>()) {
+                VK_LOGE("API ошибка: %s", doc["error"]["error_msg"] | "");
+            }
+        }
+        
+        VK_LOGE("Ошибка получения Long Poll сервера");
+        return false;
+    }
+    
+    // Хеш владельца состояния: группа и адрес API
+    uint32_t stateOwner() const {
+        return VkSavedState::hash(apiHost.c_str(), VkSavedState::hash(groupId.c_str()));
+    }
+    
+    // Сохранить сервер, ключ и ts, если они изменились
+    void saveState() {
+        if (!stateStore || lpServer.length() == 0) {
+            return;
+        }
+        VkSavedState state;
+        if (!state.fill(stateOwner(), lpServer, lpKey, lpTs, sleepInterval)) {
+            return;
+        }
+        if (state.crc == stateCrc) {
+            return;
+        }
+        if (stateStore->save(state)) {
+            stateCrc = state.crc;
+        }
+    }
+    
+    // Продолжить Long Poll с сохраненного места без getLongPollServer()
+    bool restoreState() {
+        VkSavedState state;
+        if (!stateStore || !stateStore->load(state) || !state.isValid(stateOwner())) {
+            return false;
+        }
+        if (!lpUrl.parse(state.server)) {
+            return false;
+        }
+        lpServer = state.server;
+        lpKey = state.key;
+        lpTs = state.ts;
+        lpResumed = true;
+        stateCrc = state.crc;
+        if (state.sleepMs >= sleepMin && state.sleepMs <= sleepMax) {
+            sleepInterval = state.sleepMs;
+        }
+        
+        VK_LOGI("Long Poll восстановлен: %s, ts %s", lpServer.c_str(), lpTs.c_str());
+        return true;
+    }
+    
+    // Собрать фильтры разбора ответов
+    // Поля события попадают в фильтр только для типов, на которые есть обработчик,
+    // от остальных событий в документе остается лишь "type"
+    void buildFilters() {
+        buildLongPollFilter();
+        
+        apiFilter.clear();
+        apiFilter["response"] = true;
+        apiFilter["error"]["error_code"] = true;
+        apiFilter["error"]["error_msg"] = true;
+        apiFilter["execute_errors"][0]["error_code"] = true;
+    }
+    
+    static void addMessageFields(JsonObject msg) {
+        msg["id"] = true;
+        msg["conversation_message_id"] = true;
+        msg["from_id"] = true;
+        msg["peer_id"] = true;
+        msg["text"] = true;
+        msg["date"] = true;
+    }
+    
+    void buildLongPollFilter() {
+        lpFilter.clear();
+        lpFilter["ts"] = true;
+        lpFilter["failed"] = true;
+        JsonObject update = lpFilter["updates"][0].to<JsonObject>();
+        update["type"] = true;
+        
+        bool any = false;
+        for (uint8_t i = 0; i < VK_EVENT_TYPES; i++) {
+            any = any || hasHandler((VkEventType)i);
+        }
+        if (!any) {
+            return;
+        }
+        JsonObject object = update["object"].to<JsonObject>();
+        
+        // message_new приходит как object.message, reply/edit - как сам object
+        if (hasHandler(VK_MESSAGE_NEW)) {
+            JsonObject msg = object["message"].to<JsonObject>();
+            addMessageFields(msg);
+            msg["payload"] = true;
+        }
+        if (hasHandler(VK_MESSAGE_REPLY) || hasHandler(VK_MESSAGE_EDIT)) {
+            addMessageFields(object);
+        }
+        if (hasHandler(VK_MESSAGE_EVENT)) {
+            object["user_id"] = true;
+            object["peer_id"] = true;
+            object["event_id"] = true;
+            object["payload"] = true;
+            object["conversation_message_id"] = true;
+        }
+        if (hasHandler(VK_MESSAGE_ALLOW) || hasHandler(VK_MESSAGE_DENY) ||
+            hasHandler(VK_GROUP_JOIN) || hasHandler(VK_GROUP_LEAVE)) {
+            object["user_id"] = true;
+        }
+        if (hasHandler(VK_GROUP_JOIN)) {
+            object["join_type"] = true;
+        }
+        if (hasHandler(VK_GROUP_LEAVE)) {
+            object["self"] = true;
+        }
+    }
+    
+    static void readMessage(JsonObject msg, VkMessage& message) {
+        message.id = msg["id"].as<int>();
+        message.conversation_message_id = msg["conversation_message_id"].as<int>();
+        message.from_id = msg["from_id"].as<int>();
+        message.peer_id = msg["peer_id"].as<int>();
+        message.text = msg["text"].as<String>();
+        message.date = msg["date"].as<unsigned long>();
+    }
+    
+    // Заполнить VkUpdate из события нужного типа
+    static void readUpdate(VkEventType type, JsonObject object, VkUpdate& vkUpdate) {
+        vkUpdate.type = type;
+        switch (type) {
+            case VK_MESSAGE_NEW:
+                readMessage(object["message"], vkUpdate.message);
+                vkUpdate.message.payload = object["message"]["payload"] | "";
+                vkUpdate.command = vkPayloadCommand(vkUpdate.message.payload.c_str(), &vkUpdate.command_arg);
+                break;
+            case VK_MESSAGE_REPLY:
+            case VK_MESSAGE_EDIT:
+                readMessage(object, vkUpdate.message);
+                break;
+            case VK_MESSAGE_EVENT:
+                vkUpdate.user_id = object["user_id"].as<int>();
+                vkUpdate.event_id = object["event_id"].as<String>();
+                if (!object["payload"].isNull()) {
+                    serializeJson(object["payload"], vkUpdate.payload);
+                    readCommand(object["payload"], vkUpdate.command, vkUpdate.command_arg);
+                }
+                vkUpdate.message.peer_id = object["peer_id"].as<int>();
+                vkUpdate.message.conversation_message_id = object["conversation_message_id"].as<int>();
+                break;
+            case VK_GROUP_JOIN:
+                vkUpdate.user_id = object["user_id"].as<int>();
+                vkUpdate.join_type = object["join_type"].as<String>();
+                break;
+            case VK_GROUP_LEAVE:
+                vkUpdate.user_id = object["user_id"].as<int>();
+                vkUpdate.self = object["self"].as<int>() != 0;
+                break;
+            default:
+                vkUpdate.user_id = object["user_id"].as<int>();
+                break;
+        }
+    }
+    
+    // Команда кнопки из payload события message_event (он приходит объектом)
+    static void readCommand(JsonVariant payload, uint16_t& command, long& arg) {
+        long c = payload["c"] | 0L;
+        command = c > 0 && c <= 0xFFFF ? (uint16_t)c : 0;
+        arg = command ? (payload["a"] | 0L) : 0;
+    }
+    
+    // Строка из документа без копии
+    static VkStr readStr(JsonVariant value) {
+        JsonString s = value.as<JsonString>();
+        return s.c_str() ? VkStr(s.c_str(), s.size()) : VkStr();
+    }
+    
+    static void readMessageView(JsonObject msg, VkMessageView& message) {
+        message.id = msg["id"].as<int>();
+        message.conversation_message_id = msg["conversation_message_id"].as<int>();
+        message.from_id = msg["from_id"].as<int>();
+        message.peer_id = msg["peer_id"].as<int>();
+        message.text = readStr(msg["text"]);
+        message.date = msg["date"].as<unsigned long>();
+    }
+    
+    // То же, что readUpdate(), но без копий: строки остаются в документе,
+    // payload (объект) записывается в payloadBuf
+    static void readUpdateView(VkEventType type, JsonObject object, VkUpdateView& view,
+                               char* payloadBuf, size_t payloadSize) {
+        view.type = type;
+        switch (type) {
+            case VK_MESSAGE_NEW:
+                readMessageView(object["message"], view.message);
+                view.message.payload = readStr(object["message"]["payload"]);
+                view.command = vkPayloadCommand(view.message.payload.c_str(), &view.command_arg);
+                break;
+            case VK_MESSAGE_REPLY:
+            case VK_MESSAGE_EDIT:
+                readMessageView(object, view.message);
+                break;
+            case VK_MESSAGE_EVENT:
+                view.user_id = object["user_id"].as<int>();
+                view.event_id = readStr(object["event_id"]);
+                if (!object["payload"].isNull()) {
+                    size_t len = serializeJson(object["payload"], payloadBuf, payloadSize);
+                    view.payload = VkStr(payloadBuf, len);
+                    readCommand(object["payload"], view.command, view.command_arg);
+                }
+                view.message.peer_id = object["peer_id"].as<int>();
+                view.message.conversation_message_id = object["conversation_message_id"].as<int>();
+                break;
+            case VK_GROUP_JOIN:
+                view.user_id = object["user_id"].as<int>();
+                view.join_type = readStr(object["join_type"]);
+                break;
+            case VK_GROUP_LEAVE:
+                view.user_id = object["user_id"].as<int>();
+                view.self = object["self"].as<int>() != 0;
+                break;
+            default:
+                view.user_id = object["user_id"].as<int>();
+                break;
+        }
+    }
+    
+    // Разбор ответа Long Poll из буфера (String) или потока
+    template <typename TInput>
+    bool handleLongPollResponse(TInput& body) {
+        VkArenaDoc doc(lpArena);
+        uint32_t start = micros();
+        DeserializationError error = deserializeJson(doc, body, DeserializationOption::Filter(lpFilter));
+        metrics.parse.since(start);
+        metrics.sampleHeap();
+        
+        if (error) {
+            metrics.jsonErrors++;
+            VK_LOGE("JSON ошибка: %s", error.c_str());
+            return false;
+        }
+        
+        // Обновляем ts для следующего запроса
+        // Копия в прежнюю память lpTs: длина ts от ответа к ответу почти не меняется
+        if (doc["ts"].is<const char*>()) {
+            lpTs = doc["ts"].as<const char*>();
+        }
+        // Сервер ответил - восстановленный ключ рабочий (или VK сообщит failed ниже)
+        lpResumed = false;
+        metrics.polls++;
+        
+        // Проверяем на ошибки Long Poll (failed, pts)
+        if (doc["failed"].is<int>()) {
+            int failed = doc["failed"].as<int>();
+            metrics.countFailed(failed);
+            if (failed == 1) {
+                // Нужно обновить ts (уже сделано выше)
+                saveState();
+                return true;
+            } else if (failed == 2 || failed == 3) {
+                // 2 - истек ключ (ts остается прежним), 3 - информация утрачена (нужен новый ts)
+                VK_LOGI("Long Poll требует переподключения");
+                needLongPollServer = true;
+                lpTsLost = failed == 3;
+                return true;
+            }
+        }
+        
+        // Новый ts сохраняем до вызова обработчиков: если обработчик уронит
+        // устройство, после перезагрузки эти события не придут повторно
+        saveState();
+        
+        // Обрабатываем события
+        if (doc["updates"].is<JsonArray>()) {
+            JsonArray updates = doc["updates"].as<JsonArray>();
+            metrics.updates += updates.size();
+            VK_LOGD("Long Poll: событий %u, ts %s", (unsigned)updates.size(), lpTs.c_str());
+            // С сетевой задачей кэш читает loop(), поэтому заранее не заполняем
+            if (profilePrefetch && !eventRing && hasHandler(VK_MESSAGE_NEW)) {
+                prefetchSenders(updates);
+            }
+            
+            for (JsonObject update : updates) {
+                VkEventType type = vkEventType(update["type"].as<const char*>());
+                
+                // События без обработчика пропускаем, не создавая VkUpdate
+                if (type == VK_UNKNOWN || !hasHandler(type)) {
+                    continue;
+                }
+                lpEvents++;
+                
+                // Обработчик без копий вызываем, пока документ жив. С сетевой задачей
+                // событие уходит в loop() через кольцо, и копия все равно нужна
+                if ((isStatic(type) || viewHandlers[type]) && !eventRing) {
+                    VkUpdateView view;
+                    char payload[VK_PAYLOAD_SIZE];
+                    readUpdateView(type, update["object"], view, payload, sizeof(payload));
+                    view.group_id = groupNum;
+                    if (view.message.date) {
+                        clock.addEventDate(millis(), view.message.date);
+                    }
+                    callHandler(view);
+                    continue;
+                }
+                
+                VkUpdate vkUpdate;
+                readUpdate(type, update["object"], vkUpdate);
+                vkUpdate.group_id = groupNum;
+                // Сообщение написано не позже, чем сейчас: бесплатная нижняя граница для часов
+                if (vkUpdate.message.date) {
+                    clock.addEventDate(millis(), vkUpdate.message.date);
+                }
+                deliver(vkUpdate);
+            }
+            return true;
+        }
+        return false;
+    }
+    
+    // Перейти в новое состояние Long Poll
+    void setPollState(VkPollState state) {
+        pollState = state;
+        pollStateSince = millis();
+    }
+    
+    // Завершить цикл Long Poll, следующий начнется через delayMs
+    void finishPoll(unsigned long delayMs) {
+        pollDelay = delayMs;
+        setPollState(VK_POLL_IDLE);
+    }
+    
+    // Один шаг конечного автомата Long Poll
+    // Возвращает true, если автомат продвинулся и можно сразу делать следующий шаг
+    bool stepLongPoll() {
+        switch (pollState) {
+            case VK_POLL_IDLE:
+                if (millis() - pollStateSince < pollDelay) {
+                    return false;
+                }
+                if (needLongPollServer) {
+                    // Запрос уйдет в ближайшем execute, ответ разберет stepOutbox()
+                    lpServerQueued = true;
+                    setPollState(VK_POLL_SERVER);
+                    return true;
+                }
+                setPollState(VK_POLL_CONNECT);
+                return true;
+                
+            case VK_POLL_SERVER:
+                if (lpServerQueued || lpServerInFlight) {
+                    return false;
+                }
+                if (needLongPollServer) {
+                    finishPoll(VK_LP_RETRY_DELAY);
+                    return false;
+                }
+                setPollState(VK_POLL_CONNECT);
+                return true;
+                
+            case VK_POLL_CONNECT:
+                // Единственный блокирующий шаг: TLS рукопожатие (сотни мс на ESP8266).
+                // При keep-alive оно бывает только после обрыва или смены сервера
+                pollReused = lpConn.http.connected();
+                if (!lpConn.open(lpUrl.host, lpUrl.port, lpUrl.secure)) {
+                    metrics.connectErrors++;
+                    VK_LOGE("Ошибка подключения к Long Poll серверу");
+                    // Сохраненный сервер мог устареть - берем новый, ts оставляем
+                    if (lpResumed) {
+                        needLongPollServer = true;
+                    }
+                    finishPoll(VK_LP_RETRY_DELAY);
+                    return false;
+                }
+                setPollState(VK_POLL_SEND);
+                return true;
+                
+            case VK_POLL_SEND: {
+                char path[256];
+                int n = snprintf(path, sizeof(path), "%s?act=a_check&key=%s&ts=%s&wait=%d&mode=2&version=3",
+                                 lpUrl.path.c_str(), lpKey.c_str(), lpTs.c_str(), lpWait);
+                if (n <= 0 || n >= (int)sizeof(path) || !lpConn.http.sendRequest("GET", path)) {
+                    // Соединение могло закрыться, пока мы его не использовали
+                    lpConn.http.stop();
+                    finishPoll(pollReused ? 0 : VK_LP_RETRY_DELAY);
+                    return false;
+                }
+                pollSentUs = micros();
+                setPollState(VK_POLL_WAIT_HEADERS);
+                return true;
+            }
+                
+            case VK_POLL_WAIT_HEADERS: {
+                int httpCode = lpConn.http.pollHeaders();
+                if (httpCode == 0) {
+                    if (millis() - pollStateSince > lpWait * 1000UL + VK_LP_TIMEOUT_MARGIN) {
+                        // Таймаут - нормально для Long Poll
+                        lpConn.http.stop();
+                        finishPoll(0);
+                    }
+                    return false;
+                }
+                if (httpCode < 0) {
+                    // Сервер закрыл соединение - переподключаемся
+                    lpConn.http.stop();
+                    finishPoll(pollReused ? 0 : VK_LP_RETRY_DELAY);
+                    return false;
+                }
+                clockSample(lpConn.http, true);
+                if (httpCode != 200) {
+                    // Серверная ошибка - переподключаемся
+                    metrics.httpErrors++;
+                    VK_LOGE("Long Poll HTTP ошибка: %d", httpCode);
+                    lpConn.http.stop();
+                    needLongPollServer = true;
+                    finishPoll(VK_LP_RETRY_DELAY);
+                    return false;
+                }
+                // Буфер под все тело сразу, если длина известна
+                long length = lpConn.http.getContentLength();
+                lpBody.remove(0);
+                lpBody.reserve(length > 0 && length < (long)VK_LP_BODY_MAX ? (size_t)length : 512);
+                setPollState(VK_POLL_READ_BODY);
+                return true;
+            }
+                
+            case VK_POLL_READ_BODY: {
+                // Тело копим тем, что уже пришло, и разбираем, только когда оно пришло целиком:
+                // разбор из потока ждал бы медленный сервер прямо внутри tick()
+                VkHttpClient& http = lpConn.http;
+                uint8_t chunk[256];
+                int got;
+                while (lpBody.length() < VK_LP_BODY_MAX && (got = http.read(chunk, sizeof(chunk))) > 0) {
+                    lpBody.concat((const char*)chunk, (size_t)got);
+                }
+                // Без Content-Length тело заканчивается закрытием соединения
+                bool closed = !http.connected() && http.available() <= 0;
+                if (http.isBodyDone() || lpBody.length() >= VK_LP_BODY_MAX || (closed && lpBody.length() > 0)) {
+                    setPollState(VK_POLL_PARSE);
+                    return true;
+                }
+                if (closed || millis() - pollStateSince > VK_LP_BODY_TIMEOUT) {
+                    VK_LOGW("Таймаут чтения ответа Long Poll");
+                    http.stop();
+                    finishPoll(0);
+                }
+                return false;
+            }
+                
+            case VK_POLL_PARSE:
+                if (lpBody.length() < VK_LP_BODY_MAX || lpConn.http.isBodyDone()) {
+                    lpAnswered = handleLongPollResponse(lpBody);
+                } else {
+                    // Тело больше VK_LP_BODY_MAX: остаток дочитывается во время разбора (блокирующе)
+                    VkPrefixStream body(lpBody, lpConn.http);
+                    body.setTimeout(VK_LP_BODY_TIMEOUT);
+                    lpAnswered = handleLongPollResponse(body);
+                }
+                lpConn.http.finish();
+                // С MESSAGE_SIZE память буфера остается до следующего ответа, как у batchCode
+                lpBody.remove(0);
+                if (Config::MESSAGE_SIZE == 0) {
+                    lpBody = String();
+                }
+                metrics.longPoll.since(pollSentUs);
+                finishPoll(0);
+                return true;
+        }
+        return false;
+    }
+    
+    // Полный цикл Long Poll (блокирующий режим)
+    void processLongPoll() {
+        if (pollState == VK_POLL_IDLE) {
+            unsigned long waited = millis() - pollStateSince;
+            if (waited < pollDelay) {
+                delay(pollDelay - waited);
+            }
+            stepLongPoll();
+        }
+        while (pollState != VK_POLL_IDLE) {
+            bool moved = stepLongPoll();
+            // Новый сервер приходит в ответе execute из очереди
+            if (pollState == VK_POLL_SERVER) {
+                moved = stepOutbox() || moved;
+            }
+            if (!moved) {
+                delay(1);
+            }
+        }
+    }
+
+public:
+    // Конструктор
+    DGO_VKbotT() : groupNum(0), apiHost(VK_API_HOST), apiPort(VK_API_PORT), apiSecure(true),
+                  stateStore(&defaultStateStore), stateCrc(0),
+                  pollState(VK_POLL_IDLE), pollStateSince(0), pollDelay(0), pollReused(false),
+                  needLongPollServer(false), lpTsLost(false), lpResumed(false), blockingMode(false),
+                  lpWait(Config::LP_WAIT), lpEvents(0), lpAnswered(false),
+                  lpServerQueued(false), lpServerInFlight(false),
+                  sleepMin(VK_SLEEP_MIN), sleepMax(VK_SLEEP_MAX), sleepInterval(VK_SLEEP_MIN),
+                  tickSlice(5), started(false),
+                  outboxHead(0), outboxCount(0), outboxInFlight(0), outboxNextId(0),
+                  outboxSince(0), outboxPause(0), outboxReused(false), outboxQueued(0), outboxDone(0),
+                  liveCount(0), eventRing(nullptr), outRing(nullptr), resultRing(nullptr), taskRunning(false),
+#if defined(ESP32) && !defined(DGO_VKBOT_HOST)
+                  netTask(nullptr), taskExited(false),
+#endif
+                  pollSentUs(0), timezoneOffset(0), profilePrefetch(false),
+                  profileQueued(0), profilesInFlight(0) {
+        api = &apiConn;
+        lpConn.setTransport(&defaultTransport);
+        apiConn.setTransport(&defaultTransport);
+        lpConn.connectTime = &metrics.connect;
+        apiConn.connectTime = &metrics.connect;
+    }
+    
+    ~DGO_VKbotT() {
+#ifdef VK_HAS_NET_TASK
+        stopNetworkTask();
+#endif
+    }
+    
+    // Установить токен
+    void setToken(String t) {
+        token = t;
+    }
+    
+    // Установить ID группы (с минусом!)
+    void setGroupId(String id) {
+        groupId = id;
+        groupNum = labs(id.toInt());
+    }
+    
+    // Свой транспорт (например, для тестов); вызывать до begin()
+    // Объект транспорта должен жить дольше бота
+    void setTransport(VkTransport& transport) {
+        lpConn.setTransport(&transport);
+        apiConn.setTransport(&transport);
+    }
+    
+    // Другой адрес API вместо https://api.vk.com (например, локальный mock сервер)
+    void setApiEndpoint(String host, uint16_t port, bool secure) {
+        api->release();
+        apiHost = host;
+        apiPort = port;
+        apiSecure = secure;
+    }
+    
+    // Ходить в API через соединение бота owner: на несколько групп одно TLS соединение
+    // с api.vk.com (так их связывает VkHub). Токен, очередь и лимит запросов остаются
+    // свои, пачки ботов по очереди идут по одному соединению. Вызывать до begin();
+    // сетевая задача с общим соединением не запускается
+    bool shareApi(DGO_VKbotT& owner) {
+        if (eventRing || owner.eventRing || &owner == this) {
+            return false;
+        }
+        apiConn.release();
+        api = owner.api;
+        api->shared = true;
+        return true;
+    }
+    
+    // Где хранить сервер, ключ и ts между перезагрузками (nullptr - не хранить)
+    // По умолчанию RTC память; объект хранилища должен жить дольше бота
+    void setStateStore(VkStateStore* store) {
+        stateStore = store;
+        stateCrc = 0;
+    }
+    
+    // Забыть сохраненное состояние: следующий begin() начнет с нового ts
+    void clearState() {
+        if (stateStore) {
+            stateStore->clear();
+        }
+        stateCrc = 0;
+    }
+    
+    // Записать отложенное состояние (перед ESP.restart() или сном)
+    void flushState() {
+        if (stateStore) {
+            saveState();
+            stateStore->flush();
+        }
+    }
+    
+    // Запуск бота
+    bool begin() {
+        if (token.length() == 0 || groupId.length() == 0) {
+            VK_LOGE("Установите токен и ID группы!");
+            vkLogFlush();
+            return false;
+        }
+        
+        buildFilters();
+        // Память очереди выделяется один раз, дальше ячейки и код execute ее переиспользуют
+        if (Config::MESSAGE_SIZE > 0) {
+            for (uint8_t i = 0; i < Config::OUTBOX; i++) {
+                outbox[i].text.reserve(Config::MESSAGE_SIZE);
+            }
+            uint8_t batch = Config::OUTBOX < VK_EXECUTE_BATCH ? Config::OUTBOX : VK_EXECUTE_BATCH;
+            batchCode.reserve(16 + batch * (96 + Config::MESSAGE_SIZE * 5 / 4));
+        }
+        // После перезагрузки продолжаем с сохраненного ts: события за время
+        // перезагрузки не теряются, а getLongPollServer() нужен только при failed 2/3
+        if (!restoreState() && !getLongPollServer()) {
+            vkLogFlush();
+            return false;
+        }
+        
+        finishPoll(0);
+        started = true;
+        VK_LOGI("Бот запущен с Long Poll");
+        // begin() вызывают из setup(): здесь можно подождать UART
+        vkLogFlush();
+        return true;
+    }
+    
+    // Прикрепить обработчик сообщений
+    void attach(std::function<void(VkUpdate&)> callback) {
+        on(VK_MESSAGE_NEW, callback);
+    }
+    
+    // Функция, которую tick() и pollOnce() вызывают на каждом проходе, даже если бот
+    // не запустился (так подключается VkScheduler)
+    void onTick(std::function<void()> hook) {
+        tickHook = hook;
+    }
+    
+    // Прикрепить обработчик событий типа type (пустой обработчик - отписка)
+    // Из ответа Long Poll разбираются только поля событий, на которые есть обработчик
+    // Типы вне Config::EVENTS не разбираются, а у типов из STATIC_EVENTS обработчик уже есть
+    void on(VkEventType type, std::function<void(VkUpdate&)> handler) {
+        if (type >= VK_EVENT_TYPES || !isEnabled(type) || isStatic(type)) {
+            return;
+        }
+        eventHandlers[type] = handler;
+        viewHandlers[type] = nullptr;
+        buildLongPollFilter();
+    }
+    
+    // То же без копий: строки события указывают в разобранный ответ и живут только
+    // до выхода из обработчика (дольше - update.toOwned()). Заменяет обработчик из on()
+    void onView(VkEventType type, std::function<void(const VkUpdateView&)> handler) {
+        if (type >= VK_EVENT_TYPES || !isEnabled(type) || isStatic(type)) {
+            return;
+        }
+        viewHandlers[type] = handler;
+        eventHandlers[type] = nullptr;
+        buildLongPollFilter();
+    }
+    
+    // Обработчик новых сообщений без копий
+    void attachView(std::function<void(const VkUpdateView&)> callback) {
+        onView(VK_MESSAGE_NEW, callback);
+    }
+    
+    // Отправить сообщение
+    // С сетевой задачей соединение с API занято ею, поэтому сообщение встает в очередь
+    bool sendMessage(VkMessage msg) {
+        if (!started) {
+            VK_LOGE("Бот не запущен!");
+            return false;
+        }
+        if (outRing) {
+            return enqueueMessage(msg) != 0;
+        }
+        
+        VkForm form;
+        form.add("peer_id", (long)msg.peer_id);
+        form.add("message", msg.text);
+        form.add("random_id", newRandomId());
+        if (msg.attachment.length()) {
+            form.add("attachment", msg.attachment);
+        }
+        if (msg.keyboard.length()) {
+            form.add("keyboard", msg.keyboard);
+        }
+        
+        VkArenaDoc doc(apiArena);
+        uint32_t start = micros();
+        int httpCode = apiRequest("messages.send", form, doc, false);
+        
+        bool success = false;
+        if (httpCode == 200) {
+            if (doc["response"].is<int>()) {
+                success = true;
+                metrics.sent++;
+                metrics.send.since(start);
+            } else if (isRateLimitError(doc["error"]["error_code"] | 0)) {
+                // Не теряем сообщение: очередь повторит его после паузы
+                int errorCode = doc["error"]["error_code"];
+                if (enqueueMessage(msg) != 0) {
+                    outbox[(outboxHead + outboxCount - 1) % Config::OUTBOX].attempts = 1;
+                    unsigned long wait = backoffDelay(1);
+                    apiLimiter.penalize(wait);
+                    pauseOutbox(wait);
+                }
+                VK_LOGW("Превышен лимит (%d), сообщение будет отправлено из очереди", errorCode);
+            } else if (doc["error"].is<JsonObject>()) {
+                metrics.sendErrors++;
+                VK_LOGE("Ошибка отправки: %d - %s", doc["error"]["error_code"].as<int>(),
+                        doc["error"]["error_msg"] | "");
+            }
+        } else {
+            metrics.sendErrors++;
+            VK_LOGE("HTTP ошибка отправки: %d", httpCode);
+        }
+        
+        return success;
+    }
+    
+    // Быстрая отправка (перегрузка)
+    bool sendMessage(String text, int peer_id) {
+        VkMessage msg(text, peer_id);
+        return sendMessage(msg);
+    }
+    
+    // Отправить сообщение с клавиатурой
+    bool sendMessage(String text, int peer_id, const VkKeyboard& keyboard) {
+        VkMessage msg(text, peer_id);
+        msg.keyboard = keyboard.toJson();
+        return sendMessage(msg);
+    }
+    
+    // Ответить на нажатие callback-кнопки (message_event)
+    // Пока ответа нет, на кнопке крутится индикатор, а через минуту VK покажет ошибку.
+    // snackbar - текст всплывающего уведомления (пусто - без уведомления).
+    // Ответ встает в очередь и уходит вместе с сообщениями через execute;
+    // номер для onSendComplete(), message_id в результате будет 1
+    uint32_t answerEvent(const VkUpdateView& event, const String& snackbar = "") {
+        if (event.type != VK_MESSAGE_EVENT || event.event_id.isEmpty()) {
+            return 0;
+        }
+        VkOutgoing item;
+        item.peer_id = event.message.peer_id;
+        item.user_id = event.user_id;
+        item.event_id = event.event_id.toString();
+        item.text = snackbar;
+        return enqueueOutgoing(item);
+    }
+    
+    uint32_t answerEvent(const VkUpdate& event, const String& snackbar = "") {
+        return answerEvent(VkUpdateView(event), snackbar);
+    }
+    
+    // === ФОТО И ДОКУМЕНТЫ ===
+    
+    // Загрузить фото для беседы peer_id, вернуть вложение "photo<owner>_<id>_<key>" (пусто при ошибке)
+    // Вложение можно отправить сразу (sendPhoto()) или позже: VkMessage::attachment
+    // Файл идет в сокет кусками по VK_UPLOAD_CHUNK байт, память от его размера не зависит.
+    // Блокирует loop() на время загрузки; с сетевой задачей недоступно
+    String uploadPhoto(int peer_id, VkUploadSource& source, const String& filename = "photo.jpg") {
+        return uploadAttachment(true, peer_id, source, filename);
+    }
+    
+    // Загрузить документ (лог, CSV...), вернуть вложение "doc<owner>_<id>"
+    String uploadDocument(int peer_id, VkUploadSource& source, const String& filename) {
+        return uploadAttachment(false, peer_id, source, filename);
+    }
+    
+    // Загрузить и отправить фото с подписью
+    bool sendPhoto(int peer_id, VkUploadSource& source, const String& filename = "photo.jpg",
+                   const String& text = "") {
+        VkMessage msg(text, peer_id);
+        msg.attachment = uploadPhoto(peer_id, source, filename);
+        return msg.attachment.length() > 0 && sendMessage(msg);
+    }
+    
+    // Загрузить и отправить документ с подписью
+    bool sendDocument(int peer_id, VkUploadSource& source, const String& filename,
+                      const String& text = "") {
+        VkMessage msg(text, peer_id);
+        msg.attachment = uploadDocument(peer_id, source, filename);
+        return msg.attachment.length() > 0 && sendMessage(msg);
+    }
+    
+#if defined(ESP8266) || defined(ESP32)
+    // То же для файла с флеша: bot.sendPhoto(peer, LittleFS, "/chart.png")
+    bool sendPhoto(int peer_id, fs::FS& fs, const char* path, const String& text = "") {
+        return sendFile(true, peer_id, fs, path, text);
+    }
+    
+    bool sendDocument(int peer_id, fs::FS& fs, const char* path, const String& text = "") {
+        return sendFile(false, peer_id, fs, path, text);
+    }
+
+#endif
+    
+    // === ПРОФИЛИ ===
+    
+    // Профиль пользователя: из кэша, при промахе - users.get (nullptr - сообщество или ошибка)
+    // Указатель действителен до следующего запроса профилей или участников
+    //   const VkProfile* p = bot.getProfile(update.message.from_id);
+    //   if (p) reply += p->first_name;
+    const VkProfile* getProfile(int user_id) {
+        const VkProfile* profile = nullptr;
+        getProfiles(&user_id, 1, &profile);
+        return profile;
+    }
+    
+    // Профиль без ожидания: из кэша, а при промахе id встает в очередь и nullptr.
+    // Профиль придет с ближайшим execute (вместе с очередью сообщений) в onProfile().
+    // С сетевой задачей - только из кэша
+    const VkProfile* requestProfile(int user_id) {
+        const VkProfile* profile = user_id > 0 ? profiles.find(user_id) : nullptr;
+        if (profile) {
+            metrics.profileHits++;
+        } else if (started && !outRing) {
+            queueProfile(user_id);
+        }
+        return profile;
+    }
+    
+    // Профиль из очереди (requestProfile(), setProfilePrefetch()) получен и лежит в кэше
+    void onProfile(std::function<void(const VkProfile&)> callback) {
+        profileCallback = callback;
+    }
+    
+    // Профили сразу нескольких пользователей: все промахи - одним users.get
+    // out[i] - профиль ids[i] или nullptr, возвращает число найденных.
+    // За раз не больше VK_PROFILE_CACHE id, чтобы ответ поместился в кэш
+    uint8_t getProfiles(const int* ids, uint8_t count, const VkProfile** out) {
+        if (count > Config::PROFILE_CACHE) {
+            VK_LOGW("Слишком много профилей за раз, увеличьте VK_PROFILE_CACHE");
+            for (uint8_t i = Config::PROFILE_CACHE; i < count; i++) {
+                out[i] = nullptr;
+            }
+            count = Config::PROFILE_CACHE;
+        }
+        int missing[Config::PROFILE_CACHE];
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            if (ids[i] <= 0) {
+                continue;
+            }
+            if (profiles.find(ids[i])) {
+                metrics.profileHits++;
+                continue;
+            }
+            bool seen = false;
+            for (uint8_t k = 0; k < n && !seen; k++) {
+                seen = missing[k] == ids[i];
+            }
+            if (!seen) {
+                missing[n++] = ids[i];
+            }
+        }
+        if (n > 0) {
+            metrics.profileMisses += n;
+            if (canFetchProfiles()) {
+                fetchProfiles(missing, n);
+            }
+        }
+        uint8_t found = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            out[i] = ids[i] > 0 ? profiles.peek(ids[i]) : nullptr;
+            if (out[i]) found++;
+        }
+        return found;
+    }
+    
+    // Состоит ли пользователь в беседе peer_id
+    // Первый вопрос о беседе - messages.getConversationMembers (бот должен быть администратором
+    // беседы), ответ заполняет кэш участников и их профилей, повторные вопросы - без запросов
+    bool isChatMember(int peer_id, int user_id) {
+        const VkMember* m = chatMember(peer_id, user_id);
+        return m && m->member;
+    }
+    
+    // Администратор или создатель беседы
+    bool isChatAdmin(int peer_id, int user_id) {
+        const VkMember* m = chatMember(peer_id, user_id);
+        return m && m->admin;
+    }
+    
+    // Участие в беседе из кэша или от VK (nullptr - не удалось узнать)
+    const VkMember* chatMember(int peer_id, int user_id) {
+        const VkMember* m = members.find(memberKey(peer_id, user_id));
+        if (m) {
+            metrics.profileHits++;
+            return m;
+        }
+        metrics.profileMisses++;
+        return canFetchProfiles() ? fetchMember(peer_id, user_id) : nullptr;
+    }
+    
+    // Ставить авторов новых сообщений из ответа Long Poll в очередь профилей: их запросит
+    // один users.get в ближайшем execute, события при этом не ждут (без сетевой задачи)
+    void setProfilePrefetch(bool enable) {
+        profilePrefetch = enable;
+    }
+    
+    // Сколько профиль и участие в беседе считаются свежими (по умолчанию VK_PROFILE_TTL)
+    void setProfileTtl(unsigned long ms) {
+        profiles.setTtl(ms);
+        members.setTtl(ms);
+    }
+    
+    // Забыть профили и участников (например, после изменения состава беседы)
+    void clearProfiles() {
+        profiles.clear();
+        members.clear();
+    }
+    
+    // === ОЧЕРЕДЬ ИСХОДЯЩИХ СООБЩЕНИЙ ===
+    
+    // Поставить сообщение в очередь, не дожидаясь отправки
+    // Возвращает номер сообщения для onSendComplete() или 0, если очередь заполнена
+    uint32_t enqueueMessage(VkMessage msg) {
+        VkOutgoing item;
+        item.peer_id = msg.peer_id;
+        item.random_id = newRandomId();
+        item.text = msg.text;
+        item.attachment = msg.attachment;
+        item.keyboard = msg.keyboard;
+        return enqueueOutgoing(item);
+    }
+    
+    // Быстрая постановка в очередь (перегрузка)
+    uint32_t enqueueMessage(String text, int peer_id) {
+        VkMessage msg(text, peer_id);
+        return enqueueMessage(msg);
+    }
+    
+    // Текст из буфера (snprintf, PSTR) без промежуточных String: копируется прямо в ячейку
+    // очереди, с MESSAGE_SIZE - в память, выделенную в begin()
+    uint32_t enqueueMessage(const char* text, int peer_id) {
+        if (outRing) {
+            return enqueueMessage(String(text), peer_id);
+        }
+        if (outgoingFull()) {
+            return 0;
+        }
+        VkOutgoing& slot = outbox[(outboxHead + outboxCount) % Config::OUTBOX];
+        clearSlot(slot);
+        slot.peer_id = peer_id;
+        slot.user_id = 0;
+        slot.random_id = newRandomId();
+        slot.attempts = 0;
+        slot.text = text;
+        outboxCount++;
+        return stampOutgoing(slot);
+    }
+    
+    // Поставить в очередь сообщение с клавиатурой
+    uint32_t enqueueMessage(String text, int peer_id, const VkKeyboard& keyboard) {
+        VkMessage msg(text, peer_id);
+        msg.keyboard = keyboard.toJson();
+        return enqueueMessage(msg);
+    }
+    
+    // Разослать текст списку получателей: по VK_BROADCAST_PEERS в одном messages.send
+    // с peer_ids, пачки уходят через execute вместе с остальной очередью (одна пачка - один
+    // элемент очереди и один отчет onSendComplete с peer_id = 0).
+    // Возвращает, скольким получателям рассылка поставлена в очередь: меньше count -
+    // очередь заполнена, остаток (peers + результат) можно отправить позже
+    uint16_t broadcast(const String& text, const int* peers, uint16_t count) {
+        uint16_t queued = 0;
+        while (queued < count) {
+            uint16_t n = count - queued < VK_BROADCAST_PEERS ? count - queued : VK_BROADCAST_PEERS;
+            VkOutgoing item;
+            item.random_id = newRandomId();
+            item.text = text;
+            item.recipients = n;
+            item.peer_ids.reserve(n * 11);
+            for (uint16_t i = 0; i < n; i++) {
+                if (i > 0) item.peer_ids += ',';
+                appendNumber(item.peer_ids, peers[queued + i]);
+            }
+            if (enqueueOutgoing(item) == 0) {
+                break;
+            }
+            queued += n;
+        }
+        return queued;
+    }
+    
+    // Рассылка по списку с data() и size(), например VkSubscribers
+    template <class List>
+    uint16_t broadcast(const String& text, const List& list) {
+        return broadcast(text, list.data(), list.size());
+    }
+    
+    // Показать текст в живом сообщении: первый раз - отправка, дальше messages.edit
+    // Запрос ставится в очередь, только если текст изменился и прошел интервал живого сообщения,
+    // поэтому вызывать можно хоть на каждом tick(). Возвращает true, если запрос поставлен.
+    // Отправка идет через peer_ids с одним получателем: так VK возвращает conversation_message_id,
+    // по которому сообщество может править сообщение и в беседе
+    bool updateLive(VkLiveMessage& live, const String& text) {
+        uint32_t hash = VkLiveMessage::hash(text.c_str(), text.length());
+        if (!live.due(hash) || !watchLive(live)) {
+            return false;
+        }
+        VkOutgoing item;
+        item.peer_id = live.peerId();
+        item.text = text;
+        if (live.conversationMessageId()) {
+            item.conversation_message_id = live.conversationMessageId();
+        } else {
+            item.random_id = newRandomId();
+            item.recipients = 1;
+            appendNumber(item.peer_ids, live.peerId());
+        }
+        uint32_t id = enqueueOutgoing(item);
+        if (id == 0) {
+            return false;
+        }
+        live.requested(id, hash);
+        return true;
+    }
+    
+    // Обработчик результатов отправки сообщений из очереди
+    void onSendComplete(std::function<void(const VkSendResult&)> callback) {
+        sendCallback = callback;
+    }
+    
+    // Лимит запросов к api.vk.com: запросов в секунду и сколько можно сделать подряд
+    void setApiRateLimit(uint16_t perSecond, uint16_t burst = 1) {
+        apiLimiter.setLimit(perSecond, burst);
+    }
+    
+    // Сколько сообщений ждут отправки
+    uint8_t pendingMessages() {
+        if (outRing) {
+            return (uint8_t)(outboxQueued - outboxDone);
+        }
+        return outboxCount;
+    }
+    
+    // Отправить все сообщения из очереди (блокирующе)
+    bool flushOutbox(unsigned long timeoutMs = 10000) {
+        if (!started) {
+            return false;
+        }
+        
+        unsigned long start = millis();
+        if (outRing) {
+            // Сеть отправляет сама, ждем отчетов и разбираем кольца
+            while (outboxQueued != outboxDone && millis() - start < timeoutMs) {
+                drainRings(millis());
+                delay(1);
+            }
+            drainRings(millis());
+            return outboxQueued == outboxDone;
+        }
+        while (outboxCount > 0 && millis() - start < timeoutMs) {
+            if (!stepOutbox()) {
+                delay(1);
+            }
+        }
+        // Дожидаемся ответа на уже отправленную пачку
+        while (batchInFlight()) {
+            if (!stepOutbox()) {
+                delay(1);
+            }
+        }
+        return outboxCount == 0;
+    }
+    
+    // Получить время сервера VK
+    // С сетевой задачей соединение с API занято ею: ответ дают часы бота, если они уже подведены
+    unsigned long getServerTime() {
+        if (!started) {
+            VK_LOGE("Бот не запущен, невозможно получить время");
+            return 0;
+        }
+        if (outRing) {
+            if (clock.isSynced()) {
+                return (unsigned long)clock.now();
+            }
+            VK_LOGE("Запрос времени недоступен при запущенной сетевой задаче");
+            return 0;
+        }
+        
+        VkForm form;
+        VkArenaDoc doc(apiArena);
+        int httpCode = apiRequest("utils.getServerTime", form, doc);
+        
+        unsigned long serverTime = 0;
+        if (httpCode == 200) {
+            if (doc["response"].is<unsigned long>()) {
+                serverTime = doc["response"].as<unsigned long>();
+            } else if (doc["error"].is<JsonObject>()) {
+                VK_LOGE("Ошибка получения времени: %s", doc["error"]["error_msg"] | "");
+            }
+        } else {
+            VK_LOGE("HTTP ошибка при получении времени: %d", httpCode);
+        }
+        
+        return serverTime;
+    }
+    
+    // Тикер - обработать события
+    // В асинхронном режиме (по умолчанию) возвращается за несколько мс
+    void tick() {
+        if (tickHook) {
+            tickHook();
+        }
+        // Журнал с прошлого вызова: только то, что влезает в буфер UART
+        vkLogDrain();
+        if (!started) {
+            return;
+        }
+        
+        // Сеть работает в своей задаче: здесь только обработчики
+        if (eventRing) {
+            drainRings(millis());
+            return;
+        }
+        
+        if (blockingMode) {
+            processLongPoll();
+            flushOutbox();
+            return;
+        }
+        
+        unsigned long start = millis();
+        while (stepLongPoll()) {
+            if (millis() - start >= tickSlice) {
+                break;
+            }
+        }
+        while (stepOutbox()) {
+            if (millis() - start >= tickSlice) {
+                break;
+            }
+        }
+    }
+    
+    // Блокирующий режим: tick() ждет ответа Long Poll до 25 секунд, как раньше
+    void setBlockingMode(bool blocking) {
+        blockingMode = blocking;
+    }
+    
+    // Сколько мс tick() может работать за один вызов в асинхронном режиме
+    void setTickSlice(uint16_t ms) {
+        tickSlice = ms;
+    }
+    
+    // === РЕЖИМ С ГЛУБОКИМ СНОМ ===
+    
+    // Один цикл для устройства на батарее: Long Poll с коротким wait, обработчики,
+    // отправка очереди и сохранение состояния. Возвращает, сколько мс можно спать:
+    //   bot.begin();                          // после пробуждения продолжает с сохраненного ts
+    //   ESP.deepSleep(bot.pollOnce() * 1000);
+    // Пока идет переписка, интервал равен минимальному, в тишине удваивается до максимума
+    unsigned long pollOnce(uint8_t wait = 0) {
+        unsigned long start = millis();
+        lastPoll = VkPollResult();
+        if (!started || eventRing) {
+            lastPoll.sleepMs = sleepInterval;
+            vkLogFlush();
+            return sleepInterval;
+        }
+        
+        uint8_t savedWait = lpWait;
+        lpWait = wait;
+        uint32_t events = lpEvents;
+        lpAnswered = false;
+        if (pollState == VK_POLL_IDLE) {
+            pollDelay = 0;
+        }
+        processLongPoll();
+        // failed 2/3 или устаревший сервер: сразу берем новый, чтобы не спать впустую
+        if (!lpAnswered && needLongPollServer) {
+            pollDelay = 0;
+            processLongPoll();
+        }
+        lpWait = savedWait;
+        
+        lastPoll.ok = lpAnswered;
+        lastPoll.events = (uint16_t)(lpEvents - events);
+        if (tickHook) {
+            tickHook();
+        }
+        uint8_t queued = outboxCount;
+        flushOutbox();
+        lastPoll.sent = queued - outboxCount;
+        
+        if (lastPoll.events > 0 || outboxCount > 0) {
+            sleepInterval = sleepMin;
+        } else if (lastPoll.ok) {
+            sleepInterval = sleepInterval * 2 < sleepMax ? sleepInterval * 2 : sleepMax;
+        }
+        flushState();
+        // Перед сном журнал нужно отправить целиком
+        vkLogFlush();
+        
+        lastPoll.awakeMs = millis() - start;
+        lastPoll.sleepMs = sleepInterval;
+        return sleepInterval;
+    }
+    
+    // Границы интервала сна pollOnce()
+    void setSleepInterval(unsigned long minMs, unsigned long maxMs) {
+        sleepMin = minMs;
+        sleepMax = maxMs > minMs ? maxMs : minMs;
+        if (sleepInterval < sleepMin || sleepInterval > sleepMax) {
+            sleepInterval = sleepMin;
+        }
+    }
+    
+    // Итог последнего pollOnce() (awakeMs / events - время радио на событие)
+    const VkPollResult& getLastPoll() {
+        return lastPoll;
+    }
+    
+#ifdef VK_HAS_NET_TASK
+    // === СЕТЕВАЯ ЗАДАЧА ===
+    
+    // Перенести Long Poll, разбор и отправку в отдельную задачу FreeRTOS на ядре core
+    // (на хосте - в std::thread). Обработчики по-прежнему вызываются из tick() в loop(),
+    // события и исходящие сообщения передаются через кольца без блокировок, так что
+    // loop() не ждет сеть. Обработчики (attach/on/onSendComplete) назначаются до запуска,
+    // а syncTime() и getServerTime() при работающей задаче не шлют запросов - отвечают часы бота
+    bool startNetworkTask(uint8_t core = 0, uint32_t stackSize = VK_TASK_STACK,
+                          uint8_t priority = VK_TASK_PRIORITY) {
+        if (!started || eventRing) {
+            return false;
+        }
+        if (api->shared) {
+            VK_LOGE("Сетевая задача недоступна: соединение с API общее с другим ботом");
+            return false;
+        }
+        eventRing = new VkRing<VkUpdate, VK_TASK_EVENTS>();
+        outRing = new VkRing<VkOutgoing, VK_TASK_OUTGOING>();
+        resultRing = new VkRing<VkSendResult, VK_TASK_EVENTS>();
+        taskRunning = true;
+#ifdef DGO_VKBOT_HOST
+        netThread = std::thread([this]() { runNetworkTask(); });
+#else
+        taskExited = false;
+        if (xTaskCreatePinnedToCore(netTaskEntry, "vkbot", stackSize, this, priority,
+                                    &netTask, core) != pdPASS) {
+            VK_LOGE("Не удалось создать сетевую задачу");
+            taskRunning = false;
+            taskExited = true;
+            stopNetworkTask();
+            return false;
+        }
+#endif
+        VK_LOGI("Сетевая задача запущена на ядре %d", (int)core);
+        return true;
+    }
+    
+    // Остановить сетевую задачу и вернуться к работе из tick()
+    // Неразобранные события и неотправленные сообщения остаются в очереди
+    void stopNetworkTask() {
+        if (!eventRing) {
+            return;
+        }
+        taskRunning = false;
+#ifdef DGO_VKBOT_HOST
+        if (netThread.joinable()) {
+            netThread.join();
+        }
+#else
+        while (!taskExited) {
+            delay(1);
+        }
+        netTask = nullptr;
+#endif
+        // Отправленное, но еще не вызванное в loop() - отдаем сейчас
+        VkRing<VkUpdate, VK_TASK_EVENTS>* events = eventRing;
+        VkRing<VkOutgoing, VK_TASK_OUTGOING>* outgoing = outRing;
+        VkRing<VkSendResult, VK_TASK_EVENTS>* results = resultRing;
+        eventRing = nullptr;
+        outRing = nullptr;
+        resultRing = nullptr;
+        
+        VkUpdate update;
+        while (events->pop(update)) {
+            if (hasHandler(update.type)) {
+                callHandler(update);
+            }
+        }
+        VkSendResult result;
+        while (results->pop(result)) {
+            reportResult(result);
+        }
+        VkOutgoing item;
+        while (outboxCount < Config::OUTBOX && outgoing->pop(item)) {
+            addOutgoing(item);
+        }
+        delete events;
+        delete outgoing;
+        delete results;
+    }
+    
+    // Работает ли сетевая задача
+    bool isNetworkTaskRunning() {
+        return eventRing != nullptr;
+    }
+#endif
+    
+    // Текущее состояние Long Poll запроса
+    VkPollState getPollState() {
+        return pollState;
+    }
+    
+    // Проверить подключение
+    bool isStarted() {
+        return started;
+    }
+    
+    // === МЕТРИКИ ===
+    
+    // Счетчики и гистограммы задержек (время в микросекундах)
+    // С сетевой задачей их меняет другое ядро, так что значения приблизительные
+    const VkMetrics& getMetrics() const {
+        return metrics;
+    }
+    
+    void resetMetrics() {
+        metrics.reset();
+    }
+    
+    // Арены разбора JSON: peak() - сколько байт понадобилось, overflows() - сколько раз
+    // ответ не поместился и память взята из кучи (тогда LP_ARENA / API_ARENA мало)
+    const VkArenaBase& getLongPollArena() const {
+        return lpArena;
+    }
+    
+    const VkArenaBase& getApiArena() const {
+        return apiArena;
+    }
+    
+    // Компактный JSON со всеми метриками, например в Serial или в ответ на команду "stats"
+    size_t writeMetricsJson(Print& out) const {
+        return metrics.writeJson(out);
+    }
+    
+    String getMetricsJson() const {
+        String json;
+        json.reserve(768);
+        VkStringPrint out(json);
+        metrics.writeJson(out);
+        return json;
+    }
+    
+    // === УПРАВЛЕНИЕ ВРЕМЕНЕМ И ТАЙМЗОНОЙ ===
+    
+    // Установить смещение таймзоны в секундах (например, 10800 для UTC+3)
+    bool setTimezoneOffset(int offsetSeconds) {
+        if (offsetSeconds < -43200 || offsetSeconds > 50400) {
+            VK_LOGE("Неверное значение таймзоны: %d секунд (должно быть от -43200 до +50400)", offsetSeconds);
+            return false;
+        }
+        
+        timezoneOffset = offsetSeconds;
+        int hours = abs(offsetSeconds) / 3600;
+        int minutes = (abs(offsetSeconds) % 3600) / 60;
+        char sign = offsetSeconds < 0 ? '-' : '+';
+        if (minutes > 0) {
+            VK_LOGI("Таймзона установлена: UTC%c%d:%02d (%d секунд)", sign, hours, minutes, offsetSeconds);
+        } else {
+            VK_LOGI("Таймзона установлена: UTC%c%d (%d секунд)", sign, hours, offsetSeconds);
+        }
+        return true;
+    }
+    
+    // Установить таймзону в часах (например, 3 для UTC+3)
+    bool setTimezone(int offsetHours) {
+        if (offsetHours < -12 || offsetHours > 14) {
+            VK_LOGE("Неверное значение таймзоны: %d часов (должно быть от -12 до +14)", offsetHours);
+            return false;
+        }
+        return setTimezoneOffset(offsetHours * 3600);
+    }
+    
+    // Получить текущее смещение таймзоны в секундах
+    int getTimezoneOffset() {
+        return timezoneOffset;
+    }
+    
+    // Синхронизировать время с сервером VK (UTC)
+    // Часы подводятся сами по заголовкам Date ответов VK, поэтому обычно запрос не нужен:
+    // utils.getServerTime вызывается, только если ни одного ответа с Date еще не было
+    bool syncTime() {
+        if (!started) {
+            VK_LOGE("Бот не запущен, невозможно синхронизировать время");
+            return false;
+        }
+        
+        if (!clock.isSynced()) {
+            if (outRing) {
+                // Часы подведет первый же ответ сетевой задачи
+                VK_LOGE("Запрос времени недоступен при запущенной сетевой задаче");
+                return false;
+            }
+            VK_LOGD("Синхронизация времени с сервером VK...");
+            
+            unsigned long vkTime = getServerTime();
+            if (vkTime == 0) {
+                VK_LOGE("Ошибка получения времени от VK API");
+                return false;
+            }
+            // Ответ без заголовка Date: время из тела тоже годится как нижняя граница
+            if (!clock.isSynced()) {
+                clock.addEventDate(millis(), vkTime);
+            }
+        }
+        
+        time_t utc = clock.now();
+        struct tm *timeinfo_utc = gmtime(&utc);
+        if (timeinfo_utc != nullptr) {
+            char timeStr[30];
+            strftime(timeStr, sizeof(timeStr), "%d.%m.%Y %H:%M:%S UTC", timeinfo_utc);
+            char localStr[40] = "";
+            
+            if (timezoneOffset != 0) {
+                time_t localTime = utc + timezoneOffset;
+                struct tm *timeinfo_local = gmtime(&localTime);
+                if (timeinfo_local != nullptr) {
+                    strftime(localStr, sizeof(localStr), ", локальное: %d.%m.%Y %H:%M:%S", timeinfo_local);
+                }
+            }
+            VK_LOGI("Время синхронизировано: %lu (%s)%s", (unsigned long)utc, timeStr, localStr);
+        }
+        
+        return true;
+    }
+    
+    // Получить текущее время с учетом таймзоны
+    // Часы идут по millis() с поправкой на уход кварца и подстраиваются по трафику VK
+    time_t getCurrentTime() {
+        time_t utc = clock.now();
+        if (utc == 0) {
+            return 0;
+        }
+        return utc + timezoneOffset;
+    }
+    
+    // Часы бота: UTC в мс (nowMs()), оценка ухода кварца (driftPpm()), последняя поправка
+    VkClock& getClock() {
+        return clock;
+    }
+    
+    // Получить текущее время как строку
+    String getCurrentTimeString() {
+        time_t currentTime = getCurrentTime();
+        
+        if (currentTime < 946684800) {
+            return "Время не синхронизировано";
+        }
+        
+        struct tm *timeinfo = gmtime(&currentTime);
+        if (timeinfo == nullptr) {
+            return "Ошибка получения времени";
+        }
+        
+        if (timeinfo->tm_hour > 23 || timeinfo->tm_min > 59 || timeinfo->tm_sec > 59) {
+            return "Некорректное время";
+        }
+        
+        char timeStr[30];
+        strftime(timeStr, sizeof(timeStr), "%d.%m.%Y %H:%M:%S", timeinfo);
+        return String(timeStr);
+    }
+    
+    // Получить секунды с начала дня (0-86399)
+    unsigned long getSecondsFromMidnight() {
+        time_t currentTime = getCurrentTime();
+        
+        if (currentTime < 946684800) {
+            return 0;
+        }
+        
+        struct tm *timeinfo = gmtime(&currentTime);
+        if (timeinfo == nullptr) {
+            return 0;
+        }
+        
+        if (timeinfo->tm_hour > 23 || timeinfo->tm_min > 59 || timeinfo->tm_sec > 59) {
+            return 0;
+        }
+        
+        return timeinfo->tm_hour * 3600 + timeinfo->tm_min * 60 + timeinfo->tm_sec;
+    }
+    
+    // Проверить, синхронизировано ли время
+    bool isTimeSynced() {
+        return clock.isSynced();
+    }
+};
+
+typedef DGO_VKbotT<> DGO_VKbot;
+
+#endif // DGO_VKBOT_H
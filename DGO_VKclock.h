@@ -0,0 +1,350 @@
+// DGO_VKclock.h - Часы бота, которые подстраиваются по уже идущему трафику
+// Источники времени: заголовок Date в ответах VK и поле date входящих сообщений,
+// отдельных запросов к utils.getServerTime не нужно
+//
+// Каждый замер дает интервал, в котором точно лежит время сервера:
+//   Date ответа API   [Date, Date + 1 с + время запроса]
+//   Date Long Poll    [Date, Date + 1 с + задержка сети] (сколько сервер держал запрос, неизвестно)
+//   date сообщения    [date, ...) - только нижняя граница
+// Часы сразу догоняют нарушенную границу, а за окно VK_CLOCK_WINDOW встают в середину
+// пересечения всех интервалов. Верхнюю границу окну дают только запросы к API, которые шли
+// почти так же быстро, как лучший. Середины окон за несколько часов - точки, по которым
+// методом наименьших квадратов оценивается, насколько кварц спешит или отстает, и дальше
+// этот уход учитывается при каждом чтении
+
+#ifndef DGO_VKCLOCK_H
+#define DGO_VKCLOCK_H
+
+#include <Arduino.h>
+#include <time.h>
+#include <atomic>
+#include "DGO_VKlog.h"
+
+#ifndef VK_CLOCK_WINDOW
+#define VK_CLOCK_WINDOW 600000UL         // Окно сбора замеров перед подстройкой, мс
+#endif
+#ifndef VK_CLOCK_DRIFT_SPAN
+#define VK_CLOCK_DRIFT_SPAN 21600000UL   // За какой срок оценивается уход частоты, мс (6 часов)
+#endif
+#ifndef VK_CLOCK_MAX_DRIFT
+#define VK_CLOCK_MAX_DRIFT 500L          // Максимальный учитываемый уход, ppm
+#endif
+#ifndef VK_CLOCK_ONE_WAY
+#define VK_CLOCK_ONE_WAY 500UL           // Задержка ответа Long Poll в сети, пока не измерили свою, мс
+#endif
+#ifndef VK_CLOCK_RTT_SLACK
+#define VK_CLOCK_RTT_SLACK 30UL          // Насколько запрос может быть медленнее лучшего, чтобы сузить окно, мс
+#endif
+#ifndef VK_CLOCK_POINTS
+#define VK_CLOCK_POINTS 8                // Сколько середин окон хранится для оценки ухода
+#endif
+#define VK_CLOCK_STEP 2000L              // Поправка больше этой - скачок, а не уход частоты
+
+class VkClock {
+private:
+    // Локальное время в мс без переполнения millis() через 49 дней
+    int64_t lastLocal;
+    uint32_t lastMillis;
+
+    // Модель: UTC = refUtc + dt + dt * driftPpb / 1e9, где dt = local - refLocal
+    int64_t refLocal;
+    int64_t refUtc;
+    int32_t driftPpb;
+    bool synced;
+    int64_t lastUtc;                // Последнее выданное время (часы не идут назад)
+
+    // Текущее окно: на сколько можно сдвинуть часы, не нарушив ни один замер
+    int64_t winStart;
+    int32_t winLow;                 // Максимум нижних границ минус наше время
+    int32_t winHigh;                // Минимум верхних границ минус наше время
+    bool winHasHigh;
+
+    // Середины окон для оценки ухода: наше время и время сервера минус наше.
+    // Точка не чаще раза в driftSpan / VK_CLOCK_POINTS, так что кольцо покрывает driftSpan
+    int64_t pointLocal[VK_CLOCK_POINTS];
+    int64_t pointOffset[VK_CLOCK_POINTS];
+    uint8_t pointHead;              // Самая старая точка
+    uint8_t pointCount;
+
+    uint32_t minRoundTrip;          // Лучшее время запроса к API (оценка задержки сети)
+    uint32_t sampleCount;
+    int32_t lastCorrection;
+    int32_t pendingStep;            // Скачок для журнала: пишем после снятия блокировки
+
+    uint32_t window;
+    uint32_t driftSpan;
+    int32_t maxDriftPpb;
+
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;   // Замеры идут из сетевой задачи, чтение - из loop()
+
+    void lock() {
+        while (busy.test_and_set(std::memory_order_acquire)) {
+        }
+    }
+
+    void unlock() {
+        busy.clear(std::memory_order_release);
+    }
+
+    int64_t extend(uint32_t ms) {
+        int64_t local = lastLocal + (int32_t)(ms - lastMillis);
+        if ((int32_t)(ms - lastMillis) > 0) {
+            lastLocal = local;
+            lastMillis = ms;
+        }
+        return local;
+    }
+
+    int64_t utcAt(int64_t local) const {
+        int64_t dt = local - refLocal;
+        return refUtc + dt + dt * driftPpb / 1000000000LL;
+    }
+
+    // Сдвинуть часы на c мс начиная с local
+    void correct(int64_t local, int64_t c) {
+        refUtc = utcAt(local) + c;
+        refLocal = local;
+        if (winLow != INT32_MIN) winLow -= (int32_t)c;
+        if (winHigh != INT32_MAX) winHigh -= (int32_t)c;
+        lastCorrection = (int32_t)c;
+        if (c > VK_CLOCK_STEP || c < -VK_CLOCK_STEP) {
+            // Скачок (сбой, смена сервера): точки до него уходу не верны
+            pointCount = 0;
+            pendingStep = (int32_t)c;
+        }
+    }
+
+    // Добавить середину окна; самая старая точка вытесняется
+    void addPoint(int64_t local) {
+        if (pointCount > 0) {
+            uint8_t newest = (pointHead + pointCount - 1) % VK_CLOCK_POINTS;
+            if (local - pointLocal[newest] < (int64_t)(driftSpan / VK_CLOCK_POINTS)) {
+                return;
+            }
+        }
+        uint8_t slot = (pointHead + pointCount) % VK_CLOCK_POINTS;
+        if (pointCount < VK_CLOCK_POINTS) {
+            pointCount++;
+        } else {
+            pointHead = (pointHead + 1) % VK_CLOCK_POINTS;
+        }
+        pointLocal[slot] = local;
+        pointOffset[slot] = utcAt(local) - local;
+    }
+
+    // Наклон прямой через точки (наименьшие квадраты) - уход частоты, ppb.
+    // false, если точки покрывают меньше трех окон
+    bool fitDrift(int64_t& drift) const {
+        if (pointCount < 3) {
+            return false;
+        }
+        uint8_t last = (pointHead + pointCount - 1) % VK_CLOCK_POINTS;
+        if (pointLocal[last] - pointLocal[pointHead] < (int64_t)window * 3) {
+            return false;
+        }
+        // Отсчеты от самой старой точки: в double без потери точности
+        double sx = 0, sy = 0, sxx = 0, sxy = 0;
+        for (uint8_t i = 0; i < pointCount; i++) {
+            uint8_t k = (pointHead + i) % VK_CLOCK_POINTS;
+            double x = (double)(pointLocal[k] - pointLocal[pointHead]);
+            double y = (double)(pointOffset[k] - pointOffset[pointHead]);
+            sx += x;
+            sy += y;
+            sxx += x * x;
+            sxy += x * y;
+        }
+        double den = pointCount * sxx - sx * sx;
+        if (den <= 0) {
+            return false;
+        }
+        drift = (int64_t)((pointCount * sxy - sx * sy) / den * 1e9);
+        return true;
+    }
+
+    void startWindow(int64_t local) {
+        winStart = local;
+        winLow = INT32_MIN;
+        winHigh = INT32_MAX;
+        winHasHigh = false;
+    }
+
+    // Окно закончилось: встаем в середину пересечения и уточняем уход частоты.
+    // Пока уход не оценен, границы за окно расходятся и пересечение бывает пустым; середина
+    // между ними смещена, но одинаково от окна к окну, и наклон по таким точкам верный
+    void closeWindow(int64_t local) {
+        if (winHasHigh) {
+            correct(local, ((int64_t)winLow + winHigh) / 2);
+            addPoint(local);
+            int64_t drift;
+            if (fitDrift(drift)) {
+                if (drift > maxDriftPpb) drift = maxDriftPpb;
+                if (drift < -maxDriftPpb) drift = -maxDriftPpb;
+                refUtc = utcAt(local);
+                refLocal = local;
+                driftPpb = (int32_t)drift;
+            }
+        }
+        if (minRoundTrip < 0xFFFFFFFFUL) {
+            minRoundTrip++;     // Медленно забываем старый минимум: маршрут мог измениться
+        }
+        startWindow(local);
+    }
+
+    enum SampleKind {
+        SAMPLE_API,             // Date ответа API: граница точная
+        SAMPLE_LONG_POLL,       // Date Long Poll: верхняя граница - оценка
+        SAMPLE_EVENT            // date сообщения: только нижняя граница
+    };
+
+    // Замер: в момент ms время сервера было не меньше date и не больше date + ширина интервала
+    void addSample(uint32_t ms, uint32_t date, SampleKind kind, uint32_t roundTrip) {
+        int64_t low = (int64_t)date * 1000;
+        uint32_t width = 0xFFFFFFFFUL;
+        bool hard = kind != SAMPLE_LONG_POLL;
+        bool narrows = true;        // Может ли верхняя граница сузить окно
+
+        lock();
+        if (kind == SAMPLE_API) {
+            if (roundTrip < minRoundTrip) {
+                minRoundTrip = roundTrip;
+            }
+            width = 1000 + roundTrip;
+            // Долгий запрос дает рыхлую границу: она только страхует от ошибки
+            narrows = roundTrip <= minRoundTrip + VK_CLOCK_RTT_SLACK;
+        } else if (kind == SAMPLE_LONG_POLL) {
+            width = 1000 + (minRoundTrip < VK_CLOCK_ONE_WAY ? minRoundTrip : VK_CLOCK_ONE_WAY);
+        }
+        int64_t local = extend(ms);
+        sampleCount++;
+        if (!synced) {
+            refLocal = local;
+            refUtc = low + (width < 0xFFFFFFFFUL ? width / 2 : 0);
+            pointCount = 0;
+            synced = true;
+            startWindow(local);
+            unlock();
+            return;
+        }
+
+        int64_t now = utcAt(local);
+        int64_t lowRes = low - now;
+        if (lowRes > 0) {
+            correct(local, lowRes);     // Отстаем от сервера: догоняем сразу
+            lowRes = 0;
+        }
+        int64_t highRes = INT32_MAX;
+        if (width < 0xFFFFFFFFUL) {
+            highRes = low + width - utcAt(local);
+            if (highRes < 0 && hard) {
+                correct(local, highRes);    // Спешим больше, чем может быть: отступаем
+                lowRes -= highRes;
+                highRes = 0;
+            }
+        }
+
+        if (lowRes > winLow) winLow = (int32_t)lowRes;
+        if (highRes < INT32_MAX && narrows) {
+            if (highRes < winHigh) winHigh = (int32_t)highRes;
+            winHasHigh = true;
+        }
+        if (local - winStart >= (int64_t)window) {
+            closeWindow(local);
+        }
+        int32_t step = pendingStep;
+        pendingStep = 0;
+        unlock();
+
+        if (step != 0) {
+            VK_LOGI("Часы сдвинуты на %ld мс", (long)step);
+        }
+    }
+
+public:
+    VkClock() : lastLocal(0), lastMillis(0), refLocal(0), refUtc(0), driftPpb(0), synced(false), lastUtc(0),
+                winStart(0), winLow(INT32_MIN), winHigh(INT32_MAX), winHasHigh(false),
+                pointHead(0), pointCount(0), minRoundTrip(0xFFFFFFFFUL), sampleCount(0), lastCorrection(0), pendingStep(0),
+                window(VK_CLOCK_WINDOW), driftSpan(VK_CLOCK_DRIFT_SPAN), maxDriftPpb(VK_CLOCK_MAX_DRIFT * 1000L) {
+        lastMillis = millis();
+    }
+
+    // Ответ API: заголовок Date (секунды) и время запроса roundTrip мс, ответ получен в ms
+    void addHttpDate(uint32_t ms, uint32_t date, uint32_t roundTrip) {
+        addSample(ms, date, SAMPLE_API, roundTrip);
+    }
+
+    // Ответ Long Poll: сервер держал запрос неизвестно сколько, верхняя граница - оценка
+    void addLongPollDate(uint32_t ms, uint32_t date) {
+        addSample(ms, date, SAMPLE_LONG_POLL, 0);
+    }
+
+    // Входящее сообщение: отправлено не позже, чем сейчас
+    void addEventDate(uint32_t ms, uint32_t date) {
+        addSample(ms, date, SAMPLE_EVENT, 0);
+    }
+
+    // UTC в миллисекундах, 0 если еще не синхронизированы
+    int64_t nowMs() {
+        return nowMs(millis());
+    }
+
+    // UTC в момент ms (значение millis(), не раньше последнего замера)
+    int64_t nowMs(uint32_t ms) {
+        lock();
+        int64_t utc = 0;
+        if (synced) {
+            utc = utcAt(extend(ms));
+            if (utc < lastUtc) {
+                utc = lastUtc;      // После поправки назад часы стоят, пока не догонят
+            }
+            lastUtc = utc;
+        }
+        unlock();
+        return utc;
+    }
+
+    // UTC в секундах
+    time_t now() {
+        return (time_t)(nowMs() / 1000);
+    }
+
+    bool isSynced() const {
+        return synced;
+    }
+
+    // Оценка ухода частоты: на сколько миллионных наши часы отстают (+) или спешат (-)
+    float driftPpm() const {
+        return driftPpb / 1000.0f;
+    }
+
+    // Последняя поправка, мс
+    int32_t getLastCorrection() const {
+        return lastCorrection;
+    }
+
+    uint32_t samples() const {
+        return sampleCount;
+    }
+
+    // Окно подстройки и отрезок оценки ухода (мс), предел ухода (ppm)
+    void setLimits(uint32_t windowMs, uint32_t driftSpanMs, long maxDriftPpm) {
+        lock();
+        window = windowMs;
+        driftSpan = driftSpanMs > windowMs ? driftSpanMs : windowMs;
+        maxDriftPpb = (int32_t)(maxDriftPpm * 1000L);
+        unlock();
+    }
+
+    // Забыть синхронизацию
+    void reset() {
+        lock();
+        synced = false;
+        driftPpb = 0;
+        lastUtc = 0;
+        sampleCount = 0;
+        pointCount = 0;
+        minRoundTrip = 0xFFFFFFFFUL;
+        unlock();
+    }
+};
+
+#endif // DGO_VKCLOCK_H
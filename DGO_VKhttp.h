@@ -0,0 +1,659 @@
+// DGO_VKhttp.h - Минимальный HTTP/1.1 клиент для DGO_VKbot
+// Работает поверх любого Client, не блокирует при ожидании ответа
+// Поддерживает keep-alive, Content-Length и chunked
+
+#ifndef DGO_VKHTTP_H
+#define DGO_VKHTTP_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+// Разбор URL вида https://host[:port]/path
+struct VkUrl {
+    String host;
+    String path;
+    uint16_t port;
+    bool secure;
+
+    VkUrl() : port(443), secure(true) {}
+
+    bool parse(const String& url) {
+        int start = 0;
+        secure = true;
+        if (url.startsWith("https://")) {
+            start = 8;
+        } else if (url.startsWith("http://")) {
+            start = 7;
+            secure = false;
+        }
+
+        int slash = url.indexOf('/', start);
+        String hostPort = slash < 0 ? url.substring(start) : url.substring(start, slash);
+        path = slash < 0 ? String("/") : url.substring(slash);
+
+        int colon = hostPort.indexOf(':');
+        if (colon >= 0) {
+            host = hostPort.substring(0, colon);
+            port = (uint16_t)hostPort.substring(colon + 1).toInt();
+        } else {
+            host = hostPort;
+            port = secure ? 443 : 80;
+        }
+        return host.length() > 0 && port != 0;
+    }
+};
+
+#ifndef VK_FORM_FIELDS
+#define VK_FORM_FIELDS 12       // Максимум полей в одном запросе
+#endif
+
+// Тело запроса application/x-www-form-urlencoded
+// Значения не копируются: строки должны жить до отправки запроса
+// Кодирование идет сразу в поток через небольшой буфер на стеке, без String
+class VkForm {
+private:
+    struct Field {
+        const char* name;
+        const char* value;
+        size_t len;
+        char number[12];    // Для числовых значений
+    };
+    
+    Field fields[VK_FORM_FIELDS];
+    uint8_t count;
+    
+    // Символы, которые не нужно кодировать (RFC 3986)
+    static bool unreserved(uint8_t c) {
+        return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+               c == '-' || c == '_' || c == '.' || c == '~';
+    }
+    
+public:
+    VkForm() : count(0) {}
+    VkForm(const VkForm&) = delete;
+    VkForm& operator=(const VkForm&) = delete;
+    
+    bool add(const char* name, const char* value, size_t len) {
+        if (count >= VK_FORM_FIELDS) {
+            return false;
+        }
+        Field& f = fields[count++];
+        f.name = name;
+        f.value = value;
+        f.len = len;
+        return true;
+    }
+    
+    bool add(const char* name, const char* value) {
+        return add(name, value, strlen(value));
+    }
+    
+    bool add(const char* name, const String& value) {
+        return add(name, value.c_str(), value.length());
+    }
+    
+    bool add(const char* name, long value) {
+        if (count >= VK_FORM_FIELDS) {
+            return false;
+        }
+        Field& f = fields[count];
+        int n = snprintf(f.number, sizeof(f.number), "%ld", value);
+        return add(name, f.number, (size_t)n);
+    }
+    
+    // Длина закодированного тела (для Content-Length), без записи
+    size_t length() const {
+        size_t total = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            if (i > 0) total++;
+            total += strlen(fields[i].name) + 1 + encodedLength(fields[i].value, fields[i].len);
+        }
+        return total;
+    }
+    
+    // Записать тело в поток, возвращает число записанных байт
+    size_t writeTo(Print& out) const {
+        size_t total = 0;
+        for (uint8_t i = 0; i < count; i++) {
+            if (i > 0) total += out.write('&');
+            total += out.write((const uint8_t*)fields[i].name, strlen(fields[i].name));
+            total += out.write('=');
+            total += encode(out, fields[i].value, fields[i].len);
+        }
+        return total;
+    }
+    
+    static size_t encodedLength(const char* s, size_t len) {
+        size_t total = 0;
+        for (size_t i = 0; i < len; i++) {
+            uint8_t c = (uint8_t)s[i];
+            total += (unreserved(c) || c == ' ') ? 1 : 3;
+        }
+        return total;
+    }
+    
+    // Процентное кодирование по байтам UTF-8 (пробел -> +)
+    static size_t encode(Print& out, const char* s, size_t len) {
+        static const char hex[] = "0123456789ABCDEF";
+        uint8_t buf[64];
+        size_t n = 0;
+        size_t total = 0;
+        for (size_t i = 0; i < len; i++) {
+            uint8_t c = (uint8_t)s[i];
+            if (unreserved(c)) {
+                buf[n++] = c;
+            } else if (c == ' ') {
+                buf[n++] = '+';
+            } else {
+                buf[n++] = '%';
+                buf[n++] = hex[c >> 4];
+                buf[n++] = hex[c & 0x0F];
+            }
+            if (n > sizeof(buf) - 3) {
+                total += out.write(buf, n);
+                n = 0;
+            }
+        }
+        if (n > 0) {
+            total += out.write(buf, n);
+        }
+        return total;
+    }
+};
+
+// Транспорт: откуда соединения бота берут сетевых клиентов
+// По умолчанию WiFiClient/WiFiClientSecure, на хосте - POSIX сокеты (extras/host)
+class VkTransport {
+public:
+    virtual ~VkTransport() {}
+    
+    // Создать клиента (secure - нужен TLS), nullptr если нельзя
+    virtual Client* createClient(bool secure) = 0;
+    
+    // Удалить клиента, созданного createClient() с тем же secure
+    virtual void destroyClient(Client* client, bool secure) = 0;
+};
+
+// HTTP клиент: сначала заголовки через pollHeaders(), потом тело как Stream
+class VkHttpClient : public Stream {
+private:
+    enum ChunkState {
+        CHUNK_SIZE,     // Читаем размер чанка
+        CHUNK_DATA,     // Внутри данных чанка
+        CHUNK_CRLF,     // CRLF после данных
+        CHUNK_TRAILER   // Хвост после последнего чанка
+    };
+
+    Client* client;
+    String connectedHost;
+    uint16_t connectedPort;
+
+    // Разбор заголовков ответа
+    char line[128];
+    uint8_t lineLen;
+    bool lineOverflow;
+    bool statusParsed;
+
+    int statusCode;
+    long contentLength;     // -1 если длина неизвестна
+    long remaining;         // Сколько байт тела осталось (-1 если неизвестно)
+    bool chunked;
+    bool keepAlive;
+    bool bodyDone;
+    uint32_t date;              // Заголовок Date, секунды Unix (0 если нет)
+    unsigned long sentAt;       // Когда отправили запрос (millis)
+    unsigned long headersAt;    // Когда дочитали заголовки ответа (millis)
+
+    ChunkState chunkState;
+    unsigned long chunkLeft;
+    bool chunkExt;
+    uint8_t trailerLen;
+
+    // Буфер исходящего запроса
+    uint8_t txBuf[256];
+    size_t txLen;
+    bool txFailed;
+
+    void flushTx() {
+        if (txLen > 0 && !txFailed && client->write(txBuf, txLen) != txLen) {
+            txFailed = true;
+        }
+        txLen = 0;
+    }
+
+    void resetResponse() {
+        lineLen = 0;
+        lineOverflow = false;
+        statusParsed = false;
+        statusCode = 0;
+        contentLength = -1;
+        remaining = -1;
+        chunked = false;
+        keepAlive = true;
+        bodyDone = false;
+        date = 0;
+        chunkState = CHUNK_SIZE;
+        chunkLeft = 0;
+        chunkExt = false;
+        trailerLen = 0;
+    }
+
+    static bool headerIs(const char* header, const char* name) {
+        size_t n = strlen(name);
+        return strncasecmp(header, name, n) == 0 && header[n] == ':';
+    }
+
+    static const char* headerValue(const char* header) {
+        const char* v = strchr(header, ':');
+        if (!v) return "";
+        v++;
+        while (*v == ' ' || *v == '\t') v++;
+        return v;
+    }
+
+    // Date: Sun, 06 Nov 1994 08:49:37 GMT -> секунды Unix, 0 если формат другой
+    static uint32_t parseDate(const char* v) {
+        static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+        const char* comma = strchr(v, ',');
+        if (!comma) return 0;
+        int day, year, hh, mm, ss;
+        char mon[4];
+        if (sscanf(comma + 1, " %d %3s %d %d:%d:%d", &day, mon, &year, &hh, &mm, &ss) != 6) {
+            return 0;
+        }
+        const char* m = strstr(months, mon);
+        if (!m || (m - months) % 3 != 0 || year < 1970) {
+            return 0;
+        }
+        int month = (int)(m - months) / 3 + 1;
+        
+        // Дни от 1970-01-01 (алгоритм days_from_civil)
+        int y = month <= 2 ? year - 1 : year;
+        int era = y / 400;
+        int yoe = y - era * 400;
+        int doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+        long days = (long)era * 146097 + doe - 719468;
+        return (uint32_t)(days * 86400L + hh * 3600L + mm * 60L + ss);
+    }
+
+    // Обработка одной строки заголовка, возвращает true на пустой строке
+    bool processLine() {
+        line[lineLen] = 0;
+        if (lineLen > 0 && line[lineLen - 1] == '\r') {
+            line[--lineLen] = 0;
+        }
+
+        if (!statusParsed) {
+            // HTTP/1.1 200 OK
+            const char* sp = strchr(line, ' ');
+            statusCode = sp ? atoi(sp + 1) : 0;
+            keepAlive = strncmp(line, "HTTP/1.1", 8) == 0;
+            statusParsed = true;
+            return false;
+        }
+
+        if (lineLen == 0) {
+            return true;
+        }
+
+        if (lineOverflow) {
+            return false;
+        }
+
+        if (headerIs(line, "Content-Length")) {
+            contentLength = atol(headerValue(line));
+        } else if (headerIs(line, "Transfer-Encoding")) {
+            chunked = strncasecmp(headerValue(line), "chunked", 7) == 0;
+        } else if (headerIs(line, "Connection")) {
+            const char* v = headerValue(line);
+            if (strncasecmp(v, "close", 5) == 0) keepAlive = false;
+            else if (strncasecmp(v, "keep-alive", 10) == 0) keepAlive = true;
+        } else if (headerIs(line, "Date")) {
+            date = parseDate(headerValue(line));
+        }
+        return false;
+    }
+
+    // Подготовить следующий чанк, false если данных пока нет
+    bool prepareChunk() {
+        while (chunkLeft == 0 && !bodyDone) {
+            if (client->available() <= 0) {
+                return false;
+            }
+            int c = client->read();
+            if (c < 0) {
+                return false;
+            }
+
+            switch (chunkState) {
+                case CHUNK_CRLF:
+                    if (c == '\n') chunkState = CHUNK_SIZE;
+                    break;
+
+                case CHUNK_SIZE:
+                    if (c == '\n') {
+                        chunkExt = false;
+                        if (remaining == 0) {
+                            chunkState = CHUNK_TRAILER;
+                            trailerLen = 0;
+                        } else {
+                            chunkLeft = (unsigned long)remaining;
+                            remaining = 0;
+                            chunkState = CHUNK_DATA;
+                        }
+                    } else if (c == ';') {
+                        chunkExt = true;
+                    } else if (!chunkExt && isxdigit(c)) {
+                        int v = isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10);
+                        remaining = remaining * 16 + v;
+                    }
+                    break;
+
+                case CHUNK_TRAILER:
+                    if (c == '\n') {
+                        if (trailerLen == 0) bodyDone = true;
+                        trailerLen = 0;
+                    } else if (c != '\r') {
+                        trailerLen = 1;
+                    }
+                    break;
+
+                case CHUNK_DATA:
+                    break;
+            }
+        }
+        return chunkLeft > 0;
+    }
+
+    void consumed(size_t n) {
+        if (chunked) {
+            chunkLeft -= n;
+            if (chunkLeft == 0) chunkState = CHUNK_CRLF;
+        } else if (remaining > 0) {
+            remaining -= n;
+            if (remaining == 0) bodyDone = true;
+        }
+    }
+
+public:
+    VkHttpClient() : client(nullptr), connectedPort(0), sentAt(0), headersAt(0), txLen(0), txFailed(false) {
+        resetResponse();
+    }
+
+    void setClient(Client& c) {
+        client = &c;
+    }
+
+    // Подключиться (или переиспользовать уже открытое соединение)
+    bool connect(const String& host, uint16_t port) {
+        if (!client) {
+            return false;
+        }
+        if (client->connected() && connectedPort == port && connectedHost == host) {
+            return true;
+        }
+        client->stop();
+        connectedHost = "";
+        if (!client->connect(host.c_str(), port)) {
+            return false;
+        }
+        connectedHost = host;
+        connectedPort = port;
+        return true;
+    }
+
+    bool connected() {
+        return client && client->connected();
+    }
+
+    void stop() {
+        if (client) client->stop();
+        connectedHost = "";
+        resetResponse();
+    }
+
+    // Начать запрос: строка запроса и заголовки
+    // contentLength < 0 - запрос без тела; тело пишется через write()/print()
+    bool beginRequest(const char* method, const char* path, long contentLength = -1,
+                      const char* contentType = "application/x-www-form-urlencoded") {
+        if (!connected()) {
+            return false;
+        }
+        resetResponse();
+        txLen = 0;
+        txFailed = false;
+        
+        print(method);
+        print(' ');
+        print(path);
+        print(" HTTP/1.1\r\nHost: ");
+        print(connectedHost);
+        print("\r\nConnection: keep-alive\r\n");
+        if (contentLength >= 0) {
+            print("Content-Type: ");
+            print(contentType);
+            print("\r\nContent-Length: ");
+            print(contentLength);
+            print("\r\n");
+        }
+        print("\r\n");
+        return !txFailed;
+    }
+    
+    // Отправить в сокет все, что осталось в буфере
+    bool endRequest() {
+        flushTx();
+        sentAt = millis();
+        return !txFailed;
+    }
+    
+    // Отправить запрос без тела (путь уже содержит query)
+    bool sendRequest(const char* method, const char* path) {
+        return beginRequest(method, path) && endRequest();
+    }
+    
+    // Отправить запрос с телом
+    bool sendRequest(const char* method, const char* path, const char* body, size_t bodyLen) {
+        return beginRequest(method, path, (long)bodyLen) &&
+               write((const uint8_t*)body, bodyLen) == bodyLen &&
+               endRequest();
+    }
+    
+    // Отправить форму: тело кодируется сразу в буфер отправки
+    bool sendForm(const char* path, const VkForm& form) {
+        size_t len = form.length();
+        return beginRequest("POST", path, (long)len) &&
+               form.writeTo(*this) == len &&
+               endRequest();
+    }
+
+    // Неблокирующее чтение заголовков
+    // 0 - ждем дальше, >0 - код ответа, <0 - соединение потеряно
+    int pollHeaders() {
+        if (!client) {
+            return -1;
+        }
+        while (client->available() > 0) {
+            int c = client->read();
+            if (c < 0) break;
+
+            if (c == '\n') {
+                if (processLine()) {
+                    headersAt = millis();
+                    remaining = chunked ? 0 : contentLength;
+                    if (!chunked && contentLength == 0) bodyDone = true;
+                    return statusCode > 0 ? statusCode : -1;
+                }
+                lineLen = 0;
+                lineOverflow = false;
+            } else if (lineLen < sizeof(line) - 1) {
+                line[lineLen++] = (char)c;
+            } else {
+                lineOverflow = true;
+            }
+        }
+        if (!client->connected()) {
+            return -1;
+        }
+        return 0;
+    }
+
+    // Блокирующее ожидание заголовков (для обычных запросов к API)
+    int readHeaders(unsigned long timeoutMs) {
+        unsigned long start = millis();
+        while (true) {
+            int code = pollHeaders();
+            if (code != 0) {
+                return code;
+            }
+            if (millis() - start >= timeoutMs) {
+                return 0;
+            }
+            delay(1);
+        }
+    }
+    
+    int getStatusCode() {
+        return statusCode;
+    }
+
+    long getContentLength() {
+        return contentLength;
+    }
+
+    bool isBodyDone() {
+        return bodyDone;
+    }
+
+    // Время сервера из заголовка Date (секунды Unix, 0 если заголовка нет)
+    uint32_t getDate() {
+        return date;
+    }
+
+    // Когда пришли заголовки ответа (millis)
+    unsigned long getHeadersTime() {
+        return headersAt;
+    }
+
+    // От отправки запроса до заголовков ответа, мс
+    unsigned long getRoundTrip() {
+        return headersAt - sentAt;
+    }
+
+    // Закончить ответ: дочитать тело, чтобы соединение можно было переиспользовать
+    void finish(unsigned long timeoutMs = 100) {
+        unsigned long start = millis();
+        while (!bodyDone && (remaining >= 0 || chunked) && millis() - start < timeoutMs) {
+            if (read() < 0) {
+                if (!client->connected()) break;
+                yield();
+            }
+        }
+        if (!bodyDone || !keepAlive) {
+            stop();
+        }
+    }
+
+    // === Тело ответа как Stream ===
+
+    int available() override {
+        if (!client || bodyDone) return 0;
+        if (chunked) {
+            if (!prepareChunk()) return 0;
+            int a = client->available();
+            return a < (long)chunkLeft ? a : (int)chunkLeft;
+        }
+        int a = client->available();
+        if (remaining >= 0 && a > remaining) a = (int)remaining;
+        return a;
+    }
+
+    int read() override {
+        if (!client || bodyDone) return -1;
+        if (chunked && !prepareChunk()) return -1;
+        int c = client->read();
+        if (c >= 0) consumed(1);
+        return c;
+    }
+
+    int read(uint8_t* buf, size_t size) {
+        int n = available();
+        if (n <= 0) return 0;
+        if ((size_t)n > size) n = (int)size;
+        n = client->read(buf, n);
+        if (n > 0) consumed(n);
+        return n;
+    }
+
+    int peek() override {
+        if (!client || bodyDone) return -1;
+        if (chunked && !prepareChunk()) return -1;
+        return client->peek();
+    }
+
+    // === Запись запроса (мелкое - через буфер, чтобы не плодить мелкие TLS записи) ===
+
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        if (!client || txFailed) {
+            return 0;
+        }
+        // Большой кусок (файл при загрузке) - сразу в сокет одной записью
+        if (size >= sizeof(txBuf)) {
+            flushTx();
+            if (txFailed || client->write(buf, size) != size) {
+                txFailed = true;
+                return 0;
+            }
+            return size;
+        }
+        size_t done = 0;
+        while (done < size) {
+            if (txLen == sizeof(txBuf)) {
+                flushTx();
+                if (txFailed) break;
+            }
+            size_t n = size - done;
+            if (n > sizeof(txBuf) - txLen) n = sizeof(txBuf) - txLen;
+            memcpy(txBuf + txLen, buf + done, n);
+            txLen += n;
+            done += n;
+        }
+        return done;
+    }
+
+    using Print::write;
+};
+
+// Поток для разбора: сначала уже прочитанное начало тела, затем остаток из соединения
+class VkPrefixStream : public Stream {
+private:
+    const String& head;
+    size_t pos;
+    Stream& tail;
+
+public:
+    VkPrefixStream(const String& head, Stream& tail) : head(head), pos(0), tail(tail) {}
+
+    int available() override {
+        return (int)(head.length() - pos) + tail.available();
+    }
+
+    int read() override {
+        return pos < head.length() ? (uint8_t)head[pos++] : tail.read();
+    }
+
+    int peek() override {
+        return pos < head.length() ? (uint8_t)head[pos] : tail.peek();
+    }
+
+    size_t write(uint8_t) override {
+        return 0;
+    }
+};
+
+#endif // DGO_VKHTTP_H
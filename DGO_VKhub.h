@@ -0,0 +1,241 @@
+// DGO_VKhub.h - Несколько сообществ на одном устройстве
+// У каждой группы свой бот: свой Long Poll, токен, очередь и лимит запросов.
+// Соединение с api.vk.com у всех одно (shareApi()), поэтому вторая и следующие группы
+// стоят одного TLS соединения для Long Poll, а не двух, плюс объект бота в куче: на хосте
+// (64 бита) 11960 байт с конфигурацией по умолчанию (очередь 32 x 160, метрики 712,
+// соединения 2 x 584, кэши профилей 3 КБ) и 5640 байт с VkHubSmallConfig.
+// tick() обходит группы по кругу, и каждая делает только шаги асинхронного Long Poll:
+// группа с медленным сервером не задерживает остальные (ждет только TLS рукопожатие)
+
+#ifndef DGO_VKHUB_H
+#define DGO_VKHUB_H
+
+#include "DGO_VKbot.h"
+
+#ifndef VK_HUB_GROUPS
+#define VK_HUB_GROUPS 4              // Сколько сообществ можно добавить
+#endif
+#define VK_HUB_RETRY 30000UL         // Как часто повторять begin() группы, которая не запустилась
+
+// Конфигурация для групп хаба: очередь на 8 сообщений и маленькие кэши профилей.
+// Очередь группы опустошается каждым execute, а общее соединение с API все равно
+// отправляет пачки групп по одной. Сообщения отправленного execute держат места до
+// его ответа, поэтому при непрерывном потоке на один ответ Long Poll группы надежно
+// встанут 4 ответа, а в тишине - 8 (лишним enqueueMessage() вернет 0)
+struct VkHubSmallConfig : VkDefaultConfig {
+    enum {
+        OUTBOX = 8,
+        PROFILE_CACHE = 4,
+        MEMBER_CACHE = 4
+    };
+};
+
+// Хаб сообществ. Config - конфигурация бота каждой группы (DGO_VKbotT<Config>)
+//   VkHub hub;                         // или VkHubT<VkHubSmallConfig> - меньше памяти на группу
+//   hub.add(TOKEN_A, "-111");
+//   hub.add(TOKEN_B, "-222");
+//   hub.attach([](VkUpdate& u) {
+//     hub.enqueueMessage(u.group_id, "Привет!", u.message.peer_id);   // ответ от той же группы
+//   });
+//   hub.begin();
+//   loop(): hub.tick();
+template <class Config = VkDefaultConfig>
+class VkHubT {
+public:
+    typedef DGO_VKbotT<Config> Bot;
+
+private:
+    Bot* bots[VK_HUB_GROUPS];
+    long ids[VK_HUB_GROUPS];
+    VkRtcStore stores[VK_HUB_GROUPS];   // Свой слот RTC памяти на группу
+    unsigned long retryAt[VK_HUB_GROUPS];
+    uint8_t count;
+    uint8_t next;                       // С какой группы начнется следующий tick()
+    bool begun;
+
+    // Запустить бота группы i, при неудаче повторим через VK_HUB_RETRY
+    bool start(uint8_t i) {
+        retryAt[i] = millis();
+        if (bots[i]->begin()) {
+            return true;
+        }
+        VK_LOGW("Хаб: группа %ld не запустилась, повтор позже", ids[i]);
+        return false;
+    }
+
+public:
+    VkHubT() : count(0), next(0), begun(false) {
+        for (uint8_t i = 0; i < VK_HUB_GROUPS; i++) {
+            bots[i] = nullptr;
+            ids[i] = 0;
+            retryAt[i] = 0;
+            stores[i].setSlot(i);
+        }
+    }
+
+    ~VkHubT() {
+        // Первый бот владеет общим соединением, удаляем его последним
+        for (uint8_t i = count; i > 0; i--) {
+            delete bots[i - 1];
+        }
+    }
+
+    // Добавить сообщество (ID с минусом, как в setGroupId()). Возвращает его бота
+    // для настройки (setTransport(), setStateStore(), setApiRateLimit()...) или nullptr
+    Bot* add(const String& token, const String& groupId) {
+        if (count >= VK_HUB_GROUPS) {
+            VK_LOGE("Хаб: слишком много групп, увеличьте VK_HUB_GROUPS");
+            return nullptr;
+        }
+        Bot* bot = new Bot();
+        bot->setToken(token);
+        bot->setGroupId(groupId);
+        bot->setStateStore(&stores[count]);
+        if (count > 0) {
+            bot->shareApi(*bots[0]);
+        }
+        bots[count] = bot;
+        ids[count] = labs(groupId.toInt());
+        count++;
+        return bot;
+    }
+
+    // Запустить все группы. false, если какая-то не запустилась (tick() будет повторять)
+    bool begin() {
+        bool all = true;
+        for (uint8_t i = 0; i < count; i++) {
+            if (!bots[i]->isStarted() && !start(i)) {
+                all = false;
+            }
+        }
+        begun = true;
+        return all;
+    }
+
+    // Один проход по всем группам: Long Poll, обработчики и очереди
+    // Первой каждый раз ходит следующая группа, чтобы никто не ждал постоянно
+    void tick() {
+        for (uint8_t k = 0; k < count; k++) {
+            uint8_t i = (next + k) % count;
+            Bot* bot = bots[i];
+            if (!bot->isStarted()) {
+                if (begun && millis() - retryAt[i] >= VK_HUB_RETRY) {
+                    start(i);
+                }
+                continue;
+            }
+            bot->tick();
+        }
+        if (count > 0) {
+            next = (next + 1) % count;
+        }
+    }
+
+    // === ОБРАБОТЧИКИ (для всех групп; VkUpdate::group_id - чья группа) ===
+
+    void attach(std::function<void(VkUpdate&)> callback) {
+        on(VK_MESSAGE_NEW, callback);
+    }
+
+    void attachView(std::function<void(const VkUpdateView&)> callback) {
+        onView(VK_MESSAGE_NEW, callback);
+    }
+
+    void on(VkEventType type, std::function<void(VkUpdate&)> handler) {
+        for (uint8_t i = 0; i < count; i++) {
+            bots[i]->on(type, handler);
+        }
+    }
+
+    void onView(VkEventType type, std::function<void(const VkUpdateView&)> handler) {
+        for (uint8_t i = 0; i < count; i++) {
+            bots[i]->onView(type, handler);
+        }
+    }
+
+    void onSendComplete(std::function<void(const VkSendResult&)> callback) {
+        for (uint8_t i = 0; i < count; i++) {
+            bots[i]->onSendComplete(callback);
+        }
+    }
+
+    // === ОТПРАВКА ===
+
+    // Поставить сообщение в очередь группы groupId (без минуса, как в VkUpdate::group_id)
+    uint32_t enqueueMessage(long groupId, String text, int peer_id) {
+        Bot* bot = group(groupId);
+        return bot ? bot->enqueueMessage(text, peer_id) : 0;
+    }
+
+    bool sendMessage(long groupId, String text, int peer_id) {
+        Bot* bot = group(groupId);
+        return bot && bot->sendMessage(text, peer_id);
+    }
+
+    // Ответить на нажатие callback-кнопки от имени группы, которой оно пришло
+    uint32_t answerEvent(const VkUpdateView& event, const String& snackbar = "") {
+        Bot* bot = group(event.group_id);
+        return bot ? bot->answerEvent(event, snackbar) : 0;
+    }
+
+    // Отправить очереди всех групп (блокирующе)
+    bool flushOutbox(unsigned long timeoutMs = 10000) {
+        unsigned long start = millis();
+        bool all = true;
+        for (uint8_t i = 0; i < count; i++) {
+            unsigned long spent = millis() - start;
+            if (bots[i]->isStarted() && !bots[i]->flushOutbox(spent < timeoutMs ? timeoutMs - spent : 0)) {
+                all = false;
+            }
+        }
+        return all;
+    }
+
+    // === НАСТРОЙКА ===
+
+    // Свой транспорт для всех групп (вызывать до begin())
+    void setTransport(VkTransport& transport) {
+        for (uint8_t i = 0; i < count; i++) {
+            bots[i]->setTransport(transport);
+        }
+    }
+
+    // Другой адрес API для всех групп (например, mock сервер)
+    void setApiEndpoint(String host, uint16_t port, bool secure) {
+        for (uint8_t i = 0; i < count; i++) {
+            bots[i]->setApiEndpoint(host, port, secure);
+        }
+    }
+
+    void setTimezone(int hours) {
+        for (uint8_t i = 0; i < count; i++) {
+            bots[i]->setTimezone(hours);
+        }
+    }
+
+    // === ДОСТУП К ГРУППАМ ===
+
+    // Бот группы по ID (с минусом или без), nullptr если такой нет
+    Bot* group(long groupId) {
+        groupId = labs(groupId);
+        for (uint8_t i = 0; i < count; i++) {
+            if (ids[i] == groupId) {
+                return bots[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Бот по порядку добавления
+    Bot* bot(uint8_t index) {
+        return index < count ? bots[index] : nullptr;
+    }
+
+    uint8_t size() const {
+        return count;
+    }
+};
+
+typedef VkHubT<> VkHub;
+
+#endif // DGO_VKHUB_H
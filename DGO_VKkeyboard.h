@@ -0,0 +1,223 @@
+// DGO_VKkeyboard.h - Клавиатуры для сообщений DGO_VKbot
+// Каждая кнопка несет короткий payload {"c":N} или {"c":N,"a":M}: номер команды и аргумент.
+// Нажатие разбирается в VkUpdate::command без сравнения текста, см. VkRouter::onButton()
+
+#ifndef DGO_VKKEYBOARD_H
+#define DGO_VKKEYBOARD_H
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include "DGO_VKlog.h"
+
+#define VK_KEYBOARD_ROWS 10          // Ограничения VK: строк в обычной клавиатуре
+#define VK_KEYBOARD_INLINE_ROWS 6    // строк во встроенной в сообщение
+#define VK_KEYBOARD_ROW_BUTTONS 5    // кнопок в строке
+#define VK_KEYBOARD_BUTTONS 40       // кнопок всего (во встроенной - 10)
+#define VK_KEYBOARD_INLINE_BUTTONS 10
+
+// Убрать клавиатуру: VkMessage::keyboard = VK_KEYBOARD_HIDE
+#define VK_KEYBOARD_HIDE "{\"buttons\":[],\"one_time\":true}"
+
+// Цвет кнопки
+enum VkButtonColor {
+    VK_BUTTON_SECONDARY,    // Белая (по умолчанию)
+    VK_BUTTON_PRIMARY,      // Синяя
+    VK_BUTTON_POSITIVE,     // Зеленая
+    VK_BUTTON_NEGATIVE      // Красная
+};
+
+// Дописать строку в JSON с кавычками и экранированием
+inline void vkAppendJsonString(String& out, const char* s, size_t len) {
+    out += '"';
+    for (size_t i = 0; i < len; i++) {
+        char c = s[i];
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char esc[8];
+                    snprintf(esc, sizeof(esc), "\\u%04x", (unsigned char)c);
+                    out += esc;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+inline void vkAppendJsonString(String& out, const String& s) {
+    vkAppendJsonString(out, s.c_str(), s.length());
+}
+
+// Номер команды из payload кнопки: {"c":N} или {"c":N,"a":M}, 0 - не кнопка библиотеки
+// Разбор без JsonDocument: payload короткий и всегда записан нами самими
+inline uint16_t vkPayloadCommand(const char* payload, long* arg) {
+    if (arg) {
+        *arg = 0;
+    }
+    const char* c = payload ? strstr(payload, "\"c\":") : nullptr;
+    if (!c) {
+        return 0;
+    }
+    long command = strtol(c + 4, nullptr, 10);
+    if (command <= 0 || command > 0xFFFF) {
+        return 0;
+    }
+    const char* a = strstr(payload, "\"a\":");
+    if (a && arg) {
+        *arg = strtol(a + 4, nullptr, 10);
+    }
+    return (uint16_t)command;
+}
+
+// Клавиатура
+//   VkKeyboard kb(true);                               // встроенная в сообщение
+//   kb.callback("Вкл", CMD_ON, VK_BUTTON_POSITIVE);
+//   kb.callback("Выкл", CMD_OFF, VK_BUTTON_NEGATIVE);
+//   kb.row();
+//   kb.button("Статус", CMD_STATUS);
+//   bot.sendMessage("Светодиод", peer_id, kb);
+// button() - обычная кнопка: ее подпись уходит в чат сообщением, payload приходит в message_new
+// callback() - кнопка без сообщения: приходит message_event, на него нужно ответить answerEvent()
+class VkKeyboard {
+private:
+    String body;
+    bool inlineMode;
+    bool oneTime;
+    uint8_t rows;
+    uint8_t inRow;
+    uint8_t total;
+
+    static const char* colorName(VkButtonColor color) {
+        switch (color) {
+            case VK_BUTTON_PRIMARY:  return "primary";
+            case VK_BUTTON_POSITIVE: return "positive";
+            case VK_BUTTON_NEGATIVE: return "negative";
+            default:                 return "secondary";
+        }
+    }
+
+    // Место под еще одну кнопку в текущей строке
+    bool reserve() {
+        if (total >= (inlineMode ? VK_KEYBOARD_INLINE_BUTTONS : VK_KEYBOARD_BUTTONS) ||
+            inRow >= VK_KEYBOARD_ROW_BUTTONS) {
+            VK_LOGE("Клавиатура: слишком много кнопок");
+            return false;
+        }
+        if (inRow > 0) {
+            body += ',';
+        }
+        inRow++;
+        total++;
+        return true;
+    }
+
+    void add(const char* type, const String& label, uint16_t command, VkButtonColor color, long arg) {
+        if (command == 0) {
+            VK_LOGE("Клавиатура: номер команды должен быть больше 0");
+            return;
+        }
+        if (!reserve()) {
+            return;
+        }
+        char payload[32];
+        if (arg != 0) {
+            snprintf(payload, sizeof(payload), "{\"c\":%u,\"a\":%ld}", (unsigned)command, arg);
+        } else {
+            snprintf(payload, sizeof(payload), "{\"c\":%u}", (unsigned)command);
+        }
+        // Кнопка целиком одним выделением памяти, а не по символу
+        body.reserve(body.length() + 80 + label.length() * 5 / 4);
+        body += "{\"action\":{\"type\":\"";
+        body += type;
+        body += "\",\"label\":";
+        vkAppendJsonString(body, label);
+        body += ",\"payload\":";
+        vkAppendJsonString(body, payload, strlen(payload));
+        body += "},\"color\":\"";
+        body += colorName(color);
+        body += "\"}";
+    }
+
+public:
+    // inline - клавиатура под сообщением, иначе - вместо поля ввода
+    // oneTime - скрыть обычную клавиатуру после первого нажатия
+    explicit VkKeyboard(bool inlineKeyboard = false, bool oneTimeKeyboard = false)
+        : inlineMode(inlineKeyboard), oneTime(oneTimeKeyboard), rows(1), inRow(0), total(0) {
+        body.reserve(128);
+    }
+
+    // Обычная кнопка: подпись отправляется в чат, нажатие приходит как message_new
+    VkKeyboard& button(const String& label, uint16_t command,
+                       VkButtonColor color = VK_BUTTON_SECONDARY, long arg = 0) {
+        add("text", label, command, color, arg);
+        return *this;
+    }
+
+    // Callback-кнопка: в чате ничего не появляется, приходит message_event
+    VkKeyboard& callback(const String& label, uint16_t command,
+                         VkButtonColor color = VK_BUTTON_SECONDARY, long arg = 0) {
+        add("callback", label, command, color, arg);
+        return *this;
+    }
+
+    // Кнопка-ссылка (без payload, нажатие боту не приходит)
+    VkKeyboard& link(const String& label, const String& url) {
+        if (!reserve()) {
+            return *this;
+        }
+        body.reserve(body.length() + 60 + label.length() * 5 / 4 + url.length());
+        body += "{\"action\":{\"type\":\"open_link\",\"label\":";
+        vkAppendJsonString(body, label);
+        body += ",\"link\":";
+        vkAppendJsonString(body, url);
+        body += "}}";
+        return *this;
+    }
+
+    // Начать новую строку кнопок
+    VkKeyboard& row() {
+        if (inRow == 0) {
+            return *this;
+        }
+        if (rows >= (inlineMode ? VK_KEYBOARD_INLINE_ROWS : VK_KEYBOARD_ROWS)) {
+            VK_LOGE("Клавиатура: слишком много строк");
+            return *this;
+        }
+        body += "],[";
+        rows++;
+        inRow = 0;
+        return *this;
+    }
+
+    uint8_t buttons() const {
+        return total;
+    }
+
+    // JSON для параметра keyboard метода messages.send
+    String toJson() const {
+        String json;
+        json.reserve(body.length() + 48);
+        json += "{\"buttons\":[[";
+        if (inRow == 0 && rows > 1) {
+            // row() после последней кнопки: пустую строку VK не примет
+            json.concat(body.c_str(), body.length() - 3);
+        } else {
+            json += body;
+        }
+        json += "]]";
+        if (inlineMode) {
+            json += ",\"inline\":true}";
+        } else {
+            json += oneTime ? ",\"one_time\":true}" : ",\"one_time\":false}";
+        }
+        return json;
+    }
+};
+
+#endif // DGO_VKKEYBOARD_H
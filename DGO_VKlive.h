@@ -0,0 +1,135 @@
+// DGO_VKlive.h - Живые сообщения: сводка, которая правится на месте
+// Первый updateLive() отправляет сообщение, следующие меняют его через messages.edit.
+// Запрос уходит, только если текст изменился (сравнивается хеш) и с прошлой правки прошло
+// не меньше minInterval, поэтому число запросов следует за данными, а не за таймером
+
+#ifndef DGO_VKLIVE_H
+#define DGO_VKLIVE_H
+
+#include <Arduino.h>
+
+#ifndef VK_LIVE_MESSAGES
+#define VK_LIVE_MESSAGES 4           // Живых сообщений на бота
+#endif
+#ifndef VK_LIVE_INTERVAL
+#define VK_LIVE_INTERVAL 10000UL     // Правка не чаще, мс
+#endif
+
+// Состояние одного живого сообщения; меняется только из loop() через бота
+// Объект должен жить столько же, сколько бот (обычно глобальный)
+class VkLiveMessage {
+private:
+    int peer;
+    int cmid;                   // conversation_message_id отправленного сообщения, 0 - еще нет
+    uint32_t pendingId;         // Номер запроса в очереди бота, 0 - ничего не ждем
+    uint32_t shownHash;         // Хеш текста, который показан или уже в запросе
+    bool shown;
+    unsigned long interval;
+    unsigned long lastRequest;  // millis() последней отправки или правки
+    uint32_t requestCount;
+    uint32_t skippedCount;
+
+public:
+    explicit VkLiveMessage(int peer_id = 0, unsigned long minInterval = VK_LIVE_INTERVAL)
+        : peer(peer_id), cmid(0), pendingId(0), shownHash(0), shown(false), interval(minInterval),
+          lastRequest(0), requestCount(0), skippedCount(0) {}
+
+    // FNV-1a текста
+    static uint32_t hash(const char* text, size_t len) {
+        uint32_t h = 2166136261UL;
+        for (size_t i = 0; i < len; i++) {
+            h = (h ^ (uint8_t)text[i]) * 16777619UL;
+        }
+        return h;
+    }
+
+    // Нужен ли запрос для текста с таким хешем; false - обновление пропущено
+    // Пока предыдущий запрос в очереди, новый не ставим: следующий вызов догонит данные
+    bool due(uint32_t h) {
+        if (pendingId != 0 || !peer) {
+            return false;
+        }
+        if ((shown && h == shownHash) || (cmid && millis() - lastRequest < interval)) {
+            skippedCount++;
+            return false;
+        }
+        return true;
+    }
+
+    // Запрос поставлен в очередь бота
+    void requested(uint32_t id, uint32_t h) {
+        pendingId = id;
+        shownHash = h;
+        shown = true;
+        lastRequest = millis();
+        requestCount++;
+    }
+
+    // Править уже нечего: сообщение слишком старое (909), такое не правится (920)
+    // или не найдено - удалено (100)
+    static bool editImpossible(int error_code) {
+        return error_code == 909 || error_code == 920 || error_code == 100;
+    }
+
+    // Отчет об отправке (бот передает все, номер сверяется здесь), error_code 0 - успешно
+    // Править нечего - дальше пишем новое сообщение. Остальные ошибки (нет ответа, лимит)
+    // временные: сообщение остается, следующее обновление повторит правку
+    bool complete(uint32_t id, int conversation_message_id, int error_code) {
+        if (id == 0 || id != pendingId) {
+            return false;
+        }
+        pendingId = 0;
+        if (error_code == 0) {
+            if (!cmid) {
+                cmid = conversation_message_id;
+            }
+            return true;
+        }
+        if (cmid && editImpossible(error_code)) {
+            cmid = 0;
+        }
+        shown = false;
+        return true;
+    }
+
+    // Начать с нового сообщения (старое останется в чате как есть)
+    void restart() {
+        cmid = 0;
+        shown = false;
+    }
+
+    void setPeer(int peer_id) {
+        if (peer_id != peer) {
+            peer = peer_id;
+            restart();
+        }
+    }
+
+    void setInterval(unsigned long minInterval) {
+        interval = minInterval;
+    }
+
+    int peerId() const {
+        return peer;
+    }
+
+    int conversationMessageId() const {
+        return cmid;
+    }
+
+    bool pending() const {
+        return pendingId != 0;
+    }
+
+    // Отправок и правок, поставленных в очередь
+    uint32_t requests() const {
+        return requestCount;
+    }
+
+    // Обновлений без запроса: текст тот же или интервал еще не прошел
+    uint32_t skipped() const {
+        return skippedCount;
+    }
+};
+
+#endif // DGO_VKLIVE_H
@@ -0,0 +1,243 @@
+// DGO_VKlog.h - Журнал библиотеки: уровни при компиляции и кольцо готовых строк
+// Сообщение ниже VK_LOG_LEVEL не попадает в прошивку: ни строка формата, ни вычисление аргументов.
+// Строки формата лежат во flash (PSTR). Запись в журнал только форматирует строку в свободную ячейку,
+// а в Serial строки уходят из tick() ровно столько, сколько помещается в буфер UART без ожидания
+//   -DVK_LOG_LEVEL=VK_LOG_NONE   - рабочая прошивка без журнала
+//   -DVK_LOG_LEVEL=VK_LOG_DEBUG  - отладка, подробно
+//   vkLog().setOutput(Serial1);  - другой порт
+//   vkLog().setHandler([](uint8_t level, const char* line) { ... });  - свой приемник (файл, UDP, чат)
+
+#ifndef DGO_VKLOG_H
+#define DGO_VKLOG_H
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <atomic>
+#include <functional>
+
+// Уровни
+#define VK_LOG_NONE 0
+#define VK_LOG_ERROR 1
+#define VK_LOG_WARN 2
+#define VK_LOG_INFO 3
+#define VK_LOG_DEBUG 4
+
+#ifndef VK_LOG_LEVEL
+#define VK_LOG_LEVEL VK_LOG_INFO     // Что попадает в прошивку
+#endif
+#ifndef VK_LOG_LINES
+#define VK_LOG_LINES 16              // Строк в кольце (степень двойки), 0 - печатать сразу, как Serial.print
+#endif
+#ifndef VK_LOG_LINE
+#define VK_LOG_LINE 160              // Байт на строку вместе с "[VK] ", длиннее - обрезается (кириллица - 2 байта на букву)
+#endif
+#define VK_LOG_PREFIX "[VK] "
+#define VK_LOG_PREFIX_LEN 5
+
+#if VK_LOG_LINES > 0
+static_assert((VK_LOG_LINES & (VK_LOG_LINES - 1)) == 0, "VK_LOG_LINES должно быть степенью двойки");
+#endif
+
+// Журнал. Писать может любой поток (loop() и сетевая задача), отправляет строки только drain()
+// Ячейка занимается сравнением с обменом счетчика tail, поэтому писатели не ждут друг друга;
+// если кольцо полно, строка теряется, а число потерянных выводится следующей строкой
+class VkLog {
+public:
+    typedef std::function<void(uint8_t level, const char* line)> Handler;
+
+private:
+#if VK_LOG_LINES > 0
+    struct Line {
+        std::atomic<uint8_t> level;     // 0 - ячейка пуста или писатель еще форматирует
+        uint16_t len;
+        char text[VK_LOG_LINE];
+    };
+
+    Line lines[VK_LOG_LINES];
+    std::atomic<uint32_t> head;         // Следующая к отправке (меняет только drain())
+    std::atomic<uint32_t> tail;         // Следующая свободная (занимают писатели)
+    std::atomic<uint32_t> dropped;
+    uint16_t sent;                      // Сколько байт первой строки уже ушло в Print
+#endif
+    Print* out;
+    Handler handler;
+
+    // "[VK] " + текст, обрезанный по границе символа UTF-8. Возвращает длину без нуля
+    static uint16_t format(char* text, const char* fmt, va_list args) {
+        memcpy(text, VK_LOG_PREFIX, VK_LOG_PREFIX_LEN);
+        const size_t room = VK_LOG_LINE - VK_LOG_PREFIX_LEN;
+        int n = vsnprintf_P(text + VK_LOG_PREFIX_LEN, room, fmt, args);
+        size_t len = n < 0 ? 0 : (size_t)n;
+        if (len >= room) {
+            len = room - 1;
+            while (len > 0 && ((uint8_t)text[VK_LOG_PREFIX_LEN + len] & 0xC0) == 0x80) {
+                len--;
+            }
+            text[VK_LOG_PREFIX_LEN + len] = 0;
+        }
+        return (uint16_t)(VK_LOG_PREFIX_LEN + len);
+    }
+
+    // Отдать строку приемнику. wait = false: только то, что влезает в буфер Print без ожидания,
+    // остаток строки уйдет в следующий раз. false - строка отправлена не целиком
+    bool emit(uint8_t level, const char* text, uint16_t len, uint16_t& done, bool wait) {
+        if (handler) {
+            handler(level, text);
+            return true;
+        }
+        if (!out) {
+            return true;
+        }
+        const uint16_t total = len + 2;
+        while (done < total) {
+            int room = wait ? total - done : out->availableForWrite();
+            if (room <= 0) {
+                return false;
+            }
+            // Сначала текст, потом перевод строки
+            const uint8_t* from = done < len ? (const uint8_t*)text + done : (const uint8_t*)"\r\n" + (done - len);
+            size_t left = done < len ? len - done : total - done;
+            size_t n = out->write(from, (size_t)room < left ? (size_t)room : left);
+            if (n == 0) {
+                return false;
+            }
+            done += n;
+        }
+        done = 0;
+        return true;
+    }
+
+public:
+#if VK_LOG_LINES > 0
+    VkLog() : head(0), tail(0), dropped(0), sent(0), out(&Serial) {
+        for (uint16_t i = 0; i < VK_LOG_LINES; i++) {
+            lines[i].level.store(0, std::memory_order_relaxed);
+        }
+    }
+#else
+    VkLog() : out(&Serial) {}
+#endif
+
+    // Записать строку уровня level (обычно через VK_LOGE/W/I/D). false - кольцо полно
+    __attribute__((format(printf, 3, 4)))
+    bool print(uint8_t level, const char* fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+#if VK_LOG_LINES > 0
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        do {
+            if (t - head.load(std::memory_order_acquire) >= VK_LOG_LINES) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                va_end(args);
+                return false;
+            }
+        } while (!tail.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
+        Line& line = lines[t & (VK_LOG_LINES - 1)];
+        line.len = format(line.text, fmt, args);
+        line.level.store(level, std::memory_order_release);
+#else
+        char text[VK_LOG_LINE];
+        uint16_t done = 0;
+        emit(level, text, format(text, fmt, args), done, true);
+#endif
+        va_end(args);
+        return true;
+    }
+
+    // Отправить готовые строки (только из одного потока, обычно loop() через tick())
+    // wait = false - не ждать UART: что не влезло, уйдет при следующем вызове
+    // wait = true - отправить все (перед сном, перезагрузкой, в setup())
+    void drain(bool wait = false) {
+#if VK_LOG_LINES > 0
+        for (;;) {
+            uint32_t h = head.load(std::memory_order_relaxed);
+            if (h == tail.load(std::memory_order_acquire)) {
+                break;
+            }
+            Line& line = lines[h & (VK_LOG_LINES - 1)];
+            uint8_t level = line.level.load(std::memory_order_acquire);
+            if (level == 0) {
+                break;      // Писатель еще форматирует, строки после нее подождут
+            }
+            if (!emit(level, line.text, line.len, sent, wait)) {
+                return;
+            }
+            line.level.store(0, std::memory_order_relaxed);
+            head.store(h + 1, std::memory_order_release);
+        }
+        // Потерянные строки - отдельной строкой, когда для нее есть место
+        if (dropped.load(std::memory_order_relaxed) && pending() < VK_LOG_LINES) {
+            print(VK_LOG_WARN, PSTR("Журнал: потеряно строк: %lu (увеличьте VK_LOG_LINES)"),
+                  (unsigned long)dropped.exchange(0, std::memory_order_relaxed));
+        }
+#endif
+    }
+
+    // Куда печатать (по умолчанию Serial). Print должен сообщать availableForWrite(),
+    // иначе используйте setHandler()
+    void setOutput(Print& output) {
+        out = &output;
+    }
+
+    // Свой приемник вместо Print: вызывается из drain() для каждой строки (без перевода строки)
+    void setHandler(Handler callback) {
+        handler = callback;
+    }
+
+    // Строк ждет отправки
+    uint32_t pending() const {
+#if VK_LOG_LINES > 0
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+#else
+        return 0;
+#endif
+    }
+};
+
+// Журнал один на все боты (VkHub пишет в него же)
+inline VkLog& vkLog() {
+    static VkLog log;
+    return log;
+}
+
+// Отключенный уровень: ветка if (false) выбрасывается компилятором вместе со строкой,
+// но формат и аргументы по-прежнему проверяются, и переменные не становятся "неиспользуемыми"
+__attribute__((format(printf, 1, 2)))
+inline void vkLogSkip(const char*, ...) {}
+#define VK_LOG_SKIP(fmt, ...) do { if (false) { vkLogSkip(fmt, ##__VA_ARGS__); } } while (0)
+
+#if VK_LOG_LEVEL >= VK_LOG_ERROR
+#define VK_LOGE(fmt, ...) vkLog().print(VK_LOG_ERROR, PSTR(fmt), ##__VA_ARGS__)
+#else
+#define VK_LOGE(fmt, ...) VK_LOG_SKIP(fmt, ##__VA_ARGS__)
+#endif
+#if VK_LOG_LEVEL >= VK_LOG_WARN
+#define VK_LOGW(fmt, ...) vkLog().print(VK_LOG_WARN, PSTR(fmt), ##__VA_ARGS__)
+#else
+#define VK_LOGW(fmt, ...) VK_LOG_SKIP(fmt, ##__VA_ARGS__)
+#endif
+#if VK_LOG_LEVEL >= VK_LOG_INFO
+#define VK_LOGI(fmt, ...) vkLog().print(VK_LOG_INFO, PSTR(fmt), ##__VA_ARGS__)
+#else
+#define VK_LOGI(fmt, ...) VK_LOG_SKIP(fmt, ##__VA_ARGS__)
+#endif
+#if VK_LOG_LEVEL >= VK_LOG_DEBUG
+#define VK_LOGD(fmt, ...) vkLog().print(VK_LOG_DEBUG, PSTR(fmt), ##__VA_ARGS__)
+#else
+#define VK_LOGD(fmt, ...) VK_LOG_SKIP(fmt, ##__VA_ARGS__)
+#endif
+
+// Вызовы из бота: без журнала не создают даже его буфер
+#if VK_LOG_LEVEL > VK_LOG_NONE
+inline void vkLogDrain() {
+    vkLog().drain(false);
+}
+inline void vkLogFlush() {
+    vkLog().drain(true);
+}
+#else
+inline void vkLogDrain() {}
+inline void vkLogFlush() {}
+#endif
+
+#endif // DGO_VKLOG_H
@@ -0,0 +1,264 @@
+// DGO_VKmetrics.h - Счетчики и гистограммы задержек бота
+// Все хранится в фиксированных массивах, запись - несколько сложений без выделения памяти
+// Снимок можно вывести компактным JSON (например, в ответ на команду "stats")
+
+#ifndef DGO_VKMETRICS_H
+#define DGO_VKMETRICS_H
+
+#include <Arduino.h>
+
+#define VK_HISTOGRAM_BUCKETS 20      // Корзины по степеням двойки: <64 мкс ... <16.7 с, дальше - последняя
+#define VK_HISTOGRAM_BASE 6          // Верхняя граница первой корзины 2^6 = 64 мкс
+#ifndef VK_METRICS_API_CODES
+#define VK_METRICS_API_CODES 8       // Сколько разных кодов ошибок API считать отдельно
+#endif
+
+// Print в String: для getMetricsJson() и ответа в чат
+class VkStringPrint : public Print {
+public:
+    String& out;
+
+    explicit VkStringPrint(String& s) : out(s) {}
+
+    size_t write(uint8_t c) override {
+        out += (char)c;
+        return 1;
+    }
+};
+
+// Гистограмма длительностей в микросекундах
+class VkHistogram {
+private:
+    uint32_t buckets[VK_HISTOGRAM_BUCKETS];
+    uint32_t n;
+    uint32_t maxUs;
+    uint64_t sumUs;
+
+    static uint8_t bucketOf(uint32_t us) {
+        uint32_t v = us >> VK_HISTOGRAM_BASE;
+        if (v == 0) {
+            return 0;
+        }
+        uint8_t i = 32 - __builtin_clz(v);
+        return i < VK_HISTOGRAM_BUCKETS ? i : VK_HISTOGRAM_BUCKETS - 1;
+    }
+
+public:
+    VkHistogram() {
+        reset();
+    }
+
+    void reset() {
+        memset(buckets, 0, sizeof(buckets));
+        n = 0;
+        maxUs = 0;
+        sumUs = 0;
+    }
+
+    void record(uint32_t us) {
+        buckets[bucketOf(us)]++;
+        n++;
+        sumUs += us;
+        if (us > maxUs) {
+            maxUs = us;
+        }
+    }
+
+    // Записать время, прошедшее с startUs (micros())
+    void since(uint32_t startUs) {
+        record((uint32_t)micros() - startUs);
+    }
+
+    uint32_t count() const {
+        return n;
+    }
+
+    uint32_t max() const {
+        return maxUs;
+    }
+
+    uint32_t mean() const {
+        return n ? (uint32_t)(sumUs / n) : 0;
+    }
+
+    // Верхняя граница корзины, в которую попадает процентиль p (0-100)
+    uint32_t percentile(uint8_t p) const {
+        if (n == 0) {
+            return 0;
+        }
+        uint32_t rank = (uint32_t)(((uint64_t)n * p + 99) / 100);
+        uint32_t seen = 0;
+        for (uint8_t i = 0; i < VK_HISTOGRAM_BUCKETS; i++) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                uint32_t upper = 1UL << (VK_HISTOGRAM_BASE + i);
+                return upper < maxUs ? upper : maxUs;
+            }
+        }
+        return maxUs;
+    }
+
+    uint32_t bucket(uint8_t i) const {
+        return i < VK_HISTOGRAM_BUCKETS ? buckets[i] : 0;
+    }
+
+    // {"n":12,"avg":340,"p50":512,"p95":2048,"max":3100} - микросекунды
+    size_t writeJson(Print& out) const {
+        char buf[96];
+        int len = snprintf(buf, sizeof(buf), "{\"n\":%lu,\"avg\":%lu,\"p50\":%lu,\"p95\":%lu,\"max\":%lu}",
+                           (unsigned long)n, (unsigned long)mean(), (unsigned long)percentile(50),
+                           (unsigned long)percentile(95), (unsigned long)maxUs);
+        return out.write((const uint8_t*)buf, len);
+    }
+};
+
+// Метрики бота: getMetrics(), writeMetricsJson()
+struct VkMetrics {
+    // Long Poll
+    uint32_t polls;             // Ответов Long Poll
+    uint32_t updates;           // Событий в ответах (включая те, на которые нет обработчика)
+    uint32_t dispatched;        // Событий, переданных обработчикам
+    uint32_t failed[4];         // failed 1, 2, 3 (индекс - код; 0 - неизвестный код)
+    uint32_t serverRequests;    // Запросов groups.getLongPollServer
+    uint32_t connectErrors;     // Не удалось подключиться
+    uint32_t httpErrors;        // Ответов с кодом не 200
+    uint32_t jsonErrors;        // Ошибок разбора JSON
+
+    // API
+    uint32_t apiCalls;          // Вызовов метода (в execute каждый считается)
+    uint32_t sent;              // Отправлено сообщений
+    uint32_t edits;             // Правок живых сообщений (messages.edit)
+    uint32_t sendErrors;        // Сообщений, которые не удалось отправить
+    uint32_t uploads;           // Загружено файлов (uploadPhoto(), uploadDocument())
+    uint32_t uploadErrors;      // Неудачных загрузок
+    uint32_t profileHits;       // Профилей и участников бесед, найденных в кэше
+    uint32_t profileMisses;     // Промахов кэша (каждый - id в запросе к VK)
+    uint16_t apiErrorCodes[VK_METRICS_API_CODES];
+    uint32_t apiErrorCounts[VK_METRICS_API_CODES];
+    uint32_t apiErrorsOther;    // Коды, которым не хватило места в таблице
+
+    // Время, микросекунды
+    VkHistogram connect;        // Подключение (TCP + TLS)
+    VkHistogram longPoll;       // Long Poll: от отправки запроса до разобранного ответа
+    VkHistogram parse;          // Разбор JSON ответа Long Poll
+    VkHistogram callback;       // Обработчик события
+    VkHistogram send;           // sendMessage() или от enqueueMessage() до ответа VK
+    VkHistogram upload;         // Загрузка файла: от запроса сервера загрузки до сохранения
+
+    // Память (только ESP): минимум свободной кучи и самого большого блока
+    uint32_t heapFreeMin;
+    uint32_t heapBlockMin;
+
+    VkMetrics() {
+        reset();
+    }
+
+    void reset() {
+        polls = updates = dispatched = 0;
+        memset(failed, 0, sizeof(failed));
+        serverRequests = connectErrors = httpErrors = jsonErrors = 0;
+        apiCalls = sent = edits = sendErrors = 0;
+        uploads = uploadErrors = 0;
+        profileHits = profileMisses = 0;
+        memset(apiErrorCodes, 0, sizeof(apiErrorCodes));
+        memset(apiErrorCounts, 0, sizeof(apiErrorCounts));
+        apiErrorsOther = 0;
+        connect.reset();
+        longPoll.reset();
+        parse.reset();
+        callback.reset();
+        send.reset();
+        upload.reset();
+        heapFreeMin = 0xFFFFFFFFUL;
+        heapBlockMin = 0xFFFFFFFFUL;
+    }
+
+    void countFailed(int code) {
+        failed[code >= 1 && code <= 3 ? code : 0]++;
+    }
+
+    void countApiError(int code) {
+        for (uint8_t i = 0; i < VK_METRICS_API_CODES; i++) {
+            if (apiErrorCodes[i] == code || apiErrorCodes[i] == 0) {
+                apiErrorCodes[i] = (uint16_t)code;
+                apiErrorCounts[i]++;
+                return;
+            }
+        }
+        apiErrorsOther++;
+    }
+
+    uint32_t apiErrors(int code) const {
+        for (uint8_t i = 0; i < VK_METRICS_API_CODES && apiErrorCodes[i]; i++) {
+            if (apiErrorCodes[i] == code) {
+                return apiErrorCounts[i];
+            }
+        }
+        return 0;
+    }
+
+    // Запомнить минимум свободной памяти
+    void sampleHeap() {
+#if defined(ESP8266)
+        uint32_t block = ESP.getMaxFreeBlockSize();
+#elif defined(ESP32)
+        uint32_t block = ESP.getMaxAllocHeap();
+#endif
+#if defined(ESP8266) || defined(ESP32)
+        uint32_t free = ESP.getFreeHeap();
+        if (free < heapFreeMin) heapFreeMin = free;
+        if (block < heapBlockMin) heapBlockMin = block;
+#endif
+    }
+
+    // Компактный JSON со всеми метриками (время в микросекундах)
+    size_t writeJson(Print& out) const {
+        char buf[200];
+        size_t total = 0;
+        int len = snprintf(buf, sizeof(buf),
+                           "{\"polls\":%lu,\"updates\":%lu,\"dispatched\":%lu,\"failed\":[%lu,%lu,%lu,%lu],"
+                           "\"servers\":%lu,\"connectErr\":%lu,\"httpErr\":%lu,\"jsonErr\":%lu,",
+                           (unsigned long)polls, (unsigned long)updates, (unsigned long)dispatched,
+                           (unsigned long)failed[0], (unsigned long)failed[1], (unsigned long)failed[2],
+                           (unsigned long)failed[3], (unsigned long)serverRequests, (unsigned long)connectErrors,
+                           (unsigned long)httpErrors, (unsigned long)jsonErrors);
+        total += out.write((const uint8_t*)buf, len);
+        len = snprintf(buf, sizeof(buf), "\"api\":%lu,\"sent\":%lu,\"edits\":%lu,\"sendErr\":%lu,\"uploads\":%lu,"
+                       "\"uploadErr\":%lu,\"profileHit\":%lu,\"profileMiss\":%lu,\"apiErr\":{",
+                       (unsigned long)apiCalls, (unsigned long)sent, (unsigned long)edits, (unsigned long)sendErrors,
+                       (unsigned long)uploads, (unsigned long)uploadErrors,
+                       (unsigned long)profileHits, (unsigned long)profileMisses);
+        total += out.write((const uint8_t*)buf, len);
+        for (uint8_t i = 0; i < VK_METRICS_API_CODES && apiErrorCodes[i]; i++) {
+            len = snprintf(buf, sizeof(buf), "%s\"%u\":%lu", i ? "," : "", apiErrorCodes[i],
+                           (unsigned long)apiErrorCounts[i]);
+            total += out.write((const uint8_t*)buf, len);
+        }
+        if (apiErrorsOther) {
+            len = snprintf(buf, sizeof(buf), "%s\"other\":%lu", apiErrorCodes[0] ? "," : "",
+                           (unsigned long)apiErrorsOther);
+            total += out.write((const uint8_t*)buf, len);
+        }
+        total += out.print("},\"connect\":");
+        total += connect.writeJson(out);
+        total += out.print(",\"longPoll\":");
+        total += longPoll.writeJson(out);
+        total += out.print(",\"parse\":");
+        total += parse.writeJson(out);
+        total += out.print(",\"callback\":");
+        total += callback.writeJson(out);
+        total += out.print(",\"send\":");
+        total += send.writeJson(out);
+        total += out.print(",\"upload\":");
+        total += upload.writeJson(out);
+        if (heapFreeMin != 0xFFFFFFFFUL) {
+            len = snprintf(buf, sizeof(buf), ",\"heapMin\":%lu,\"blockMin\":%lu",
+                           (unsigned long)heapFreeMin, (unsigned long)heapBlockMin);
+            total += out.write((const uint8_t*)buf, len);
+        }
+        total += out.print("}");
+        return total;
+    }
+};
+
+#endif // DGO_VKMETRICS_H
@@ -0,0 +1,151 @@
+// DGO_VKprofiles.h - Кэш профилей пользователей и участников бесед
+// Память выделена заранее: VK_PROFILE_CACHE профилей и VK_MEMBER_CACHE пар (беседа, участник).
+// Когда места нет, вытесняется запись, к которой дольше всех не обращались (LRU)
+
+#ifndef DGO_VKPROFILES_H
+#define DGO_VKPROFILES_H
+
+#include <Arduino.h>
+
+#ifndef VK_PROFILE_CACHE
+#define VK_PROFILE_CACHE 16          // Профилей в кэше
+#endif
+#ifndef VK_MEMBER_CACHE
+#define VK_MEMBER_CACHE 32           // Пар (беседа, пользователь) в кэше участников
+#endif
+#ifndef VK_PROFILE_TTL
+#define VK_PROFILE_TTL 3600000UL     // Сколько запись считается свежей, мс (час)
+#endif
+#define VK_PROFILE_NAME 48           // Байт на имя в UTF-8 (длинное обрезается по символу)
+
+// Профиль пользователя (users.get)
+struct VkProfile {
+    int id;
+    char first_name[VK_PROFILE_NAME];
+    char last_name[VK_PROFILE_NAME];
+    uint8_t sex;        // 0 - не указан, 1 - женский, 2 - мужской
+
+    VkProfile() : id(0), sex(0) {
+        first_name[0] = 0;
+        last_name[0] = 0;
+    }
+
+    // Скопировать имя, не разрезая многобайтный символ
+    static void copyName(char* dst, const char* src) {
+        size_t len = src ? strlen(src) : 0;
+        if (len >= VK_PROFILE_NAME) {
+            len = VK_PROFILE_NAME - 1;
+            while (len > 0 && ((uint8_t)src[len] & 0xC0) == 0x80) {
+                len--;
+            }
+        }
+        if (len) {
+            memcpy(dst, src, len);
+        }
+        dst[len] = 0;
+    }
+};
+
+// Участие пользователя в беседе (messages.getConversationMembers)
+struct VkMember {
+    bool member;
+    bool admin;         // Администратор или создатель беседы
+
+    VkMember() : member(false), admin(false) {}
+};
+
+// Кэш фиксированного размера с вытеснением самой старой по обращению записи
+// Поиск - просмотр всех N ячеек: при десятках записей это быстрее и проще хеш-таблицы
+template <typename T, uint8_t N>
+class VkLruCache {
+private:
+    struct Slot {
+        long long key;
+        uint32_t used;          // Номер последнего обращения, 0 - ячейка пуста
+        unsigned long storedAt; // millis() записи
+        T value;
+    };
+
+    Slot slots[N];
+    uint32_t counter;
+    unsigned long ttl;
+
+    Slot* lookup(long long key) {
+        for (uint8_t i = 0; i < N; i++) {
+            if (slots[i].used && slots[i].key == key) {
+                if (millis() - slots[i].storedAt > ttl) {
+                    slots[i].used = 0;      // Устарела: освобождаем, чтобы запросить заново
+                    return nullptr;
+                }
+                return &slots[i];
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    VkLruCache() : counter(0), ttl(VK_PROFILE_TTL) {
+        clear();
+    }
+
+    // Найти свежую запись и отметить обращение
+    T* find(long long key) {
+        Slot* slot = lookup(key);
+        if (!slot) {
+            return nullptr;
+        }
+        slot->used = ++counter;
+        return &slot->value;
+    }
+
+    // Найти, не меняя порядок вытеснения
+    const T* peek(long long key) {
+        Slot* slot = lookup(key);
+        return slot ? &slot->value : nullptr;
+    }
+
+    // Ячейка под ключ: прежняя, пустая или самая давно использованная
+    T& put(long long key) {
+        Slot* slot = lookup(key);
+        if (!slot) {
+            slot = &slots[0];
+            for (uint8_t i = 0; i < N; i++) {
+                if (slots[i].used < slot->used) {
+                    slot = &slots[i];
+                }
+                if (!slot->used) {
+                    break;
+                }
+            }
+            slot->key = key;
+            slot->value = T();
+        }
+        slot->used = ++counter;
+        slot->storedAt = millis();
+        return slot->value;
+    }
+
+    void clear() {
+        for (uint8_t i = 0; i < N; i++) {
+            slots[i].used = 0;
+        }
+    }
+
+    void setTtl(unsigned long ms) {
+        ttl = ms;
+    }
+
+    uint8_t size() const {
+        uint8_t n = 0;
+        for (uint8_t i = 0; i < N; i++) {
+            if (slots[i].used) n++;
+        }
+        return n;
+    }
+
+    static uint8_t capacity() {
+        return N;
+    }
+};
+
+#endif // DGO_VKPROFILES_H
@@ -0,0 +1,61 @@
+// DGO_VKring.h - Кольцевой буфер без блокировок: один писатель, один читатель
+// Через него сетевая задача (ESP32: другое ядро, хост: std::thread) передает события
+// в loop(), а loop() - исходящие сообщения обратно
+
+#ifndef DGO_VKRING_H
+#define DGO_VKRING_H
+
+#include <stdint.h>
+#include <atomic>
+#include <utility>
+
+// N - степень двойки. Счетчики идут без переполнения индекса: tail - head = заполнено
+template <typename T, uint32_t N>
+class VkRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "Размер VkRing должен быть степенью двойки");
+
+private:
+    T slots[N];
+    std::atomic<uint32_t> head;     // Следующий для чтения (меняет только читатель)
+    std::atomic<uint32_t> tail;     // Следующий для записи (меняет только писатель)
+
+public:
+    VkRing() : head(0), tail(0) {}
+
+    // Переместить item в кольцо (только писатель). false - кольцо полно, item не тронут
+    bool push(T& item) {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) >= N) {
+            return false;
+        }
+        slots[t & (N - 1)] = std::move(item);
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Забрать элемент (только читатель). false - кольцо пусто
+    bool pop(T& item) {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = std::move(slots[h & (N - 1)]);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Заполненность (из любого потока, значение приблизительное)
+    uint32_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    bool empty() const {
+        return size() == 0;
+    }
+
+    static uint32_t capacity() {
+        return N;
+    }
+};
+
+#endif // DGO_VKRING_H
@@ -0,0 +1,571 @@
+// DGO_VKrouter.h - Роутер текстовых команд для DGO_VKbot
+// Команды и синонимы регистрируются один раз и собираются в префиксное дерево
+// Разбор сообщения - один проход по байтам текста без выделения памяти
+// Регистр не важен для латиницы и кириллицы ("Включить" == "включить")
+// Нажатия кнопок VkKeyboard находятся по номеру команды из payload, без разбора текста
+
+#ifndef DGO_VKROUTER_H
+#define DGO_VKROUTER_H
+
+#include "DGO_VKbot.h"
+
+#ifndef VK_ROUTER_NODES
+#define VK_ROUTER_NODES 256          // Узлов дерева (примерно байт во всех командах)
+#endif
+#ifndef VK_ROUTER_COMMANDS
+#define VK_ROUTER_COMMANDS 16        // Команд (синонимы не считаются)
+#endif
+#ifndef VK_ROUTER_ARGS
+#define VK_ROUTER_ARGS 8             // Аргументов после команды
+#endif
+#ifndef VK_ROUTER_BUTTONS
+#define VK_ROUTER_BUTTONS 32         // Номера кнопок 1..VK_ROUTER_BUTTONS-1
+#endif
+#define VK_ROUTER_NAME 64            // Максимальная длина имени команды в байтах
+
+// Работа с UTF-8: декодирование и приведение к нижнему регистру
+struct VkUtf8 {
+    // Прочитать символ, возвращает число байт (некорректный байт читается как есть)
+    static uint8_t decode(const uint8_t* p, const uint8_t* end, uint32_t& cp) {
+        uint8_t c = p[0];
+        uint8_t n = c < 0x80 ? 1 : (c & 0xE0) == 0xC0 ? 2 : (c & 0xF0) == 0xE0 ? 3 : (c & 0xF8) == 0xF0 ? 4 : 0;
+        if (n == 0 || p + n > end) {
+            cp = c;
+            return 1;
+        }
+        if (n == 1) {
+            cp = c;
+            return 1;
+        }
+        cp = c & (0x7F >> n);
+        for (uint8_t i = 1; i < n; i++) {
+            if ((p[i] & 0xC0) != 0x80) {
+                cp = c;
+                return 1;
+            }
+            cp = (cp << 6) | (p[i] & 0x3F);
+        }
+        return n;
+    }
+
+    static uint8_t encode(uint32_t cp, uint8_t* out) {
+        if (cp < 0x80) {
+            out[0] = (uint8_t)cp;
+            return 1;
+        }
+        if (cp < 0x800) {
+            out[0] = (uint8_t)(0xC0 | (cp >> 6));
+            out[1] = (uint8_t)(0x80 | (cp & 0x3F));
+            return 2;
+        }
+        if (cp < 0x10000) {
+            out[0] = (uint8_t)(0xE0 | (cp >> 12));
+            out[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+            out[2] = (uint8_t)(0x80 | (cp & 0x3F));
+            return 3;
+        }
+        out[0] = (uint8_t)(0xF0 | (cp >> 18));
+        out[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = (uint8_t)(0x80 | (cp & 0x3F));
+        return 4;
+    }
+
+    // Нижний регистр для латиницы (включая Latin-1) и кириллицы
+    // Длина в UTF-8 при этом не меняется
+    static uint32_t fold(uint32_t cp) {
+        if (cp >= 'A' && cp <= 'Z') return cp + 0x20;
+        if (cp < 0xC0) return cp;
+        if (cp <= 0xDE && cp != 0xD7) return cp + 0x20;         // À-Þ
+        if (cp >= 0x0410 && cp <= 0x042F) return cp + 0x20;     // А-Я
+        if (cp >= 0x0400 && cp <= 0x040F) return cp + 0x50;     // Ѐ-Џ (Ё, Є, І, Ї, Ў ...)
+        return cp;
+    }
+
+    static bool isSpace(uint32_t cp) {
+        return cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r' || cp == 0xA0;
+    }
+
+    // Привести строку к нижнему регистру на месте, возвращает длину
+    static size_t foldInPlace(char* s, size_t len) {
+        uint8_t* p = (uint8_t*)s;
+        uint8_t* end = p + len;
+        while (p < end) {
+            uint32_t cp;
+            uint8_t n = decode(p, end, cp);
+            uint32_t f = fold(cp);
+            if (f != cp) {
+                encode(f, p);
+            }
+            p += n;
+        }
+        return len;
+    }
+
+    // Сравнить без учета регистра
+    static bool equalsFold(const char* a, size_t alen, const char* b, size_t blen) {
+        const uint8_t* pa = (const uint8_t*)a;
+        const uint8_t* ea = pa + alen;
+        const uint8_t* pb = (const uint8_t*)b;
+        const uint8_t* eb = pb + blen;
+        while (pa < ea && pb < eb) {
+            uint32_t ca;
+            uint32_t cb;
+            pa += decode(pa, ea, ca);
+            pb += decode(pb, eb, cb);
+            if (fold(ca) != fold(cb)) {
+                return false;
+            }
+        }
+        return pa == ea && pb == eb;
+    }
+};
+
+// Аргументы после команды: указатели в текст сообщения, без копий
+// "установить 23.5 \"на кухне\"" -> args[0] = "23.5", args[1] = "на кухне"
+class VkArgs {
+private:
+    const char* text;
+    uint16_t starts[VK_ROUTER_ARGS];
+    uint16_t lens[VK_ROUTER_ARGS];
+    uint8_t n;
+    uint16_t restStart;
+    uint16_t total;
+
+public:
+    VkArgs() : text(""), n(0), restStart(0), total(0) {}
+
+    // Разбить text[from..len) по пробелам, кавычки объединяют слова
+    void parse(const char* s, size_t len, size_t from) {
+        text = s;
+        total = (uint16_t)len;
+        n = 0;
+        size_t i = from;
+        while (i < len && isspace((unsigned char)s[i])) i++;
+        restStart = (uint16_t)i;
+
+        while (i < len && n < VK_ROUTER_ARGS) {
+            size_t start = i;
+            size_t end;
+            if (s[i] == '"') {
+                start = ++i;
+                while (i < len && s[i] != '"') i++;
+                end = i;
+                if (i < len) i++;
+            } else {
+                while (i < len && !isspace((unsigned char)s[i])) i++;
+                end = i;
+            }
+            starts[n] = (uint16_t)start;
+            lens[n] = (uint16_t)(end - start);
+            n++;
+            while (i < len && isspace((unsigned char)s[i])) i++;
+        }
+    }
+
+    uint8_t count() const {
+        return n;
+    }
+
+    const char* data(uint8_t i) const {
+        return i < n ? text + starts[i] : "";
+    }
+
+    size_t length(uint8_t i) const {
+        return i < n ? lens[i] : 0;
+    }
+
+    // Сравнить аргумент со строкой без учета регистра
+    bool equals(uint8_t i, const char* s) const {
+        return i < n && VkUtf8::equalsFold(text + starts[i], lens[i], s, strlen(s));
+    }
+
+    long toInt(uint8_t i, long def = 0) const {
+        if (i >= n || lens[i] == 0) return def;
+        char* end;
+        long v = strtol(text + starts[i], &end, 10);
+        return end == text + starts[i] + lens[i] ? v : def;
+    }
+
+    float toFloat(uint8_t i, float def = 0) const {
+        if (i >= n || lens[i] == 0) return def;
+        char* end;
+        float v = (float)strtod(text + starts[i], &end);
+        return end == text + starts[i] + lens[i] ? v : def;
+    }
+
+    // Копия аргумента (выделяет память)
+    String toString(uint8_t i) const {
+        String s;
+        if (i < n) {
+            s.reserve(lens[i]);
+            for (uint16_t k = 0; k < lens[i]; k++) {
+                s += text[starts[i] + k];
+            }
+        }
+        return s;
+    }
+
+    // Весь текст после команды
+    const char* rest() const {
+        return text + restStart;
+    }
+
+    size_t restLength() const {
+        return total - restStart;
+    }
+};
+
+typedef std::function<void(VkUpdate&, const VkArgs&)> VkCommandHandler;
+// Обработчик без копий: событие и аргументы действительны до выхода из него
+typedef std::function<void(const VkUpdateView&, const VkArgs&)> VkCommandViewHandler;
+
+// Роутер команд
+//   router.on("включить|вкл|on", onLedOn, CMD_ON);   // CMD_ON - номер кнопки для той же команды
+//   router.onButton(CMD_BRIGHT, onBright);            // только кнопка, аргумент - args.toInt(0)
+//   router.onUnknown(onHelp);
+//   router.attach(bot);
+class VkRouter {
+private:
+    // Узел дерева: байт, первый потомок и следующий брат (0 - нет), номер команды + 1
+    struct Node {
+        uint8_t byte;
+        uint8_t command;
+        uint16_t child;
+        uint16_t next;
+    };
+
+    Node nodes[VK_ROUTER_NODES];
+    uint16_t nodeCount;
+    VkCommandViewHandler handlers[VK_ROUTER_COMMANDS];
+    uint8_t commandCount;
+    VkCommandViewHandler unknownHandler;
+    const char* prefixes;
+    uint8_t buttons[VK_ROUTER_BUTTONS];     // Номер кнопки -> номер команды + 1
+    bool hasButtons;
+
+    uint16_t findChild(uint16_t node, uint8_t byte) const {
+        for (uint16_t c = nodes[node].child; c != 0; c = nodes[c].next) {
+            if (nodes[c].byte == byte) {
+                return c;
+            }
+        }
+        return 0;
+    }
+
+    uint16_t addChild(uint16_t node, uint8_t byte) {
+        uint16_t c = findChild(node, byte);
+        if (c != 0) {
+            return c;
+        }
+        if (nodeCount >= VK_ROUTER_NODES) {
+            return 0;
+        }
+        c = nodeCount++;
+        nodes[c].byte = byte;
+        nodes[c].command = 0;
+        nodes[c].child = 0;
+        nodes[c].next = nodes[node].child;
+        nodes[node].child = c;
+        return c;
+    }
+
+    // Добавить одно имя (уже без '|') для команды index
+    bool insert(const char* name, size_t len, uint8_t index) {
+        // Нормализуем как при разборе: нижний регистр, пробелы схлопываются
+        uint8_t buf[VK_ROUTER_NAME];
+        size_t n = 0;
+        const uint8_t* p = (const uint8_t*)name;
+        const uint8_t* end = p + len;
+        bool space = false;
+        while (p < end) {
+            uint32_t cp;
+            p += VkUtf8::decode(p, end, cp);
+            if (VkUtf8::isSpace(cp)) {
+                space = n > 0;
+                continue;
+            }
+            if (n + 5 > sizeof(buf)) {
+                return false;
+            }
+            if (space) {
+                buf[n++] = ' ';
+                space = false;
+            }
+            n += VkUtf8::encode(VkUtf8::fold(cp), buf + n);
+        }
+        if (n == 0) {
+            return false;
+        }
+
+        uint16_t node = 0;
+        for (size_t i = 0; i < n; i++) {
+            node = addChild(node, buf[i]);
+            if (node == 0) {
+                VK_LOGE("Роутер: закончились узлы, увеличьте VK_ROUTER_NODES");
+                return false;
+            }
+        }
+        if (nodes[node].command != 0 && nodes[node].command != index + 1) {
+            VK_LOGE("Роутер: команда уже занята: %.*s", (int)len, name);
+            return false;
+        }
+        nodes[node].command = index + 1;
+        return true;
+    }
+
+    // Обработчик с VkUpdate&: копия события делается, только когда команда найдена
+    static VkCommandViewHandler owning(VkCommandHandler handler) {
+        if (!handler) {
+            return nullptr;
+        }
+        return [handler](const VkUpdateView& view, const VkArgs& args) {
+            VkUpdate update = view.toOwned();
+            handler(update, args);
+        };
+    }
+
+    bool bindButton(uint16_t button, uint8_t index) {
+        if (button == 0 || button >= VK_ROUTER_BUTTONS) {
+            VK_LOGE("Роутер: номер кнопки вне диапазона, увеличьте VK_ROUTER_BUTTONS");
+            return false;
+        }
+        if (buttons[button] != 0) {
+            VK_LOGE("Роутер: кнопка уже занята: %u", (unsigned)button);
+            return false;
+        }
+        buttons[button] = index + 1;
+        hasButtons = true;
+        return true;
+    }
+
+    // Нажатие кнопки: команда по номеру из таблицы, текст не разбирается
+    bool dispatchButton(const VkUpdateView& update) {
+        uint8_t index = update.command < VK_ROUTER_BUTTONS ? buttons[update.command] : 0;
+        
+        // Аргумент кнопки передаем как единственный аргумент команды
+        VkArgs args;
+        char arg[24];               // long на 64-битной сборке - до 20 знаков
+        if (update.command_arg != 0) {
+            int len = snprintf(arg, sizeof(arg), "%ld", update.command_arg);
+            if (len > 0) {
+                args.parse(arg, (size_t)len < sizeof(arg) ? (size_t)len : sizeof(arg) - 1, 0);
+            }
+        }
+        
+        if (index != 0) {
+            if (handlers[index - 1]) {
+                handlers[index - 1](update, args);
+            }
+            return true;
+        }
+        if (unknownHandler) {
+            unknownHandler(update, args);
+        }
+        return false;
+    }
+
+    bool isPrefix(uint8_t c) const {
+        for (const char* p = prefixes; p && *p; p++) {
+            if ((uint8_t)*p == c) return true;
+        }
+        return false;
+    }
+
+public:
+    VkRouter() : nodeCount(1), commandCount(0), prefixes("/!"), hasButtons(false) {
+        memset(buttons, 0, sizeof(buttons));
+        nodes[0].byte = 0;
+        nodes[0].command = 0;
+        nodes[0].child = 0;
+        nodes[0].next = 0;
+    }
+
+    // Зарегистрировать команду, синонимы через '|': "включить|вкл|on"
+    // button - номер кнопки VkKeyboard с той же командой (0 - без кнопки)
+    bool on(const char* names, VkCommandHandler handler, uint16_t button = 0) {
+        return on(names, owning(handler), button);
+    }
+
+    // То же с обработчиком без копий
+    bool on(const char* names, VkCommandViewHandler handler, uint16_t button = 0) {
+        if (commandCount >= VK_ROUTER_COMMANDS) {
+            VK_LOGE("Роутер: слишком много команд, увеличьте VK_ROUTER_COMMANDS");
+            return false;
+        }
+        uint8_t index = commandCount;
+        bool ok = true;
+        const char* start = names;
+        while (true) {
+            const char* bar = strchr(start, '|');
+            size_t len = bar ? (size_t)(bar - start) : strlen(start);
+            ok = insert(start, len, index) && ok;
+            if (!bar) break;
+            start = bar + 1;
+        }
+        handlers[index] = handler;
+        commandCount++;
+        if (button != 0) {
+            ok = bindButton(button, index) && ok;
+        }
+        return ok;
+    }
+
+    // Команда только для кнопки: сработает на нажатие кнопки с номером button
+    // Аргумент кнопки (VkKeyboard::button(..., arg)) - args.toInt(0)
+    bool onButton(uint16_t button, VkCommandHandler handler) {
+        return onButton(button, owning(handler));
+    }
+
+    bool onButton(uint16_t button, VkCommandViewHandler handler) {
+        if (commandCount >= VK_ROUTER_COMMANDS) {
+            VK_LOGE("Роутер: слишком много команд, увеличьте VK_ROUTER_COMMANDS");
+            return false;
+        }
+        if (!bindButton(button, commandCount)) {
+            return false;
+        }
+        handlers[commandCount++] = handler;
+        return true;
+    }
+
+    // Добавить синоним к уже зарегистрированной команде
+    bool alias(const char* name, const char* command) {
+        VkArgs args;
+        int index = match(command, strlen(command), args);
+        if (index < 0) {
+            return false;
+        }
+        return insert(name, strlen(name), (uint8_t)index);
+    }
+
+    // Обработчик для сообщений, которые не подошли ни к одной команде
+    void onUnknown(VkCommandHandler handler) {
+        unknownHandler = owning(handler);
+    }
+
+    void onUnknown(VkCommandViewHandler handler) {
+        unknownHandler = handler;
+    }
+
+    // Символы, которые можно поставить перед командой ("/start", "!help"), по умолчанию "/!"
+    void setPrefixes(const char* chars) {
+        prefixes = chars;
+    }
+
+    // Найти команду в тексте, возвращает ее номер или -1
+    // Выбирается самое длинное совпадение, которое заканчивается на границе слова
+    int match(const char* text, size_t len, VkArgs& args) const {
+        const uint8_t* begin = (const uint8_t*)text;
+        const uint8_t* end = begin + len;
+        const uint8_t* p = begin;
+        while (p < end && isspace(*p)) p++;
+        if (p < end && isPrefix(*p)) p++;
+
+        uint16_t node = 0;
+        int best = -1;
+        const uint8_t* bestEnd = p;
+        bool space = false;
+        bool alive = true;
+
+        while (p < end) {
+            uint32_t cp;
+            uint8_t n = VkUtf8::decode(p, end, cp);
+            if (VkUtf8::isSpace(cp)) {
+                if (!space && node != 0 && nodes[node].command) {
+                    best = nodes[node].command - 1;
+                    bestEnd = p;
+                }
+                space = true;
+                p += n;
+                continue;
+            }
+            if (space) {
+                node = findChild(node, ' ');
+                space = false;
+                if (node == 0) {
+                    alive = false;
+                    break;
+                }
+            }
+
+            uint8_t folded[4];
+            uint8_t m = VkUtf8::encode(VkUtf8::fold(cp), folded);
+            for (uint8_t i = 0; i < m; i++) {
+                node = findChild(node, folded[i]);
+                if (node == 0) break;
+            }
+            if (node == 0) {
+                alive = false;
+                break;
+            }
+            p += n;
+        }
+        if (alive && node != 0 && nodes[node].command) {
+            best = nodes[node].command - 1;
+            bestEnd = end;
+        }
+
+        if (best >= 0) {
+            args.parse(text, len, (size_t)(bestEnd - begin));
+        }
+        return best;
+    }
+
+    // Разобрать сообщение и вызвать обработчик команды
+    // Нажатие кнопки (message_new с payload или message_event) ищется по номеру команды
+    // Возвращает true, если команда найдена
+    bool dispatch(const VkUpdateView& update) {
+        if (update.command != 0 && (update.type == VK_MESSAGE_NEW || update.type == VK_MESSAGE_EVENT)) {
+            return dispatchButton(update);
+        }
+        if (update.type != VK_MESSAGE_NEW) {
+            return false;
+        }
+        const char* text = update.message.text.data();
+        size_t len = update.message.text.length();
+
+        VkArgs args;
+        int index = match(text, len, args);
+        if (index >= 0) {
+            if (handlers[index]) {
+                handlers[index](update, args);
+            }
+            return true;
+        }
+        if (unknownHandler) {
+            args.parse(text, len, 0);
+            unknownHandler(update, args);
+        }
+        return false;
+    }
+
+    bool dispatch(const VkUpdate& update) {
+        return dispatch(VkUpdateView(update));
+    }
+
+    // Подключить роутер к боту вместо обработчика attach()
+    // Если есть кнопки, роутер получает и нажатия callback-кнопок (message_event);
+    // ответить на них нужно из обработчика: bot.answerEvent(update)
+    template <class Config>
+    void attach(DGO_VKbotT<Config>& bot) {
+        bot.attachView([this](const VkUpdateView& update) {
+            dispatch(update);
+        });
+        if (hasButtons) {
+            bot.onView(VK_MESSAGE_EVENT, [this](const VkUpdateView& update) {
+                dispatch(update);
+            });
+        }
+    }
+
+    uint8_t commands() const {
+        return commandCount;
+    }
+
+    uint16_t nodesUsed() const {
+        return nodeCount;
+    }
+};
+
+#endif // DGO_VKROUTER_H
@@ -0,0 +1,524 @@
+// DGO_VKscheduler.h - Планировщик задач для DGO_VKbot
+// Разовые задачи, задачи с периодом и задачи по часам ("каждый день в 08:00", cron)
+// Задачи лежат в куче по времени срабатывания: tick() смотрит только на вершину,
+// поэтому сотни задач стоят столько же, сколько одна, пока ни одной не пора
+// Время по часам берется у бота (getClock(), setTimezone()); после подстройки часов
+// или смены таймзоны задачи по часам пересчитываются
+
+#ifndef DGO_VKSCHEDULER_H
+#define DGO_VKSCHEDULER_H
+
+#include "DGO_VKbot.h"
+#include <limits.h>
+
+#ifndef VK_SCHEDULER_JOBS
+#define VK_SCHEDULER_JOBS 16         // Сколько задач можно запланировать одновременно (до 255)
+#endif
+#ifndef VK_SCHEDULER_RESYNC
+#define VK_SCHEDULER_RESYNC 1000L    // На сколько мс должны сдвинуться часы, чтобы пересчитать задачи
+#endif
+#define VK_SCHEDULER_NEVER INT64_MAX // Задача по часам, пока время не синхронизировано
+
+static_assert(VK_SCHEDULER_JOBS >= 1 && VK_SCHEDULER_JOBS <= 255, "VK_SCHEDULER_JOBS: от 1 до 255");
+
+typedef std::function<void()> VkJob;
+
+// Расписание в формате cron: "минуты часы дни_месяца месяцы дни_недели"
+// Поле: *, число, диапазон a-b, список через запятую, шаг /n ("*/15", "9-18/3", "1,15")
+// Дни недели 0-7 (0 и 7 - воскресенье). Если заданы и дни месяца, и дни недели,
+// подходит любой из них, как в обычном cron. Сокращения: @hourly, @daily, @weekly, @monthly
+struct VkCron {
+    uint64_t minutes;
+    uint32_t hours;
+    uint32_t days;          // Биты 1-31
+    uint16_t months;        // Биты 1-12
+    uint8_t weekdays;       // Биты 0-6
+    bool anyDay;            // Дни месяца - "*"
+    bool anyWeekday;        // Дни недели - "*"
+
+    VkCron() : minutes(0), hours(0), days(0), months(0), weekdays(0), anyDay(true), anyWeekday(true) {}
+
+    // Каждый день в hour:minute
+    static VkCron daily(uint8_t hour, uint8_t minute) {
+        VkCron c;
+        c.minutes = 1ULL << (minute % 60);
+        c.hours = 1UL << (hour % 24);
+        c.days = 0xFFFFFFFEUL;
+        c.months = 0x1FFE;
+        c.weekdays = 0x7F;
+        return c;
+    }
+
+    // Разобрать одно поле в битовую маску, false при ошибке
+    static bool parseField(const char*& p, uint8_t lo, uint8_t hi, uint64_t& mask, bool& any) {
+        mask = 0;
+        any = false;
+        while (true) {
+            int from, to, step = 1;
+            if (*p == '*') {
+                from = lo;
+                to = hi;
+                any = true;
+                p++;
+            } else if (isdigit((unsigned char)*p)) {
+                from = (int)strtol(p, (char**)&p, 10);
+                to = from;
+                if (*p == '-') {
+                    p++;
+                    if (!isdigit((unsigned char)*p)) return false;
+                    to = (int)strtol(p, (char**)&p, 10);
+                }
+            } else {
+                return false;
+            }
+            if (*p == '/') {
+                p++;
+                if (!isdigit((unsigned char)*p)) return false;
+                step = (int)strtol(p, (char**)&p, 10);
+                if (step < 1) return false;
+                any = false;
+                if (from == to) to = hi;    // "5/15" = с 5 до конца с шагом 15
+            }
+            if (from < lo || to > hi || from > to) return false;
+            for (int v = from; v <= to; v += step) {
+                mask |= 1ULL << v;
+            }
+            if (*p != ',') break;
+            p++;
+            any = false;
+        }
+        if (*p != ' ' && *p != '\t' && *p != 0) return false;
+        while (*p == ' ' || *p == '\t') p++;
+        return true;
+    }
+
+    // Разобрать строку расписания, false при ошибке
+    bool parse(const char* spec) {
+        while (*spec == ' ') spec++;
+        if (strcmp(spec, "@hourly") == 0) spec = "0 * * * *";
+        else if (strcmp(spec, "@daily") == 0) spec = "0 0 * * *";
+        else if (strcmp(spec, "@weekly") == 0) spec = "0 0 * * 0";
+        else if (strcmp(spec, "@monthly") == 0) spec = "0 0 1 * *";
+
+        const char* p = spec;
+        uint64_t mask;
+        bool any;
+        if (!parseField(p, 0, 59, mask, any)) return false;
+        minutes = mask;
+        if (!parseField(p, 0, 23, mask, any)) return false;
+        hours = (uint32_t)mask;
+        if (!parseField(p, 1, 31, mask, any)) return false;
+        days = (uint32_t)mask;
+        anyDay = any;
+        if (!parseField(p, 1, 12, mask, any)) return false;
+        months = (uint16_t)mask;
+        if (!parseField(p, 0, 7, mask, any)) return false;
+        weekdays = (uint8_t)((mask | (mask >> 7)) & 0x7F);
+        anyWeekday = any;
+        return *p == 0;
+    }
+
+    // Дни от 1970-01-01 -> год, месяц, день (алгоритм civil_from_days)
+    static void civil(int64_t days, int& y, int& m, int& d) {
+        days += 719468;
+        int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+        int64_t doe = days - era * 146097;
+        int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        int64_t mp = (5 * doy + 2) / 153;
+        d = (int)(doy - (153 * mp + 2) / 5 + 1);
+        m = (int)(mp < 10 ? mp + 3 : mp - 9);
+        y = (int)(yoe + era * 400 + (m <= 2 ? 1 : 0));
+    }
+
+    bool dayMatches(int day, int weekday) const {
+        bool d = (days >> day) & 1;
+        bool w = (weekdays >> weekday) & 1;
+        if (anyDay) return w;
+        if (anyWeekday) return d;
+        return d || w;
+    }
+
+    // Следующая подходящая минута строго после t (местное время, секунды)
+    // -1, если за 5 лет такой нет (например, "0 0 31 2 *")
+    int64_t next(int64_t t) const {
+        t = t - ((t % 60) + 60) % 60 + 60;
+        int64_t limit = t + 5LL * 366 * 86400;
+        while (t < limit) {
+            int64_t day = t / 86400;
+            int y, m, d;
+            civil(day, y, m, d);
+            if (!((months >> m) & 1)) {
+                // Первое число следующего месяца
+                t = (day - d + 1) * 86400 + (int64_t)(m == 2 ? ((y % 4 == 0 && y % 100 != 0) || y % 400 == 0 ? 29 : 28)
+                    : (m == 4 || m == 6 || m == 9 || m == 11) ? 30 : 31) * 86400;
+                continue;
+            }
+            int weekday = (int)((day + 4) % 7);     // 1970-01-01 - четверг
+            if (!dayMatches(d, weekday)) {
+                t = (day + 1) * 86400;
+                continue;
+            }
+            int h = (int)(t % 86400 / 3600);
+            if (!((hours >> h) & 1)) {
+                t = t - t % 3600 + 3600;
+                continue;
+            }
+            int mi = (int)(t % 3600 / 60);
+            if (!((minutes >> mi) & 1)) {
+                t += 60;
+                continue;
+            }
+            return t;
+        }
+        return -1;
+    }
+};
+
+// Планировщик
+//   VkScheduler scheduler;
+//   scheduler.every(2000, readSensor);
+//   scheduler.at(8, 0, sendReport);             // каждый день в 08:00 по таймзоне бота
+//   scheduler.cron("*/15 9-18 * * 1-5", poll);  // в рабочие часы каждые 15 минут
+//   scheduler.attach(bot);                      // задачи выполняются из bot.tick()
+class VkScheduler {
+private:
+    enum JobType : uint8_t {
+        JOB_FREE,
+        JOB_ONCE,
+        JOB_EVERY,
+        JOB_CRON
+    };
+
+    struct Job {
+        VkJob fn;
+        int64_t due;            // Когда сработать, локальные мс (millis() без переполнения)
+        int64_t wallUtc;        // Задача по часам: когда сработать, UTC мс
+        uint32_t interval;
+        VkCron cron;
+        JobType type;
+        uint16_t gen;           // Поколение слота: старый номер задачи не отменит новую
+        int16_t heapPos;        // -1 - не в куче
+
+        Job() : due(0), wallUtc(0), interval(0), type(JOB_FREE), gen(0), heapPos(-1) {}
+    };
+
+    Job jobs[VK_SCHEDULER_JOBS];
+    uint8_t heap[VK_SCHEDULER_JOBS];    // Номера задач, вершина - ближайшая
+    uint8_t heapSize;
+    uint8_t jobCount;
+
+    int64_t lastLocal;
+    uint32_t lastMillis;
+
+    void* bot;                  // Бот любой конфигурации (DGO_VKbotT<Config>)
+    bool (*botTime)(void* bot, int64_t& utc, int& tz);
+    bool wallSynced;
+    int64_t wallOffset;         // UTC минус локальное время, когда считали задачи по часам
+    int wallTz;
+
+    int16_t running;            // Задача, которая выполняется сейчас (-1 - нет)
+    bool runningCancelled;
+
+    int64_t localMs() {
+        uint32_t ms = millis();
+        lastLocal += (uint32_t)(ms - lastMillis);
+        lastMillis = ms;
+        return lastLocal;
+    }
+
+    bool earlier(uint8_t a, uint8_t b) const {
+        return jobs[a].due < jobs[b].due;
+    }
+
+    void place(uint8_t pos, uint8_t slot) {
+        heap[pos] = slot;
+        jobs[slot].heapPos = pos;
+    }
+
+    void siftUp(uint8_t pos) {
+        uint8_t slot = heap[pos];
+        while (pos > 0) {
+            uint8_t parent = (pos - 1) / 2;
+            if (!earlier(slot, heap[parent])) break;
+            place(pos, heap[parent]);
+            pos = parent;
+        }
+        place(pos, slot);
+    }
+
+    void siftDown(uint8_t pos) {
+        uint8_t slot = heap[pos];
+        while (true) {
+            uint16_t child = 2 * pos + 1;
+            if (child >= heapSize) break;
+            if (child + 1 < heapSize && earlier(heap[child + 1], heap[child])) child++;
+            if (!earlier(heap[child], slot)) break;
+            place(pos, heap[child]);
+            pos = (uint8_t)child;
+        }
+        place(pos, slot);
+    }
+
+    void push(uint8_t slot) {
+        place(heapSize, slot);
+        siftUp(heapSize++);
+    }
+
+    void remove(uint8_t slot) {
+        int16_t pos = jobs[slot].heapPos;
+        if (pos < 0) return;
+        jobs[slot].heapPos = -1;
+        uint8_t last = heap[--heapSize];
+        if (pos < heapSize) {
+            place(pos, last);
+            siftUp(pos);
+            siftDown(jobs[last].heapPos);
+        }
+    }
+
+    uint32_t idOf(uint8_t slot) const {
+        return ((uint32_t)jobs[slot].gen << 8) | (slot + 1);
+    }
+
+    // Слот по номеру задачи, -1 если задача уже выполнена или отменена
+    int findSlot(uint32_t id) const {
+        uint32_t slot = (id & 0xFF) - 1;
+        if (slot >= VK_SCHEDULER_JOBS || jobs[slot].type == JOB_FREE || idOf(slot) != id) {
+            return -1;
+        }
+        return (int)slot;
+    }
+
+    void release(uint8_t slot) {
+        jobs[slot].type = JOB_FREE;
+        jobs[slot].fn = nullptr;
+        jobs[slot].gen++;
+        jobCount--;
+    }
+
+    uint32_t add(JobType type, uint32_t ms, const VkJob& fn, const VkCron* cron = nullptr) {
+        if (!fn) {
+            return 0;
+        }
+        for (uint8_t slot = 0; slot < VK_SCHEDULER_JOBS; slot++) {
+            Job& job = jobs[slot];
+            if (job.type != JOB_FREE || slot == running) {
+                continue;
+            }
+            job.type = type;
+            job.fn = fn;
+            job.interval = ms;
+            if (cron) {
+                job.cron = *cron;
+                job.due = VK_SCHEDULER_NEVER;
+                planWall(slot, localMs());
+            } else {
+                job.due = localMs() + ms;
+            }
+            jobCount++;
+            push(slot);
+            return idOf(slot);
+        }
+        VK_LOGE("Планировщик заполнен (VK_SCHEDULER_JOBS)");
+        return 0;
+    }
+
+    template <class Bot>
+    static bool readBotTime(void* bot, int64_t& utc, int& tz) {
+        Bot* b = static_cast<Bot*>(bot);
+        utc = b->getClock().nowMs();
+        tz = b->getTimezoneOffset();
+        return utc != 0;
+    }
+
+    // Текущее время по часам бота, false если оно неизвестно
+    bool wallNow(int64_t& utc, int& tz) {
+        if (!bot) {
+            return false;
+        }
+        return botTime(bot, utc, tz);
+    }
+
+    // Рассчитать срабатывание задачи по часам (кучу не трогает)
+    void planWall(uint8_t slot, int64_t local) {
+        Job& job = jobs[slot];
+        int64_t utc;
+        int tz;
+        if (!wallNow(utc, tz)) {
+            job.due = VK_SCHEDULER_NEVER;
+            return;
+        }
+        int64_t next = job.cron.next(utc / 1000 + tz);
+        if (next < 0) {
+            job.due = VK_SCHEDULER_NEVER;
+            return;
+        }
+        job.wallUtc = (next - tz) * 1000;
+        job.due = local + (job.wallUtc - utc);
+    }
+
+    // Часы подвели или сменили таймзону: пересчитать все задачи по часам
+    void replanWall(int64_t local, int64_t utc, int tz) {
+        wallSynced = true;
+        wallOffset = utc - local;
+        wallTz = tz;
+        for (uint8_t slot = 0; slot < VK_SCHEDULER_JOBS; slot++) {
+            if (jobs[slot].type == JOB_CRON && jobs[slot].heapPos >= 0) {
+                remove(slot);
+                planWall(slot, local);
+                push(slot);
+            }
+        }
+    }
+
+public:
+    VkScheduler() : heapSize(0), jobCount(0), lastLocal(0), lastMillis(0), bot(nullptr), botTime(nullptr),
+                    wallSynced(false), wallOffset(0), wallTz(0), running(-1), runningCancelled(false) {
+        lastMillis = millis();
+    }
+
+    // Выполнить задачу один раз через ms миллисекунд. Возвращает номер задачи или 0
+    uint32_t after(uint32_t ms, VkJob fn) {
+        return add(JOB_ONCE, ms, fn);
+    }
+
+    // Выполнять задачу каждые ms миллисекунд (первый раз - через ms)
+    // Если tick() опоздал больше чем на период, пропущенные запуски не догоняются
+    uint32_t every(uint32_t ms, VkJob fn) {
+        return add(JOB_EVERY, ms > 0 ? ms : 1, fn);
+    }
+
+    // Каждый день в hour:minute по времени бота (с учетом setTimezone())
+    uint32_t at(uint8_t hour, uint8_t minute, VkJob fn) {
+        if (hour > 23 || minute > 59) {
+            return 0;
+        }
+        VkCron cron = VkCron::daily(hour, minute);
+        return add(JOB_CRON, 0, fn, &cron);
+    }
+
+    // По расписанию cron ("0 8 * * 1-5" - по будням в 08:00). 0 - ошибка в расписании
+    uint32_t cron(const char* spec, VkJob fn) {
+        VkCron cron;
+        if (!cron.parse(spec)) {
+            VK_LOGE("Неверное расписание: %s", spec);
+            return 0;
+        }
+        return add(JOB_CRON, 0, fn, &cron);
+    }
+
+    // Отменить задачу (можно и из нее самой)
+    bool cancel(uint32_t id) {
+        int slot = findSlot(id);
+        if (slot < 0) {
+            return false;
+        }
+        remove(slot);
+        if (slot == running) {
+            runningCancelled = true;    // Освободим, когда задача вернется
+        } else {
+            release(slot);
+        }
+        return true;
+    }
+
+    bool isScheduled(uint32_t id) const {
+        int slot = findSlot(id);
+        return slot >= 0 && !(slot == running && runningCancelled);
+    }
+
+    // Сколько задач запланировано
+    uint8_t count() const {
+        return jobCount;
+    }
+
+    // Через сколько мс ближайшая задача (0 - пора, ULONG_MAX - задач нет)
+    // Пригодится, чтобы не проспать задачу в режиме с глубоким сном
+    unsigned long msUntilNext() {
+        if (heapSize == 0 || jobs[heap[0]].due == VK_SCHEDULER_NEVER) {
+            return ULONG_MAX;
+        }
+        int64_t left = jobs[heap[0]].due - localMs();
+        return left > 0 ? (unsigned long)left : 0;
+    }
+
+    // Выполнить задачи, которым пора. attach() вызывает это из bot.tick()
+    void run() {
+        int64_t local = localMs();
+        int64_t utc = 0;
+        int tz = 0;
+        if (wallNow(utc, tz)) {
+            int64_t shift = utc - local - wallOffset;
+            if (!wallSynced || tz != wallTz || shift > VK_SCHEDULER_RESYNC || shift < -VK_SCHEDULER_RESYNC) {
+                replanWall(local, utc, tz);
+            }
+        }
+
+        // Каждая задача срабатывает не больше раза за вызов
+        for (uint8_t n = heapSize; n > 0 && heapSize > 0 && jobs[heap[0]].due <= local; n--) {
+            uint8_t slot = heap[0];
+            Job& job = jobs[slot];
+            remove(slot);
+
+            // Часы чуть отстали от расчета: задаче по часам еще рано
+            if (job.type == JOB_CRON && utc != 0 && utc < job.wallUtc) {
+                job.due = local + (job.wallUtc - utc);
+                push(slot);
+                continue;
+            }
+
+            running = slot;
+            runningCancelled = false;
+            job.fn();
+            running = -1;
+
+            if (runningCancelled) {
+                release(slot);
+                continue;
+            }
+            switch (job.type) {
+                case JOB_ONCE:
+                    release(slot);
+                    break;
+                case JOB_EVERY:
+                    job.due += job.interval;
+                    if (job.due <= local) {
+                        job.due = local + job.interval;
+                    }
+                    push(slot);
+                    break;
+                case JOB_CRON:
+                    // Следующее время считаем от запланированного, а не от текущего:
+                    // задача, сработавшая на секунду раньше, не запустится дважды
+                    if (utc != 0) {
+                        int64_t next = job.cron.next(job.wallUtc / 1000 + tz);
+                        if (next < 0) {
+                            job.due = VK_SCHEDULER_NEVER;
+                        } else {
+                            job.wallUtc = (next - tz) * 1000;
+                            job.due = local + (job.wallUtc - utc);
+                        }
+                    } else {
+                        job.due = VK_SCHEDULER_NEVER;
+                    }
+                    push(slot);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+    // Взять время у бота и выполнять задачи из bot.tick() (и bot.pollOnce())
+    template <class Config>
+    void attach(DGO_VKbotT<Config>& bot) {
+        this->bot = &bot;
+        botTime = &readBotTime<DGO_VKbotT<Config>>;
+        bot.onTick([this]() {
+            run();
+        });
+    }
+};
+
+#endif // DGO_VKSCHEDULER_H
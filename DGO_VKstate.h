@@ -0,0 +1,280 @@
+// DGO_VKstate.h - Сохранение состояния Long Poll между перезагрузками
+// Сервер, ключ и ts пишутся в RTC память (переживает reset и brownout),
+// при желании - еще и в файл на LittleFS (переживает отключение питания)
+
+#ifndef DGO_VKSTATE_H
+#define DGO_VKSTATE_H
+
+#include <Arduino.h>
+
+#if defined(ESP8266) || defined(ESP32)
+    #include <FS.h>
+#endif
+
+#define VK_STATE_MAGIC 0x32534B56UL  // "VKS2"
+
+// Смещение в RTC памяти ESP8266 (в 4-байтных блоках): первые 128 байт занимает OTA
+#ifndef VK_STATE_RTC_OFFSET
+#define VK_STATE_RTC_OFFSET 32
+#endif
+
+// Сколько снимков помещается в RTC память (по одному на группу в VkHub)
+// На ESP8266 пользовательской RTC памяти 512 байт: помещается только слот 0
+#ifndef VK_STATE_RTC_SLOTS
+#define VK_STATE_RTC_SLOTS 4
+#endif
+
+// Как часто VkFsStore может перезаписывать файл ради одного только нового ts
+#ifndef VK_STATE_FLASH_INTERVAL
+#define VK_STATE_FLASH_INTERVAL 300000UL
+#endif
+
+// Снимок состояния Long Poll
+struct VkSavedState {
+    uint32_t magic;
+    uint32_t crc;           // CRC32 всех полей после crc
+    uint32_t owner;         // Хеш группы и адреса API: чужое состояние не подхватываем
+    uint32_t sleepMs;       // Текущий интервал сна pollOnce() (переживает deep sleep)
+    char server[96];
+    char key[64];
+    char ts[20];
+
+    static uint32_t crc32(const uint8_t* data, size_t len) {
+        uint32_t crc = 0xFFFFFFFFUL;
+        for (size_t i = 0; i < len; i++) {
+            crc ^= data[i];
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+            }
+        }
+        return ~crc;
+    }
+
+    // FNV-1a, для owner
+    static uint32_t hash(const char* s, uint32_t h = 2166136261UL) {
+        while (*s) {
+            h = (h ^ (uint8_t)*s++) * 16777619UL;
+        }
+        return h;
+    }
+
+    uint32_t checksum() const {
+        const uint8_t* start = (const uint8_t*)&owner;
+        return crc32(start, sizeof(VkSavedState) - (start - (const uint8_t*)this));
+    }
+
+    // Заполнить снимок, false если строки не помещаются
+    bool fill(uint32_t ownerHash, const String& lpServer, const String& lpKey, const String& lpTs,
+              uint32_t sleep = 0) {
+        memset(this, 0, sizeof(VkSavedState));
+        if (lpServer.length() >= sizeof(server) || lpKey.length() >= sizeof(key) ||
+            lpTs.length() >= sizeof(ts)) {
+            return false;
+        }
+        memcpy(server, lpServer.c_str(), lpServer.length());
+        memcpy(key, lpKey.c_str(), lpKey.length());
+        memcpy(ts, lpTs.c_str(), lpTs.length());
+        owner = ownerHash;
+        sleepMs = sleep;
+        magic = VK_STATE_MAGIC;
+        crc = checksum();
+        return true;
+    }
+
+    bool isValid(uint32_t ownerHash) const {
+        return magic == VK_STATE_MAGIC && owner == ownerHash && crc == checksum() &&
+               server[0] && key[0] && ts[0];
+    }
+};
+
+// Хранилище снимка (RTC, файл или свое)
+class VkStateStore {
+public:
+    virtual ~VkStateStore() {}
+
+    // Прочитать последний снимок (проверку делает бот)
+    virtual bool load(VkSavedState& state) = 0;
+
+    // Сохранить снимок; хранилище может отложить запись, если она дорогая
+    virtual bool save(const VkSavedState& state) = 0;
+
+    // Записать отложенное (например, перед сном или перезагрузкой)
+    virtual bool flush() {
+        return true;
+    }
+
+    // Забыть снимок
+    virtual void clear() = 0;
+};
+
+// RTC память: запись дешевая и не изнашивает flash, поэтому пишем каждый ts
+// ESP8266 - rtcUserMemory, ESP32 - RTC_NOINIT (не обнуляется при reset),
+// на хосте - обычная память процесса (перезапуск бота без перезапуска процесса)
+#if defined(ESP32) || defined(DGO_VKBOT_HOST)
+#ifndef RTC_NOINIT_ATTR
+#define RTC_NOINIT_ATTR
+#endif
+RTC_NOINIT_ATTR static VkSavedState vkRtcState[VK_STATE_RTC_SLOTS];
+#endif
+
+class VkRtcStore : public VkStateStore {
+private:
+    uint8_t slot;
+
+public:
+    explicit VkRtcStore(uint8_t rtcSlot = 0) : slot(rtcSlot) {}
+
+    void setSlot(uint8_t rtcSlot) {
+        slot = rtcSlot;
+    }
+
+    bool load(VkSavedState& state) override {
+#ifdef ESP8266
+        return ESP.rtcUserMemoryRead(VK_STATE_RTC_OFFSET + slot * (sizeof(state) / 4), (uint32_t*)&state,
+                                     sizeof(state));
+#else
+        if (slot >= VK_STATE_RTC_SLOTS) {
+            return false;
+        }
+        memcpy(&state, &vkRtcState[slot], sizeof(state));
+        return true;
+#endif
+    }
+
+    bool save(const VkSavedState& state) override {
+#ifdef ESP8266
+        return ESP.rtcUserMemoryWrite(VK_STATE_RTC_OFFSET + slot * (sizeof(state) / 4), (uint32_t*)&state,
+                                      sizeof(state));
+#else
+        if (slot >= VK_STATE_RTC_SLOTS) {
+            return false;
+        }
+        memcpy(&vkRtcState[slot], &state, sizeof(state));
+        return true;
+#endif
+    }
+
+    void clear() override {
+        VkSavedState empty;
+        memset(&empty, 0, sizeof(empty));
+        save(empty);
+    }
+};
+
+#if defined(ESP8266) || defined(ESP32)
+// Файл на LittleFS/SPIFFS: переживает отключение питания
+// Новый сервер или ключ пишется сразу, новый ts - не чаще VK_STATE_FLASH_INTERVAL,
+// поэтому после отключения питания могут повториться события за этот интервал
+class VkFsStore : public VkStateStore {
+private:
+    fs::FS& fs;
+    const char* path;
+    unsigned long interval;
+    unsigned long lastWrite;
+    bool written;
+    bool dirty;
+    VkSavedState pending;
+
+    bool write(const VkSavedState& state) {
+        // Пишем во временный файл и переименовываем: оборванная запись не портит старый
+        String tmp = String(path) + ".tmp";
+        fs::File f = fs.open(tmp.c_str(), "w");
+        if (!f) {
+            return false;
+        }
+        size_t n = f.write((const uint8_t*)&state, sizeof(state));
+        f.close();
+        if (n != sizeof(state)) {
+            return false;
+        }
+        fs.remove(path);
+        if (!fs.rename(tmp.c_str(), path)) {
+            return false;
+        }
+        lastWrite = millis();
+        written = true;
+        dirty = false;
+        return true;
+    }
+
+public:
+    VkFsStore(fs::FS& filesystem, const char* filePath = "/vkstate.bin",
+              unsigned long minInterval = VK_STATE_FLASH_INTERVAL)
+        : fs(filesystem), path(filePath), interval(minInterval), lastWrite(0), written(false), dirty(false) {
+        memset(&pending, 0, sizeof(pending));
+    }
+
+    bool load(VkSavedState& state) override {
+        fs::File f = fs.open(path, "r");
+        if (!f) {
+            return false;
+        }
+        size_t n = f.read((uint8_t*)&state, sizeof(state));
+        f.close();
+        if (n != sizeof(state)) {
+            return false;
+        }
+        memcpy(&pending, &state, sizeof(state));
+        written = true;
+        return true;
+    }
+
+    bool save(const VkSavedState& state) override {
+        bool sameServer = written && strcmp(state.server, pending.server) == 0 &&
+                          strcmp(state.key, pending.key) == 0;
+        memcpy(&pending, &state, sizeof(state));
+        dirty = true;
+        if (sameServer && millis() - lastWrite < interval) {
+            return true;    // Только ts - подождет
+        }
+        return write(pending);
+    }
+
+    bool flush() override {
+        return !dirty || write(pending);
+    }
+
+    void clear() override {
+        fs.remove(path);
+        written = false;
+        dirty = false;
+    }
+};
+#endif
+
+// Два хранилища сразу: читаем из первого, если там пусто или мусор - из второго
+// Например, VkStateChain chain(rtc, file) - быстрый warm restart и защита от отключения питания
+class VkStateChain : public VkStateStore {
+private:
+    VkStateStore& first;
+    VkStateStore& second;
+
+public:
+    VkStateChain(VkStateStore& a, VkStateStore& b) : first(a), second(b) {}
+
+    bool load(VkSavedState& state) override {
+        if (first.load(state) && state.magic == VK_STATE_MAGIC && state.crc == state.checksum()) {
+            return true;
+        }
+        return second.load(state);
+    }
+
+    bool save(const VkSavedState& state) override {
+        bool a = first.save(state);
+        bool b = second.save(state);
+        return a && b;
+    }
+
+    bool flush() override {
+        bool a = first.flush();
+        bool b = second.flush();
+        return a && b;
+    }
+
+    void clear() override {
+        first.clear();
+        second.clear();
+    }
+};
+
+#endif // DGO_VKSTATE_H
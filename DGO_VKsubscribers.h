@@ -0,0 +1,211 @@
+// DGO_VKsubscribers.h - Подписчики рассылки
+// Отсортированный массив peer_id фиксированного размера: поиск двоичный, память выделена заранее.
+// Команды "подписаться" и "отписаться" добавляются в роутер, список можно хранить в файле
+// на LittleFS/SPIFFS (заголовок и по 4 байта на подписчика)
+//   subscribers.begin(LittleFS);
+//   subscribers.attach(router, bot);
+//   bot.broadcast("Температура выше нормы", subscribers);
+
+#ifndef DGO_VKSUBSCRIBERS_H
+#define DGO_VKSUBSCRIBERS_H
+
+#include "DGO_VKrouter.h"
+
+#ifndef VK_SUBSCRIBERS
+#define VK_SUBSCRIBERS 256           // Подписчиков в списке (4 байта на каждого)
+#endif
+
+#define VK_SUBSCRIBERS_MAGIC 0x31425356UL  // "VSB1"
+
+class VkSubscribers {
+private:
+    // Заголовок файла, за ним count чисел int32
+    struct Header {
+        uint32_t magic;
+        uint32_t count;
+        uint32_t crc;       // CRC32 списка
+    };
+
+    int peers[VK_SUBSCRIBERS];
+    uint16_t count;
+#if defined(ESP8266) || defined(ESP32)
+    fs::FS* fs;
+    const char* path;
+#endif
+
+    // Позиция peer_id или место, куда его вставить
+    uint16_t lowerBound(int peer_id) const {
+        uint16_t lo = 0;
+        uint16_t hi = count;
+        while (lo < hi) {
+            uint16_t mid = (lo + hi) / 2;
+            if (peers[mid] < peer_id) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    uint32_t checksum() const {
+        return VkSavedState::crc32((const uint8_t*)peers, count * sizeof(int));
+    }
+
+    void changed() {
+#if defined(ESP8266) || defined(ESP32)
+        if (fs && !save()) {
+            VK_LOGE("Подписчики: не удалось записать %s", path);
+        }
+#endif
+    }
+
+public:
+#if defined(ESP8266) || defined(ESP32)
+    VkSubscribers() : count(0), fs(nullptr), path(nullptr) {}
+#else
+    VkSubscribers() : count(0) {}
+#endif
+
+    // Добавить получателя, false - уже есть или список полон
+    bool add(int peer_id) {
+        uint16_t i = lowerBound(peer_id);
+        if (i < count && peers[i] == peer_id) {
+            return false;
+        }
+        if (count >= VK_SUBSCRIBERS) {
+            VK_LOGW("Подписчики: список полон, увеличьте VK_SUBSCRIBERS");
+            return false;
+        }
+        memmove(peers + i + 1, peers + i, (count - i) * sizeof(int));
+        peers[i] = peer_id;
+        count++;
+        changed();
+        return true;
+    }
+
+    // Убрать получателя, false - его не было
+    bool remove(int peer_id) {
+        uint16_t i = lowerBound(peer_id);
+        if (i >= count || peers[i] != peer_id) {
+            return false;
+        }
+        memmove(peers + i, peers + i + 1, (count - i - 1) * sizeof(int));
+        count--;
+        changed();
+        return true;
+    }
+
+    bool contains(int peer_id) const {
+        uint16_t i = lowerBound(peer_id);
+        return i < count && peers[i] == peer_id;
+    }
+
+    void clear() {
+        count = 0;
+        changed();
+    }
+
+    uint16_t size() const {
+        return count;
+    }
+
+    static uint16_t capacity() {
+        return VK_SUBSCRIBERS;
+    }
+
+    // Получатели по возрастанию peer_id (для broadcast())
+    const int* data() const {
+        return peers;
+    }
+
+    int operator[](uint16_t i) const {
+        return peers[i];
+    }
+
+    // Команды подписки: отвечают в тот же чат и добавляют или убирают его peer_id
+    template <class Bot>
+    bool attach(VkRouter& router, Bot& bot, const char* subscribe = "подписаться|subscribe",
+                const char* unsubscribe = "отписаться|unsubscribe") {
+        VkSubscribers* self = this;
+        bool a = router.on(subscribe, [self, &bot](const VkUpdateView& update, const VkArgs&) {
+            int peer_id = update.message.peer_id;
+            if (self->contains(peer_id)) {
+                bot.enqueueMessage("Вы уже подписаны", peer_id);
+            } else if (self->add(peer_id)) {
+                bot.enqueueMessage("Вы подписаны на уведомления", peer_id);
+            } else {
+                bot.enqueueMessage("Список подписчиков заполнен", peer_id);
+            }
+        });
+        bool b = router.on(unsubscribe, [self, &bot](const VkUpdateView& update, const VkArgs&) {
+            int peer_id = update.message.peer_id;
+            bot.enqueueMessage(self->remove(peer_id) ? "Вы отписались от уведомлений" : "Вы не подписаны",
+                               peer_id);
+        });
+        return a && b;
+    }
+
+#if defined(ESP8266) || defined(ESP32)
+    // Прочитать список из файла и дальше сохранять каждое изменение
+    // false - файла нет или он испорчен (список тогда пуст)
+    bool begin(fs::FS& filesystem, const char* filePath = "/vksubs.bin") {
+        fs = nullptr;
+        path = filePath;
+        bool ok = load(filesystem, filePath);
+        fs = &filesystem;
+        return ok;
+    }
+
+    bool load(fs::FS& filesystem, const char* filePath) {
+        count = 0;
+        fs::File f = filesystem.open(filePath, "r");
+        if (!f) {
+            return false;
+        }
+        Header header;
+        size_t n = f.read((uint8_t*)&header, sizeof(header));
+        bool ok = n == sizeof(header) && header.magic == VK_SUBSCRIBERS_MAGIC && header.count <= VK_SUBSCRIBERS;
+        if (ok) {
+            n = f.read((uint8_t*)peers, header.count * sizeof(int));
+            ok = n == header.count * sizeof(int);
+        }
+        f.close();
+        if (ok) {
+            count = header.count;
+            ok = header.crc == checksum();
+        }
+        if (!ok) {
+            count = 0;
+            VK_LOGW("Подписчики: файл %s испорчен", filePath);
+        }
+        return ok;
+    }
+
+    // Записать во временный файл и переименовать: оборванная запись не портит старый
+    bool save() {
+        if (!fs) {
+            return false;
+        }
+        Header header;
+        header.magic = VK_SUBSCRIBERS_MAGIC;
+        header.count = count;
+        header.crc = checksum();
+        String tmp = String(path) + ".tmp";
+        fs::File f = fs->open(tmp.c_str(), "w");
+        if (!f) {
+            return false;
+        }
+        size_t n = f.write((const uint8_t*)&header, sizeof(header));
+        n += f.write((const uint8_t*)peers, count * sizeof(int));
+        f.close();
+        if (n != sizeof(header) + count * sizeof(int)) {
+            return false;
+        }
+        fs->remove(path);
+        return fs->rename(tmp.c_str(), path);
+    }
+#endif
+};
+
+#endif // DGO_VKSUBSCRIBERS_H
@@ -0,0 +1,164 @@
+// DGO_VKupload.h - Источники данных для загрузки фото и документов
+// Файл не читается в память целиком: тело multipart/form-data собирается на лету,
+// данные идут в сокет кусками по VK_UPLOAD_CHUNK байт. Размер нужен заранее (Content-Length)
+
+#ifndef DGO_VKUPLOAD_H
+#define DGO_VKUPLOAD_H
+
+#include <Arduino.h>
+#include <functional>
+
+#if defined(ESP8266) || defined(ESP32)
+    #include <FS.h>
+#endif
+
+#ifndef VK_UPLOAD_CHUNK
+#define VK_UPLOAD_CHUNK 512          // Буфер на стеке для одного куска файла
+#endif
+#define VK_UPLOAD_TIMEOUT 30000UL    // Сколько ждать ответа сервера загрузки (он обрабатывает файл)
+
+// Откуда брать данные файла
+class VkUploadSource {
+public:
+    virtual ~VkUploadSource() {}
+
+    // Размер в байтах (должен быть известен до начала загрузки)
+    virtual size_t size() = 0;
+
+    // Прочитать до len байт, 0 - данные кончились или ошибка чтения
+    virtual size_t read(uint8_t* buf, size_t len) = 0;
+};
+
+// Данные из Stream: файл LittleFS/SPIFFS, SD, UART...
+class VkStreamSource : public VkUploadSource {
+private:
+    Stream& stream;
+    size_t total;
+
+public:
+    VkStreamSource(Stream& s, size_t size) : stream(s), total(size) {}
+
+#if defined(ESP8266) || defined(ESP32)
+    // Размер берется у открытого файла
+    explicit VkStreamSource(fs::File& file) : stream(file), total(file.size()) {}
+#endif
+
+    size_t size() override {
+        return total;
+    }
+
+    size_t read(uint8_t* buf, size_t len) override {
+        return stream.readBytes(buf, len);
+    }
+};
+
+// Данные генерирует функция: (буфер, сколько нужно, смещение от начала) -> сколько записала
+// Так можно отправить график или лог, которого нет в памяти и на флеше целиком
+//   VkGeneratorSource csv(4096, [](uint8_t* buf, size_t len, size_t offset) { ... return len; });
+class VkGeneratorSource : public VkUploadSource {
+private:
+    size_t total;
+    size_t offset;
+    std::function<size_t(uint8_t*, size_t, size_t)> generate;
+
+public:
+    VkGeneratorSource(size_t size, std::function<size_t(uint8_t*, size_t, size_t)> generator)
+        : total(size), offset(0), generate(generator) {}
+
+    size_t size() override {
+        return total;
+    }
+
+    size_t read(uint8_t* buf, size_t len) override {
+        if (offset >= total) {
+            return 0;
+        }
+        if (len > total - offset) {
+            len = total - offset;
+        }
+        size_t n = generate(buf, len, offset);
+        if (n > len) {
+            n = len;
+        }
+        offset += n;
+        return n;
+    }
+};
+
+// Тело multipart/form-data с одним файлом:
+//   --граница, заголовки части, данные файла, --граница--
+class VkMultipart {
+private:
+    char boundary[28];
+    char contentType[64];
+    String head;
+
+    // Тип по расширению: серверу VK важно только, что это картинка или документ
+    static const char* mimeType(const String& name) {
+        String lower = name;
+        lower.toLowerCase();
+        if (lower.endsWith(".png")) return "image/png";
+        if (lower.endsWith(".jpg") || lower.endsWith(".jpeg")) return "image/jpeg";
+        if (lower.endsWith(".gif")) return "image/gif";
+        if (lower.endsWith(".txt") || lower.endsWith(".log") || lower.endsWith(".csv")) return "text/plain";
+        return "application/octet-stream";
+    }
+
+public:
+    // field - имя поля формы (photo для фото, file для документа)
+    VkMultipart(const char* field, const String& filename) {
+        snprintf(boundary, sizeof(boundary), "----DGOVKbot%08lx", (unsigned long)random(0x7FFFFFFFL));
+        snprintf(contentType, sizeof(contentType), "multipart/form-data; boundary=%s", boundary);
+
+        // Кавычки и переводы строк в имени сломали бы заголовок части
+        String name = filename;
+        for (unsigned int i = 0; i < name.length(); i++) {
+            char c = name.charAt(i);
+            if (c == '"' || c == '\r' || c == '\n' || c == '\\') {
+                name.setCharAt(i, '_');
+            }
+        }
+        head.reserve(140 + name.length());
+        head += "--";
+        head += boundary;
+        head += "\r\nContent-Disposition: form-data; name=\"";
+        head += field;
+        head += "\"; filename=\"";
+        head += name;
+        head += "\"\r\nContent-Type: ";
+        head += mimeType(name);
+        head += "\r\n\r\n";
+    }
+
+    // Значение заголовка Content-Type запроса
+    const char* getContentType() const {
+        return contentType;
+    }
+
+    // Длина всего тела при размере файла dataSize
+    size_t length(size_t dataSize) const {
+        return head.length() + dataSize + 6 + strlen(boundary) + 2;
+    }
+
+    // Записать тело, данные файла идут кусками через буфер buf
+    // false, если источник отдал меньше size() байт или запись не прошла
+    bool writeTo(Print& out, VkUploadSource& source, uint8_t* buf, size_t bufSize) const {
+        if (out.write((const uint8_t*)head.c_str(), head.length()) != head.length()) {
+            return false;
+        }
+        size_t left = source.size();
+        while (left > 0) {
+            size_t n = source.read(buf, left < bufSize ? left : bufSize);
+            if (n == 0 || out.write(buf, n) != n) {
+                return false;
+            }
+            left -= n;
+            yield();
+        }
+        return out.print("\r\n--") == 4 &&
+               out.print(boundary) == strlen(boundary) &&
+               out.print("--\r\n") == 4;
+    }
+};
+
+#endif // DGO_VKUPLOAD_H
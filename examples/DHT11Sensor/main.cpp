@@ -1,90 +1,172 @@
 // Пример: Датчик DHT11 через VK бота
-// Команды: "температура" - получить температуру, "влажность" - получить влажность
+// Команды: "температура" - получить температуру, "влажность" - получить влажность,
+// "лог" - прислать журнал измерений файлом (он пишется в LittleFS раз в 10 минут),
+// "подписаться" / "отписаться" - уведомления о перегреве и утренняя сводка в 08:00,
+// "панель" - живое сообщение с показаниями, которое правится на месте при их изменении
+// Рассылка идет пачками по 100 получателей: сотня подписчиков - один запрос к VK
 // Требуется библиотека DHT sensor library
 
 #include <DGO_VKbot.h>
+#include <DGO_VKrouter.h>
+#include <DGO_VKscheduler.h>
+#include <DGO_VKsubscribers.h>
 #include <DHT.h>
+#include <LittleFS.h>
 
 // НАСТРОЙКИ
 #define WIFI_SSID "your_wifi_ssid"
 #define WIFI_PASS "your_wifi_password"
 #define VK_TOKEN "your_vk_token_here"
 #define GROUP_ID "-your_group_id"
+#define TEMP_ALERT 30.0         // Выше - уведомление подписчикам
+#define TEMP_ALERT_RESET 28.0   // Ниже - можно уведомлять снова
 
 // Настройки DHT11
 #define DHTPIN 4        // Пин подключения DHT11
 #define DHTTYPE DHT11   // Тип датчика
 
+#define LOG_FILE "/log.csv"
+#define LOG_MAX_SIZE 65536  // Больше - начинаем журнал заново
+
 // Создаем объекты
 DGO_VKbot bot;
+VkRouter router;
+VkScheduler scheduler;
+VkSubscribers subscribers;
+VkLiveMessage dashboard(0, 30000);  // Правка не чаще раза в 30 секунд
 DHT dht(DHTPIN, DHTTYPE);
+bool overheat = false;
 
-unsigned long lastRead = 0;
-const unsigned long READ_INTERVAL = 2000; // Чтение каждые 2 секунды
+// Периодическое чтение датчика и уведомление о перегреве
+void readSensor() {
+  float temp = dht.readTemperature();
+  float humidity = dht.readHumidity();
+  if (isnan(temp) || isnan(humidity)) {
+    return;
+  }
+  // Запрос к VK будет, только если текст панели изменился
+  if (dashboard.peerId()) {
+    String panel = "Температура: " + String(temp, 1) + " °C\n";
+    panel += "Влажность: " + String(humidity, 0) + " %";
+    bot.updateLive(dashboard, panel);
+  }
+  if (!overheat && temp > TEMP_ALERT) {
+    overheat = true;
+    bot.broadcast("Внимание! Температура " + String(temp, 1) + " °C", subscribers);
+  } else if (overheat && temp < TEMP_ALERT_RESET) {
+    overheat = false;
+    bot.broadcast("Температура снова в норме: " + String(temp, 1) + " °C", subscribers);
+  }
+}
 
-// Обработчик новых сообщений
-void onNewMessage(VkUpdate& update) {
-  if (update.type == VK_MESSAGE_NEW) {
-    String text = update.message.text;
-    text.toLowerCase();
-    text.trim();
-    
-    int peer_id = update.message.peer_id;
-    
-    Serial.print("Получено сообщение: ");
-    Serial.println(text);
-    
-    // Обработка команд
-    if (text == "температура" || text == "temp" || text == "t") {
-      float temp = dht.readTemperature();
-      if (!isnan(temp)) {
-        String reply = "Температура: " + String(temp, 1) + " °C";
-        bot.sendMessage(reply, peer_id);
-      } else {
-        bot.sendMessage("Ошибка чтения температуры", peer_id);
-      }
-      
-    } else if (text == "влажность" || text == "humidity" || text == "h") {
-      float humidity = dht.readHumidity();
-      if (!isnan(humidity)) {
-        String reply = "Влажность: " + String(humidity, 1) + " %";
-        bot.sendMessage(reply, peer_id);
-      } else {
-        bot.sendMessage("Ошибка чтения влажности", peer_id);
-      }
-      
-    } else if (text == "данные" || text == "data" || text == "d") {
-      float temp = dht.readTemperature();
-      float humidity = dht.readHumidity();
-      
-      if (!isnan(temp) && !isnan(humidity)) {
-        String reply = "Температура: " + String(temp, 1) + " °C\n";
-        reply += "Влажность: " + String(humidity, 1) + " %";
-        bot.sendMessage(reply, peer_id);
-      } else {
-        bot.sendMessage("Ошибка чтения данных с датчика", peer_id);
-      }
-      
-    } else if (text == "помощь" || text == "help") {
-      String help = "Команды:\n";
-      help += "температура - температура\n";
-      help += "влажность - влажность\n";
-      help += "данные - все данные\n";
-      help += "помощь - эта справка";
-      bot.sendMessage(help, peer_id);
-      
-    } else {
-      bot.sendMessage("Используйте команду 'помощь' для списка команд", peer_id);
-    }
+// Строка в журнал: время, температура, влажность
+void writeLog() {
+  float temp = dht.readTemperature();
+  float humidity = dht.readHumidity();
+  if (isnan(temp) || isnan(humidity)) {
+    return;
+  }
+  File file = LittleFS.open(LOG_FILE, "a");
+  if (!file) {
+    return;
+  }
+  if (file.size() > LOG_MAX_SIZE) {
+    file.close();
+    file = LittleFS.open(LOG_FILE, "w");
+  }
+  file.print(bot.getCurrentTimeString());
+  file.print(';');
+  file.print(temp, 1);
+  file.print(';');
+  file.println(humidity, 1);
+  file.close();
+}
+
+// Утренняя сводка подписчикам
+void sendReport() {
+  float temp = dht.readTemperature();
+  float humidity = dht.readHumidity();
+  if (isnan(temp) || isnan(humidity)) {
+    return;
+  }
+  String report = "Доброе утро! Сейчас " + bot.getCurrentTimeString() + "\n";
+  report += "Температура: " + String(temp, 1) + " °C\n";
+  report += "Влажность: " + String(humidity, 1) + " %";
+  bot.broadcast(report, subscribers);
+}
+
+// Обработчики команд
+void onTemperature(const VkUpdateView& update, const VkArgs& args) {
+  float temp = dht.readTemperature();
+  if (!isnan(temp)) {
+    String reply = "Температура: " + String(temp, 1) + " °C";
+    bot.sendMessage(reply, update.message.peer_id);
+  } else {
+    bot.sendMessage("Ошибка чтения температуры", update.message.peer_id);
+  }
+}
+
+void onHumidity(const VkUpdateView& update, const VkArgs& args) {
+  float humidity = dht.readHumidity();
+  if (!isnan(humidity)) {
+    String reply = "Влажность: " + String(humidity, 1) + " %";
+    bot.sendMessage(reply, update.message.peer_id);
+  } else {
+    bot.sendMessage("Ошибка чтения влажности", update.message.peer_id);
   }
 }
 
+void onData(const VkUpdateView& update, const VkArgs& args) {
+  float temp = dht.readTemperature();
+  float humidity = dht.readHumidity();
+
+  if (!isnan(temp) && !isnan(humidity)) {
+    String reply = "Температура: " + String(temp, 1) + " °C\n";
+    reply += "Влажность: " + String(humidity, 1) + " %";
+    bot.sendMessage(reply, update.message.peer_id);
+  } else {
+    bot.sendMessage("Ошибка чтения данных с датчика", update.message.peer_id);
+  }
+}
+
+// Журнал уходит в сокет кусками, целиком в память он не читается
+void onLog(const VkUpdateView& update, const VkArgs& args) {
+  if (!bot.sendDocument(update.message.peer_id, LittleFS, LOG_FILE, "Журнал измерений")) {
+    bot.sendMessage("Не удалось отправить журнал", update.message.peer_id);
+  }
+}
+
+// Панель переезжает в чат, откуда ее попросили
+void onDashboard(const VkUpdateView& update, const VkArgs& args) {
+  dashboard.setPeer(update.message.peer_id);
+  dashboard.restart();
+}
+
+void onHelp(const VkUpdateView& update, const VkArgs& args) {
+  String help = "Команды:\n";
+  help += "температура - температура\n";
+  help += "влажность - влажность\n";
+  help += "данные - все данные\n";
+  help += "лог - журнал измерений файлом\n";
+  help += "подписаться / отписаться - уведомления\n";
+  help += "панель - показания, которые обновляются сами\n";
+  help += "помощь - эта справка";
+  bot.sendMessage(help, update.message.peer_id);
+}
+
+void onUnknown(const VkUpdateView& update, const VkArgs& args) {
+  Serial.print("Получено сообщение: ");
+  Serial.println(update.message.text.c_str());
+  bot.sendMessage("Используйте команду 'помощь' для списка команд", update.message.peer_id);
+}
+
 void setup() {
   Serial.begin(115200);
   
   // Инициализация DHT11
   dht.begin();
   Serial.println("DHT11 инициализирован");
+  LittleFS.begin();
   
   Serial.println("Подключение к WiFi...");
   WiFi.begin(WIFI_SSID, WIFI_PASS);
@@ -101,7 +183,28 @@ void setup() {
   // Настраиваем бота
   bot.setToken(VK_TOKEN);
   bot.setGroupId(GROUP_ID);
-  bot.attach(onNewMessage);
+  // Команды и синонимы через '|'
+  router.on("температура|temp|t", onTemperature);
+  router.on("влажность|humidity|h", onHumidity);
+  router.on("данные|data|d", onData);
+  router.on("лог|log", onLog);
+  router.on("панель|dashboard", onDashboard);
+  router.on("помощь|help", onHelp);
+  router.onUnknown(onUnknown);
+  // Список подписчиков хранится в LittleFS и переживает перезагрузку
+  subscribers.begin(LittleFS);
+  subscribers.attach(router, bot);
+  router.attach(bot);
+  // Запретил сообщения от сообщества - рассылать ему больше нечего
+  bot.on(VK_MESSAGE_DENY, [](VkUpdate& update) {
+    subscribers.remove(update.user_id);
+  });
+
+  // Задачи выполняются из bot.tick()
+  scheduler.every(2000, readSensor);  // Чтение каждые 2 секунды
+  scheduler.at(8, 0, sendReport);     // Каждый день в 08:00 по таймзоне бота
+  scheduler.every(600000, writeLog);  // Журнал раз в 10 минут
+  scheduler.attach(bot);
   
   // Запускаем бота
   Serial.println("Запуск VK бота...");
@@ -124,13 +227,5 @@ void setup() {
 
 void loop() {
   bot.tick();
-  
-  // Периодическое чтение датчика (для стабилизации)
-  if (millis() - lastRead > READ_INTERVAL) {
-    dht.readTemperature();
-    dht.readHumidity();
-    lastRead = millis();
-  }
-  
   delay(100);
 }
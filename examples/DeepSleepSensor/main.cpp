@@ -0,0 +1,90 @@
+// Пример: Датчик DHT11 на батарее с глубоким сном
+// Устройство просыпается, один раз опрашивает VK, отвечает и снова засыпает.
+// Пока идет переписка, просыпается часто, в тишине - все реже (до 10 минут).
+// ESP8266: соедините GPIO16 (D0) с RST, иначе устройство не проснется
+// Требуется библиотека DHT sensor library
+
+#include <DGO_VKbot.h>
+#include <DGO_VKrouter.h>
+#include <DHT.h>
+
+// НАСТРОЙКИ
+#define WIFI_SSID "your_wifi_ssid"
+#define WIFI_PASS "your_wifi_password"
+#define VK_TOKEN "your_vk_token_here"
+#define GROUP_ID "-your_group_id"
+
+#define DHTPIN 4
+#define DHTTYPE DHT11
+
+DGO_VKbot bot;
+VkRouter router;
+DHT dht(DHTPIN, DHTTYPE);
+
+void onData(const VkUpdateView& update, const VkArgs& args) {
+  float temp = dht.readTemperature();
+  float humidity = dht.readHumidity();
+  
+  if (!isnan(temp) && !isnan(humidity)) {
+    String reply = "Температура: " + String(temp, 1) + " °C\n";
+    reply += "Влажность: " + String(humidity, 1) + " %";
+    bot.enqueueMessage(reply, update.message.peer_id);
+  } else {
+    bot.enqueueMessage("Ошибка чтения датчика", update.message.peer_id);
+  }
+}
+
+void onHelp(const VkUpdateView& update, const VkArgs& args) {
+  bot.enqueueMessage("Команда: данные. Ответ придет при следующем пробуждении датчика",
+                     update.message.peer_id);
+}
+
+void goToSleep(unsigned long ms) {
+  Serial.print("Сон ");
+  Serial.print(ms / 1000);
+  Serial.println(" с");
+  ESP.deepSleep(ms * 1000UL);
+}
+
+void setup() {
+  Serial.begin(115200);
+  dht.begin();
+  
+  WiFi.begin(WIFI_SSID, WIFI_PASS);
+  unsigned long start = millis();
+  while (WiFi.status() != WL_CONNECTED) {
+    if (millis() - start > 15000) {
+      goToSleep(60000);   // Нет WiFi - попробуем позже
+    }
+    delay(100);
+  }
+  
+  bot.setToken(VK_TOKEN);
+  bot.setGroupId(GROUP_ID);
+  bot.setSleepInterval(15000, 600000);
+  
+  router.on("данные|data|d|температура|temp|t", onData);
+  router.onUnknown(onHelp);
+  router.attach(bot);
+  
+  // begin() продолжает с ts, сохраненного в RTC памяти перед сном
+  if (!bot.begin()) {
+    goToSleep(60000);
+  }
+  
+  unsigned long sleepMs = bot.pollOnce();
+  const VkPollResult& poll = bot.getLastPoll();
+  Serial.print("Событий: ");
+  Serial.print(poll.events);
+  Serial.print(", отправлено: ");
+  Serial.print(poll.sent);
+  Serial.print(", радио ");
+  Serial.print(poll.awakeMs);
+  Serial.println(" мс");
+  
+  goToSleep(sleepMs);
+}
+
+void loop() {
+  // Не используется: после сна ESP начинает с setup()
+}
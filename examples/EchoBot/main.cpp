@@ -1,5 +1,6 @@
 // Пример: Эхо-бот
-// Отвечает на все сообщения эхом
+// Отвечает на все сообщения эхом и обращается по имени
+// Имя берется из кэша профилей: запрос к VK - только на первое сообщение автора
 
 #include <DGO_VKbot.h>
 
@@ -13,22 +14,29 @@
 DGO_VKbot bot;
 
 // Обработчик новых сообщений
-void onNewMessage(VkUpdate& update) {
-  if (update.type == VK_MESSAGE_NEW) {
-    String text = update.message.text;
-    int peer_id = update.message.peer_id;
-    
-    Serial.print("Получено сообщение от ");
-    Serial.print(update.message.from_id);
-    Serial.print(": ");
-    Serial.println(text);
-    
-    // Отправляем эхо-ответ
-    String reply = "Эхо: " + text;
-    bot.sendMessage(reply, peer_id);
-    
-    Serial.println("Ответ отправлен");
+// Текст не копируется: update.message.text указывает в разобранный ответ VK
+// и действителен до выхода из обработчика
+void onNewMessage(const VkUpdateView& update) {
+  const VkStr& text = update.message.text;
+  
+  Serial.print("Получено сообщение от ");
+  Serial.print(update.message.from_id);
+  Serial.print(": ");
+  Serial.println(text.c_str());
+  
+  // Отправляем эхо-ответ
+  String reply;
+  reply.reserve(text.length() + 64);
+  const VkProfile* profile = bot.getProfile(update.message.from_id);
+  if (profile) {
+    reply += profile->first_name;
+    reply += ", ";
   }
+  reply += "Эхо: ";
+  reply += text.c_str();
+  bot.sendMessage(reply, update.message.peer_id);
+  
+  Serial.println("Ответ отправлен");
 }
 
 void setup() {
@@ -49,7 +57,8 @@ void setup() {
   // Настраиваем бота
   bot.setToken(VK_TOKEN);
   bot.setGroupId(GROUP_ID);
-  bot.attach(onNewMessage);
+  bot.attachView(onNewMessage);
+  bot.setProfilePrefetch(true);  // Авторы всей пачки событий - одним users.get
   
   // Запускаем бота
   Serial.println("Запуск VK бота...");
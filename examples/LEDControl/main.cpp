@@ -1,7 +1,10 @@
 // Пример: Управление светодиодом через VK бота
-// Команды: "включить" - включить LED, "выключить" - выключить LED
+// Команды: "включить" - включить LED, "выключить" - выключить LED, "stats" - метрики бота
+// На любое другое сообщение бот присылает кнопки под сообщением: нажатие не пишет в чат,
+// а показывает всплывающее уведомление
 
 #include <DGO_VKbot.h>
+#include <DGO_VKrouter.h>
 
 // НАСТРОЙКИ
 #define WIFI_SSID "your_wifi_ssid"
@@ -11,41 +14,64 @@
 
 #define LED_PIN 2  // Пин светодиода (встроенный LED на большинстве ESP)
 
+// Номера кнопок: по ним роутер находит команду, не разбирая текст
+enum {
+  CMD_ON = 1,
+  CMD_OFF,
+  CMD_STATUS
+};
+
 // Создаем экземпляр бота
 DGO_VKbot bot;
+VkRouter router;
 
-// Обработчик новых сообщений
-void onNewMessage(VkUpdate& update) {
-  if (update.type == VK_MESSAGE_NEW) {
-    String text = update.message.text;
-    text.toLowerCase();
-    text.trim();
-    
-    int peer_id = update.message.peer_id;
-    
-    Serial.print("Получено сообщение: ");
-    Serial.println(text);
-    
-    // Обработка команд
-    if (text == "включить" || text == "вкл" || text == "on") {
-      digitalWrite(LED_PIN, HIGH);
-      bot.sendMessage("LED включен", peer_id);
-      Serial.println("LED включен");
-      
-    } else if (text == "выключить" || text == "выкл" || text == "off") {
-      digitalWrite(LED_PIN, LOW);
-      bot.sendMessage("LED выключен", peer_id);
-      Serial.println("LED выключен");
-      
-    } else if (text == "статус" || text == "status") {
-      bool ledState = digitalRead(LED_PIN);
-      String status = ledState ? "LED включен" : "LED выключен";
-      bot.sendMessage(status, peer_id);
-      
-    } else {
-      bot.sendMessage("Команды: включить, выключить, статус", peer_id);
-    }
+// Ответ на команду: на нажатие кнопки - уведомлением, на текст - сообщением
+void reply(const VkUpdateView& update, const char* text) {
+  if (update.type == VK_MESSAGE_EVENT) {
+    bot.answerEvent(update, text);
+  } else {
+    bot.sendMessage(text, update.message.peer_id);
+  }
+}
+
+// Обработчики команд (регистр не важен: "Включить", "ВКЛ" и "/on" тоже подходят)
+void onLedOn(const VkUpdateView& update, const VkArgs& args) {
+  digitalWrite(LED_PIN, HIGH);
+  reply(update, "LED включен");
+  Serial.println("LED включен");
+}
+
+void onLedOff(const VkUpdateView& update, const VkArgs& args) {
+  digitalWrite(LED_PIN, LOW);
+  reply(update, "LED выключен");
+  Serial.println("LED выключен");
+}
+
+void onStatus(const VkUpdateView& update, const VkArgs& args) {
+  bool ledState = digitalRead(LED_PIN);
+  reply(update, ledState ? "LED включен" : "LED выключен");
+}
+
+// Счетчики и задержки бота в JSON (время в микросекундах)
+void onStats(const VkUpdateView& update, const VkArgs& args) {
+  bot.sendMessage(bot.getMetricsJson(), update.message.peer_id);
+}
+
+// Все остальные сообщения: подсказка и кнопки
+void onHelp(const VkUpdateView& update, const VkArgs& args) {
+  if (update.type == VK_MESSAGE_EVENT) {
+    bot.answerEvent(update);  // Кнопка из старой версии прошивки
+    return;
   }
+  Serial.print("Получено сообщение: ");
+  Serial.println(update.message.text.c_str());
+
+  VkKeyboard keyboard(true);
+  keyboard.callback("Включить", CMD_ON, VK_BUTTON_POSITIVE);
+  keyboard.callback("Выключить", CMD_OFF, VK_BUTTON_NEGATIVE);
+  keyboard.row();
+  keyboard.callback("Статус", CMD_STATUS);
+  bot.sendMessage("Команды: включить, выключить, статус, stats", update.message.peer_id, keyboard);
 }
 
 void setup() {
@@ -70,7 +96,13 @@ void setup() {
   // Настраиваем бота
   bot.setToken(VK_TOKEN);
   bot.setGroupId(GROUP_ID);
-  bot.attach(onNewMessage);
+  // Команды и синонимы через '|', последним параметром - номер кнопки той же команды
+  router.on("включить|вкл|on", onLedOn, CMD_ON);
+  router.on("выключить|выкл|off", onLedOff, CMD_OFF);
+  router.on("статус|status", onStatus, CMD_STATUS);
+  router.on("stats|статистика", onStats);
+  router.onUnknown(onHelp);
+  router.attach(bot);
   
   // Запускаем бота
   Serial.println("Запуск VK бота...");
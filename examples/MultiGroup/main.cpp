@@ -0,0 +1,58 @@
+// Пример: Несколько сообществ на одном ESP32
+// Одно устройство обслуживает три группы: у каждой свой Long Poll,
+// а соединение с api.vk.com и цикл обработки общие (VkHub)
+
+#include <DGO_VKbot.h>
+#include <DGO_VKhub.h>
+
+// НАСТРОЙКИ
+#define WIFI_SSID "your_wifi_ssid"
+#define WIFI_PASS "your_wifi_password"
+
+// Боты групп с короткой очередью и маленькими кэшами: памяти на группу примерно вдвое меньше, чем с VkHub
+VkHubT<VkHubSmallConfig> hub;
+
+// Обработчик новых сообщений всех групп
+// update.group_id - сообщество, которому написали; отвечаем от его имени
+void onNewMessage(const VkUpdateView& update) {
+  Serial.print("Группа ");
+  Serial.print(update.group_id);
+  Serial.print(", сообщение: ");
+  Serial.println(update.message.text.c_str());
+
+  String reply = "Вы написали в сообщество ";
+  reply += update.group_id;
+  hub.enqueueMessage(update.group_id, reply, update.message.peer_id);
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial.println("Подключение к WiFi...");
+
+  WiFi.begin(WIFI_SSID, WIFI_PASS);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+    Serial.print(".");
+  }
+  Serial.println();
+  Serial.println("WiFi подключен!");
+
+  // Сначала группы, потом обработчики
+  hub.add("token_of_first_group", "-111111111");
+  hub.add("token_of_second_group", "-222222222");
+  hub.add("token_of_third_group", "-333333333");
+  hub.attachView(onNewMessage);
+
+  // Группа, которая не запустилась, будет запускаться из tick() раз в 30 секунд
+  if (hub.begin()) {
+    Serial.println("Все группы запущены!");
+  } else {
+    Serial.println("Не все группы запустились");
+  }
+  hub.setTimezone(3);
+}
+
+void loop() {
+  hub.tick();
+  delay(10);
+}
@@ -0,0 +1,87 @@
+// Пример: Бот без кучи
+// Размеры памяти заданы при компиляции (DGO_VKbotT<Config>): ответы VK разбираются
+// в аренах, у каждой ячейки очереди свой буфер текста. После begin() опрос и ответы
+// не обращаются к куче, поэтому она не дробится за недели работы
+// Команды: "вкл", "выкл", "статус"
+
+#include <DGO_VKbot.h>
+
+// НАСТРОЙКИ
+#define WIFI_SSID "your_wifi_ssid"
+#define WIFI_PASS "your_wifi_password"
+#define VK_TOKEN "your_vk_token_here"
+#define GROUP_ID "-your_group_id"  // ID группы с минусом!
+#define RELAY_PIN 5
+
+// Только новые сообщения, обработчик - обычная функция, а не std::function
+// Размеры арен подбираются по getLongPollArena().peak() / getApiArena().peak()
+struct RelayConfig : VkDefaultConfig {
+  enum {
+    OUTBOX = 8,
+    EVENTS = VK_EVENT_BIT(VK_MESSAGE_NEW),
+    STATIC_EVENTS = EVENTS,
+    LP_ARENA = 8192,
+    API_ARENA = 1536,
+    MESSAGE_SIZE = 128
+  };
+
+  static void onUpdate(const VkUpdateView& update);
+};
+
+DGO_VKbotT<RelayConfig> bot;
+bool relayOn = false;
+
+void RelayConfig::onUpdate(const VkUpdateView& update) {
+  const VkStr& text = update.message.text;
+  char reply[RelayConfig::MESSAGE_SIZE];
+
+  if (text.equals("вкл")) {
+    relayOn = true;
+    digitalWrite(RELAY_PIN, HIGH);
+    snprintf(reply, sizeof(reply), "Реле включено");
+  } else if (text.equals("выкл")) {
+    relayOn = false;
+    digitalWrite(RELAY_PIN, LOW);
+    snprintf(reply, sizeof(reply), "Реле выключено");
+  } else if (text.equals("статус")) {
+    snprintf(reply, sizeof(reply), "Реле %s, свободно %u байт, арены: %u/%u и %u/%u байт",
+             relayOn ? "включено" : "выключено", (unsigned)ESP.getFreeHeap(),
+             (unsigned)bot.getLongPollArena().peak(), (unsigned)bot.getLongPollArena().capacity(),
+             (unsigned)bot.getApiArena().peak(), (unsigned)bot.getApiArena().capacity());
+  } else {
+    snprintf(reply, sizeof(reply), "Команды: вкл, выкл, статус");
+  }
+  // Текст копируется прямо в ячейку очереди
+  bot.enqueueMessage(reply, update.message.peer_id);
+}
+
+void setup() {
+  Serial.begin(115200);
+  pinMode(RELAY_PIN, OUTPUT);
+
+  WiFi.begin(WIFI_SSID, WIFI_PASS);
+  while (WiFi.status() != WL_CONNECTED) {
+    delay(500);
+    Serial.print(".");
+  }
+  Serial.println();
+
+  bot.setToken(VK_TOKEN);
+  bot.setGroupId(GROUP_ID);
+  if (!bot.begin()) {
+    Serial.println("Ошибка запуска бота!");
+  }
+}
+
+void loop() {
+  bot.tick();
+
+  // Ответ не поместился в арену - значит, ее пора увеличить
+  static uint32_t overflows = 0;
+  uint32_t now = bot.getLongPollArena().overflows() + bot.getApiArena().overflows();
+  if (now != overflows) {
+    overflows = now;
+    Serial.printf("Арены малы: LP пик %u, API пик %u байт\n",
+                  (unsigned)bot.getLongPollArena().peak(), (unsigned)bot.getApiArena().peak());
+  }
+}
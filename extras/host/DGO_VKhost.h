@@ -0,0 +1,223 @@
+// DGO_VKhost.h - Транспорт DGO_VKbot для Linux (POSIX сокеты)
+// Подключается из DGO_VKbot.h при сборке с DGO_VKBOT_HOST
+// TLS нет: на хосте бот работает с локальным mock сервером по http
+
+#ifndef DGO_VKHOST_H
+#define DGO_VKHOST_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "DGO_VKhttp.h"
+
+#define VK_HOST_CONNECT_TIMEOUT 3000    // Таймаут подключения, мс
+#define VK_HOST_WRITE_TIMEOUT 3000      // Сколько ждать освобождения буфера сокета, мс
+
+// TCP клиент с интерфейсом Arduino Client
+// Чтение неблокирующее, как у WiFiClient: available() не ждет данных
+class VkPosixClient : public Client {
+private:
+    int fd;
+    bool eof;
+    uint8_t buf[2048];
+    size_t bufPos;
+    size_t bufLen;
+
+    // Подтянуть данные из сокета, если буфер пуст
+    void fill() {
+        if (fd < 0 || eof || bufPos < bufLen) {
+            return;
+        }
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            bufPos = 0;
+            bufLen = (size_t)n;
+        } else if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            eof = true;
+        }
+    }
+
+    bool waitFor(short events, int timeoutMs) {
+        pollfd p;
+        p.fd = fd;
+        p.events = events;
+        p.revents = 0;
+        return ::poll(&p, 1, timeoutMs) > 0 && (p.revents & events);
+    }
+
+    bool connectTo(const addrinfo* ai) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (fd < 0) {
+            return false;
+        }
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+        if (::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+            int err = 0;
+            socklen_t len = sizeof(err);
+            if (errno != EINPROGRESS || !waitFor(POLLOUT, VK_HOST_CONNECT_TIMEOUT) ||
+                ::getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &len) != 0 || err != 0) {
+                ::close(fd);
+                fd = -1;
+                return false;
+            }
+        }
+
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        return true;
+    }
+
+public:
+    VkPosixClient() : fd(-1), eof(false), bufPos(0), bufLen(0) {}
+
+    ~VkPosixClient() {
+        stop();
+    }
+
+    int connect(const char* host, uint16_t port) override {
+        stop();
+
+        char service[8];
+        snprintf(service, sizeof(service), "%u", (unsigned)port);
+        addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        addrinfo* list = nullptr;
+        if (::getaddrinfo(host, service, &hints, &list) != 0) {
+            return 0;
+        }
+        for (addrinfo* ai = list; ai; ai = ai->ai_next) {
+            if (connectTo(ai)) {
+                break;
+            }
+        }
+        ::freeaddrinfo(list);
+        return fd >= 0 ? 1 : 0;
+    }
+
+    int connect(IPAddress ip, uint16_t port) override {
+        uint32_t a = (uint32_t)ip;
+        char host[16];
+        snprintf(host, sizeof(host), "%u.%u.%u.%u",
+                 (unsigned)(a & 0xFF), (unsigned)(a >> 8 & 0xFF),
+                 (unsigned)(a >> 16 & 0xFF), (unsigned)(a >> 24));
+        return connect(host, port);
+    }
+
+    size_t write(uint8_t c) override {
+        return write(&c, 1);
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        size_t done = 0;
+        while (fd >= 0 && done < size) {
+            ssize_t n = ::send(fd, data + done, size - done, MSG_NOSIGNAL);
+            if (n > 0) {
+                done += (size_t)n;
+            } else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+                if (!waitFor(POLLOUT, VK_HOST_WRITE_TIMEOUT)) {
+                    break;
+                }
+            } else {
+                eof = true;
+                break;
+            }
+        }
+        return done;
+    }
+
+    int available() override {
+        fill();
+        return (int)(bufLen - bufPos);
+    }
+
+    int read() override {
+        fill();
+        if (bufPos >= bufLen) {
+            return -1;
+        }
+        return buf[bufPos++];
+    }
+
+    int read(uint8_t* out, size_t size) override {
+        fill();
+        size_t n = bufLen - bufPos;
+        if (n == 0) {
+            return -1;
+        }
+        if (n > size) {
+            n = size;
+        }
+        memcpy(out, buf + bufPos, n);
+        bufPos += n;
+        return (int)n;
+    }
+
+    int peek() override {
+        fill();
+        if (bufPos >= bufLen) {
+            return -1;
+        }
+        return buf[bufPos];
+    }
+
+    void flush() override {
+    }
+
+    void stop() override {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        fd = -1;
+        eof = false;
+        bufPos = 0;
+        bufLen = 0;
+    }
+
+    // Как у WiFiClient: пока есть непрочитанные данные, клиент считается подключенным
+    uint8_t connected() override {
+        if (fd < 0) {
+            return 0;
+        }
+        fill();
+        return (bufPos < bufLen || !eof) ? 1 : 0;
+    }
+
+    operator bool() override {
+        return fd >= 0;
+    }
+
+    using Print::write;
+};
+
+// Транспорт по умолчанию на хосте
+class VkPosixTransport : public VkTransport {
+public:
+    Client* createClient(bool secure) override {
+        if (secure) {
+            Serial.println("[VK] TLS на хосте не поддерживается, нужен адрес http://");
+            return nullptr;
+        }
+        return new VkPosixClient();
+    }
+
+    void destroyClient(Client* client, bool secure) override {
+        delete static_cast<VkPosixClient*>(client);
+    }
+};
+
+typedef VkPosixTransport VkDefaultTransport;
+
+#endif // DGO_VKHOST_H
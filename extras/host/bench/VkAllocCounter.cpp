@@ -0,0 +1,56 @@
+// VkAllocCounter.cpp - Подсчет аллокаций через подмену malloc (glibc)
+// operator new в libstdc++ вызывает malloc, поэтому new тоже попадает в счетчики
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "VkBench.h"
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static bool counting = false;
+static uint64_t allocCount = 0;
+static uint64_t allocBytes = 0;
+
+static inline void note(size_t size) {
+    if (counting) {
+        allocCount++;
+        allocBytes += size;
+    }
+}
+
+extern "C" void* malloc(size_t size) {
+    note(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) {
+    note(count * size);
+    return __libc_calloc(count, size);
+}
+
+// realloc считается новой аллокацией: именно так растут String и документы JSON
+extern "C" void* realloc(void* ptr, size_t size) {
+    note(size);
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+void vkAllocCountingEnable(bool enable) {
+    counting = enable;
+}
+
+VkAllocStats vkAllocStats() {
+    VkAllocStats s;
+    s.allocs = allocCount;
+    s.bytes = allocBytes;
+    return s;
+}
@@ -0,0 +1,121 @@
+// VkBench.h - Минимальный каркас микробенчмарков с подсчетом аллокаций
+// Время на операцию, число аллокаций и байт на операцию (malloc/realloc/calloc/new)
+
+#ifndef VK_BENCH_H
+#define VK_BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Счетчики из VkAllocCounter.cpp (считаются только при включенном подсчете)
+struct VkAllocStats {
+    uint64_t allocs;
+    uint64_t bytes;
+};
+
+void vkAllocCountingEnable(bool enable);
+VkAllocStats vkAllocStats();
+
+struct VkBenchResult {
+    std::string name;
+    uint64_t iterations;
+    double nsPerOp;
+    double allocsPerOp;
+    double bytesPerOp;
+};
+
+class VkBench {
+public:
+    VkBench() : minTimeMs(200), csv(false) {}
+
+    void setMinTime(unsigned ms) { minTimeMs = ms; }
+    void setFilter(const std::string& f) { filter = f; }
+    void setCsv(bool enable) { csv = enable; }
+
+    // Прогнать fn столько раз, чтобы набралось minTimeMs, и напечатать строку результата
+    // nullptr - замер отфильтрован
+    template <typename Fn>
+    const VkBenchResult* run(const std::string& name, Fn fn) {
+        if (!filter.empty() && name.find(filter) == std::string::npos) {
+            return nullptr;
+        }
+
+        // Прогрев: первые вызовы могут выделять память под кеши
+        fn();
+
+        uint64_t n = 1;
+        double ns = 0;
+        while (true) {
+            ns = measure(fn, n);
+            if (ns >= minTimeMs * 1e6 || n >= (1ULL << 30)) {
+                break;
+            }
+            uint64_t next = ns > 0 ? (uint64_t)(n * (minTimeMs * 1e6 / ns) * 1.2) : n * 10;
+            n = next > n * 10 ? n * 10 : (next > n ? next : n * 2);
+        }
+
+        // Аллокации считаем отдельным проходом, чтобы подсчет не влиял на время
+        uint64_t countN = n < 1000 ? n : 1000;
+        vkAllocCountingEnable(true);
+        VkAllocStats before = vkAllocStats();
+        for (uint64_t i = 0; i < countN; i++) {
+            fn();
+        }
+        VkAllocStats after = vkAllocStats();
+        vkAllocCountingEnable(false);
+
+        VkBenchResult r;
+        r.name = name;
+        r.iterations = n;
+        r.nsPerOp = ns / n;
+        r.allocsPerOp = (double)(after.allocs - before.allocs) / countN;
+        r.bytesPerOp = (double)(after.bytes - before.bytes) / countN;
+        print(r);
+        results.push_back(r);
+        return &results.back();
+    }
+
+    void header() {
+        if (csv) {
+            printf("name,iterations,ns_per_op,allocs_per_op,bytes_per_op\n");
+        } else {
+            printf("%-36s %12s %12s %10s %12s\n", "benchmark", "iterations", "ns/op", "allocs/op", "bytes/op");
+        }
+    }
+
+    const std::vector<VkBenchResult>& all() const { return results; }
+
+private:
+    unsigned minTimeMs;
+    bool csv;
+    std::string filter;
+    std::vector<VkBenchResult> results;
+
+    template <typename Fn>
+    static double measure(Fn& fn, uint64_t n) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < n; i++) {
+            fn();
+        }
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+
+    void print(const VkBenchResult& r) {
+        if (csv) {
+            printf("%s,%llu,%.1f,%.2f,%.1f\n", r.name.c_str(), (unsigned long long)r.iterations,
+                   r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+        } else {
+            printf("%-36s %12llu %12.1f %10.2f %12.1f\n", r.name.c_str(), (unsigned long long)r.iterations,
+                   r.nsPerOp, r.allocsPerOp, r.bytesPerOp);
+        }
+        fflush(stdout);
+    }
+};
+
+#endif // VK_BENCH_H
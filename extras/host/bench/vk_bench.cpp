@@ -0,0 +1,647 @@
+// vk_bench.cpp - Микробенчмарки горячих путей DGO_VKbot
+// Сеть не используется: API отвечает подставной клиент в памяти
+//
+// Запуск: vk_bench [--filter подстрока] [--time мс] [--csv]
+// Код выхода 1 - замеры static/ выделяли память в куче или арены переполнились
+
+#include <Arduino.h>
+#include <DGO_VKbot.h>
+#include <DGO_VKrouter.h>
+#include <DGO_VKscheduler.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+
+#include "VkBench.h"
+
+// Замеры аллокаций имеют смысл только с настоящим ArduinoJson 7: он берет память у аллокатора
+// документа (арены), а заглушки обычно идут мимо него
+#if !defined(ARDUINOJSON_VERSION_MAJOR) || ARDUINOJSON_VERSION_MAJOR < 7
+#error "vk_bench нужен ArduinoJson 7: оставьте ARDUINOJSON_DIR пустым, и CMake скачает его"
+#endif
+
+// Доступ к закрытым функциям бота (friend в DGO_VKbot)
+struct VkBenchAccess {
+    template <class Config>
+    static bool parseLongPoll(DGO_VKbotT<Config>& bot, Stream& body) {
+        return bot.handleLongPollResponse(body);
+    }
+};
+
+// Вывод в никуда: считает байты (для кодирования форм)
+class VkNullPrint : public Print {
+public:
+    size_t bytes;
+
+    VkNullPrint() : bytes(0) {}
+    size_t write(uint8_t) override { bytes++; return 1; }
+    size_t write(const uint8_t*, size_t size) override { bytes += size; return size; }
+    int availableForWrite() override { return 128; }
+};
+
+// Поток из строки в памяти (тело ответа Long Poll)
+class VkBenchStream : public Stream {
+private:
+    const char* data;
+    size_t len;
+    size_t pos;
+
+public:
+    VkBenchStream() : data(""), len(0), pos(0) {}
+
+    void reset(const std::string& s) {
+        data = s.data();
+        len = s.size();
+        pos = 0;
+    }
+
+    int available() override { return (int)(len - pos); }
+    int read() override { return pos < len ? (uint8_t)data[pos++] : -1; }
+    int peek() override { return pos < len ? (uint8_t)data[pos] : -1; }
+    size_t write(uint8_t) override { return 0; }
+
+    size_t readBytes(char* buffer, size_t length) override {
+        size_t n = len - pos < length ? len - pos : length;
+        memcpy(buffer, data + pos, n);
+        pos += n;
+        return n;
+    }
+};
+
+// Подставной клиент: принимает запрос и сразу "отвечает" заготовленным ответом
+// Ответ выбирается по строке запроса, сам клиент ничего не выделяет
+class VkBenchClient : public Client {
+private:
+    char requestLine[128];
+    size_t requestLen;
+    bool requestDone;
+    const std::string* response;
+    size_t respPos;
+    bool open;
+
+    void select() {
+        if (response || !requestDone) {
+            return;
+        }
+        requestLine[requestLen] = 0;
+        if (strstr(requestLine, "getLongPollServer")) {
+            response = &lpServerResponse;
+        } else if (strstr(requestLine, "getServerTime")) {
+            response = &timeResponse;
+        } else if (strstr(requestLine, "execute")) {
+            response = &executeResponse;
+        } else {
+            response = &sendResponse;
+        }
+        respPos = 0;
+    }
+
+public:
+    static std::string lpServerResponse;
+    static std::string sendResponse;
+    static std::string timeResponse;
+    static std::string executeResponse;
+
+    VkBenchClient() : requestLen(0), requestDone(false), response(nullptr), respPos(0), open(false) {}
+
+    int connect(const char*, uint16_t) override { open = true; return 1; }
+    int connect(IPAddress, uint16_t) override { open = true; return 1; }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t* buf, size_t size) override {
+        // Первая запись после прочитанного ответа - новый запрос
+        if (response && respPos >= response->size()) {
+            response = nullptr;
+            requestLen = 0;
+            requestDone = false;
+        }
+        for (size_t i = 0; i < size && !requestDone; i++) {
+            if (buf[i] == '\n' || requestLen == sizeof(requestLine) - 1) {
+                requestDone = true;
+            } else {
+                requestLine[requestLen++] = (char)buf[i];
+            }
+        }
+        return size;
+    }
+
+    int available() override {
+        select();
+        return response ? (int)(response->size() - respPos) : 0;
+    }
+
+    int read() override {
+        select();
+        if (!response || respPos >= response->size()) return -1;
+        return (uint8_t)(*response)[respPos++];
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+        int n = available();
+        if (n <= 0) return -1;
+        if ((size_t)n > size) n = (int)size;
+        memcpy(buf, response->data() + respPos, n);
+        respPos += n;
+        return n;
+    }
+
+    int peek() override {
+        select();
+        if (!response || respPos >= response->size()) return -1;
+        return (uint8_t)(*response)[respPos];
+    }
+
+    void flush() override {}
+    void stop() override { open = false; response = nullptr; requestLen = 0; requestDone = false; }
+    uint8_t connected() override { return open ? 1 : 0; }
+    operator bool() override { return open; }
+
+    using Print::write;
+};
+
+std::string VkBenchClient::lpServerResponse;
+std::string VkBenchClient::sendResponse;
+std::string VkBenchClient::timeResponse;
+std::string VkBenchClient::executeResponse;
+
+class VkBenchTransport : public VkTransport {
+public:
+    VkBenchClient client;
+
+    Client* createClient(bool) override { return &client; }
+    void destroyClient(Client*, bool) override {}
+};
+
+static std::string httpResponse(const std::string& body) {
+    char head[160];
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 200 OK\r\nContent-Type: application/json; charset=utf-8\r\n"
+             "Connection: keep-alive\r\nContent-Length: %zu\r\n\r\n", body.size());
+    return head + body;
+}
+
+// Ответ Long Poll с count событиями message_new
+// (или message_reply - ответами самого бота, на которые он обычно не подписан)
+static std::string longPollBody(int count, bool reply = false) {
+    const char* message =
+        "\"date\":1760000000,\"from_id\":123456789,\"out\":0,\"version\":10000,"
+        "\"attachments\":[],\"fwd_messages\":[],\"important\":false,\"is_hidden\":false,"
+        "\"peer_id\":123456789,\"random_id\":0,\"text\":\"Привет, бот! Включи свет на кухне\"";
+    std::string body = "{\"ts\":\"1000\",\"updates\":[";
+    for (int i = 0; i < count; i++) {
+        char id[128];
+        if (i) body += ',';
+        if (reply) {
+            // message_reply: объект сообщения лежит прямо в object
+            snprintf(id, sizeof(id), "\"event_id\":\"e%d\",\"v\":\"5.199\",\"object\":{"
+                     "\"id\":%d,\"conversation_message_id\":%d,", i, 100 + i, 100 + i);
+            body += "{\"group_id\":1,\"type\":\"message_reply\",";
+            body += id;
+            body += message;
+            body += "}}";
+            continue;
+        }
+        snprintf(id, sizeof(id), "\"event_id\":\"e%d\",\"v\":\"5.199\",\"object\":{\"message\":{"
+                 "\"id\":%d,\"conversation_message_id\":%d,", i, 100 + i, 100 + i);
+        body += "{\"group_id\":1,\"type\":\"message_new\",";
+        body += id;
+        body += message;
+        body += "},\"client_info\":{\"button_actions\":[\"text\",\"vkpay\",\"open_app\",\"location\","
+                "\"open_link\",\"callback\",\"intent_subscribe\",\"intent_unsubscribe\"],"
+                "\"keyboard\":true,\"inline_keyboard\":true,\"carousel\":true,\"lang_id\":0}}}";
+    }
+    body += "]}";
+    return body;
+}
+
+// Бот без кучи в установившемся режиме: только message_new, обработчик - функция,
+// ответы разбираются в аренах, у ячеек очереди своя память
+static unsigned long staticDispatched = 0;
+
+struct VkBenchStaticConfig : VkDefaultConfig {
+    enum {
+        OUTBOX = 8,
+        EVENTS = VK_EVENT_BIT(VK_MESSAGE_NEW),
+        STATIC_EVENTS = EVENTS,
+        LP_ARENA = 16384,
+        API_ARENA = 2048,
+        MESSAGE_SIZE = 128
+    };
+
+    static void onUpdate(const VkUpdateView& update) {
+        staticDispatched += update.message.text.length();
+    }
+};
+
+// Бот со статической конфигурацией после begin() не должен трогать кучу: ни на разбор
+// Long Poll, ни на отправку. Нарушение печатается и дает код выхода 1
+static int heapFailures = 0;
+
+static void expectNoHeap(const VkBenchResult* r) {
+    if (r && r->allocsPerOp > 0) {
+        printf("  ОШИБКА: %s - %.2f аллокаций на операцию, ожидалось 0\n", r->name.c_str(), r->allocsPerOp);
+        heapFailures++;
+    }
+}
+
+int main(int argc, char** argv) {
+    VkBench bench;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            bench.setFilter(argv[++i]);
+        } else if (arg == "--time" && i + 1 < argc) {
+            bench.setMinTime((unsigned)atoi(argv[++i]));
+        } else if (arg == "--csv") {
+            bench.setCsv(true);
+        } else {
+            printf("Использование: %s [--filter подстрока] [--time мс] [--csv]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    VkBenchClient::lpServerResponse = httpResponse(
+        "{\"response\":{\"key\":\"key\",\"server\":\"https://lp.vk.com/whp/1\",\"ts\":\"1000\"}}");
+    VkBenchClient::sendResponse = httpResponse("{\"response\":12345}");
+    VkBenchClient::timeResponse = httpResponse("{\"response\":1760000000}");
+    VkBenchClient::executeResponse = httpResponse("{\"response\":[12345]}");
+
+    VkBenchTransport transport;
+    DGO_VKbot bot;
+    bot.setTransport(transport);
+    bot.setToken("vk1.a.0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef");
+    bot.setGroupId("-123456789");
+    // Ограничитель частоты открыт полностью, чтобы мерить саму библиотеку
+    bot.setApiRateLimit(65535, 65535);
+
+    unsigned long dispatched = 0;
+    bot.attach([&](VkUpdate& update) {
+        dispatched += update.message.text.length();
+    });
+    if (!bot.begin()) {
+        printf("Бот не запустился\n");
+        return 1;
+    }
+    printf("\n");
+    bench.header();
+
+    // === Кодирование формы (application/x-www-form-urlencoded) ===
+
+    String ascii = "hello world 123";
+    String cyrillic = "Температура: 23.5°C, влажность: 41%";
+    String longText;
+    while (longText.length() < 2000) {
+        longText += "Длинный ответ бота с результатами измерений и подробностями. ";
+    }
+
+    VkNullPrint sink;
+    bench.run("formEncode/ascii-15", [&] {
+        VkForm::encode(sink, ascii.c_str(), ascii.length());
+    });
+    bench.run("formEncode/cyrillic-60b", [&] {
+        VkForm::encode(sink, cyrillic.c_str(), cyrillic.length());
+    });
+    bench.run("formEncode/long-2kb", [&] {
+        VkForm::encode(sink, longText.c_str(), longText.length());
+    });
+    bench.run("form/messages.send-2kb", [&] {
+        VkForm form;
+        form.add("peer_id", 123456789L);
+        form.add("message", longText);
+        form.add("random_id", 424242L);
+        form.add("access_token", "vk1.a.0123456789abcdef");
+        form.add("v", VK_API_VERSION);
+        size_t len = form.length();
+        if (form.writeTo(sink) != len) {
+            printf("Длина формы не совпала\n");
+        }
+    });
+
+    // === Тело загрузки файла: память не должна зависеть от размера ===
+
+    size_t uploadSizes[] = { 4096, 65536, 1048576 };
+    const char* uploadNames[] = { "upload/multipart-4k", "upload/multipart-64k", "upload/multipart-1m" };
+    for (int i = 0; i < 3; i++) {
+        size_t size = uploadSizes[i];
+        bench.run(uploadNames[i], [&sink, size] {
+            VkGeneratorSource source(size, [](uint8_t* buf, size_t len, size_t offset) {
+                memset(buf, (int)(offset & 0xFF), len);
+                return len;
+            });
+            VkMultipart body("photo", "chart.png");
+            uint8_t chunk[VK_UPLOAD_CHUNK];
+            if (!body.writeTo(sink, source, chunk, sizeof(chunk))) {
+                printf("Тело загрузки не записалось\n");
+            }
+        });
+    }
+
+    // === Разбор ответа Long Poll + диспетчеризация ===
+
+    int batches[] = { 1, 10, 100 };
+    std::string bodies[3];
+    VkBenchStream stream;
+    for (int i = 0; i < 3; i++) {
+        bodies[i] = longPollBody(batches[i]);
+        char name[48];
+        snprintf(name, sizeof(name), "longpoll/parse-%d", batches[i]);
+        const std::string& body = bodies[i];
+        bench.run(name, [&] {
+            stream.reset(body);
+            VkBenchAccess::parseLongPoll(bot, stream);
+        });
+    }
+
+    // Те же ответы с обработчиком без копий (onView): текст не копируется в String
+    bot.attachView([&](const VkUpdateView& update) {
+        dispatched += update.message.text.length();
+    });
+    for (int i = 0; i < 3; i++) {
+        char name[48];
+        snprintf(name, sizeof(name), "longpoll/parse-%d-view", batches[i]);
+        const std::string& body = bodies[i];
+        bench.run(name, [&] {
+            stream.reset(body);
+            VkBenchAccess::parseLongPoll(bot, stream);
+        });
+    }
+    bot.attach([&](VkUpdate& update) {
+        dispatched += update.message.text.length();
+    });
+
+    // События без обработчика: поля не попадают в документ, VkUpdate не создается
+    std::string replies = longPollBody(100, true);
+    bench.run("longpoll/parse-100-unsubscribed", [&] {
+        stream.reset(replies);
+        VkBenchAccess::parseLongPoll(bot, stream);
+    });
+
+    // === Конфигурация при компиляции: арены и память очереди (DGO_VKbotT<Config>) ===
+
+    VkBenchTransport staticTransport;
+    DGO_VKbotT<VkBenchStaticConfig> staticBot;
+    staticBot.setTransport(staticTransport);
+    staticBot.setToken("vk1.a.0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef");
+    staticBot.setGroupId("-123456789");
+    staticBot.setApiRateLimit(65535, 65535);
+    staticBot.setStateStore(nullptr);
+    if (!staticBot.begin()) {
+        printf("Бот со статической конфигурацией не запустился\n");
+        return 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        char name[48];
+        snprintf(name, sizeof(name), "static/longpoll-parse-%d", batches[i]);
+        const std::string& body = bodies[i];
+        expectNoHeap(bench.run(name, [&] {
+            stream.reset(body);
+            VkBenchAccess::parseLongPoll(staticBot, stream);
+        }));
+    }
+    // Постановка в очередь и execute с разбором ответа
+    expectNoHeap(bench.run("static/enqueue+execute", [&] {
+        staticBot.enqueueMessage("Свет включен", 123456789);
+        staticBot.flushOutbox();
+    }));
+    const VkArenaBase& lpArena = staticBot.getLongPollArena();
+    const VkArenaBase& apiArena = staticBot.getApiArena();
+    // Пики арен видны, если замеры выше не отфильтрованы
+    if (lpArena.peak() || apiArena.peak()) {
+        printf("  арены: Long Poll %u из %u байт, API %u из %u байт, из кучи %u раз\n",
+               (unsigned)lpArena.peak(), (unsigned)lpArena.capacity(), (unsigned)apiArena.peak(),
+               (unsigned)apiArena.capacity(), (unsigned)(lpArena.overflows() + apiArena.overflows()));
+    }
+    if (lpArena.overflows() || apiArena.overflows()) {
+        printf("  ОШИБКА: ответ не поместился в арену (Long Poll %u раз, API %u раз), увеличьте LP_ARENA/API_ARENA\n",
+               (unsigned)lpArena.overflows(), (unsigned)apiArena.overflows());
+        heapFailures++;
+    }
+
+    // === VkUpdate/VkMessage и вызов обработчика ===
+
+    std::function<void(VkUpdate&)> callback = [&](VkUpdate& update) {
+        dispatched += update.message.peer_id;
+    };
+    bench.run("update/construct+dispatch", [&] {
+        VkUpdate update;
+        update.type = VK_MESSAGE_NEW;
+        update.message.id = 100;
+        update.message.from_id = 123456789;
+        update.message.peer_id = 123456789;
+        update.message.text = "Привет, бот! Включи свет на кухне";
+        update.message.date = 1760000000;
+        callback(update);
+    });
+
+    // === Роутер команд ===
+
+    VkRouter router;
+    router.on("включить|вкл|on", [&](const VkUpdateView& u, const VkArgs& a) { dispatched += a.count(); });
+    router.on("выключить|выкл|off", [&](const VkUpdateView& u, const VkArgs& a) { dispatched += a.count(); });
+    router.on("статус|status", [&](const VkUpdateView& u, const VkArgs& a) { dispatched++; }, 3);
+    router.on("температура|temp|t", [&](const VkUpdateView& u, const VkArgs& a) { dispatched++; });
+    router.on("влажность|humidity|h", [&](const VkUpdateView& u, const VkArgs& a) { dispatched++; });
+    router.on("установить таймер|таймер", [&](const VkUpdateView& u, const VkArgs& a) { dispatched += a.toInt(0); });
+    router.on("помощь|help", [&](const VkUpdateView& u, const VkArgs& a) { dispatched++; });
+    router.onButton(5, [&](const VkUpdateView& u, const VkArgs& a) { dispatched += a.toInt(0); });
+    router.onUnknown([&](const VkUpdateView& u, const VkArgs& a) { dispatched += a.restLength(); });
+
+    VkUpdate command;
+    command.type = VK_MESSAGE_NEW;
+    command.message.peer_id = 123456789;
+    command.message.text = "  /Установить  ТАЙМЕР 15 \"на кухне\"";
+    bench.run("router/dispatch-args", [&] {
+        router.dispatch(command);
+    });
+    VkUpdate unknown = command;
+    unknown.message.text = "Привет, бот! Включи свет на кухне";
+    bench.run("router/dispatch-unknown", [&] {
+        router.dispatch(unknown);
+    });
+    // Для сравнения: прежний разбор через копию, toLowerCase() и цепочку ==
+    VkUpdate plain = command;
+    plain.message.text = "помощь";
+    bench.run("router/dispatch-help", [&] {
+        router.dispatch(plain);
+    });
+    // Кнопка: команда по номеру из payload, текст (подпись кнопки) не разбирается
+    VkUpdate button = command;
+    button.message.text = "📊 Статус";
+    button.command = 3;
+    bench.run("router/dispatch-button", [&] {
+        router.dispatch(button);
+    });
+    VkUpdate callbackButton;
+    callbackButton.type = VK_MESSAGE_EVENT;
+    callbackButton.command = 5;
+    callbackButton.command_arg = 42;
+    bench.run("router/dispatch-callback-arg", [&] {
+        router.dispatch(callbackButton);
+    });
+    const char* payload = "{\"c\":5,\"a\":42}";
+    bench.run("keyboard/payload-command", [&] {
+        long arg;
+        dispatched += vkPayloadCommand(payload, &arg) + arg;
+    });
+    bench.run("keyboard/build-2x2", [&] {
+        VkKeyboard kb(true);
+        kb.callback("Вкл", 1, VK_BUTTON_POSITIVE).callback("Выкл", 2, VK_BUTTON_NEGATIVE).row();
+        kb.button("Статус", 3).button("Яркость", 4, VK_BUTTON_PRIMARY, 50);
+        dispatched += kb.toJson().length();
+    });
+    // Обработчик с VkUpdate&: копия события только для найденной команды
+    VkRouter owning;
+    owning.on("помощь|help", [&](VkUpdate& u, const VkArgs& a) { dispatched++; });
+    bench.run("router/dispatch-help-owned", [&] {
+        owning.dispatch(plain);
+    });
+    bench.run("router/string-chain-help", [&] {
+        String text = plain.message.text;
+        text.toLowerCase();
+        text.trim();
+        if (text == "включить" || text == "вкл" || text == "on") dispatched++;
+        else if (text == "выключить" || text == "выкл" || text == "off") dispatched++;
+        else if (text == "статус" || text == "status") dispatched++;
+        else if (text == "температура" || text == "temp" || text == "t") dispatched++;
+        else if (text == "влажность" || text == "humidity" || text == "h") dispatched++;
+        else if (text == "помощь" || text == "help") dispatched++;
+    });
+
+    // === sendMessage(): построение запроса, отправка и разбор ответа ===
+
+    bench.run("sendMessage/short", [&] {
+        bot.sendMessage("Свет включен", 123456789);
+    });
+    bench.run("sendMessage/long-2kb", [&] {
+        bot.sendMessage(longText, 123456789);
+    });
+
+    // === Кэш профилей (DGO_VKprofiles.h) ===
+
+    VkLruCache<VkProfile, VK_PROFILE_CACHE> profileCache;
+    for (int i = 0; i < VK_PROFILE_CACHE; i++) {
+        VkProfile& p = profileCache.put(100 + i);
+        p.id = 100 + i;
+        VkProfile::copyName(p.first_name, "Александр");
+    }
+    int profileId = 0;
+    bench.run("profiles/lru-hit", [&] {
+        const VkProfile* p = profileCache.find(100 + (profileId++ % VK_PROFILE_CACHE));
+        dispatched += p ? p->id : 0;
+    });
+    bench.run("profiles/lru-miss+put", [&] {
+        long long id = 1000 + profileId++;
+        if (!profileCache.find(id)) {
+            VkProfile& p = profileCache.put(id);
+            p.id = (int)id;
+            VkProfile::copyName(p.first_name, "Екатерина");
+        }
+    });
+
+    // === Кольца сетевой задачи (DGO_VKring.h) ===
+
+    VkRing<VkUpdate, VK_TASK_EVENTS> updateRing;
+    VkUpdate ringItem;
+    ringItem.type = VK_MESSAGE_NEW;
+    ringItem.message.peer_id = 123456789;
+    ringItem.message.text = "Привет, бот! Включи свет на кухне";
+    bench.run("ring/update-push+pop", [&] {
+        updateRing.push(ringItem);
+        updateRing.pop(ringItem);
+    });
+
+    // Писатель в этом потоке, читатель - в другом, как сеть и loop() на ESP32
+    // (ожидание через yield(), чтобы замер имел смысл и на одном ядре)
+    VkRing<VkSendResult, VK_TASK_EVENTS> resultRing;
+    std::atomic<bool> consumerStop(false);
+    std::atomic<uint64_t> consumed(0);
+    uint64_t produced = 0;
+    std::thread consumer([&] {
+        VkSendResult r;
+        while (!consumerStop) {
+            if (resultRing.pop(r)) {
+                consumed.fetch_add(1, std::memory_order_release);
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    bench.run("ring/thread-transfer-1000", [&] {
+        for (int i = 0; i < 1000; i++) {
+            VkSendResult r = { (uint32_t)i, 123456789, i, 0, 0, 0, 0 };
+            while (!resultRing.push(r)) {
+                std::this_thread::yield();
+            }
+        }
+        produced += 1000;
+        while (consumed.load(std::memory_order_acquire) < produced) {
+            std::this_thread::yield();
+        }
+    });
+    consumerStop = true;
+    consumer.join();
+
+    // === Журнал (DGO_VKlog.h) ===
+
+    // Строка в кольцо и отправка в Print: столько стоит сообщение в горячем пути
+    VkNullPrint logOut;
+    vkLog().setOutput(logOut);
+    int logCode = 0;
+    bench.run("log/ring-write+drain", [&] {
+        VK_LOGI("Long Poll HTTP ошибка: %d, сервер %s", logCode++, "lp.vk.com");
+        vkLog().drain();
+    });
+    // Уровень ниже VK_LOG_LEVEL: вызова нет вовсе
+    bench.run("log/disabled-debug", [&] {
+        VK_LOGD("Long Poll: событий %u, ts %d", 0u, logCode++);
+    });
+    vkLog().setOutput(Serial);
+
+    // === Метрики ===
+
+    // Запись одного замера: столько стоит каждая точка измерения в боте
+    VkHistogram hist;
+    uint32_t sample = 0;
+    bench.run("metrics/histogram-record", [&] {
+        hist.record(sample);
+        sample = (sample * 1664525UL + 1013904223UL) >> 8;
+    });
+    bench.run("metrics/writeJson", [&] {
+        bot.writeMetricsJson(sink);
+    });
+    bench.run("metrics/getMetricsJson", [&] {
+        String json = bot.getMetricsJson();
+        dispatched += json.length();
+    });
+
+    // === Время ===
+
+    bot.setTimezone(3);
+    bench.run("time/getCurrentTimeString", [&] {
+        String s = bot.getCurrentTimeString();
+        dispatched += s.length();
+    });
+
+    // === Планировщик ===
+
+    VkScheduler scheduler;
+    for (uint8_t i = 0; i < VK_SCHEDULER_JOBS - 1; i++) {
+        scheduler.every(60000UL + i * 1000UL, [&] { dispatched++; });
+    }
+    bench.run("scheduler/run-idle", [&] {
+        scheduler.run();
+    });
+    bench.run("scheduler/after+run", [&] {
+        scheduler.after(0, [&] { dispatched++; });
+        scheduler.run();
+    });
+
+    printf("\n(контрольная сумма %lu)\n", dispatched + staticDispatched + sink.bytes);
+    if (heapFailures) {
+        printf("Статическая конфигурация обращалась к куче: %d\n", heapFailures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,1348 @@
+// VkMockServer.cpp - Реализация локального mock сервера VK
+
+#include "VkMockServer.h"
+
+#include <Arduino.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include <chrono>
+
+#define MOCK_MAX_UPDATES 100        // Больше событий в одном ответе VK не отдает
+#define MOCK_CHUNK_SIZE 100
+#define MOCK_IO_POLL 100            // Как часто потоки проверяют остановку, мс
+
+// === РАЗБОР ===
+
+static int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+static std::string urlDecode(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] == '+') {
+            out += ' ';
+        } else if (s[i] == '%' && i + 2 < s.size() && hexValue(s[i + 1]) >= 0 && hexValue(s[i + 2]) >= 0) {
+            out += (char)(hexValue(s[i + 1]) * 16 + hexValue(s[i + 2]));
+            i += 2;
+        } else {
+            out += s[i];
+        }
+    }
+    return out;
+}
+
+// a=1&b=2 -> params
+static void parseForm(const std::string& s, VkMockServer::Params& params) {
+    size_t start = 0;
+    while (start < s.size()) {
+        size_t amp = s.find('&', start);
+        if (amp == std::string::npos) amp = s.size();
+        std::string pair = s.substr(start, amp - start);
+        size_t eq = pair.find('=');
+        if (eq != std::string::npos) {
+            params[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq + 1));
+        } else if (!pair.empty()) {
+            params[urlDecode(pair)] = "";
+        }
+        start = amp + 1;
+    }
+}
+
+// Параметр заголовка: name="value" или name=value
+static std::string headerParam(const std::string& header, const std::string& name) {
+    size_t pos = header.find(name + "=");
+    if (pos == std::string::npos) return "";
+    pos += name.size() + 1;
+    if (pos < header.size() && header[pos] == '"') {
+        size_t end = header.find('"', pos + 1);
+        return header.substr(pos + 1, end == std::string::npos ? std::string::npos : end - pos - 1);
+    }
+    size_t end = header.find_first_of("; \r", pos);
+    return header.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+}
+
+// Часть multipart/form-data
+struct MultipartPart {
+    std::string name;
+    std::string filename;
+    std::string contentType;
+    std::string data;
+};
+
+static bool parseMultipart(const std::string& body, const std::string& boundary,
+                           std::vector<MultipartPart>& parts) {
+    if (boundary.empty()) return false;
+    std::string delim = "--" + boundary;
+    size_t pos = body.find(delim);
+    while (pos != std::string::npos) {
+        pos += delim.size();
+        if (body.compare(pos, 2, "--") == 0) {
+            return true;    // Последняя граница
+        }
+        if (body.compare(pos, 2, "\r\n") != 0) return false;
+        pos += 2;
+        size_t headEnd = body.find("\r\n\r\n", pos);
+        if (headEnd == std::string::npos) return false;
+
+        MultipartPart part;
+        size_t h = pos;
+        while (h < headEnd) {
+            size_t end = body.find("\r\n", h);
+            if (end == std::string::npos || end > headEnd) end = headEnd;
+            std::string line = body.substr(h, end - h);
+            if (strncasecmp(line.c_str(), "Content-Disposition:", 20) == 0) {
+                part.name = headerParam(line, "name");
+                part.filename = headerParam(line, "filename");
+            } else if (strncasecmp(line.c_str(), "Content-Type:", 13) == 0) {
+                part.contentType = line.substr(13);
+                while (!part.contentType.empty() && part.contentType[0] == ' ') part.contentType.erase(0, 1);
+            }
+            h = end + 2;
+        }
+
+        size_t dataStart = headEnd + 4;
+        size_t next = body.find("\r\n" + delim, dataStart);
+        if (next == std::string::npos) return false;
+        part.data = body.substr(dataStart, next - dataStart);
+        parts.push_back(part);
+        pos = next + 2;
+    }
+    return false;
+}
+
+static void appendUtf8(std::string& out, unsigned cp) {
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | cp >> 6);
+        out += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += (char)(0xE0 | cp >> 12);
+        out += (char)(0x80 | (cp >> 6 & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xF0 | cp >> 18);
+        out += (char)(0x80 | (cp >> 12 & 0x3F));
+        out += (char)(0x80 | (cp >> 6 & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+static void skipSpaces(const std::string& s, size_t& i) {
+    while (i < s.size() && isspace((unsigned char)s[i])) i++;
+}
+
+static bool parseJsonString(const std::string& s, size_t& i, std::string& out) {
+    if (i >= s.size() || s[i] != '"') return false;
+    i++;
+    out.clear();
+    while (i < s.size() && s[i] != '"') {
+        char c = s[i++];
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (i >= s.size()) return false;
+        char e = s[i++];
+        switch (e) {
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                if (i + 4 > s.size()) return false;
+                unsigned cp = (unsigned)strtoul(s.substr(i, 4).c_str(), nullptr, 16);
+                i += 4;
+                // Суррогатная пара
+                if (cp >= 0xD800 && cp < 0xDC00 && i + 6 <= s.size() && s[i] == '\\' && s[i + 1] == 'u') {
+                    unsigned lo = (unsigned)strtoul(s.substr(i + 2, 4).c_str(), nullptr, 16);
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    i += 6;
+                }
+                appendUtf8(out, cp);
+                break;
+            }
+            default: out += e;
+        }
+    }
+    if (i >= s.size()) return false;
+    i++;
+    return true;
+}
+
+// Значение без разбора: число, true/false или вложенный объект/массив как есть
+static bool skipJsonValue(const std::string& s, size_t& i, std::string& raw) {
+    size_t start = i;
+    int depth = 0;
+    std::string tmp;
+    while (i < s.size()) {
+        char c = s[i];
+        if (c == '"') {
+            if (!parseJsonString(s, i, tmp)) return false;
+            continue;
+        }
+        if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (depth == 0) break;
+            depth--;
+        } else if (c == ',' && depth == 0) {
+            break;
+        }
+        i++;
+    }
+    raw = s.substr(start, i - start);
+    while (!raw.empty() && isspace((unsigned char)raw.back())) raw.pop_back();
+    return depth == 0;
+}
+
+// Объект {"ключ": значение, ...} из аргументов API.метод(...) в execute
+static bool parseJsonObject(const std::string& s, size_t& i, VkMockServer::Params& params) {
+    skipSpaces(s, i);
+    if (i >= s.size() || s[i] != '{') return false;
+    i++;
+    while (true) {
+        skipSpaces(s, i);
+        if (i < s.size() && s[i] == '}') {
+            i++;
+            return true;
+        }
+        std::string key;
+        std::string value;
+        if (!parseJsonString(s, i, key)) return false;
+        skipSpaces(s, i);
+        if (i >= s.size() || s[i] != ':') return false;
+        i++;
+        skipSpaces(s, i);
+        if (i < s.size() && s[i] == '"') {
+            if (!parseJsonString(s, i, value)) return false;
+        } else if (!skipJsonValue(s, i, value)) {
+            return false;
+        }
+        params[key] = value;
+        skipSpaces(s, i);
+        if (i < s.size() && s[i] == ',') {
+            i++;
+        }
+    }
+}
+
+std::string vkMockJsonString(const std::string& text) {
+    std::string out = "\"";
+    for (size_t i = 0; i < text.size(); i++) {
+        unsigned char c = (unsigned char)text[i];
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char esc[8];
+                    snprintf(esc, sizeof(esc), "\\u%04x", c);
+                    out += esc;
+                } else {
+                    out += (char)c;
+                }
+        }
+    }
+    out += '"';
+    return out;
+}
+
+static const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 500: return "Internal Server Error";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        default:  return "Error";
+    }
+}
+
+static const char* errorText(int code) {
+    switch (code) {
+        case 3:  return "Unknown method passed";
+        case 5:  return "User authorization failed: no access_token passed.";
+        case 6:  return "Too many requests per second";
+        case 9:  return "Flood control";
+        case 10: return "Internal server error";
+        case 12: return "Unable to compile code";
+        case 100: return "One of the parameters specified was missing or invalid";
+        case 113: return "Invalid user id";
+        case 901: return "Can't send messages for users without permission";
+        case 909: return "Can't edit this message, because it's too old";
+        case 917: return "You don't have access to this chat";
+        default: return "Mock error";
+    }
+}
+
+static bool sendAll(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::send(fd, data.data() + done, data.size() - done, MSG_NOSIGNAL);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            return false;
+        }
+        done += (size_t)n;
+    }
+    return true;
+}
+
+// === СЕРВЕР ===
+
+VkMockServer::VkMockServer()
+    : listenFd(-1), listenPort(0), running(false), activeWorkers(0),
+      keySerial(0), incomingId(0), uploadsTaken(0), rateLimit(0), nextMessageId(1),
+      chunked(false), log(false), maxWait(25), latencyMs(0), skewPpm(0), skewOffsetMs(0),
+      clockStart(std::chrono::system_clock::now()) {
+    memset(&counters, 0, sizeof(counters));
+    group(DEFAULT_GROUP);
+}
+
+VkMockServer::~VkMockServer() {
+    stop();
+}
+
+uint16_t VkMockServer::start(uint16_t port) {
+    if (running) {
+        return listenPort;
+    }
+
+    listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        return 0;
+    }
+    int one = 1;
+    ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t len = sizeof(addr);
+    if (::bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+        ::listen(listenFd, 64) != 0 ||
+        ::getsockname(listenFd, (sockaddr*)&addr, &len) != 0) {
+        ::close(listenFd);
+        listenFd = -1;
+        return 0;
+    }
+
+    listenPort = ntohs(addr.sin_port);
+    running = true;
+    acceptThread = std::thread(&VkMockServer::acceptLoop, this);
+    return listenPort;
+}
+
+void VkMockServer::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    cv.notify_all();
+    if (acceptThread.joinable()) {
+        acceptThread.join();
+    }
+    ::close(listenFd);
+    listenFd = -1;
+
+    std::unique_lock<std::mutex> lock(mtx);
+    for (size_t i = 0; i < clientFds.size(); i++) {
+        ::shutdown(clientFds[i], SHUT_RDWR);
+    }
+    cv.notify_all();
+    cv.wait(lock, [this] { return activeWorkers == 0; });
+}
+
+void VkMockServer::acceptLoop() {
+    while (running) {
+        pollfd p;
+        p.fd = listenFd;
+        p.events = POLLIN;
+        p.revents = 0;
+        if (::poll(&p, 1, MOCK_IO_POLL) <= 0) {
+            continue;
+        }
+        int fd = ::accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(mtx);
+        counters.connections++;
+        clientFds.push_back(fd);
+        activeWorkers++;
+        std::thread(&VkMockServer::serveClient, this, fd).detach();
+    }
+}
+
+// Обслуживание одного keep-alive соединения
+void VkMockServer::serveClient(int fd) {
+    std::string buf;
+    Request req;
+    while (running && readRequest(fd, buf, req)) {
+        Response resp;
+        if (log) {
+            printf("[mock] %s %s\n", req.method.c_str(), req.path.c_str());
+        }
+
+        if (req.path == "/lp") {
+            resp = handleLongPoll(DEFAULT_GROUP, req.params);
+        } else if (req.path.compare(0, 4, "/lp/") == 0) {
+            resp = handleLongPoll(atoll(req.path.c_str() + 4), req.params);
+        } else if (req.path.compare(0, 8, "/method/") == 0) {
+            resp = handleApi(req.path.substr(8), req.params);
+        } else if (req.path.compare(0, 8, "/upload/") == 0) {
+            resp = handleUpload(req.path.substr(8), req);
+        } else {
+            resp.status = 404;
+            resp.body = "{}";
+            resp.drop = false;
+            resp.close = false;
+        }
+
+        if (resp.drop) {
+            holdUntilClosed(fd);
+            break;
+        }
+        int latency;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            latency = latencyMs;
+        }
+        if (latency > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(latency));
+        }
+        if (!writeResponse(fd, resp) || resp.close || req.close) {
+            break;
+        }
+    }
+
+    ::close(fd);
+    std::lock_guard<std::mutex> lock(mtx);
+    for (size_t i = 0; i < clientFds.size(); i++) {
+        if (clientFds[i] == fd) {
+            clientFds.erase(clientFds.begin() + i);
+            break;
+        }
+    }
+    activeWorkers--;
+    cv.notify_all();
+}
+
+bool VkMockServer::readRequest(int fd, std::string& buf, Request& req) {
+    size_t headerEnd;
+    while ((headerEnd = buf.find("\r\n\r\n")) == std::string::npos) {
+        pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+        int r = ::poll(&p, 1, MOCK_IO_POLL);
+        if (!running) return false;
+        if (r <= 0) continue;
+
+        char tmp[4096];
+        ssize_t n = ::recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) return false;
+        buf.append(tmp, (size_t)n);
+    }
+
+    // Строка запроса: GET /path?query HTTP/1.1
+    std::string head = buf.substr(0, headerEnd);
+    size_t lineEnd = head.find("\r\n");
+    std::string line = head.substr(0, lineEnd);
+    size_t sp1 = line.find(' ');
+    size_t sp2 = line.find(' ', sp1 + 1);
+    if (sp1 == std::string::npos || sp2 == std::string::npos) return false;
+
+    req.method = line.substr(0, sp1);
+    std::string target = line.substr(sp1 + 1, sp2 - sp1 - 1);
+    req.params.clear();
+    req.contentType.clear();
+    req.body.clear();
+    req.close = line.compare(sp2 + 1, 8, "HTTP/1.1") != 0;
+
+    size_t q = target.find('?');
+    req.path = target.substr(0, q);
+    if (q != std::string::npos) {
+        parseForm(target.substr(q + 1), req.params);
+    }
+
+    // Заголовки
+    size_t contentLength = 0;
+    size_t pos = lineEnd == std::string::npos ? head.size() : lineEnd + 2;
+    while (pos < head.size()) {
+        size_t end = head.find("\r\n", pos);
+        if (end == std::string::npos) end = head.size();
+        std::string h = head.substr(pos, end - pos);
+        size_t colon = h.find(':');
+        if (colon != std::string::npos) {
+            std::string name = h.substr(0, colon);
+            std::string value = h.substr(colon + 1);
+            while (!value.empty() && value[0] == ' ') value.erase(0, 1);
+            if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+                contentLength = (size_t)atol(value.c_str());
+            } else if (strcasecmp(name.c_str(), "Connection") == 0) {
+                req.close = strncasecmp(value.c_str(), "close", 5) == 0;
+            } else if (strcasecmp(name.c_str(), "Content-Type") == 0) {
+                req.contentType = value;
+            }
+        }
+        pos = end + 2;
+    }
+
+    // Тело
+    size_t total = headerEnd + 4 + contentLength;
+    while (buf.size() < total) {
+        char tmp[4096];
+        pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+        int r = ::poll(&p, 1, MOCK_IO_POLL);
+        if (!running) return false;
+        if (r <= 0) continue;
+        ssize_t n = ::recv(fd, tmp, sizeof(tmp), 0);
+        if (n <= 0) return false;
+        buf.append(tmp, (size_t)n);
+    }
+    if (req.contentType.compare(0, 19, "multipart/form-data") == 0) {
+        req.body = buf.substr(headerEnd + 4, contentLength);
+    } else {
+        parseForm(buf.substr(headerEnd + 4, contentLength), req.params);
+    }
+    buf.erase(0, total);
+    return true;
+}
+
+bool VkMockServer::writeResponse(int fd, const Response& resp) {
+    char date[64];
+    time_t now = (time_t)(serverTimeMs() / 1000);
+    struct tm tmv;
+    gmtime_r(&now, &tmv);
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tmv);
+
+    char head[256];
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 %d %s\r\n"
+             "Server: vk-mock\r\n"
+             "Date: %s\r\n"
+             "Content-Type: application/json; charset=utf-8\r\n"
+             "Connection: %s\r\n",
+             resp.status, statusText(resp.status), date, resp.close ? "close" : "keep-alive");
+    std::string out = head;
+
+    if (chunked) {
+        out += "Transfer-Encoding: chunked\r\n\r\n";
+        for (size_t i = 0; i < resp.body.size(); i += MOCK_CHUNK_SIZE) {
+            size_t n = resp.body.size() - i < MOCK_CHUNK_SIZE ? resp.body.size() - i : MOCK_CHUNK_SIZE;
+            char size[16];
+            snprintf(size, sizeof(size), "%zx\r\n", n);
+            out += size;
+            out.append(resp.body, i, n);
+            out += "\r\n";
+        }
+        out += "0\r\n\r\n";
+    } else {
+        char length[48];
+        snprintf(length, sizeof(length), "Content-Length: %zu\r\n\r\n", resp.body.size());
+        out += length;
+        out += resp.body;
+    }
+    return sendAll(fd, out);
+}
+
+// "Таймаут": запрос принят, но ответа нет, пока клиент сам не закроет соединение
+void VkMockServer::holdUntilClosed(int fd) {
+    char tmp[256];
+    while (running) {
+        pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+        if (::poll(&p, 1, MOCK_IO_POLL) > 0 && ::recv(fd, tmp, sizeof(tmp), 0) <= 0) {
+            return;
+        }
+    }
+}
+
+VkMockServer::Response VkMockServer::json(const std::string& body) {
+    Response resp;
+    resp.status = 200;
+    resp.body = body;
+    resp.drop = false;
+    resp.close = false;
+    return resp;
+}
+
+std::string VkMockServer::errorJson(int code) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "{\"error_code\":%d,\"error_msg\":", code);
+    return std::string(buf) + vkMockJsonString(errorText(code)) + ",\"request_params\":[]}";
+}
+
+void VkMockServer::rotateKey(Group& g) {
+    char key[32];
+    snprintf(key, sizeof(key), "mockkey%d", ++keySerial);
+    g.key = key;
+}
+
+// Группа создается при первом обращении (вызывать под mtx)
+VkMockServer::Group& VkMockServer::group(long long id) {
+    std::map<long long, Group>::iterator it = groups.find(id);
+    if (it != groups.end()) {
+        return it->second;
+    }
+    Group& g = groups[id];
+    rotateKey(g);
+    return g;
+}
+
+// === LONG POLL ===
+
+VkMockServer::Response VkMockServer::handleLongPoll(long long groupId, const Params& params) {
+    std::unique_lock<std::mutex> lock(mtx);
+    counters.lpRequests++;
+    Group& g = group(groupId);
+    std::vector<std::string>& events = g.events;
+
+    Params::const_iterator it = params.find("key");
+    std::string key = it != params.end() ? it->second : "";
+    it = params.find("ts");
+    long long ts = it != params.end() ? atoll(it->second.c_str()) : 0;
+    it = params.find("wait");
+    int wait = it != params.end() ? atoi(it->second.c_str()) : 0;
+    if (wait > maxWait) wait = maxWait;
+
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now() + std::chrono::seconds(wait);
+    char buf[96];
+
+    while (true) {
+        if (!g.actions.empty()) {
+            Action a = g.actions.front();
+            g.actions.pop_front();
+
+            if (a.type == ACT_TIMEOUT) {
+                Response resp = json("");
+                resp.drop = true;
+                return resp;
+            }
+            if (a.type == ACT_HTTP_ERROR) {
+                Response resp = json("{\"error\":\"mock\"}");
+                resp.status = a.code;
+                return resp;
+            }
+            if (a.code == 1) {
+                snprintf(buf, sizeof(buf), "{\"failed\":1,\"ts\":\"%zu\"}", a.ts);
+                return json(buf);
+            }
+            rotateKey(g);
+            snprintf(buf, sizeof(buf), "{\"failed\":%d}", a.code);
+            return json(buf);
+        }
+
+        if (key != g.key) {
+            return json("{\"failed\":2}");
+        }
+
+        // События с номера ts
+        if (ts >= 1 && (size_t)ts <= events.size()) {
+            size_t from = (size_t)ts - 1;
+            size_t to = events.size();
+            if (to - from > MOCK_MAX_UPDATES) to = from + MOCK_MAX_UPDATES;
+
+            snprintf(buf, sizeof(buf), "{\"ts\":\"%zu\",\"updates\":[", to + 1);
+            std::string body = buf;
+            for (size_t i = from; i < to; i++) {
+                if (i > from) body += ',';
+                body += events[i];
+            }
+            body += "]}";
+            return json(body);
+        }
+
+        // Событий нет: держим запрос до wait секунд, как настоящий сервер
+        if (!running || cv.wait_until(lock, deadline) == std::cv_status::timeout) {
+            bool ready = !g.actions.empty() || (ts >= 1 && (size_t)ts <= events.size());
+            if (!ready || !running) {
+                snprintf(buf, sizeof(buf), "{\"ts\":\"%lld\",\"updates\":[]}", ts);
+                return json(buf);
+            }
+        }
+    }
+}
+
+void VkMockServer::pushMessage(long long peerId, long long fromId, const std::string& text,
+                               long long groupId) {
+    pushButton(peerId, fromId, text, "", groupId);
+}
+
+void VkMockServer::pushButton(long long peerId, long long fromId, const std::string& text,
+                              const std::string& payload, long long groupId) {
+    char head[256];
+    int id;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        id = ++incomingId;
+    }
+    snprintf(head, sizeof(head),
+             "{\"group_id\":%lld,\"type\":\"message_new\",\"event_id\":\"mock%d\",\"v\":\"5.199\","
+             "\"object\":{\"message\":{\"date\":%ld,\"from_id\":%lld,\"id\":%d,\"out\":0,"
+             "\"peer_id\":%lld,\"conversation_message_id\":%d,\"attachments\":[],",
+             groupId, id, (long)(serverTimeMs() / 1000), fromId, id, peerId, id);
+    // Как у VK: payload кнопки приходит в сообщении строкой
+    std::string body = head;
+    if (!payload.empty()) {
+        body += "\"payload\":" + vkMockJsonString(payload) + ",";
+    }
+    pushEvent(body + "\"text\":" + vkMockJsonString(text) +
+              "},\"client_info\":{\"keyboard\":true,\"inline_keyboard\":true,\"lang_id\":0}}}", groupId);
+}
+
+std::string VkMockServer::pushCallback(long long peerId, long long userId, const std::string& payload,
+                                       long long groupId) {
+    char head[256];
+    char eventId[32];
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        int id = ++incomingId;
+        snprintf(eventId, sizeof(eventId), "ev%08x", (unsigned)(id * 2654435761u));
+        pendingEvents.insert(eventId);
+        snprintf(head, sizeof(head),
+                 "{\"group_id\":%lld,\"type\":\"message_event\",\"event_id\":\"mock%d\",\"v\":\"5.199\","
+                 "\"object\":{\"user_id\":%lld,\"peer_id\":%lld,\"event_id\":\"%s\",\"payload\":",
+                 groupId, id, userId, peerId, eventId);
+    }
+    pushEvent(std::string(head) + (payload.empty() ? "{}" : payload) +
+              ",\"conversation_message_id\":1}}", groupId);
+    return eventId;
+}
+
+void VkMockServer::pushEvent(const std::string& updateJson, long long groupId) {
+    std::lock_guard<std::mutex> lock(mtx);
+    group(groupId).events.push_back(updateJson);
+    cv.notify_all();
+}
+
+void VkMockServer::pushFailed(int code) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Group& g = group(DEFAULT_GROUP);
+    Action a = { ACT_FAILED, code, g.events.size() + 1 };
+    g.actions.push_back(a);
+    cv.notify_all();
+}
+
+void VkMockServer::pushTimeout() {
+    std::lock_guard<std::mutex> lock(mtx);
+    Action a = { ACT_TIMEOUT, 0, 0 };
+    group(DEFAULT_GROUP).actions.push_back(a);
+    cv.notify_all();
+}
+
+void VkMockServer::pushHttpError(int status) {
+    std::lock_guard<std::mutex> lock(mtx);
+    Action a = { ACT_HTTP_ERROR, status, 0 };
+    group(DEFAULT_GROUP).actions.push_back(a);
+    cv.notify_all();
+}
+
+// === API ===
+
+bool VkMockServer::rateLimited() {
+    if (rateLimit == 0) {
+        return false;
+    }
+    unsigned long now = millis();
+    while (!callTimes.empty() && now - callTimes.front() >= 1000) {
+        callTimes.pop_front();
+    }
+    if (callTimes.size() >= rateLimit) {
+        return true;
+    }
+    callTimes.push_back(now);
+    return false;
+}
+
+VkMockServer::Response VkMockServer::handleApi(const std::string& method, const Params& params) {
+    std::lock_guard<std::mutex> lock(mtx);
+    counters.apiRequests++;
+
+    if (rateLimited()) {
+        counters.apiErrors++;
+        return json("{\"error\":" + errorJson(6) + "}");
+    }
+    Params::const_iterator token = params.find("access_token");
+    if (token == params.end() || token->second.empty()) {
+        counters.apiErrors++;
+        return json("{\"error\":" + errorJson(5) + "}");
+    }
+
+    if (method == "execute") {
+        counters.executeRequests++;
+        Params::const_iterator code = params.find("code");
+        return handleExecute(code != params.end() ? code->second : "", token->second);
+    }
+
+    std::string result;
+    int error = callMethod(method, params, token->second, result);
+    if (error) {
+        counters.apiErrors++;
+        return json("{\"error\":" + errorJson(error) + "}");
+    }
+    return json("{\"response\":" + result + "}");
+}
+
+// execute: разбираем только вызовы вида API.метод({...}) из кода бота
+VkMockServer::Response VkMockServer::handleExecute(const std::string& code, const std::string& token) {
+    std::string results;
+    std::string errors;
+    size_t pos = 0;
+    int calls = 0;
+
+    while ((pos = code.find("API.", pos)) != std::string::npos) {
+        pos += 4;
+        size_t paren = code.find('(', pos);
+        if (paren == std::string::npos) break;
+        std::string method = code.substr(pos, paren - pos);
+
+        Params params;
+        size_t i = paren + 1;
+        if (!parseJsonObject(code, i, params)) {
+            counters.apiErrors++;
+            return json("{\"error\":" + errorJson(12) + "}");
+        }
+        pos = i;
+
+        std::string result;
+        int error = callMethod(method, params, token, result, true);
+        if (calls++ > 0) results += ',';
+        if (error) {
+            counters.apiErrors++;
+            results += "false";
+            if (!errors.empty()) errors += ',';
+            char buf[64];
+            snprintf(buf, sizeof(buf), "{\"method\":%s,\"error_code\":%d,\"error_msg\":",
+                     vkMockJsonString(method).c_str(), error);
+            errors += std::string(buf) + vkMockJsonString(errorText(error)) + "}";
+        } else {
+            results += result;
+        }
+    }
+
+    std::string body = "{\"response\":[" + results + "]";
+    if (!errors.empty()) {
+        body += ",\"execute_errors\":[" + errors + "]";
+    }
+    body += "}";
+    return json(body);
+}
+
+int VkMockServer::callMethod(const std::string& method, const Params& params, const std::string& token,
+                             std::string& result, bool viaExecute) {
+    std::map<std::string, std::deque<int> >::iterator scripted = apiErrors.find(method);
+    if (scripted != apiErrors.end() && !scripted->second.empty()) {
+        int code = scripted->second.front();
+        scripted->second.pop_front();
+        return code;
+    }
+
+    char buf[160];
+    if (method == "groups.getLongPollServer") {
+        counters.lpServerRequests++;
+        Params::const_iterator id = params.find("group_id");
+        long long groupId = id != params.end() ? atoll(id->second.c_str()) : DEFAULT_GROUP;
+        Group& g = group(groupId);
+        snprintf(buf, sizeof(buf), "{\"key\":\"%s\",\"server\":\"http://127.0.0.1:%u/lp/%lld\",\"ts\":\"%zu\"}",
+                 g.key.c_str(), (unsigned)listenPort, groupId, g.events.size() + 1);
+        result = buf;
+        return 0;
+    }
+    if (method == "messages.send") {
+        return sendMessage(params, token, viaExecute, result);
+    }
+    if (method == "messages.edit") {
+        return editMessage(params, result);
+    }
+    if (method == "photos.getMessagesUploadServer" || method == "docs.getMessagesUploadServer") {
+        bool photo = method[0] == 'p';
+        snprintf(buf, sizeof(buf), "{\"upload_url\":\"http://127.0.0.1:%u/upload/%s?act=do_add\"%s}",
+                 (unsigned)listenPort, photo ? "photo" : "doc", photo ? ",\"album_id\":-64" : "");
+        result = buf;
+        return 0;
+    }
+    if (method == "photos.saveMessagesPhoto") {
+        return savePhoto(params, result);
+    }
+    if (method == "docs.save") {
+        return saveDoc(params, result);
+    }
+    if (method == "users.get") {
+        return usersGet(params, result);
+    }
+    if (method == "messages.getConversationMembers") {
+        return conversationMembers(params, result);
+    }
+    if (method == "messages.sendMessageEventAnswer") {
+        return answerEvent(params, viaExecute, result);
+    }
+    if (method == "utils.getServerTime") {
+        snprintf(buf, sizeof(buf), "%ld", (long)(serverTimeMs() / 1000));
+        result = buf;
+        return 0;
+    }
+    return 3;
+}
+
+int VkMockServer::sendMessage(const Params& params, const std::string& token, bool viaExecute,
+                              std::string& result) {
+    Params::const_iterator peer = params.find("peer_id");
+    Params::const_iterator peers = params.find("peer_ids");
+    Params::const_iterator random = params.find("random_id");
+    Params::const_iterator text = params.find("message");
+    Params::const_iterator attachment = params.find("attachment");
+    if (peer == params.end() && peers == params.end()) {
+        return 100;
+    }
+
+    SentMessage msg;
+    msg.randomId = random != params.end() ? atoll(random->second.c_str()) : 0;
+    msg.text = text != params.end() ? text->second : "";
+    msg.atMs = millis();
+    msg.viaExecute = viaExecute;
+    msg.token = token;
+    msg.attachment = attachment != params.end() ? attachment->second : "";
+    Params::const_iterator keyboard = params.find("keyboard");
+    msg.keyboard = keyboard != params.end() ? keyboard->second : "";
+
+    char buf[128];
+    if (peers == params.end()) {
+        msg.peerId = atoll(peer->second.c_str());
+        if (deniedPeers.count(msg.peerId)) {
+            return 901;
+        }
+        snprintf(buf, sizeof(buf), "%d", storeMessage(msg));
+        result = buf;
+        return 0;
+    }
+
+    // Как VK: до 100 получателей через запятую, ответ - объект на каждого
+    std::vector<long long> ids;
+    const std::string& list = peers->second;
+    for (size_t start = 0; start < list.size();) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        ids.push_back(atoll(list.substr(start, comma - start).c_str()));
+        start = comma + 1;
+    }
+    if (ids.empty() || ids.size() > 100) {
+        return 100;
+    }
+    counters.multiSends++;
+    result = "[";
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (i > 0) result += ',';
+        msg.peerId = ids[i];
+        if (deniedPeers.count(msg.peerId)) {
+            snprintf(buf, sizeof(buf), "{\"peer_id\":%lld,\"error\":{\"code\":901,\"description\":", msg.peerId);
+            result += std::string(buf) + vkMockJsonString(errorText(901)) + "}}";
+            continue;
+        }
+        int id = storeMessage(msg);
+        snprintf(buf, sizeof(buf), "{\"peer_id\":%lld,\"message_id\":%d,\"conversation_message_id\":%d}",
+                 msg.peerId, id, id);
+        result += buf;
+    }
+    result += "]";
+    return 0;
+}
+
+// Записать сообщение одному получателю, возвращает его message_id
+// Как VK: повтор с тем же random_id не создает новое сообщение
+int VkMockServer::storeMessage(SentMessage& msg) {
+    std::pair<long long, long long> dedup(msg.peerId, msg.randomId);
+    std::map<std::pair<long long, long long>, int>::iterator seen = randomIds.find(dedup);
+    if (msg.randomId != 0 && seen != randomIds.end()) {
+        counters.duplicates++;
+        msg.messageId = seen->second;
+        return msg.messageId;
+    }
+    msg.messageId = nextMessageId++;
+    if (msg.randomId != 0) {
+        randomIds[dedup] = msg.messageId;
+    }
+    counters.sentMessages++;
+    texts[std::make_pair(msg.peerId, msg.messageId)] = msg.text;
+    sent.push_back(msg);
+    cv.notify_all();
+    if (log) {
+        printf("[mock] -> %lld: %s%s%s\n", msg.peerId, msg.text.c_str(),
+               msg.attachment.empty() ? "" : " + ", msg.attachment.c_str());
+    }
+    return msg.messageId;
+}
+
+// Как VK: править можно только свое сообщение, найденное по peer_id и conversation_message_id
+int VkMockServer::editMessage(const Params& params, std::string& result) {
+    Params::const_iterator peer = params.find("peer_id");
+    Params::const_iterator cmid = params.find("conversation_message_id");
+    Params::const_iterator text = params.find("message");
+    if (peer == params.end() || cmid == params.end()) {
+        return 100;
+    }
+    std::map<std::pair<long long, int>, std::string>::iterator it =
+        texts.find(std::make_pair(atoll(peer->second.c_str()), atoi(cmid->second.c_str())));
+    if (it == texts.end()) {
+        return 100;
+    }
+    it->second = text != params.end() ? text->second : "";
+    counters.edits++;
+    cv.notify_all();
+    if (log) {
+        printf("[mock] edit %s/%s: %s\n", peer->second.c_str(), cmid->second.c_str(), it->second.c_str());
+    }
+    result = "1";
+    return 0;
+}
+
+// Как VK: на каждое нажатие отвечают один раз, чужой или повторный event_id - ошибка 100
+int VkMockServer::answerEvent(const Params& params, bool viaExecute, std::string& result) {
+    Params::const_iterator eventId = params.find("event_id");
+    Params::const_iterator user = params.find("user_id");
+    Params::const_iterator peer = params.find("peer_id");
+    if (eventId == params.end() || user == params.end() || peer == params.end() ||
+        pendingEvents.erase(eventId->second) == 0) {
+        return 100;
+    }
+    EventAnswer answer;
+    answer.eventId = eventId->second;
+    answer.userId = atoll(user->second.c_str());
+    answer.peerId = atoll(peer->second.c_str());
+    Params::const_iterator data = params.find("event_data");
+    answer.eventData = data != params.end() ? data->second : "";
+    answer.atMs = millis();
+    answer.viaExecute = viaExecute;
+    answers.push_back(answer);
+    counters.eventAnswers++;
+    cv.notify_all();
+    if (log) {
+        printf("[mock] answer %s -> %lld %s\n", answer.eventId.c_str(), answer.userId, answer.eventData.c_str());
+    }
+    result = "1";
+    return 0;
+}
+
+// === ПРОФИЛИ ===
+
+void VkMockServer::setChatMembers(long long peerId, const std::vector<long long>& users, long long admin) {
+    std::lock_guard<std::mutex> lock(mtx);
+    chatMembers[peerId] = users;
+    chatAdmins[peerId] = admin;
+}
+
+void VkMockServer::denyMessages(long long peerId) {
+    std::lock_guard<std::mutex> lock(mtx);
+    deniedPeers.insert(peerId);
+}
+
+std::string VkMockServer::firstName(long long userId) {
+    static const char* const names[] = {
+        "Анна", "Иван", "Мария", "Пётр", "Ольга", "Александр", "Екатерина", "Дмитрий"
+    };
+    return names[(userId < 0 ? -userId : userId) % 8];
+}
+
+static std::string mockProfile(long long id) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "{\"id\":%lld,\"first_name\":", id);
+    std::string out = buf;
+    out += vkMockJsonString(VkMockServer::firstName(id));
+    snprintf(buf, sizeof(buf), ",\"last_name\":\"N%lld\",\"sex\":%d,\"can_access_closed\":true}",
+             id, id % 2 ? 2 : 1);
+    return out + buf;
+}
+
+// users.get: user_ids через запятую, отрицательные и нулевые id VK пропускает
+int VkMockServer::usersGet(const Params& params, std::string& result) {
+    counters.usersGet++;
+    Params::const_iterator ids = params.find("user_ids");
+    if (ids == params.end()) {
+        return 100;
+    }
+    result = "[";
+    const char* p = ids->second.c_str();
+    bool first = true;
+    while (*p) {
+        char* end;
+        long long id = strtoll(p, &end, 10);
+        if (end == p) {
+            return 113;
+        }
+        if (id > 0) {
+            if (!first) result += ',';
+            result += mockProfile(id);
+            first = false;
+        }
+        p = *end == ',' ? end + 1 : end;
+    }
+    result += "]";
+    return 0;
+}
+
+int VkMockServer::conversationMembers(const Params& params, std::string& result) {
+    counters.memberRequests++;
+    Params::const_iterator peer = params.find("peer_id");
+    std::map<long long, std::vector<long long> >::iterator chat =
+        peer != params.end() ? chatMembers.find(atoll(peer->second.c_str())) : chatMembers.end();
+    if (chat == chatMembers.end()) {
+        return 917;
+    }
+    long long admin = chatAdmins[chat->first];
+    std::string items;
+    std::string profiles;
+    char buf[128];
+    for (size_t i = 0; i < chat->second.size(); i++) {
+        long long id = chat->second[i];
+        snprintf(buf, sizeof(buf), "%s{\"member_id\":%lld,\"invited_by\":%lld,\"join_date\":1700000000%s}",
+                 i ? "," : "", id, admin, id == admin ? ",\"is_admin\":true,\"is_owner\":true" : "");
+        items += buf;
+        if (id > 0) {
+            if (!profiles.empty()) profiles += ',';
+            profiles += mockProfile(id);
+        }
+    }
+    snprintf(buf, sizeof(buf), "{\"count\":%zu,\"items\":[", chat->second.size());
+    result = buf + items + "],\"profiles\":[" + profiles + "],\"groups\":[]}";
+    return 0;
+}
+
+// === ЗАГРУЗКА ФАЙЛОВ ===
+
+// Сервер загрузки: как у VK, отвечает данными для photos.saveMessagesPhoto/docs.save
+VkMockServer::Response VkMockServer::handleUpload(const std::string& kind, const Request& req) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!uploadErrors.empty()) {
+        Response resp = json("{\"error\":\"mock\"}");
+        resp.status = uploadErrors.front();
+        uploadErrors.pop_front();
+        return resp;
+    }
+
+    bool photo = kind == "photo";
+    if (!photo && kind != "doc") {
+        Response resp = json("{}");
+        resp.status = 404;
+        return resp;
+    }
+    std::vector<MultipartPart> parts;
+    const MultipartPart* file = nullptr;
+    if (parseMultipart(req.body, headerParam(req.contentType, "boundary"), parts)) {
+        for (size_t i = 0; i < parts.size(); i++) {
+            if (parts[i].name == (photo ? "photo" : "file")) {
+                file = &parts[i];
+            }
+        }
+    }
+    if (!file || file->data.empty()) {
+        return json(photo ? "{\"server\":0,\"photo\":\"[]\",\"hash\":\"\"}"
+                          : "{\"error\":\"no_file\",\"error_descr\":\"No file\"}");
+    }
+
+    Upload up;
+    up.id = (int)uploads.size() + 1;
+    up.kind = kind;
+    up.field = file->name;
+    up.filename = file->filename;
+    up.contentType = file->contentType;
+    up.data = file->data;
+    uploads.push_back(up);
+    counters.uploads++;
+    if (log) {
+        printf("[mock] upload %s %s: %zu bytes\n", kind.c_str(), up.filename.c_str(), up.data.size());
+    }
+
+    // photo - строка с JSON внутри, hash проверяется при сохранении
+    char buf[160];
+    if (photo) {
+        snprintf(buf, sizeof(buf), "{\"server\":777,\"photo\":\"[{\\\"photo\\\":\\\"mock%d\\\"}]\",\"hash\":\"hash%d\"}",
+                 up.id, up.id);
+    } else {
+        snprintf(buf, sizeof(buf), "{\"file\":\"file%d\"}", up.id);
+    }
+    return json(buf);
+}
+
+// Номер загрузки из значения вида <prefix><id>, 0 если такой загрузки нет
+static int uploadIdAfter(const std::string& value, const char* prefix, size_t count) {
+    size_t pos = value.find(prefix);
+    if (pos == std::string::npos) return 0;
+    int id = atoi(value.c_str() + pos + strlen(prefix));
+    return id >= 1 && (size_t)id <= count ? id : 0;
+}
+
+int VkMockServer::savePhoto(const Params& params, std::string& result) {
+    Params::const_iterator photo = params.find("photo");
+    Params::const_iterator hash = params.find("hash");
+    Params::const_iterator server = params.find("server");
+    if (photo == params.end() || hash == params.end() || server == params.end() || server->second != "777") {
+        return 100;
+    }
+    int id = uploadIdAfter(photo->second, "mock", uploads.size());
+    if (id == 0 || uploads[id - 1].kind != "photo" || hash->second != "hash" + std::to_string(id)) {
+        return 100;
+    }
+    char buf[160];
+    snprintf(buf, sizeof(buf), "[{\"album_id\":-64,\"date\":%ld,\"id\":%d,\"owner_id\":-%lld,"
+             "\"access_key\":\"key%d\",\"sizes\":[],\"text\":\"\"}]",
+             (long)(serverTimeMs() / 1000), id, DEFAULT_GROUP, id);
+    result = buf;
+    snprintf(buf, sizeof(buf), "photo-%lld_%d_key%d", DEFAULT_GROUP, id, id);
+    uploads[id - 1].attachment = buf;
+    return 0;
+}
+
+int VkMockServer::saveDoc(const Params& params, std::string& result) {
+    Params::const_iterator file = params.find("file");
+    if (file == params.end()) {
+        return 100;
+    }
+    int id = uploadIdAfter(file->second, "file", uploads.size());
+    if (id == 0 || uploads[id - 1].kind != "doc") {
+        return 100;
+    }
+    Params::const_iterator title = params.find("title");
+    const Upload& up = uploads[id - 1];
+    char buf[160];
+    snprintf(buf, sizeof(buf), "{\"type\":\"doc\",\"doc\":{\"id\":%d,\"owner_id\":-%lld,\"size\":%zu,\"title\":",
+             id, DEFAULT_GROUP, up.data.size());
+    result = std::string(buf) + vkMockJsonString(title != params.end() ? title->second : up.filename) + "}}";
+    snprintf(buf, sizeof(buf), "doc-%lld_%d", DEFAULT_GROUP, id);
+    uploads[id - 1].attachment = buf;
+    return 0;
+}
+
+void VkMockServer::pushUploadError(int status) {
+    std::lock_guard<std::mutex> lock(mtx);
+    uploadErrors.push_back(status);
+}
+
+void VkMockServer::pushApiError(const std::string& method, int code) {
+    std::lock_guard<std::mutex> lock(mtx);
+    apiErrors[method].push_back(code);
+}
+
+void VkMockServer::setRateLimit(unsigned perSecond) {
+    std::lock_guard<std::mutex> lock(mtx);
+    rateLimit = perSecond;
+    callTimes.clear();
+}
+
+void VkMockServer::setChunked(bool enable) {
+    std::lock_guard<std::mutex> lock(mtx);
+    chunked = enable;
+}
+
+void VkMockServer::setLog(bool enable) {
+    std::lock_guard<std::mutex> lock(mtx);
+    log = enable;
+}
+
+void VkMockServer::setMaxWait(int seconds) {
+    std::lock_guard<std::mutex> lock(mtx);
+    maxWait = seconds;
+}
+
+void VkMockServer::setLatency(int ms) {
+    std::lock_guard<std::mutex> lock(mtx);
+    latencyMs = ms;
+}
+
+void VkMockServer::setClockSkew(long ppm, long long offsetMs) {
+    // Переносим начало отсчета, чтобы время сервера не прыгнуло от смены скорости
+    long long now = serverTimeMs();
+    clockStart = std::chrono::system_clock::now();
+    skewOffsetMs = now + offsetMs - std::chrono::duration_cast<std::chrono::milliseconds>(
+        clockStart.time_since_epoch()).count();
+    skewPpm = ppm;
+}
+
+long long VkMockServer::serverTimeMs() {
+    std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+    long long real = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count();
+    long long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - clockStart).count();
+    return real + skewOffsetMs + elapsed * skewPpm / 1000000;
+}
+
+// === РЕЗУЛЬТАТЫ ===
+
+std::vector<VkMockServer::SentMessage> VkMockServer::takeSent() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<SentMessage> out;
+    out.swap(sent);
+    return out;
+}
+
+std::string VkMockServer::messageText(long long peerId, int conversationMessageId) {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::map<std::pair<long long, int>, std::string>::iterator it =
+        texts.find(std::make_pair(peerId, conversationMessageId));
+    return it != texts.end() ? it->second : std::string();
+}
+
+std::vector<VkMockServer::Upload> VkMockServer::takeUploads() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<Upload> out(uploads.begin() + uploadsTaken, uploads.end());
+    uploadsTaken = uploads.size();
+    return out;
+}
+
+std::vector<VkMockServer::EventAnswer> VkMockServer::takeAnswers() {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<EventAnswer> out;
+    out.swap(answers);
+    return out;
+}
+
+size_t VkMockServer::sentCount() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters.sentMessages;
+}
+
+size_t VkMockServer::pendingActions() {
+    std::lock_guard<std::mutex> lock(mtx);
+    size_t n = 0;
+    for (std::map<long long, Group>::const_iterator it = groups.begin(); it != groups.end(); it++) {
+        n += it->second.actions.size();
+    }
+    return n;
+}
+
+bool VkMockServer::waitSent(size_t count, unsigned long timeoutMs) {
+    std::unique_lock<std::mutex> lock(mtx);
+    return cv.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                       [this, count] { return counters.sentMessages >= count; });
+}
+
+VkMockServer::Stats VkMockServer::stats() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return counters;
+}
@@ -0,0 +1,263 @@
+// VkMockServer.h - Локальный mock сервер VK API и Long Poll
+// Отвечает на groups.getLongPollServer, a_check, messages.send, execute
+// и utils.getServerTime, принимает фото и документы (/upload/photo, /upload/doc).
+// Сценарий задается из кода или файлом (vk_mock_server)
+
+#ifndef VK_MOCK_SERVER_H
+#define VK_MOCK_SERVER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+class VkMockServer {
+public:
+    typedef std::map<std::string, std::string> Params;
+
+    // Сообщество по умолчанию (у каждой группы свой Long Poll сервер /lp/<id>)
+    static const long long DEFAULT_GROUP = 1;
+
+    // Сообщение, которое бот отправил через messages.send (напрямую или в execute)
+    struct SentMessage {
+        long long peerId;
+        long long randomId;
+        int messageId;
+        std::string text;
+        unsigned long atMs;     // millis() на момент приема
+        bool viaExecute;
+        std::string token;      // access_token запроса: по нему видно, от какой группы ответ
+        std::string attachment;
+        std::string keyboard;   // JSON клавиатуры как его передал бот
+    };
+
+    // Ответ бота на нажатие callback-кнопки (messages.sendMessageEventAnswer)
+    struct EventAnswer {
+        std::string eventId;
+        long long userId;
+        long long peerId;
+        std::string eventData;  // JSON уведомления, пусто - без уведомления
+        unsigned long atMs;
+        bool viaExecute;
+    };
+
+    // Файл, принятый сервером загрузки
+    struct Upload {
+        int id;
+        std::string kind;           // photo или doc
+        std::string field;          // Имя поля формы
+        std::string filename;
+        std::string contentType;
+        std::string data;
+        std::string attachment;     // Строка вложения после photos.saveMessagesPhoto/docs.save
+    };
+
+    struct Stats {
+        unsigned long connections;      // Принятые TCP соединения
+        unsigned long lpRequests;       // Запросы a_check
+        unsigned long lpServerRequests; // Вызовы groups.getLongPollServer
+        unsigned long apiRequests;      // HTTP запросы к /method/*
+        unsigned long executeRequests;
+        unsigned long sentMessages;     // Без повторов с тем же random_id
+        unsigned long duplicates;       // Повторы с уже виденным random_id
+        unsigned long apiErrors;        // Ответы с ошибкой (включая лимит)
+        unsigned long uploads;          // Принятые файлы
+        unsigned long eventAnswers;     // Ответы на callback-кнопки
+        unsigned long usersGet;         // Вызовы users.get
+        unsigned long memberRequests;   // Вызовы messages.getConversationMembers
+        unsigned long multiSends;       // Вызовы messages.send с peer_ids (рассылки)
+        unsigned long edits;            // Правки messages.edit
+    };
+
+    VkMockServer();
+    ~VkMockServer();
+
+    // Запустить сервер на 127.0.0.1 (port 0 - любой свободный), возвращает порт или 0
+    uint16_t start(uint16_t port = 0);
+    void stop();
+    uint16_t port() const { return listenPort; }
+
+    // === СЦЕНАРИЙ LONG POLL ===
+
+    // Новое входящее сообщение (событие message_new) в группу groupId
+    void pushMessage(long long peerId, long long fromId, const std::string& text,
+                     long long groupId = DEFAULT_GROUP);
+    // Сообщение от обычной кнопки клавиатуры: текст - подпись кнопки, payload - строка JSON
+    void pushButton(long long peerId, long long fromId, const std::string& text, const std::string& payload,
+                    long long groupId = DEFAULT_GROUP);
+    // Нажатие callback-кнопки (событие message_event), payload - объект JSON
+    // Возвращает event_id, ответ на него придет в takeAnswers()
+    std::string pushCallback(long long peerId, long long userId, const std::string& payload,
+                             long long groupId = DEFAULT_GROUP);
+    // Произвольное событие: JSON объект из массива updates
+    void pushEvent(const std::string& updateJson, long long groupId = DEFAULT_GROUP);
+    // Следующий a_check ответит {"failed": code} (2 и 3 также меняют ключ)
+    void pushFailed(int code);
+    // Следующий a_check останется без ответа, пока клиент не закроет соединение
+    void pushTimeout();
+    // Следующий a_check ответит HTTP ошибкой (например, 503)
+    void pushHttpError(int status);
+
+    // === СЦЕНАРИЙ API ===
+
+    // Следующий вызов метода вернет ошибку VK с этим кодом
+    void pushApiError(const std::string& method, int code);
+    // Следующая загрузка файла ответит HTTP ошибкой
+    void pushUploadError(int status);
+    // Участники беседы для messages.getConversationMembers (admin - администратор, 0 - нет)
+    // Для бесед без списка метод отвечает ошибкой 917, как будто бот не администратор
+    void setChatMembers(long long peerId, const std::vector<long long>& users, long long admin = 0);
+    // Получатель запретил сообщения от сообщества: messages.send отвечает ошибкой 901,
+    // в рассылке (peer_ids) - ошибкой в его элементе ответа
+    void denyMessages(long long peerId);
+    // Имя пользователя в ответах users.get и getConversationMembers
+    static std::string firstName(long long userId);
+    // Не больше perSecond HTTP запросов к API в секунду, дальше ошибка 6 (0 - без лимита)
+    void setRateLimit(unsigned perSecond);
+    // Отдавать ответы с Transfer-Encoding: chunked
+    void setChunked(bool enable);
+    // Печатать каждый запрос в stdout
+    void setLog(bool enable);
+    // Сколько держать a_check без событий, если клиент просит больше (секунды)
+    void setMaxWait(int seconds);
+    // Задержка перед каждым ответом (имитация задержки сети), мс
+    void setLatency(int ms);
+    // Часы сервера (Date, date сообщений, utils.getServerTime) идут быстрее настоящих
+    // на ppm миллионных и сдвинуты на offsetMs - как будто у бота уходит кварц (до start())
+    void setClockSkew(long ppm, long long offsetMs);
+    // Текущее время сервера, мс Unix
+    long long serverTimeMs();
+
+    // === РЕЗУЛЬТАТЫ ===
+
+    std::vector<SentMessage> takeSent();
+    std::vector<Upload> takeUploads();
+    std::vector<EventAnswer> takeAnswers();
+    // Текущий текст сообщения с учетом правок (conversation_message_id совпадает с message_id)
+    // Пусто, если такого сообщения нет
+    std::string messageText(long long peerId, int conversationMessageId);
+    size_t sentCount();
+    // Сколько действий сценария Long Poll еще не выполнено
+    size_t pendingActions();
+    // Дождаться, пока бот отправит count сообщений
+    bool waitSent(size_t count, unsigned long timeoutMs);
+    Stats stats();
+
+private:
+    enum ActionType {
+        ACT_FAILED,
+        ACT_TIMEOUT,
+        ACT_HTTP_ERROR
+    };
+
+    struct Action {
+        ActionType type;
+        int code;
+        size_t ts;      // failed 1: ts на момент постановки, события после него не теряются
+    };
+
+    // Long Poll одной группы: событие с номером ts лежит в events[ts - 1]
+    // Сценарий (failed, таймауты, HTTP ошибки) - только у группы по умолчанию
+    struct Group {
+        std::vector<std::string> events;
+        std::deque<Action> actions;
+        std::string key;
+    };
+
+    struct Request {
+        std::string method;
+        std::string path;
+        Params params;
+        bool close;
+        std::string contentType;
+        std::string body;       // Тело multipart/form-data (формы разбираются в params)
+    };
+
+    struct Response {
+        int status;
+        std::string body;
+        bool drop;      // Не отвечать, держать соединение до закрытия клиентом
+        bool close;
+    };
+
+    std::mutex mtx;
+    std::condition_variable cv;
+
+    int listenFd;
+    uint16_t listenPort;
+    std::atomic<bool> running;
+    std::thread acceptThread;
+    std::vector<int> clientFds;
+    int activeWorkers;
+
+    // Long Poll по группам
+    std::map<long long, Group> groups;
+    int keySerial;
+    int incomingId;
+
+    // API
+    std::map<std::string, std::deque<int> > apiErrors;
+    std::map<std::pair<long long, long long>, int> randomIds;
+    std::vector<SentMessage> sent;
+    std::vector<Upload> uploads;        // Все принятые файлы (id = индекс + 1)
+    size_t uploadsTaken;                // Сколько уже забрал takeUploads()
+    std::set<std::string> pendingEvents;    // event_id нажатий, на которые еще не ответили
+    std::map<long long, std::vector<long long> > chatMembers;
+    std::map<long long, long long> chatAdmins;
+    std::set<long long> deniedPeers;
+    std::map<std::pair<long long, int>, std::string> texts;   // (peer_id, message_id) -> текст
+    std::vector<EventAnswer> answers;
+    std::deque<int> uploadErrors;
+    std::deque<unsigned long> callTimes;
+    unsigned rateLimit;
+    int nextMessageId;
+
+    bool chunked;
+    bool log;
+    int maxWait;
+    int latencyMs;
+    std::atomic<long> skewPpm;
+    std::atomic<long long> skewOffsetMs;
+    std::chrono::system_clock::time_point clockStart;
+    Stats counters;
+
+    void acceptLoop();
+    void serveClient(int fd);
+    bool readRequest(int fd, std::string& buf, Request& req);
+    bool writeResponse(int fd, const Response& resp);
+    void holdUntilClosed(int fd);
+
+    Response handleLongPoll(long long groupId, const Params& params);
+    Response handleApi(const std::string& method, const Params& params);
+    Response handleUpload(const std::string& kind, const Request& req);
+    int savePhoto(const Params& params, std::string& result);
+    int saveDoc(const Params& params, std::string& result);
+    int answerEvent(const Params& params, bool viaExecute, std::string& result);
+    int usersGet(const Params& params, std::string& result);
+    int conversationMembers(const Params& params, std::string& result);
+    Response handleExecute(const std::string& code, const std::string& token);
+    int callMethod(const std::string& method, const Params& params, const std::string& token,
+                   std::string& result, bool viaExecute = false);
+    int sendMessage(const Params& params, const std::string& token, bool viaExecute, std::string& result);
+    int storeMessage(SentMessage& msg);
+    int editMessage(const Params& params, std::string& result);
+    Group& group(long long id);
+    void rotateKey(Group& g);
+    bool rateLimited();
+
+    static Response json(const std::string& body);
+    static std::string errorJson(int code);
+};
+
+// Экранирование строки для JSON
+std::string vkMockJsonString(const std::string& text);
+
+#endif // VK_MOCK_SERVER_H
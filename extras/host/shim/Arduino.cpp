@@ -0,0 +1,60 @@
+// Arduino.cpp - реализация прослойки Arduino API для Linux
+
+#include "Arduino.h"
+
+#include <chrono>
+#include <random>
+#include <thread>
+
+static const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+static std::mt19937 rng(12345);
+static uint8_t pinState[256];
+
+HardwareSerial Serial;
+
+unsigned long millis() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros() {
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void yield() {
+    std::this_thread::yield();
+}
+
+void pinMode(uint8_t, uint8_t) {
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+    pinState[pin] = val;
+}
+
+int digitalRead(uint8_t pin) {
+    return pinState[pin];
+}
+
+long random(long howbig) {
+    if (howbig <= 0) {
+        return 0;
+    }
+    return (long)(rng() % (unsigned long)howbig);
+}
+
+long random(long howsmall, long howbig) {
+    if (howbig <= howsmall) {
+        return howsmall;
+    }
+    return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed) {
+    rng.seed(seed);
+}
@@ -0,0 +1,432 @@
+// Arduino.h - минимальная прослойка Arduino API для сборки DGO_VKbot на Linux
+// Только то, что нужно библиотеке, примерам и инструментам из extras/host
+
+#ifndef DGO_VKBOT_HOST_ARDUINO_H
+#define DGO_VKBOT_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <math.h>
+#include <time.h>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+// PROGMEM на хосте не нужен
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(s))
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define memcpy_P memcpy
+#define vsnprintf_P vsnprintf
+#define snprintf_P snprintf
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+
+typedef uint8_t byte;
+typedef bool boolean;
+class __FlashStringHelper;
+
+// === ВРЕМЯ ===
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void yield();
+
+// === GPIO (на хосте только запоминает состояние) ===
+
+#define LOW 0
+#define HIGH 1
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+// === СЛУЧАЙНЫЕ ЧИСЛА ===
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+// === STRING ===
+
+class String {
+public:
+    String() : buf(nullptr), len(0), cap(0) {}
+    String(const char* s) : buf(nullptr), len(0), cap(0) { if (s) copy(s, strlen(s)); }
+    String(const char* s, size_t n) : buf(nullptr), len(0), cap(0) { if (s) copy(s, n); }
+    String(const __FlashStringHelper* s) : String(reinterpret_cast<const char*>(s)) {}
+    String(const String& s) : buf(nullptr), len(0), cap(0) { copy(s.buf, s.len); }
+    String(String&& s) : buf(s.buf), len(s.len), cap(s.cap) { s.buf = nullptr; s.len = s.cap = 0; }
+    explicit String(char c) : buf(nullptr), len(0), cap(0) { copy(&c, 1); }
+    explicit String(unsigned char v, unsigned char base = 10) : String((unsigned long)v, base) {}
+    explicit String(int v, unsigned char base = 10) : String((long)v, base) {}
+    explicit String(unsigned int v, unsigned char base = 10) : String((unsigned long)v, base) {}
+    explicit String(long v, unsigned char base = 10) : buf(nullptr), len(0), cap(0) {
+        char tmp[34];
+        if (base == 10) snprintf(tmp, sizeof(tmp), "%ld", v);
+        else formatUnsigned(tmp, (unsigned long)v, base);
+        copy(tmp, strlen(tmp));
+    }
+    explicit String(unsigned long v, unsigned char base = 10) : buf(nullptr), len(0), cap(0) {
+        char tmp[34];
+        formatUnsigned(tmp, v, base);
+        copy(tmp, strlen(tmp));
+    }
+    explicit String(long long v) : buf(nullptr), len(0), cap(0) {
+        char tmp[24];
+        snprintf(tmp, sizeof(tmp), "%lld", v);
+        copy(tmp, strlen(tmp));
+    }
+    explicit String(unsigned long long v) : buf(nullptr), len(0), cap(0) {
+        char tmp[24];
+        snprintf(tmp, sizeof(tmp), "%llu", v);
+        copy(tmp, strlen(tmp));
+    }
+    explicit String(float v, unsigned char decimals = 2) : String((double)v, decimals) {}
+    explicit String(double v, unsigned char decimals = 2) : buf(nullptr), len(0), cap(0) {
+        char tmp[40];
+        snprintf(tmp, sizeof(tmp), "%.*f", (int)decimals, v);
+        copy(tmp, strlen(tmp));
+    }
+    ~String() { free(buf); }
+
+    String& operator=(const String& s) { if (this != &s) copy(s.buf, s.len); return *this; }
+    String& operator=(String&& s) {
+        if (this != &s) {
+            free(buf);
+            buf = s.buf; len = s.len; cap = s.cap;
+            s.buf = nullptr; s.len = s.cap = 0;
+        }
+        return *this;
+    }
+    String& operator=(const char* s) { if (s) copy(s, strlen(s)); else invalidate(); return *this; }
+
+    bool reserve(size_t size) {
+        if (buf && cap >= size) return true;
+        char* p = (char*)realloc(buf, size + 1);
+        if (!p) return false;
+        if (!buf) p[0] = 0;
+        buf = p;
+        cap = size;
+        return true;
+    }
+
+    size_t length() const { return len; }
+    bool isEmpty() const { return len == 0; }
+    const char* c_str() const { return buf ? buf : ""; }
+    char* begin() { return buf; }
+    char* end() { return buf + len; }
+    const char* begin() const { return c_str(); }
+    const char* end() const { return c_str() + len; }
+
+    bool concat(const char* s, size_t n) {
+        if (!s) return false;
+        if (n == 0) return true;
+        if (!reserve(len + n)) return false;
+        memmove(buf + len, s, n);
+        len += n;
+        buf[len] = 0;
+        return true;
+    }
+    bool concat(const char* s) { return s ? concat(s, strlen(s)) : false; }
+    bool concat(const String& s) { return concat(s.c_str(), s.len); }
+    bool concat(char c) { return concat(&c, 1); }
+    bool concat(int v) { return concat(String(v)); }
+    bool concat(unsigned int v) { return concat(String(v)); }
+    bool concat(long v) { return concat(String(v)); }
+    bool concat(unsigned long v) { return concat(String(v)); }
+    bool concat(long long v) { return concat(String(v)); }
+    bool concat(unsigned long long v) { return concat(String(v)); }
+    bool concat(double v) { return concat(String(v)); }
+    bool concat(const __FlashStringHelper* s) { return concat(reinterpret_cast<const char*>(s)); }
+
+    template <typename T> String& operator+=(const T& v) { concat(v); return *this; }
+    String& operator+=(const char* s) { concat(s); return *this; }
+    String& operator+=(char c) { concat(c); return *this; }
+
+    bool equals(const String& s) const { return len == s.len && memcmp(c_str(), s.c_str(), len) == 0; }
+    bool equals(const char* s) const { return s && strlen(s) == len && memcmp(c_str(), s, len) == 0; }
+    bool equalsIgnoreCase(const String& s) const {
+        if (len != s.len) return false;
+        for (size_t i = 0; i < len; i++) {
+            if (tolower((unsigned char)buf[i]) != tolower((unsigned char)s.buf[i])) return false;
+        }
+        return true;
+    }
+    bool operator==(const String& s) const { return equals(s); }
+    bool operator==(const char* s) const { return equals(s); }
+    bool operator!=(const String& s) const { return !equals(s); }
+    bool operator!=(const char* s) const { return !equals(s); }
+    bool operator<(const String& s) const { return strcmp(c_str(), s.c_str()) < 0; }
+    int compareTo(const String& s) const { return strcmp(c_str(), s.c_str()); }
+    bool startsWith(const String& s) const { return s.len <= len && memcmp(c_str(), s.c_str(), s.len) == 0; }
+    bool endsWith(const String& s) const { return s.len <= len && memcmp(c_str() + len - s.len, s.c_str(), s.len) == 0; }
+
+    char charAt(unsigned int i) const { return i < len ? buf[i] : 0; }
+    void setCharAt(unsigned int i, char c) { if (i < len) buf[i] = c; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    char& operator[](unsigned int i) { static char dummy; return i < len ? buf[i] : (dummy = 0); }
+
+    int indexOf(char c, unsigned int from = 0) const {
+        for (size_t i = from; i < len; i++) if (buf[i] == c) return (int)i;
+        return -1;
+    }
+    int indexOf(const String& s, unsigned int from = 0) const {
+        if (from > len) return -1;
+        const char* p = strstr(c_str() + from, s.c_str());
+        return p ? (int)(p - c_str()) : -1;
+    }
+    int lastIndexOf(char c) const {
+        for (size_t i = len; i > 0; i--) if (buf[i - 1] == c) return (int)(i - 1);
+        return -1;
+    }
+    String substring(unsigned int from) const { return substring(from, len); }
+    String substring(unsigned int from, unsigned int to) const {
+        if (from > to) { unsigned int t = from; from = to; to = t; }
+        if (from >= len) return String();
+        if (to > len) to = len;
+        return String(c_str() + from, to - from);
+    }
+    void remove(unsigned int index) { remove(index, len > index ? len - index : 0); }
+    void remove(unsigned int index, unsigned int count) {
+        if (index >= len) return;
+        if (count > len - index) count = len - index;
+        memmove(buf + index, buf + index + count, len - index - count);
+        len -= count;
+        buf[len] = 0;
+    }
+    void replace(const String& find, const String& repl) {
+        if (find.len == 0) return;
+        String out;
+        size_t i = 0;
+        while (i < len) {
+            if (i + find.len <= len && memcmp(buf + i, find.buf, find.len) == 0) {
+                out.concat(repl);
+                i += find.len;
+            } else {
+                out.concat(buf[i++]);
+            }
+        }
+        *this = out;
+    }
+    void toLowerCase() { for (size_t i = 0; i < len; i++) buf[i] = tolower((unsigned char)buf[i]); }
+    void toUpperCase() { for (size_t i = 0; i < len; i++) buf[i] = toupper((unsigned char)buf[i]); }
+    void trim() {
+        if (!buf) return;
+        size_t b = 0, e = len;
+        while (b < e && isspace((unsigned char)buf[b])) b++;
+        while (e > b && isspace((unsigned char)buf[e - 1])) e--;
+        memmove(buf, buf + b, e - b);
+        len = e - b;
+        buf[len] = 0;
+    }
+    long toInt() const { return atol(c_str()); }
+    float toFloat() const { return (float)atof(c_str()); }
+    double toDouble() const { return atof(c_str()); }
+
+private:
+    char* buf;
+    size_t len;
+    size_t cap;
+
+    void copy(const char* s, size_t n) {
+        if (!reserve(n)) { invalidate(); return; }
+        memmove(buf, s, n);
+        len = n;
+        buf[len] = 0;
+    }
+    void invalidate() { free(buf); buf = nullptr; len = cap = 0; }
+    static void formatUnsigned(char* out, unsigned long v, unsigned char base) {
+        char tmp[34];
+        int i = 0;
+        if (base < 2) base = 10;
+        do {
+            int d = (int)(v % base);
+            tmp[i++] = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+            v /= base;
+        } while (v);
+        for (int j = 0; j < i; j++) out[j] = tmp[i - 1 - j];
+        out[i] = 0;
+    }
+};
+
+// Нужен ArduinoJson (поддержка Arduino String)
+class StringSumHelper : public String {
+public:
+    StringSumHelper(const String& s) : String(s) {}
+    StringSumHelper(const char* s) : String(s) {}
+};
+
+inline String operator+(const String& a, const String& b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r.concat(b); return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r.concat(b); return r; }
+inline String operator+(const String& a, char b) { String r(a); r.concat(b); return r; }
+inline bool operator==(const char* a, const String& b) { return b.equals(a); }
+
+// === PRINT / STREAM / CLIENT ===
+
+class Print;
+
+class Printable {
+public:
+    virtual ~Printable() {}
+    virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            if (!write(*buffer++)) break;
+            n++;
+        }
+        return n;
+    }
+    size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+    size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const __FlashStringHelper* s) { return write(reinterpret_cast<const char*>(s)); }
+    size_t print(const String& s) { return write(s.c_str(), s.length()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned char v, int base = DEC) { return print((unsigned long)v, base); }
+    size_t print(int v, int base = DEC) { return print((long)v, base); }
+    size_t print(unsigned int v, int base = DEC) { return print((unsigned long)v, base); }
+    // Десятичные числа - через буфер на стеке, как printNumber() в ядрах ESP (без кучи)
+    size_t print(long v, int base = DEC) {
+        if (base != DEC) return print(String(v, (unsigned char)base));
+        char tmp[24];
+        return write(tmp, (size_t)snprintf(tmp, sizeof(tmp), "%ld", v));
+    }
+    size_t print(unsigned long v, int base = DEC) {
+        if (base != DEC) return print(String(v, (unsigned char)base));
+        char tmp[24];
+        return write(tmp, (size_t)snprintf(tmp, sizeof(tmp), "%lu", v));
+    }
+    size_t print(long long v, int base = DEC) { (void)base; return print(String(v)); }
+    size_t print(unsigned long long v, int base = DEC) { (void)base; return print(String(v)); }
+    size_t print(double v, int digits = 2) { return print(String(v, (unsigned char)digits)); }
+    size_t print(const Printable& p) { return p.printTo(*this); }
+
+    size_t println() { return write("\r\n"); }
+    template <typename T> size_t println(const T& v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(const T& v, int base) { size_t n = print(v, base); return n + println(); }
+
+    size_t printf(const char* format, ...) __attribute__((format(printf, 2, 3))) {
+        char tmp[256];
+        va_list args;
+        va_start(args, format);
+        int n = vsnprintf(tmp, sizeof(tmp), format, args);
+        va_end(args);
+        if (n < 0) return 0;
+        return write(tmp, (size_t)n < sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+    }
+};
+
+class Stream : public Print {
+public:
+    Stream() : _timeout(1000) {}
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+
+    void setTimeout(unsigned long timeout) { _timeout = timeout; }
+    unsigned long getTimeout() const { return _timeout; }
+
+    virtual size_t readBytes(char* buffer, size_t length) {
+        size_t count = 0;
+        while (count < length) {
+            int c = timedRead();
+            if (c < 0) break;
+            *buffer++ = (char)c;
+            count++;
+        }
+        return count;
+    }
+    size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+    String readString() {
+        String ret;
+        int c = timedRead();
+        while (c >= 0) {
+            ret += (char)c;
+            c = timedRead();
+        }
+        return ret;
+    }
+
+protected:
+    unsigned long _timeout;
+
+    int timedRead() {
+        unsigned long start = millis();
+        do {
+            int c = read();
+            if (c >= 0) return c;
+            yield();
+        } while (millis() - start < _timeout);
+        return -1;
+    }
+};
+
+class IPAddress {
+public:
+    IPAddress() : addr(0) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr((uint32_t)a | (uint32_t)b << 8 | (uint32_t)c << 16 | (uint32_t)d << 24) {}
+    operator uint32_t() const { return addr; }
+private:
+    uint32_t addr;
+};
+
+class Client : public Stream {
+public:
+    virtual int connect(IPAddress ip, uint16_t port) = 0;
+    virtual int connect(const char* host, uint16_t port) = 0;
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t* buf, size_t size) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int read(uint8_t* buf, size_t size) = 0;
+    virtual int peek() = 0;
+    virtual void flush() = 0;
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() = 0;
+    using Print::write;
+};
+
+// Serial пишет в stdout
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override { return fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t* buffer, size_t size) override { return fwrite(buffer, 1, size, stdout); }
+    int availableForWrite() override { return 4096; }
+    void flush() override { fflush(stdout); }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    operator bool() const { return true; }
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif // DGO_VKBOT_HOST_ARDUINO_H
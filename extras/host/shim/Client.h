@@ -0,0 +1,2 @@
+// Client.h - на хосте Client объявлен в Arduino.h
+#include "Arduino.h"
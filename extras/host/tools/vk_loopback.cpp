@@ -0,0 +1,1152 @@
+// vk_loopback.cpp - Бот и mock сервер VK в одном процессе
+// Меряет пропускную способность и задержку эхо-бота, воспроизводит шторм переподключений
+//
+// Запуск: vk_loopback [--messages N] [--burst N] [--sync] [--storm] [--chunked] [--rate N] [--restart]
+//                     [--sleep] [--task] [--latency мс] [--clock ppm] [--view] [--hub N] [--upload КБ]
+//                     [--buttons] [--profiles] [--broadcast N] [--live]
+//   --sync     отвечать через sendMessage() вместо очереди
+//   --storm    между пачками сообщений: failed 1/2/3, HTTP 503 и таймаут Long Poll
+//   --restart  перед каждой второй пачкой бот "перезагружается", пачка приходит, пока его нет
+//   --sleep    устройство на батарее: каждый цикл - новый бот, begin() + pollOnce(), затем "сон";
+//              пять циклов с перепиской чередуются с пятью тихими
+//   --task     сеть в отдельном потоке (startNetworkTask()), loop() только вызывает обработчики
+//   --latency  mock отвечает с задержкой, мс
+//   --view     обработчик без копий (attachView())
+//   --clock    часы mock сервера спешат на ppm и на 3.7 с: бот должен подстроиться без
+//              utils.getServerTime; затем VkClock проходит сутки модельного трафика (зерно
+//              фиксировано, время модельное) и должен оценить уход с точностью 10% + 200 ppm
+//   --hub      N сообществ в одном VkHub: ответ должен уйти с токеном своей группы, а пока
+//              Long Poll первой группы висит, остальные отвечают без задержки
+//   --upload   на каждое сообщение бот отвечает файлом этого размера (фото и документ по очереди),
+//              сервер сверяет его побайтно; одна загрузка получает HTTP 500, последняя прерывает a_check
+//   --buttons  роутер с клавиатурой: текстовая команда, обычные и callback-кнопки вперемешку;
+//              на каждое нажатие callback-кнопки должен прийти ровно один ответ с ее аргументом
+//   --profiles бот приветствует по имени и проверяет участие в беседе: восемь авторов пишут
+//              пачками, users.get - один на все, повторные авторы не стоят ни одного запроса
+//   --broadcast N пользователей подписываются командой, каждый десятый отписывается, каждый седьмой
+//              запретил сообщения; три рассылки должны дойти до каждого подписчика ровно один раз,
+//              по одному execute на рассылку (до VK_EXECUTE_PEERS получателей)
+//   --live     сводка обновляется на каждом tick(): значение то меняется редко, то часто, то стоит;
+//              запросов должно быть по изменениям (и не чаще интервала), а не по вызовам, в конце
+//              сервер отказывается править старое сообщение и сводка уходит новым
+
+#include <Arduino.h>
+#include <DGO_VKbot.h>
+#include <DGO_VKhub.h>
+#include <DGO_VKrouter.h>
+#include <DGO_VKsubscribers.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "VkMockServer.h"
+
+#define LOOPBACK_PEER 2000000001
+#define LOOPBACK_FROM 100
+#define LOOPBACK_TIMEOUT 120000UL
+
+struct Options {
+    int messages;
+    int burst;
+    bool sync;
+    bool storm;
+    bool chunked;
+    unsigned rate;
+    bool restart;
+    bool sleep;
+    bool task;
+    int latency;
+    long clockPpm;
+    bool view;
+    int hub;
+    int upload;
+    bool buttons;
+    bool profiles;
+    int broadcast;
+    bool live;
+};
+
+static unsigned long percentile(std::vector<unsigned long>& v, int p) {
+    if (v.empty()) {
+        return 0;
+    }
+    size_t i = (v.size() - 1) * p / 100;
+    return v[i];
+}
+
+// Режим с глубоким сном: время бодрствования на обработанное сообщение
+static int runSleep(const Options& opt, VkMockServer& server, std::function<bool()>& startBot,
+                    std::unique_ptr<DGO_VKbot>& bot) {
+    int pushed = 0;
+    int answered = 0;
+    int cycles = 0;
+    unsigned long awake = 0;
+    unsigned long slept = 0;
+    std::string intervals;
+
+    // Первое включение: сохраненного ts еще нет, события до него VK не отдаст
+    if (!startBot()) {
+        printf("Бот не запустился\n");
+        return 1;
+    }
+    bot->pollOnce();
+    bot.reset();
+
+    while (answered < opt.messages && cycles < 1000) {
+        // Пять циклов переписки, пять тихих
+        bool active = (cycles / 5) % 2 == 0;
+        for (int i = 0; active && i < opt.burst && pushed < opt.messages; i++, pushed++) {
+            char text[32];
+            snprintf(text, sizeof(text), "msg %d", pushed);
+            server.pushMessage(LOOPBACK_PEER, LOOPBACK_FROM, text);
+        }
+
+        if (!startBot()) {
+            printf("Бот не запустился\n");
+            return 1;
+        }
+        unsigned long sleepMs = bot->pollOnce();
+        VkPollResult r = bot->getLastPoll();
+        bot.reset();
+
+        answered += (int)server.takeSent().size();
+        awake += r.awakeMs;
+        slept += sleepMs;
+        cycles++;
+        if (cycles <= 20) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%s%lu", intervals.empty() ? "" : " ", sleepMs / 1000);
+            intervals += buf;
+        }
+    }
+
+    VkMockServer::Stats s = server.stats();
+    server.stop();
+    printf("\n=== loopback: %d сообщений, пачки по %d, глубокий сон ===\n", opt.messages, opt.burst);
+    printf("Отвечено:        %d из %d за %d пробуждений\n", answered, opt.messages, cycles);
+    printf("Бодрствование:   %lu мс всего, %.2f мс на сообщение, сон %lu с\n", awake,
+           answered ? (double)awake / answered : 0.0, slept / 1000);
+    printf("Интервалы сна, с: %s%s\n", intervals.c_str(), cycles > 20 ? " ..." : "");
+    printf("Сервер:          a_check %lu, getLongPollServer %lu, API %lu, execute %lu\n",
+           s.lpRequests, s.lpServerRequests, s.apiRequests, s.executeRequests);
+    return answered == opt.messages ? 0 : 1;
+}
+
+// Смоделированный трафик для VkClock: время сервера и millis() считаются, а не берутся из системы
+struct VkClockModel {
+    long ppm;
+    int64_t serverStart;            // Время сервера в начале модели, мс
+    std::mt19937 rng;
+
+    VkClockModel(long ppm) : ppm(ppm), serverStart(1700000000437LL + 3700), rng(20240611) {}
+
+    // Время сервера через local мс нашего времени
+    int64_t serverAt(int64_t local) const {
+        return serverStart + local + local * ppm / 1000000;
+    }
+
+    uint32_t uniform(uint32_t from, uint32_t to) {
+        return std::uniform_int_distribution<uint32_t>(from, to)(rng);
+    }
+};
+
+// Часы: сначала бот с mock сервером подводится по трафику без utils.getServerTime,
+// затем VkClock проходит сутки смоделированного трафика с окнами по умолчанию.
+// Зерно фиксировано, а время модельное, поэтому оценка ухода от прогона к прогону одна и та же
+static int runClock(const Options& opt, VkMockServer& server, std::function<bool()>& startBot,
+                    std::unique_ptr<DGO_VKbot>& bot) {
+    if (!startBot()) {
+        printf("Бот не запустился\n");
+        return 1;
+    }
+    VkClock& clock = bot->getClock();
+    unsigned long apiBefore = server.stats().apiRequests;
+    bot->syncTime();
+    bool extraRequest = server.stats().apiRequests != apiBefore;
+
+    printf("\n=== loopback: часы сервера спешат на %ld ppm ===\n", opt.clockPpm);
+    unsigned long start = millis();
+    unsigned long lastPush = 0;
+    int pushed = 0;
+    while (millis() - start < 3000) {
+        if (millis() - lastPush >= 200) {
+            lastPush = millis();
+            char text[32];
+            snprintf(text, sizeof(text), "tick %d", pushed++);
+            server.pushMessage(LOOPBACK_PEER, LOOPBACK_FROM, text);
+        }
+        bot->tick();
+        delay(1);
+    }
+    server.takeSent();
+    // Date с точностью до секунды: за 3 с часы точнее интервала одного замера не станут
+    long long liveError = clock.nowMs() - server.serverTimeMs();
+    printf("С сервером:      замеров %lu, ошибка %+lld мс, запрос utils.getServerTime: %s\n",
+           (unsigned long)clock.samples(), liveError, extraRequest ? "был" : "не нужен");
+
+    // Модель: API отвечает раз в 5-60 с (каждый седьмой запрос долгий), сообщения приходят
+    // раз в 2-120 с, пустой Long Poll - каждые 25 с. Отсчет millis() проходит через переполнение
+    VkClockModel model(opt.clockPpm);
+    VkClock sim;
+    sim.setLimits(VK_CLOCK_WINDOW, VK_CLOCK_DRIFT_SPAN, 100000);
+    const int64_t duration = 24LL * 3600 * 1000;
+    const uint32_t millisStart = 0xFFFFFFFFUL - 3600000UL;
+    int64_t nextApi = 0;
+    int64_t nextMessage = model.uniform(2000, 120000);
+    int64_t nextPoll = 25000;
+    int64_t nextReport = 0;
+    int64_t error = 0;
+    int64_t maxError = 0;
+    for (int64_t local = 0; local < duration; ) {
+        if (nextApi <= nextMessage && nextApi <= nextPoll) {
+            local = nextApi;
+            uint32_t roundTrip = 30 + model.uniform(0, 25);
+            if (model.uniform(0, 6) == 0) {
+                roundTrip += model.uniform(200, 3000);
+            }
+            // Сервер ставит Date где-то посередине запроса
+            int64_t handled = local + roundTrip * model.uniform(30, 70) / 100;
+            sim.addHttpDate(millisStart + (uint32_t)(local + roundTrip),
+                            (uint32_t)(model.serverAt(handled) / 1000), roundTrip);
+            nextApi = local + model.uniform(5000, 60000);
+        } else {
+            bool message = nextMessage <= nextPoll;
+            local = message ? nextMessage : nextPoll;
+            int64_t answered = local + model.uniform(5, 60);
+            uint32_t received = millisStart + (uint32_t)(answered + model.uniform(5, 20));
+            sim.addLongPollDate(received, (uint32_t)(model.serverAt(answered) / 1000));
+            if (message) {
+                sim.addEventDate(received, (uint32_t)(model.serverAt(local) / 1000));
+                nextMessage = local + model.uniform(2000, 120000);
+            }
+            nextPoll = answered + 25000;
+        }
+
+        error = sim.nowMs(millisStart + (uint32_t)local) - model.serverAt(local);
+        if (local >= duration / 2 && llabs(error) > maxError) {
+            maxError = llabs(error);
+        }
+        if (local >= nextReport) {
+            nextReport += 7200000;
+            printf("%3lld ч: ошибка %+5lld мс, уход %+8.1f ppm\n", (long long)(local / 3600000),
+                   (long long)error, sim.driftPpm());
+        }
+    }
+    float driftError = sim.driftPpm() - opt.clockPpm;
+    float driftLimit = labs(opt.clockPpm) * 0.1f + 200;
+    printf("Модель, сутки:   замеров %lu, худшая ошибка за вторые 12 ч %lld мс\n",
+           (unsigned long)sim.samples(), (long long)maxError);
+    printf("Уход:            %+.1f ppm при заданных %+ld (допуск %.0f)\n", sim.driftPpm(), opt.clockPpm,
+           driftLimit);
+    bool ok = !extraRequest && llabs(liveError) < 1500 && maxError < 150 && fabsf(driftError) < driftLimit;
+    return ok ? 0 : 1;
+}
+
+// Хаб: сообщения по кругу во все группы, ответ - от группы, которой пришло сообщение
+// Вторая половина - Long Poll группы 1 висит (таймаут mock), сообщения идут остальным
+static int runHub(const Options& opt, VkMockServer& server, uint16_t port) {
+    VkHubT<VkHubSmallConfig> hub;
+    for (int g = 1; g <= opt.hub; g++) {
+        char token[16];
+        char id[16];
+        snprintf(token, sizeof(token), "token%d", g);
+        snprintf(id, sizeof(id), "-%d", g);
+        if (!hub.add(token, id)) {
+            return 1;
+        }
+    }
+    hub.setApiEndpoint("127.0.0.1", port, false);
+    hub.attachView([&](const VkUpdateView& update) {
+        char reply[64];
+        snprintf(reply, sizeof(reply), "echo %ld: %s", update.group_id, update.message.text.c_str());
+        hub.enqueueMessage(update.group_id, reply, update.message.peer_id);
+    });
+    if (!hub.begin()) {
+        printf("Хаб не запустился\n");
+        return 1;
+    }
+
+    // Следующая пачка приходит, когда сервер уже принял ответы, но бот мог еще не разобрать
+    // ответ execute: его сообщения держат места в очереди. Поэтому на группу не больше
+    // половины очереди VkHubSmallConfig, даже когда отвечают только группы 2..N
+    int burst = opt.burst;
+    int groups = opt.hub > 1 ? opt.hub - 1 : 1;
+    if (burst > groups * (VkHubSmallConfig::OUTBOX / 2)) {
+        burst = groups * (VkHubSmallConfig::OUTBOX / 2);
+    }
+
+    std::map<std::string, unsigned long> pushedAt;
+    std::vector<unsigned long> latencies;
+    std::vector<unsigned long> stalledLatencies;
+    int wrongToken = 0;
+    int pushed = 0;
+    bool stalled = false;
+    unsigned long start = millis();
+    while ((int)(latencies.size() + stalledLatencies.size()) < opt.messages &&
+           millis() - start < LOOPBACK_TIMEOUT) {
+        if (pushed < opt.messages && pushedAt.empty()) {
+            if (!stalled && pushed >= opt.messages / 2 && opt.hub > 1) {
+                server.pushTimeout();   // Следующий a_check группы 1 повиснет
+                stalled = true;
+                delay(50);
+            }
+            for (int i = 0; i < burst && pushed < opt.messages; i++, pushed++) {
+                int group = stalled ? 2 + pushed % (opt.hub - 1) : 1 + pushed % opt.hub;
+                char text[32];
+                char reply[64];
+                snprintf(text, sizeof(text), "msg %d", pushed);
+                snprintf(reply, sizeof(reply), "echo %d: %s", group, text);
+                pushedAt[reply] = millis();
+                server.pushMessage(LOOPBACK_PEER, LOOPBACK_FROM, text, group);
+            }
+        }
+        hub.tick();
+
+        std::vector<VkMockServer::SentMessage> sent = server.takeSent();
+        for (size_t i = 0; i < sent.size(); i++) {
+            std::map<std::string, unsigned long>::iterator it = pushedAt.find(sent[i].text);
+            if (it == pushedAt.end()) {
+                continue;
+            }
+            int group = atoi(sent[i].text.c_str() + 5);
+            char token[16];
+            snprintf(token, sizeof(token), "token%d", group);
+            if (sent[i].token != token) {
+                wrongToken++;
+            }
+            (stalled ? stalledLatencies : latencies).push_back(sent[i].atMs - it->second);
+            pushedAt.erase(it);
+        }
+        delay(1);
+    }
+
+    unsigned long elapsed = millis() - start;
+    VkMockServer::Stats s = server.stats();
+    server.stop();
+    int answered = (int)(latencies.size() + stalledLatencies.size());
+    std::sort(latencies.begin(), latencies.end());
+    std::sort(stalledLatencies.begin(), stalledLatencies.end());
+    printf("\n=== loopback: %d сообщений, %d сообществ в VkHub ===\n", opt.messages, opt.hub);
+    printf("Отвечено:        %d из %d за %lu мс, с чужим токеном %d\n", answered, opt.messages, elapsed,
+           wrongToken);
+    printf("Задержка, мс:    p50 %lu  p99 %lu  max %lu\n", percentile(latencies, 50),
+           percentile(latencies, 99), latencies.empty() ? 0 : latencies.back());
+    printf("Группа 1 висит:  p50 %lu  p99 %lu  max %lu\n", percentile(stalledLatencies, 50),
+           percentile(stalledLatencies, 99), stalledLatencies.empty() ? 0 : stalledLatencies.back());
+    printf("Сервер:          соединений %lu (Long Poll %d + API 1), getLongPollServer %lu, API %lu\n",
+           s.connections, opt.hub, s.lpServerRequests, s.apiRequests);
+    bool ok = answered == opt.messages && wrongToken == 0 && s.connections == (unsigned long)opt.hub + 1;
+    return ok ? 0 : 1;
+}
+
+// Содержимое тестового файла: байт по смещению, чтобы сервер мог сверить без копии
+static uint8_t uploadByte(size_t offset) {
+    return (uint8_t)(offset * 31 + offset / 251);
+}
+
+// Загрузка: на сообщение "msg N" бот отвечает фото (N четное) или документом с подписью "file N"
+static int runUpload(const Options& opt, VkMockServer& server, uint16_t port) {
+    DGO_VKbot bot;
+    bot.setToken("loopback");
+    bot.setGroupId("-1");
+    bot.setApiEndpoint("127.0.0.1", port, false);
+
+    size_t size = (size_t)opt.upload * 1024;
+    size_t maxChunk = 0;
+    int failed = 0;
+    std::map<std::string, std::string> sentNames;    // Подпись -> имя файла
+    auto sendFile = [&](int n, bool photo) {
+        VkGeneratorSource source(size, [&](uint8_t* buf, size_t len, size_t offset) {
+            if (len > maxChunk) maxChunk = len;
+            for (size_t i = 0; i < len; i++) {
+                buf[i] = uploadByte(offset + i);
+            }
+            return len;
+        });
+        char name[32];
+        char text[32];
+        snprintf(name, sizeof(name), photo ? "chart%d.png" : "log%d.csv", n);
+        snprintf(text, sizeof(text), "file %d", n);
+        sentNames[text] = name;
+        bool ok = photo ? bot.sendPhoto(LOOPBACK_PEER, source, name, text)
+                        : bot.sendDocument(LOOPBACK_PEER, source, name, text);
+        if (!ok) {
+            failed++;
+        }
+    };
+    bot.attachView([&](const VkUpdateView& update) {
+        int n = atoi(update.message.text.c_str() + 4);
+        sendFile(n, n % 2 == 0);
+    });
+    if (!bot.begin()) {
+        printf("Бот не запустился\n");
+        return 1;
+    }
+
+    // По одному сообщению: следующее, когда пришел ответ (или загрузка не удалась)
+    int answered = 0;
+    std::vector<VkMockServer::SentMessage> replies;
+    unsigned long start = millis();
+    for (int n = 0; n <= opt.messages && millis() - start < LOOPBACK_TIMEOUT; n++) {
+        bool last = n == opt.messages;
+        int before = failed;
+        if (n == 1) {
+            server.pushUploadError(500);
+        }
+        if (last) {
+            // Последний файл - не из обработчика, а пока Long Poll ждет событий
+            while (bot.getPollState() != VK_POLL_WAIT_HEADERS && millis() - start < LOOPBACK_TIMEOUT) {
+                bot.tick();
+                delay(1);
+            }
+            sendFile(n, false);
+        }
+        // После последнего файла Long Poll должен переподключиться и не потерять сообщение
+        char text[32];
+        snprintf(text, sizeof(text), "msg %d", last ? n + 1 : n);
+        server.pushMessage(LOOPBACK_PEER, LOOPBACK_FROM, text);
+        size_t want = replies.size() + (last ? 2 : 1);
+        while (replies.size() + (failed - before) < want && millis() - start < LOOPBACK_TIMEOUT) {
+            bot.tick();
+            std::vector<VkMockServer::SentMessage> sent = server.takeSent();
+            replies.insert(replies.end(), sent.begin(), sent.end());
+            delay(1);
+        }
+    }
+    unsigned long elapsed = millis() - start;
+    String metrics = bot.getMetricsJson();
+    std::vector<VkMockServer::Upload> uploads = server.takeUploads();
+    VkMockServer::Stats s = server.stats();
+    server.stop();
+
+    // Каждый ответ: вложение того файла, что пришел на сервер, и побайтно тот же файл
+    std::map<std::string, const VkMockServer::Upload*> byAttachment;
+    for (size_t i = 0; i < uploads.size(); i++) {
+        byAttachment[uploads[i].attachment] = &uploads[i];
+    }
+    int corrupted = 0;
+    for (size_t i = 0; i < replies.size(); i++) {
+        std::map<std::string, const VkMockServer::Upload*>::iterator it = byAttachment.find(replies[i].attachment);
+        if (it == byAttachment.end() || it->second->filename != sentNames[replies[i].text]) {
+            corrupted++;
+            continue;
+        }
+        const std::string& data = it->second->data;
+        bool same = data.size() == size &&
+                    it->second->field == (it->second->kind == "photo" ? "photo" : "file");
+        for (size_t k = 0; same && k < data.size(); k++) {
+            same = (uint8_t)data[k] == uploadByte(k);
+        }
+        if (same) {
+            answered++;
+        } else {
+            corrupted++;
+        }
+    }
+
+    int expected = opt.messages + 1;
+    printf("\n=== loopback: %d файлов по %d КБ ===\n", expected + 1, opt.upload);
+    printf("Отправлено:      %d с верным вложением и содержимым, %d испорчено, %d не загружено\n",
+           answered, corrupted, failed);
+    printf("Время:           %lu мс, %.1f КБ/с\n", elapsed,
+           elapsed ? (double)answered * opt.upload * 1000.0 / elapsed : 0.0);
+    printf("Кусок файла:     не больше %zu байт (VK_UPLOAD_CHUNK %d)\n", maxChunk, VK_UPLOAD_CHUNK);
+    printf("Сервер:          файлов %lu, соединений %lu, a_check %lu, API %lu\n",
+           s.uploads, s.connections, s.lpRequests, s.apiRequests);
+    printf("Метрики бота:    %s\n", metrics.c_str());
+    // Один файл отбит HTTP 500, остальные дошли целыми
+    bool ok = answered == expected && corrupted == 0 && failed == 1 && maxChunk <= VK_UPLOAD_CHUNK;
+    return ok ? 0 : 1;
+}
+
+// Кнопки: "меню" присылает клавиатуру, обычная кнопка с подписью, которой нет среди команд,
+// должна найти команду по payload, callback-кнопка - получить ответ со своим аргументом
+enum {
+    CMD_STATUS = 1,
+    CMD_SET = 2,
+    CMD_MISSING = 9     // Кнопка без команды в роутере
+};
+
+static int runButtons(const Options& opt, VkMockServer& server, uint16_t port) {
+    DGO_VKbot bot;
+    bot.setToken("loopback");
+    bot.setGroupId("-1");
+    bot.setApiEndpoint("127.0.0.1", port, false);
+
+    int unknown = 0;
+    int textParsed = 0;
+    VkRouter router;
+    router.on("меню|menu", [&](const VkUpdateView& update, const VkArgs&) {
+        textParsed++;
+        VkKeyboard kb(true);
+        kb.button("Статус", CMD_STATUS, VK_BUTTON_PRIMARY);
+        kb.row();
+        kb.callback("Вкл", CMD_SET, VK_BUTTON_POSITIVE, 1).callback("Выкл", CMD_SET, VK_BUTTON_NEGATIVE, -1);
+        bot.enqueueMessage("menu", update.message.peer_id, kb);
+    });
+    router.on("статус|status", [&](const VkUpdateView& update, const VkArgs&) {
+        bot.enqueueMessage("status", update.message.peer_id);
+    }, CMD_STATUS);
+    router.onButton(CMD_SET, [&](const VkUpdateView& update, const VkArgs& args) {
+        String text = "set ";
+        text += args.toInt(0);
+        bot.answerEvent(update, text);
+    });
+    router.onUnknown([&](const VkUpdateView& update, const VkArgs&) {
+        unknown++;
+        if (update.type == VK_MESSAGE_EVENT) {
+            bot.answerEvent(update);
+        }
+    });
+    router.attach(bot);
+    if (!bot.begin() || (opt.task && !bot.startNetworkTask())) {
+        printf("Бот не запустился\n");
+        return 1;
+    }
+
+    // По одному событию: меню, кнопка "Нажми" (payload статуса), callback с аргументом n,
+    // каждое десятое - callback неизвестной кнопки
+    int menus = 0;
+    int statuses = 0;
+    int callbacks = 0;
+    int wrong = 0;
+    std::map<std::string, std::string> expected;     // event_id -> ожидаемый event_data
+    std::vector<VkMockServer::SentMessage> replies;
+    std::vector<VkMockServer::EventAnswer> answers;
+    unsigned long start = millis();
+    for (int n = 0; n < opt.messages && millis() - start < LOOPBACK_TIMEOUT; n++) {
+        char payload[48];
+        switch (n % 3) {
+            case 0:
+                server.pushMessage(LOOPBACK_PEER, LOOPBACK_FROM, "Меню");
+                menus++;
+                break;
+            case 1:
+                snprintf(payload, sizeof(payload), "{\"c\":%d}", CMD_STATUS);
+                server.pushButton(LOOPBACK_PEER, LOOPBACK_FROM, "Нажми", payload);
+                statuses++;
+                break;
+            default: {
+                bool missing = n % 10 == 2;
+                snprintf(payload, sizeof(payload), "{\"c\":%d,\"a\":%d}", missing ? CMD_MISSING : CMD_SET, n);
+                std::string id = server.pushCallback(LOOPBACK_PEER, LOOPBACK_FROM, payload);
+                char data[64];
+                snprintf(data, sizeof(data), "{\"type\":\"show_snackbar\",\"text\":\"set %d\"}", n);
+                expected[id] = missing ? "" : data;
+                callbacks++;
+                break;
+            }
+        }
+        size_t want = replies.size() + answers.size() + 1;
+        while (replies.size() + answers.size() < want && millis() - start < LOOPBACK_TIMEOUT) {
+            bot.tick();
+            std::vector<VkMockServer::SentMessage> sent = server.takeSent();
+            replies.insert(replies.end(), sent.begin(), sent.end());
+            std::vector<VkMockServer::EventAnswer> got = server.takeAnswers();
+            answers.insert(answers.end(), got.begin(), got.end());
+            delay(1);
+        }
+    }
+    unsigned long elapsed = millis() - start;
+    if (opt.task) {
+        bot.stopNetworkTask();
+    }
+    String metrics = bot.getMetricsJson();
+    server.stop();
+
+    int menuOk = 0;
+    int statusOk = 0;
+    for (size_t i = 0; i < replies.size(); i++) {
+        if (replies[i].text == "menu" && replies[i].keyboard.find("\"inline\":true") != std::string::npos &&
+            replies[i].keyboard.find("{\\\"c\\\":2,\\\"a\\\":-1}") != std::string::npos) {
+            menuOk++;
+        } else if (replies[i].text == "status" && replies[i].keyboard.empty()) {
+            statusOk++;
+        } else {
+            wrong++;
+        }
+    }
+    int answerOk = 0;
+    for (size_t i = 0; i < answers.size(); i++) {
+        std::map<std::string, std::string>::iterator it = expected.find(answers[i].eventId);
+        if (it != expected.end() && it->second == answers[i].eventData && answers[i].userId == LOOPBACK_FROM) {
+            answerOk++;
+            expected.erase(it);
+        } else {
+            wrong++;
+        }
+    }
+
+    printf("\n=== loopback: %d событий с кнопками%s ===\n", opt.messages, opt.task ? ", сетевой поток" : "");
+    printf("Меню:            %d/%d с клавиатурой\n", menuOk, menus);
+    printf("Обычные кнопки:  %d/%d (разбор текста: %d раз - только для \"меню\")\n", statusOk, statuses, textParsed);
+    printf("Callback:        %d/%d ответов, неизвестных кнопок %d, неверных ответов %d\n",
+           answerOk, callbacks, unknown, wrong);
+    printf("Время:           %lu мс\n", elapsed);
+    printf("Метрики бота:    %s\n", metrics.c_str());
+    bool ok = menuOk == menus && statusOk == statuses && answerOk == callbacks && textParsed == menus && wrong == 0;
+    return ok ? 0 : 1;
+}
+
+// Профили: авторы LOOPBACK_FROM+1..+8, в беседе только первые шесть, первый - администратор
+#define PROFILE_SENDERS 8
+#define PROFILE_MEMBERS 6
+
+static int runProfiles(const Options& opt, VkMockServer& server, uint16_t port) {
+    std::vector<long long> chat;
+    for (int i = 1; i <= PROFILE_MEMBERS; i++) {
+        chat.push_back(LOOPBACK_FROM + i);
+    }
+    server.setChatMembers(LOOPBACK_PEER, chat, LOOPBACK_FROM + 1);
+
+    DGO_VKbot bot;
+    bot.setToken("loopback");
+    bot.setGroupId("-1");
+    bot.setApiEndpoint("127.0.0.1", port, false);
+    bot.setProfilePrefetch(true);
+    auto greet = [&](int peer, const VkProfile& profile) {
+        String reply = "Привет, ";
+        reply += profile.first_name;
+        if (!bot.isChatMember(peer, profile.id)) {
+            reply += " (не в беседе)";
+        } else if (bot.isChatAdmin(peer, profile.id)) {
+            reply += " (админ)";
+        }
+        bot.enqueueMessage(reply, peer);
+    };
+    // Обработчик не ждет users.get: незнакомым авторам отвечаем, когда придет профиль
+    std::multimap<int, int> waiting;
+    bot.attachView([&](const VkUpdateView& update) {
+        const VkProfile* profile = bot.requestProfile(update.message.from_id);
+        if (profile) {
+            greet(update.message.peer_id, *profile);
+        } else {
+            waiting.insert(std::make_pair(update.message.from_id, update.message.peer_id));
+        }
+    });
+    bot.onProfile([&](const VkProfile& profile) {
+        std::pair<std::multimap<int, int>::iterator, std::multimap<int, int>::iterator> range =
+            waiting.equal_range(profile.id);
+        for (std::multimap<int, int>::iterator it = range.first; it != range.second; ++it) {
+            greet(it->second, profile);
+        }
+        waiting.erase(range.first, range.second);
+    });
+    if (!bot.begin()) {
+        printf("Бот не запустился\n");
+        return 1;
+    }
+
+    // Пачки по burst сообщений, авторы по кругу: в первой пачке все восемь сразу
+    int burst = opt.burst < PROFILE_SENDERS ? PROFILE_SENDERS : opt.burst;
+    std::map<std::string, int> expected;
+    std::vector<VkMockServer::SentMessage> replies;
+    unsigned long start = millis();
+    int pushed = 0;
+    while (pushed < opt.messages && millis() - start < LOOPBACK_TIMEOUT) {
+        for (int i = 0; i < burst && pushed < opt.messages; i++, pushed++) {
+            int from = LOOPBACK_FROM + 1 + pushed % PROFILE_SENDERS;
+            char text[32];
+            snprintf(text, sizeof(text), "msg %d", pushed);
+            server.pushMessage(LOOPBACK_PEER, from, text);
+            std::string reply = "Привет, " + VkMockServer::firstName(from);
+            if (from - LOOPBACK_FROM > PROFILE_MEMBERS) {
+                reply += " (не в беседе)";
+            } else if (from == LOOPBACK_FROM + 1) {
+                reply += " (админ)";
+            }
+            expected[reply]++;
+        }
+        // Ждем и отчетов бота: иначе следующая пачка может застать в очереди еще не
+        // подтвержденный execute и не поместиться в VK_OUTBOX_SIZE
+        while (((int)replies.size() < pushed || bot.pendingMessages() > 0) &&
+               millis() - start < LOOPBACK_TIMEOUT) {
+            bot.tick();
+            std::vector<VkMockServer::SentMessage> sent = server.takeSent();
+            replies.insert(replies.end(), sent.begin(), sent.end());
+            delay(1);
+        }
+    }
+    unsigned long elapsed = millis() - start;
+    String metrics = bot.getMetricsJson();
+    VkMockServer::Stats s = server.stats();
+    server.stop();
+
+    int correct = 0;
+    for (size_t i = 0; i < replies.size(); i++) {
+        std::map<std::string, int>::iterator it = expected.find(replies[i].text);
+        if (it != expected.end() && it->second > 0) {
+            it->second--;
+            correct++;
+        }
+    }
+    // Один users.get (в execute) на всех авторов, один список участников и по запросу на
+    // каждого, кого в беседе нет (отказ тоже кэшируется) - сколько бы сообщений ни пришло
+    unsigned long memberExpected = 1 + (PROFILE_SENDERS - PROFILE_MEMBERS);
+    printf("\n=== loopback: %d сообщений от %d авторов, пачки по %d ===\n", opt.messages, PROFILE_SENDERS, burst);
+    printf("Ответы:          %d/%d с верным именем и участием в беседе\n", correct, opt.messages);
+    printf("Запросы:         users.get %lu, getConversationMembers %lu (ожидается 1 и %lu), API всего %lu\n",
+           s.usersGet, s.memberRequests, memberExpected, s.apiRequests);
+    printf("Время:           %lu мс\n", elapsed);
+    printf("Метрики бота:    %s\n", metrics.c_str());
+    bool ok = correct == opt.messages && s.usersGet == 1 && s.memberRequests == memberExpected;
+    return ok ? 0 : 1;
+}
+
+#define BROADCAST_ALERTS 3
+
+static int runBroadcast(const Options& opt, VkMockServer& server, uint16_t port) {
+    int users = opt.broadcast < VkSubscribers::capacity() ? opt.broadcast : VkSubscribers::capacity();
+    DGO_VKbot bot;
+    VkRouter router;
+    VkSubscribers subscribers;
+    bot.setToken("loopback");
+    bot.setGroupId("-1");
+    bot.setApiEndpoint("127.0.0.1", port, false);
+    subscribers.attach(router, bot);
+    router.attach(bot);
+    uint32_t delivered = 0;
+    uint32_t failed = 0;
+    uint32_t chunks = 0;
+    bot.onSendComplete([&](const VkSendResult& result) {
+        if (result.recipients) {
+            chunks++;
+            delivered += result.recipients - result.failed;
+            failed += result.failed;
+        }
+    });
+    if (!bot.begin()) {
+        printf("Бот не запустился\n");
+        return 1;
+    }
+    unsigned long start = millis();
+    auto drain = [&](size_t expect, std::vector<VkMockServer::SentMessage>& out) {
+        while ((out.size() < expect || bot.pendingMessages() > 0) && millis() - start < LOOPBACK_TIMEOUT) {
+            bot.tick();
+            std::vector<VkMockServer::SentMessage> sent = server.takeSent();
+            out.insert(out.end(), sent.begin(), sent.end());
+            delay(1);
+        }
+    };
+
+    // Подписка: каждый пишет боту в личные сообщения, каждый десятый потом отписывается
+    std::set<long long> expected;
+    std::vector<VkMockServer::SentMessage> replies;
+    int commands = 0;
+    for (int i = 1; i <= users; i++) {
+        long long user = LOOPBACK_FROM + i;
+        server.pushMessage(user, user, i % 2 ? "подписаться" : "/subscribe");
+        commands++;
+        if (i % 10 == 0) {
+            server.pushMessage(user, user, "отписаться");
+            commands++;
+        } else {
+            expected.insert(user);
+        }
+        if (commands >= opt.burst) {
+            drain(replies.size() + commands, replies);
+            commands = 0;
+        }
+    }
+    drain(replies.size() + commands, replies);
+    bool listOk = subscribers.size() == expected.size();
+    for (std::set<long long>::iterator it = expected.begin(); it != expected.end(); ++it) {
+        listOk = listOk && subscribers.contains((int)*it);
+    }
+
+    // Рассылки: каждый седьмой запретил сообщения, остальные должны получить каждую ровно один раз
+    std::set<long long> reachable;
+    for (std::set<long long>::iterator it = expected.begin(); it != expected.end(); ++it) {
+        if ((*it - LOOPBACK_FROM) % 7 == 0) {
+            server.denyMessages(*it);
+        } else {
+            reachable.insert(*it);
+        }
+    }
+    VkMockServer::Stats before = server.stats();
+    unsigned long broadcastStart = millis();
+    std::map<std::string, std::set<long long> > got;
+    std::vector<VkMockServer::SentMessage> alerts;
+    uint16_t queued = 0;
+    for (int a = 0; a < BROADCAST_ALERTS; a++) {
+        char text[32];
+        snprintf(text, sizeof(text), "alert %d", a);
+        queued += bot.broadcast(text, subscribers);
+        drain(alerts.size() + reachable.size(), alerts);
+    }
+    unsigned long elapsed = millis() - broadcastStart;
+    VkMockServer::Stats after = server.stats();
+    String metrics = bot.getMetricsJson();
+    server.stop();
+
+    int duplicates = 0;
+    for (size_t i = 0; i < alerts.size(); i++) {
+        if (!got[alerts[i].text].insert(alerts[i].peerId).second || !reachable.count(alerts[i].peerId)) {
+            duplicates++;
+        }
+    }
+    int complete = 0;
+    for (int a = 0; a < BROADCAST_ALERTS; a++) {
+        char text[32];
+        snprintf(text, sizeof(text), "alert %d", a);
+        if (got[text] == reachable) {
+            complete++;
+        }
+    }
+    unsigned long requests = after.apiRequests - before.apiRequests;
+    uint32_t blocked = (uint32_t)(expected.size() - reachable.size()) * BROADCAST_ALERTS;
+    uint32_t chunksExpected = (uint32_t)((expected.size() + VK_BROADCAST_PEERS - 1) / VK_BROADCAST_PEERS) *
+                              BROADCAST_ALERTS;
+    unsigned long requestsExpected = (unsigned long)((expected.size() + VK_EXECUTE_PEERS - 1) / VK_EXECUTE_PEERS) *
+                                     BROADCAST_ALERTS;
+    printf("\n=== loopback: %d пользователей, подписаны %u, рассылок %d ===\n", users,
+           (unsigned)subscribers.size(), BROADCAST_ALERTS);
+    printf("Подписка:        %s, ответов на команды %u\n", listOk ? "список верный" : "СПИСОК НЕВЕРНЫЙ",
+           (unsigned)replies.size());
+    printf("Рассылки:        %d/%d дошли до всех %u получателей, лишних %d\n", complete, BROADCAST_ALERTS,
+           (unsigned)reachable.size(), duplicates);
+    printf("Отчеты:          пачек %u, доставлено %u, запрет сообщений %u (ожидается %u, %u и %u)\n",
+           (unsigned)chunks, (unsigned)delivered, (unsigned)failed, (unsigned)chunksExpected,
+           (unsigned)(reachable.size() * BROADCAST_ALERTS), (unsigned)blocked);
+    printf("Запросы:         API %lu (ожидается %lu), messages.send с peer_ids %lu\n", requests, requestsExpected,
+           after.multiSends - before.multiSends);
+    printf("Время:           %lu мс\n", elapsed);
+    printf("Метрики бота:    %s\n", metrics.c_str());
+    bool ok = listOk && complete == BROADCAST_ALERTS && duplicates == 0 &&
+              queued == expected.size() * BROADCAST_ALERTS && chunks == chunksExpected &&
+              delivered == reachable.size() * BROADCAST_ALERTS && failed == blocked && requests == requestsExpected;
+    return ok ? 0 : 1;
+}
+
+#define LIVE_INTERVAL 150
+
+// Показание "датчика" в момент t мс от начала: 0-1000 меняется раз в 300 мс, 1000-1500 -
+// каждые 10 мс, дальше стоит до 2500, потом меняется один раз
+static int liveValue(unsigned long t) {
+    if (t < 1000) return (int)(t / 300);
+    if (t < 1500) return 100 + (int)(t / 10);
+    if (t < 2500) return 1000;
+    return 2000;
+}
+
+static int runLive(const Options& opt, VkMockServer& server, uint16_t port) {
+    DGO_VKbot bot;
+    VkLiveMessage live(LOOPBACK_PEER, LIVE_INTERVAL);
+    bot.setToken("loopback");
+    bot.setGroupId("-1");
+    bot.setApiEndpoint("127.0.0.1", port, false);
+    if (!bot.begin() || (opt.task && !bot.startNetworkTask())) {
+        printf("Бот не запустился\n");
+        return 1;
+    }
+
+    unsigned long start = millis();
+    unsigned long t = 0;
+    unsigned long calls = 0;
+    int changes = 0;
+    int last = -1;
+    bool glitched = false;
+    bool denied = false;
+    String text;
+    while ((t = millis() - start) < 3000) {
+        int value = liveValue(t);
+        if (value != last) {
+            last = value;
+            changes++;
+        }
+        if (t >= 1200 && !glitched) {
+            // Временная ошибка: сообщение остается, правка повторяется, нового сообщения нет
+            server.pushApiError("messages.edit", 10);
+            glitched = true;
+        }
+        if (t >= 2500 && !denied) {
+            // Сообщение "устарело": правка не пройдет, сводка должна уйти новым сообщением
+            server.pushApiError("messages.edit", 909);
+            denied = true;
+        }
+        text = "Температура: " + String(value) + " °C";
+        bot.updateLive(live, text);
+        calls++;
+        bot.tick();
+        delay(1);
+    }
+    // Догоняем последнее значение: интервал мог не дать его показать
+    while ((live.pending() || server.messageText(LOOPBACK_PEER, live.conversationMessageId()) != text.c_str()) &&
+           millis() - start < 10000) {
+        bot.updateLive(live, text);
+        calls++;
+        bot.tick();
+        delay(1);
+    }
+    bot.stopNetworkTask();
+    std::string shown = server.messageText(LOOPBACK_PEER, live.conversationMessageId());
+    VkMockServer::Stats s = server.stats();
+    String metrics = bot.getMetricsJson();
+    server.stop();
+
+    // Не больше одного запроса на изменение и не чаще интервала
+    // (+ отправка, повтор после ошибки 10 и новое сообщение после 909)
+    unsigned long elapsed = millis() - start;
+    unsigned long limit = elapsed / LIVE_INTERVAL + 4;
+    unsigned long requests = live.requests();
+    printf("\n=== loopback: живое сообщение, интервал %d мс%s ===\n", LIVE_INTERVAL, opt.task ? ", сетевая задача" : "");
+    printf("Обновления:      %lu вызовов, %d изменений значения, пропущено %lu\n", calls, changes,
+           (unsigned long)live.skipped());
+    printf("Запросы:         %lu (не больше %lu): messages.send %lu, messages.edit %lu, API всего %lu\n",
+           requests, limit, s.sentMessages, s.edits, s.apiRequests);
+    printf("Итог:            %s (\"%s\")\n", shown == text.c_str() ? "показано последнее значение" : "НЕ СОВПАДАЕТ",
+           shown.c_str());
+    printf("Метрики бота:    %s\n", metrics.c_str());
+    bool ok = shown == text.c_str() && s.sentMessages == 2 && requests <= limit && requests <= (unsigned long)changes + 3 &&
+              requests == s.sentMessages + s.edits + 2;
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv) {
+    Options opt = { 200, 10, false, false, false, 0, false, false, false, 0, 0, false, 0, 0, false, false, 0, false };
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--messages" && i + 1 < argc) {
+            opt.messages = atoi(argv[++i]);
+        } else if (arg == "--burst" && i + 1 < argc) {
+            opt.burst = atoi(argv[++i]);
+        } else if (arg == "--sync") {
+            opt.sync = true;
+        } else if (arg == "--storm") {
+            opt.storm = true;
+        } else if (arg == "--chunked") {
+            opt.chunked = true;
+        } else if (arg == "--rate" && i + 1 < argc) {
+            opt.rate = (unsigned)atoi(argv[++i]);
+        } else if (arg == "--restart") {
+            opt.restart = true;
+        } else if (arg == "--sleep") {
+            opt.sleep = true;
+        } else if (arg == "--task") {
+            opt.task = true;
+        } else if (arg == "--latency" && i + 1 < argc) {
+            opt.latency = atoi(argv[++i]);
+        } else if (arg == "--clock" && i + 1 < argc) {
+            opt.clockPpm = atol(argv[++i]);
+        } else if (arg == "--view") {
+            opt.view = true;
+        } else if (arg == "--hub" && i + 1 < argc) {
+            opt.hub = atoi(argv[++i]);
+        } else if (arg == "--upload" && i + 1 < argc) {
+            opt.upload = atoi(argv[++i]);
+        } else if (arg == "--buttons") {
+            opt.buttons = true;
+        } else if (arg == "--profiles") {
+            opt.profiles = true;
+        } else if (arg == "--broadcast" && i + 1 < argc) {
+            opt.broadcast = atoi(argv[++i]);
+        } else if (arg == "--live") {
+            opt.live = true;
+        } else {
+            printf("Использование: %s [--messages N] [--burst N] [--sync] [--storm] [--chunked] [--rate N] [--restart]\n"
+                   "       [--sleep] [--task] [--latency мс] [--clock ppm] [--view] [--hub N] [--upload КБ]\n"
+                   "       [--buttons] [--profiles] [--broadcast N] [--live]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+    if (opt.burst < 1) opt.burst = 1;
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    VkMockServer server;
+    server.setChunked(opt.chunked);
+    server.setRateLimit(opt.rate);
+    server.setLatency(opt.latency);
+    if (opt.clockPpm) {
+        server.setClockSkew(opt.clockPpm, 3700);
+    }
+    uint16_t port = server.start();
+    if (!port) {
+        printf("Не удалось запустить mock сервер\n");
+        return 1;
+    }
+
+    if (opt.hub > 0) {
+        return runHub(opt, server, port);
+    }
+    if (opt.upload > 0) {
+        return runUpload(opt, server, port);
+    }
+    if (opt.buttons) {
+        return runButtons(opt, server, port);
+    }
+    if (opt.profiles) {
+        return runProfiles(opt, server, port);
+    }
+    if (opt.broadcast > 0) {
+        return runBroadcast(opt, server, port);
+    }
+    if (opt.live) {
+        return runLive(opt, server, port);
+    }
+
+    // Бот пересоздается при --restart: состояние Long Poll переживает его в "RTC памяти"
+    std::unique_ptr<DGO_VKbot> bot;
+    std::function<bool()> startBot = [&]() {
+        bot.reset(new DGO_VKbot());
+        bot->setToken("loopback");
+        bot->setGroupId("-1");
+        bot->setApiEndpoint("127.0.0.1", port, false);
+        auto answer = [&](const char* text, int peer_id) {
+            String reply = "echo: ";
+            reply += text;
+            if (opt.sync) {
+                bot->sendMessage(reply, peer_id);
+            } else {
+                bot->enqueueMessage(reply, peer_id);
+            }
+        };
+        if (opt.view) {
+            bot->attachView([&, answer](const VkUpdateView& update) {
+                answer(update.message.text.c_str(), update.message.peer_id);
+            });
+        } else {
+            bot->attach([&, answer](VkUpdate& update) {
+                answer(update.message.text.c_str(), update.message.peer_id);
+            });
+        }
+        if (!bot->begin()) {
+            return false;
+        }
+        return !opt.task || bot->startNetworkTask();
+    };
+    if (opt.sleep) {
+        return runSleep(opt, server, startBot, bot);
+    }
+    if (opt.clockPpm) {
+        return runClock(opt, server, startBot, bot);
+    }
+    if (!startBot()) {
+        printf("Бот не запустился\n");
+        return 1;
+    }
+
+    // Когда отправили каждое сообщение (по тексту ответа)
+    std::map<std::string, unsigned long> pushedAt;
+    std::vector<unsigned long> latencies;
+    unsigned long maxTick = 0;
+    int pushed = 0;
+    int stormStep = 0;
+    bool stormSent = false;
+    unsigned long lostAfter = 0;    // После failed 3 события до нового ts теряются (так задумано в VK)
+    int bursts = 0;
+    int restarts = 0;
+    unsigned long restartedAt = 0;
+    std::vector<unsigned long> firstReply;  // От перезапуска до первого ответа
+    std::set<std::string> answeredTexts;
+    int replays = 0;
+    unsigned long start = millis();
+
+    while ((int)latencies.size() < opt.messages && millis() - start < LOOPBACK_TIMEOUT) {
+        // Следующая пачка, когда ответы на предыдущую получены
+        bool needBurst = pushed < opt.messages && (int)latencies.size() == pushed;
+
+        if (needBurst && opt.storm && !stormSent) {
+            switch (stormStep++ % 5) {
+                case 0: server.pushFailed(2); break;
+                case 1: server.pushHttpError(503); break;
+                case 2: server.pushFailed(1); break;
+                case 3:
+                    server.pushFailed(3);
+                    lostAfter = server.stats().lpRequests;
+                    break;
+                case 4: server.pushTimeout(); break;
+            }
+            stormSent = true;
+        }
+
+        // После failed 3 ждем, пока бот возьмет новый ts и снова начнет a_check
+        if (lostAfter && server.pendingActions() == 0 && server.stats().lpRequests > lostAfter + 1) {
+            lostAfter = 0;
+        }
+
+        // Перезагрузка: бота нет, пока приходит пачка, потом он продолжает с сохраненного ts
+        bool restartNow = needBurst && !lostAfter && opt.restart && bursts % 2 == 1;
+        if (restartNow) {
+            bot.reset();
+        }
+
+        if (needBurst && !lostAfter) {
+            bursts++;
+            for (int i = 0; i < opt.burst && pushed < opt.messages; i++, pushed++) {
+                char text[32];
+                snprintf(text, sizeof(text), "msg %d", pushed);
+                pushedAt[std::string("echo: ") + text] = millis();
+                server.pushMessage(LOOPBACK_PEER, LOOPBACK_FROM, text);
+            }
+            stormSent = false;
+        }
+
+        if (restartNow) {
+            delay(20);
+            if (!startBot()) {
+                printf("Бот не запустился после перезапуска\n");
+                break;
+            }
+            restarts++;
+            restartedAt = millis();
+        }
+
+        unsigned long t = micros();
+        bot->tick();
+        t = micros() - t;
+        if (t > maxTick) maxTick = t;
+
+        std::vector<VkMockServer::SentMessage> sent = server.takeSent();
+        for (size_t i = 0; i < sent.size(); i++) {
+            std::map<std::string, unsigned long>::iterator it = pushedAt.find(sent[i].text);
+            if (it != pushedAt.end()) {
+                latencies.push_back(sent[i].atMs - it->second);
+                pushedAt.erase(it);
+                answeredTexts.insert(sent[i].text);
+                if (restartedAt) {
+                    firstReply.push_back(sent[i].atMs - restartedAt);
+                    restartedAt = 0;
+                }
+            } else if (answeredTexts.count(sent[i].text)) {
+                replays++;
+            }
+        }
+        delay(1);
+    }
+
+    unsigned long elapsed = millis() - start;
+    VkMockServer::Stats s = server.stats();
+    // Метрики читаем, когда сетевой поток уже остановлен
+    if (opt.task && bot) {
+        bot->stopNetworkTask();
+    }
+    String metrics = bot ? bot->getMetricsJson() : String();
+    server.stop();
+
+    int answered = (int)latencies.size();
+    std::sort(latencies.begin(), latencies.end());
+    printf("\n=== loopback: %d сообщений, пачки по %d, %s%s%s%s%s ===\n", opt.messages, opt.burst,
+           opt.sync ? "sendMessage" : "очередь", opt.storm ? ", шторм" : "", opt.chunked ? ", chunked" : "",
+           opt.restart ? ", перезапуски" : "", opt.task ? ", сетевой поток" : "");
+    printf("Отвечено:        %d из %d за %lu мс (%.1f сообщ/с)\n", answered, opt.messages, elapsed,
+           elapsed ? answered * 1000.0 / elapsed : 0.0);
+    printf("Задержка, мс:    p50 %lu  p95 %lu  p99 %lu  max %lu\n", percentile(latencies, 50),
+           percentile(latencies, 95), percentile(latencies, 99), latencies.empty() ? 0 : latencies.back());
+    printf("Самый долгий tick(): %lu мкс\n", maxTick);
+    printf("Сервер:          соединений %lu, a_check %lu, getLongPollServer %lu, API %lu, execute %lu\n",
+           s.connections, s.lpRequests, s.lpServerRequests, s.apiRequests, s.executeRequests);
+    printf("                 ошибок API %lu, повторов random_id %lu\n", s.apiErrors, s.duplicates);
+    printf("Метрики бота:    %s\n", metrics.c_str());
+    if (opt.restart) {
+        std::sort(firstReply.begin(), firstReply.end());
+        printf("Перезапусков:    %d, повторных событий %d, до первого ответа p50 %lu max %lu мс\n", restarts,
+               replays, percentile(firstReply, 50), firstReply.empty() ? 0 : firstReply.back());
+    }
+    return answered == opt.messages && replays == 0 ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+// vk_mock_server.cpp - Mock сервер VK как отдельная программа
+// Бот (например, собранный на хосте) подключается к нему через setApiEndpoint()
+//
+// Запуск: vk_mock_server [--port N] [--script файл] [--chunked] [--rate N] [--quiet]
+//
+// Команды сценария (по одной в строке, # - комментарий):
+//   message <peer_id> <from_id> <текст>   входящее сообщение
+//   button <peer_id> <from_id> <c> <текст>  нажатие обычной кнопки с payload {"c":c}
+//   callback <peer_id> <user_id> <c> [a]  нажатие callback-кнопки с payload {"c":c,"a":a}
+//   failed <1|2|3>                        ответ {"failed": N} на следующий a_check
+//   timeout                               следующий a_check без ответа
+//   http <код>                            HTTP ошибка на следующий a_check
+//   api_error <метод> <код>               ошибка VK на следующий вызов метода
+//   upload_error <код>                    HTTP ошибка на следующую загрузку файла
+//   deny <peer_id>                        получатель запретил сообщения (ошибка 901)
+//   sleep <мс>                            пауза
+//   wait_sent <N> [мс]                    дождаться N отправленных ботом сообщений
+
+#include <Arduino.h>
+#include <signal.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "VkMockServer.h"
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int) {
+    stopRequested = 1;
+}
+
+static void printSent(VkMockServer& server) {
+    std::vector<VkMockServer::SentMessage> sent = server.takeSent();
+    for (size_t i = 0; i < sent.size(); i++) {
+        printf("[mock] %s %lld: %s%s%s\n", sent[i].viaExecute ? "execute" : "send",
+               sent[i].peerId, sent[i].text.c_str(), sent[i].attachment.empty() ? "" : " + ",
+               sent[i].attachment.c_str());
+        if (!sent[i].keyboard.empty()) {
+            printf("[mock]   keyboard: %s\n", sent[i].keyboard.c_str());
+        }
+    }
+    std::vector<VkMockServer::EventAnswer> answers = server.takeAnswers();
+    for (size_t i = 0; i < answers.size(); i++) {
+        printf("[mock] answer %s %lld: %s\n", answers[i].eventId.c_str(), answers[i].peerId,
+               answers[i].eventData.c_str());
+    }
+    fflush(stdout);
+}
+
+static bool runCommand(VkMockServer& server, const std::string& line) {
+    std::istringstream in(line);
+    std::string cmd;
+    in >> cmd;
+    if (cmd.empty() || cmd[0] == '#') {
+        return true;
+    }
+
+    if (cmd == "message") {
+        long long peerId = 0;
+        long long fromId = 0;
+        std::string text;
+        in >> peerId >> fromId;
+        std::getline(in >> std::ws, text);
+        server.pushMessage(peerId, fromId, text);
+    } else if (cmd == "button" || cmd == "callback") {
+        long long peerId = 0;
+        long long fromId = 0;
+        int command = 0;
+        in >> peerId >> fromId >> command;
+        char payload[48];
+        if (cmd == "button") {
+            std::string text;
+            std::getline(in >> std::ws, text);
+            snprintf(payload, sizeof(payload), "{\"c\":%d}", command);
+            server.pushButton(peerId, fromId, text, payload);
+        } else {
+            long arg = 0;
+            in >> arg;
+            snprintf(payload, sizeof(payload), arg ? "{\"c\":%d,\"a\":%ld}" : "{\"c\":%d}", command, arg);
+            server.pushCallback(peerId, fromId, payload);
+        }
+    } else if (cmd == "failed") {
+        int code = 0;
+        in >> code;
+        server.pushFailed(code);
+    } else if (cmd == "timeout") {
+        server.pushTimeout();
+    } else if (cmd == "http") {
+        int status = 0;
+        in >> status;
+        server.pushHttpError(status);
+    } else if (cmd == "api_error") {
+        std::string method;
+        int code = 0;
+        in >> method >> code;
+        server.pushApiError(method, code);
+    } else if (cmd == "upload_error") {
+        int status = 0;
+        in >> status;
+        server.pushUploadError(status);
+    } else if (cmd == "deny") {
+        long long peer = 0;
+        in >> peer;
+        server.denyMessages(peer);
+    } else if (cmd == "sleep") {
+        unsigned long ms = 0;
+        in >> ms;
+        delay(ms);
+    } else if (cmd == "wait_sent") {
+        size_t count = 0;
+        unsigned long ms = 60000;
+        in >> count >> ms;
+        if (!server.waitSent(count, ms)) {
+            printf("[mock] Не дождались %zu сообщений\n", count);
+        }
+    } else {
+        printf("[mock] Неизвестная команда: %s\n", cmd.c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    uint16_t port = 8080;
+    const char* script = nullptr;
+    VkMockServer server;
+    server.setLog(true);
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            port = (uint16_t)atoi(argv[++i]);
+        } else if (arg == "--script" && i + 1 < argc) {
+            script = argv[++i];
+        } else if (arg == "--chunked") {
+            server.setChunked(true);
+        } else if (arg == "--rate" && i + 1 < argc) {
+            server.setRateLimit((unsigned)atoi(argv[++i]));
+        } else if (arg == "--quiet") {
+            server.setLog(false);
+        } else {
+            printf("Использование: %s [--port N] [--script файл] [--chunked] [--rate N] [--quiet]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!server.start(port)) {
+        printf("[mock] Не удалось открыть порт %u\n", (unsigned)port);
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("[mock] Слушаю http://127.0.0.1:%u\n", (unsigned)server.port());
+    printf("[mock] В боте: bot.setApiEndpoint(\"127.0.0.1\", %u, false)\n", (unsigned)server.port());
+    fflush(stdout);
+
+    if (script) {
+        std::ifstream file(script);
+        if (!file) {
+            printf("[mock] Не удалось открыть сценарий %s\n", script);
+            return 1;
+        }
+        std::string line;
+        while (!stopRequested && std::getline(file, line)) {
+            runCommand(server, line);
+            printSent(server);
+        }
+        printf("[mock] Сценарий выполнен\n");
+    }
+
+    while (!stopRequested) {
+        delay(100);
+        printSent(server);
+    }
+
+    VkMockServer::Stats s = server.stats();
+    printf("[mock] Соединений: %lu, a_check: %lu, API: %lu, отправлено: %lu, повторов: %lu, файлов: %lu\n",
+           s.connections, s.lpRequests, s.apiRequests, s.sentMessages, s.duplicates, s.uploads);
+    server.stop();
+    return 0;
+}